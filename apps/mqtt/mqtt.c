@@ -132,12 +132,12 @@ typedef enum {
 #define PT_MQTT_WRITE_BYTES(conn, data, len)                                   \
   conn->out_write_pos = 0;                                                     \
   while(write_bytes(conn, data, len)) {                                        \
-    PT_WAIT_UNTIL(pt, (conn)->out_buffer_sent);                                \
+    PT_WAIT_UNTIL(pt, tcp_socket_max_sendlen(&(conn)->socket) > 0);            \
   }
 
 #define PT_MQTT_WRITE_BYTE(conn, data)                                         \
   while(write_byte(conn, data)) {                                              \
-    PT_WAIT_UNTIL(pt, (conn)->out_buffer_sent);                                \
+    PT_WAIT_UNTIL(pt, tcp_socket_max_sendlen(&(conn)->socket) > 0);            \
   }
 /*---------------------------------------------------------------------------*/
 /*
@@ -219,9 +219,13 @@ reset_defaults(struct mqtt_connection *conn)
 static void
 abort_connection(struct mqtt_connection *conn)
 {
-  conn->out_buffer_ptr = conn->out_buffer;
   conn->out_queue_full = 0;
 
+  /* Forget the PUBLISH messages waiting for a PUBACK, the session is clean */
+  ctimer_stop(&conn->inflight_timer);
+  memset(conn->inflight, 0, sizeof(conn->inflight));
+  conn->inflight_count = 0;
+
   /* Reset outgoing packet */
   memset(&conn->out_packet, 0, sizeof(conn->out_packet));
 
@@ -263,17 +267,16 @@ disconnect_tcp(struct mqtt_connection *conn)
 static void
 send_out_buffer(struct mqtt_connection *conn)
 {
-  if(conn->out_buffer_ptr - conn->out_buffer == 0) {
+  if(tcp_socket_queuelen(&conn->socket) == 0) {
     conn->out_buffer_sent = 1;
     return;
   }
   conn->out_buffer_sent = 0;
 
   DBG("MQTT - (send_out_buffer) Space used in buffer: %i\n",
-      conn->out_buffer_ptr - conn->out_buffer);
+      tcp_socket_queuelen(&conn->socket));
 
-  tcp_socket_send(&conn->socket, conn->out_buffer,
-                  conn->out_buffer_ptr - conn->out_buffer);
+  tcp_socket_flush(&conn->socket);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -291,20 +294,22 @@ string_to_mqtt_string(struct mqtt_string *mqtt_string, char *string)
   }
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * The data is queued directly in the TCP socket output buffer, it is only
+ * handed to the TCP/IP stack by send_out_buffer(), or when the buffer is full.
+ */
 static int
 write_byte(struct mqtt_connection *conn, uint8_t data)
 {
   DBG("MQTT - (write_byte) buff_size: %i write: '%02X'\n",
-      &conn->out_buffer[MQTT_TCP_OUTPUT_BUFF_SIZE] - conn->out_buffer_ptr,
+      tcp_socket_max_sendlen(&conn->socket),
       data);
 
-  if(&conn->out_buffer[MQTT_TCP_OUTPUT_BUFF_SIZE] - conn->out_buffer_ptr == 0) {
+  if(tcp_socket_queue(&conn->socket, &data, 1) != 1) {
     send_out_buffer(conn);
     return 1;
   }
 
-  *conn->out_buffer_ptr = data;
-  conn->out_buffer_ptr++;
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -312,13 +317,10 @@ static int
 write_bytes(struct mqtt_connection *conn, uint8_t *data, uint16_t len)
 {
   uint16_t write_bytes;
-  write_bytes =
-    MIN(&conn->out_buffer[MQTT_TCP_OUTPUT_BUFF_SIZE] - conn->out_buffer_ptr,
-        len - conn->out_write_pos);
+  write_bytes = tcp_socket_queue(&conn->socket, &data[conn->out_write_pos],
+                                 len - conn->out_write_pos);
 
-  memcpy(conn->out_buffer_ptr, &data[conn->out_write_pos], write_bytes);
   conn->out_write_pos += write_bytes;
-  conn->out_buffer_ptr += write_bytes;
 
   DBG("MQTT - (write_bytes) len: %u write_pos: %lu\n", len,
       conn->out_write_pos);
@@ -332,6 +334,48 @@ write_bytes(struct mqtt_connection *conn, uint8_t *data, uint16_t len)
   }
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Queues as much of the PUBLISH payload as the output buffer can hold, either
+ * copied from the application buffer or written in place by the payload
+ * callback. Returns the number of bytes left to write, or -1 on error.
+ */
+static int32_t
+write_payload(struct mqtt_connection *conn)
+{
+  struct mqtt_out_packet *packet = &conn->out_packet;
+  uint8_t *buf;
+  int space;
+  int len;
+
+  while(conn->out_write_pos < packet->payload_size) {
+    buf = tcp_socket_output_space(&conn->socket, &space);
+    len = MIN(space, packet->payload_size - conn->out_write_pos);
+    if(len == 0) {
+      break;
+    }
+    if(packet->payload_callback != NULL) {
+      len = packet->payload_callback(conn, packet->payload_ptr,
+                                     conn->out_write_pos, buf, len);
+      if(len < 0 || len > space) {
+        return -1;
+      }
+      if(len == 0) {
+        break;
+      }
+      tcp_socket_queue(&conn->socket, NULL, len);
+    } else {
+      tcp_socket_queue(&conn->socket, &packet->payload[conn->out_write_pos],
+                       len);
+    }
+    conn->out_write_pos += len;
+  }
+
+  DBG("MQTT - (write_payload) size: %lu write_pos: %lu\n",
+      packet->payload_size, conn->out_write_pos);
+
+  return packet->payload_size - conn->out_write_pos;
+}
+/*---------------------------------------------------------------------------*/
 static void
 encode_remaining_length(uint8_t *remaining_length,
                         uint8_t *remaining_length_bytes,
@@ -357,6 +401,86 @@ encode_remaining_length(uint8_t *remaining_length,
 }
 /*---------------------------------------------------------------------------*/
 static void
+inflight_callback(void *ptr)
+{
+  struct mqtt_connection *conn = ptr;
+  clock_time_t next = 0;
+  clock_time_t remaining;
+  uint8_t was_full;
+  int i;
+
+  was_full = conn->inflight_count >= MQTT_MAX_INFLIGHT;
+
+  for(i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+    if(conn->inflight[i].mid == 0) {
+      continue;
+    }
+    if(timer_expired(&conn->inflight[i].timeout)) {
+      DBG("MQTT - Timeout waiting for PUBACK of %u\n", conn->inflight[i].mid);
+      conn->inflight[i].mid = 0;
+      conn->inflight_count--;
+    } else {
+      remaining = timer_remaining(&conn->inflight[i].timeout);
+      if(next == 0 || remaining < next) {
+        next = remaining;
+      }
+    }
+  }
+
+  if(next > 0) {
+    ctimer_set(&conn->inflight_timer, next, inflight_callback, conn);
+  }
+
+  /* The window was holding the out queue, let the application go on */
+  if(was_full && conn->inflight_count < MQTT_MAX_INFLIGHT) {
+    conn->out_queue_full = 0;
+    process_post(conn->app_process, mqtt_update_event, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+inflight_add(struct mqtt_connection *conn, uint16_t mid)
+{
+  int i;
+
+  for(i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+    if(conn->inflight[i].mid == 0) {
+      conn->inflight[i].mid = mid;
+      timer_set(&conn->inflight[i].timeout, RESPONSE_WAIT_TIMEOUT);
+      conn->inflight_count++;
+      break;
+    }
+  }
+
+  if(ctimer_expired(&conn->inflight_timer)) {
+    ctimer_set(&conn->inflight_timer, RESPONSE_WAIT_TIMEOUT,
+               inflight_callback, conn);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+inflight_remove(struct mqtt_connection *conn, uint16_t mid)
+{
+  int i;
+
+  for(i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+    if(conn->inflight[i].mid == mid) {
+      /* A full window is what kept the out queue full */
+      if(conn->inflight_count >= MQTT_MAX_INFLIGHT) {
+        conn->out_queue_full = 0;
+      }
+      conn->inflight[i].mid = 0;
+      conn->inflight_count--;
+      if(conn->inflight_count == 0) {
+        ctimer_stop(&conn->inflight_timer);
+      }
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
 keep_alive_callback(void *ptr)
 {
   struct mqtt_connection *conn = ptr;
@@ -417,16 +541,16 @@ PT_THREAD(connect_pt(struct pt *pt, struct mqtt_connection *conn))
   PT_MQTT_WRITE_BYTE(conn, conn->connect_vhdr_flags);
   PT_MQTT_WRITE_BYTE(conn, (conn->keep_alive >> 8));
   PT_MQTT_WRITE_BYTE(conn, (conn->keep_alive & 0x00FF));
-  PT_MQTT_WRITE_BYTE(conn, conn->client_id.length << 8);
+  PT_MQTT_WRITE_BYTE(conn, conn->client_id.length >> 8);
   PT_MQTT_WRITE_BYTE(conn, conn->client_id.length & 0x00FF);
   PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->client_id.string,
                       conn->client_id.length);
   if(conn->connect_vhdr_flags & MQTT_VHDR_WILL_FLAG) {
-    PT_MQTT_WRITE_BYTE(conn, conn->will.topic.length << 8);
+    PT_MQTT_WRITE_BYTE(conn, conn->will.topic.length >> 8);
     PT_MQTT_WRITE_BYTE(conn, conn->will.topic.length & 0x00FF);
     PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->will.topic.string,
                         conn->will.topic.length);
-    PT_MQTT_WRITE_BYTE(conn, conn->will.message.length << 8);
+    PT_MQTT_WRITE_BYTE(conn, conn->will.message.length >> 8);
     PT_MQTT_WRITE_BYTE(conn, conn->will.message.length & 0x00FF);
     PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->will.message.string,
                         conn->will.message.length);
@@ -437,14 +561,14 @@ PT_THREAD(connect_pt(struct pt *pt, struct mqtt_connection *conn))
         conn->will.message.length);
   }
   if(conn->connect_vhdr_flags & MQTT_VHDR_USERNAME_FLAG) {
-    PT_MQTT_WRITE_BYTE(conn, conn->credentials.username.length << 8);
+    PT_MQTT_WRITE_BYTE(conn, conn->credentials.username.length >> 8);
     PT_MQTT_WRITE_BYTE(conn, conn->credentials.username.length & 0x00FF);
     PT_MQTT_WRITE_BYTES(conn,
                         (uint8_t *)conn->credentials.username.string,
                         conn->credentials.username.length);
   }
   if(conn->connect_vhdr_flags & MQTT_VHDR_PASSWORD_FLAG) {
-    PT_MQTT_WRITE_BYTE(conn, conn->credentials.password.length << 8);
+    PT_MQTT_WRITE_BYTE(conn, conn->credentials.password.length >> 8);
     PT_MQTT_WRITE_BYTE(conn, conn->credentials.password.length & 0x00FF);
     PT_MQTT_WRITE_BYTES(conn,
                         (uint8_t *)conn->credentials.password.string,
@@ -473,7 +597,7 @@ PT_THREAD(connect_pt(struct pt *pt, struct mqtt_connection *conn))
 #if DEBUG_MQTT == 1
   DBG("MQTT - CONNECT message sent: \n");
   uint16_t i;
-  for(i = 0; i < (conn->out_buffer_ptr - conn->out_buffer); i++) {
+  for(i = 0; i < tcp_socket_queuelen(&conn->socket); i++) {
     DBG("%02X ", conn->out_buffer[i]);
   }
   DBG("\n");
@@ -512,7 +636,7 @@ PT_THREAD(subscribe_pt(struct pt *pt, struct mqtt_connection *conn))
       conn->out_packet.topic,
       conn->out_packet.topic_length);
   DBG("MQTT - Buffer space is %i \n",
-      &conn->out_buffer[MQTT_TCP_OUTPUT_BUFF_SIZE] - conn->out_buffer_ptr);
+      tcp_socket_max_sendlen(&conn->socket));
 
   /* Set up FHDR */
   conn->out_packet.fhdr = MQTT_FHDR_MSG_TYPE_SUBSCRIBE | MQTT_FHDR_QOS_LEVEL_1;
@@ -535,7 +659,7 @@ PT_THREAD(subscribe_pt(struct pt *pt, struct mqtt_connection *conn))
                       conn->out_packet.remaining_length_enc,
                       conn->out_packet.remaining_length_enc_bytes);
   /* Write Variable Header */
-  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid << 8));
+  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid >> 8));
   PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid & 0x00FF));
   /* Write Payload */
   PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.topic_length >> 8));
@@ -575,7 +699,7 @@ PT_THREAD(unsubscribe_pt(struct pt *pt, struct mqtt_connection *conn))
       conn->out_packet.topic,
       conn->out_packet.topic_length);
   DBG("MQTT - Buffer space is %i \n",
-      &conn->out_buffer[MQTT_TCP_OUTPUT_BUFF_SIZE] - conn->out_buffer_ptr);
+      tcp_socket_max_sendlen(&conn->socket));
 
   /* Set up FHDR */
   conn->out_packet.fhdr = MQTT_FHDR_MSG_TYPE_UNSUBSCRIBE |
@@ -597,7 +721,7 @@ PT_THREAD(unsubscribe_pt(struct pt *pt, struct mqtt_connection *conn))
   PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->out_packet.remaining_length_enc,
                       conn->out_packet.remaining_length_enc_bytes);
   /* Write Variable Header */
-  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid << 8));
+  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid >> 8));
   PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid & 0x00FF));
   /* Write Payload */
   PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.topic_length >> 8));
@@ -631,13 +755,16 @@ PT_THREAD(unsubscribe_pt(struct pt *pt, struct mqtt_connection *conn))
 static
 PT_THREAD(publish_pt(struct pt *pt, struct mqtt_connection *conn))
 {
+  static mqtt_event_t event = MQTT_EVENT_ERROR;
+  int32_t left;
+
   PT_BEGIN(pt);
 
   DBG("MQTT - Sending publish message! topic %s topic_length %i\n",
       conn->out_packet.topic,
       conn->out_packet.topic_length);
   DBG("MQTT - Buffer space is %i \n",
-      &conn->out_buffer[MQTT_TCP_OUTPUT_BUFF_SIZE] - conn->out_buffer_ptr);
+      tcp_socket_max_sendlen(&conn->socket));
 
   /* Set up FHDR */
   conn->out_packet.fhdr = MQTT_FHDR_MSG_TYPE_PUBLISH |
@@ -670,46 +797,45 @@ PT_THREAD(publish_pt(struct pt *pt, struct mqtt_connection *conn))
   PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->out_packet.topic,
                       conn->out_packet.topic_length);
   if(conn->out_packet.qos > MQTT_QOS_LEVEL_0) {
-    PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid << 8));
+    PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid >> 8));
     PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid & 0x00FF));
   }
-  /* Write Payload */
-  PT_MQTT_WRITE_BYTES(conn,
-                      conn->out_packet.payload,
-                      conn->out_packet.payload_size);
+  /* Write Payload, in as many pieces as the output buffer requires */
+  conn->out_write_pos = 0;
+  while((left = write_payload(conn)) > 0) {
+    send_out_buffer(conn);
+    PT_YIELD(pt);
+  }
+  if(left < 0) {
+    /* The message is truncated, the stream can not be recovered */
+    PRINTF("MQTT - Error, payload callback failed\n");
+    call_event(conn, MQTT_EVENT_ERROR, NULL);
+    ctimer_stop(&conn->keep_alive_timer);
+    abort_connection(conn);
+    call_event(conn, MQTT_EVENT_DISCONNECTED, &event);
+    PT_EXIT(pt);
+  }
 
   send_out_buffer(conn);
-  timer_set(&conn->t, RESPONSE_WAIT_TIMEOUT);
 
   /*
-   * If QoS is zero then wait until the message has been sent, since there is
-   * no ACK to wait for.
+   * The PUBACK is not waited for, the message is recorded in the in-flight
+   * window instead so that the next messages can be sent right away. The out
+   * queue stays full only when the window is.
    *
-   * Also notify the app will not be notified via PUBACK or PUBCOMP
+   * The app is notified that the payload has been queued and its buffer can
+   * be reused.
    */
-  if(conn->out_packet.qos == 0) {
-    process_post(conn->app_process, mqtt_update_event, NULL);
-  } else if(conn->out_packet.qos == 1) {
-    /* Wait for PUBACK */
-    reset_packet(&conn->in_packet);
-    PT_WAIT_UNTIL(pt, conn->out_packet.qos_state == MQTT_QOS_STATE_GOT_ACK ||
-                  timer_expired(&conn->t));
-    if(timer_expired(&conn->t)) {
-      DBG("Timeout waiting for PUBACK\n");
-    }
-    if(conn->in_packet.mid != conn->out_packet.mid) {
-      DBG("MQTT - Warning, got PUBACK with none matching MID. Currently there "
-          "is no support for several concurrent PUBLISH messages.\n");
-    }
+  if(conn->out_packet.qos == 1) {
+    inflight_add(conn, conn->out_packet.mid);
   } else if(conn->out_packet.qos == 2) {
     DBG("MQTT - QoS not implemented yet.\n");
     /* Should wait for PUBREC, send PUBREL and then wait for PUBCOMP */
   }
 
-  reset_packet(&conn->in_packet);
-
-  /* This is clear after the entire transaction is complete */
-  conn->out_queue_full = 0;
+  /* This is clear once the message is queued, unless the window is full */
+  conn->out_queue_full = conn->inflight_count >= MQTT_MAX_INFLIGHT;
+  process_post(conn->app_process, mqtt_update_event, NULL);
 
   DBG("MQTT - Publish Enqueued\n");
 
@@ -827,10 +953,14 @@ handle_puback(struct mqtt_connection *conn)
 {
   DBG("MQTT - Got PUBACK\n");
 
-  conn->out_packet.qos_state = MQTT_QOS_STATE_GOT_ACK;
   conn->in_packet.mid = (conn->in_packet.payload[0] << 8) |
     (conn->in_packet.payload[1]);
 
+  if(!inflight_remove(conn, conn->in_packet.mid)) {
+    DBG("MQTT - Warning, got PUBACK for unknown or timed out MID %u\n",
+        conn->in_packet.mid);
+  }
+
   call_event(conn, MQTT_EVENT_PUBACK, &conn->in_packet.mid);
 }
 /*---------------------------------------------------------------------------*/
@@ -1135,9 +1265,8 @@ tcp_event(struct tcp_socket *s, void *ptr, tcp_socket_event_t event)
   case TCP_SOCKET_DATA_SENT: {
     DBG("MQTT - Got TCP_DATA_SENT\n");
 
-    if(conn->socket.output_data_len == 0) {
+    if(tcp_socket_queuelen(&conn->socket) == 0) {
       conn->out_buffer_sent = 1;
-      conn->out_buffer_ptr = conn->out_buffer;
     }
 
     ctimer_restart(&conn->keep_alive_timer);
@@ -1221,8 +1350,8 @@ PROCESS_THREAD(mqtt_process, ev, data)
       conn = data;
       DBG("MQTT - Got mqtt_do_subscribe_mqtt_event!\n");
 
-      if(conn->out_buffer_sent == 1 &&
-         conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+      /* Messages are queued behind any data still being sent */
+      if(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
         PT_INIT(&conn->out_proto_thread);
         while(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER &&
               subscribe_pt(&conn->out_proto_thread, conn) < PT_EXITED) {
@@ -1234,8 +1363,8 @@ PROCESS_THREAD(mqtt_process, ev, data)
       conn = data;
       DBG("MQTT - Got mqtt_do_unsubscribe_mqtt_event!\n");
 
-      if(conn->out_buffer_sent == 1 &&
-         conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+      /* Messages are queued behind any data still being sent */
+      if(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
         PT_INIT(&conn->out_proto_thread);
         while(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER &&
               unsubscribe_pt(&conn->out_proto_thread, conn) < PT_EXITED) {
@@ -1247,8 +1376,8 @@ PROCESS_THREAD(mqtt_process, ev, data)
       conn = data;
       DBG("MQTT - Got mqtt_do_publish_mqtt_event!\n");
 
-      if(conn->out_buffer_sent == 1 &&
-         conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+      /* Messages are queued behind any data still being sent */
+      if(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
         PT_INIT(&conn->out_proto_thread);
         while(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER &&
               publish_pt(&conn->out_proto_thread, conn) < PT_EXITED) {
@@ -1333,7 +1462,6 @@ mqtt_connect(struct mqtt_connection *conn, char *host, uint16_t port,
   conn->server_host = host;
   conn->keep_alive = keep_alive;
   conn->server_port = port;
-  conn->out_buffer_ptr = conn->out_buffer;
   conn->out_packet.qos_state = MQTT_QOS_STATE_NO_ACK;
   conn->connect_vhdr_flags |= MQTT_VHDR_CLEAN_SESSION_FLAG;
 
@@ -1419,10 +1547,11 @@ mqtt_unsubscribe(struct mqtt_connection *conn, uint16_t *mid, char *topic)
   return MQTT_STATUS_OK;
 }
 /*----------------------------------------------------------------------------*/
-mqtt_status_t
-mqtt_publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
-             uint8_t *payload, uint32_t payload_size,
-             mqtt_qos_level_t qos_level, mqtt_retain_t retain)
+static mqtt_status_t
+publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
+        uint8_t *payload, uint32_t payload_size,
+        mqtt_payload_callback_t payload_callback, void *ptr,
+        mqtt_qos_level_t qos_level, mqtt_retain_t retain)
 {
   if(conn->state != MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
     return MQTT_STATUS_NOT_CONNECTED_ERROR;
@@ -1430,7 +1559,7 @@ mqtt_publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
 
   DBG("MQTT - Call to mqtt_publish...\n");
 
-  /* Currently don't have a queue, so only one item at a time */
+  /* One message is written at a time, QoS 1 ones are then in the window */
   if(conn->out_queue_full) {
     DBG("MQTT - Not accepted!\n");
     return MQTT_STATUS_OUT_QUEUE_FULL;
@@ -1444,13 +1573,39 @@ mqtt_publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
   conn->out_packet.topic_length = strlen(topic);
   conn->out_packet.payload = payload;
   conn->out_packet.payload_size = payload_size;
+  conn->out_packet.payload_callback = payload_callback;
+  conn->out_packet.payload_ptr = ptr;
   conn->out_packet.qos = qos_level;
-  conn->out_packet.qos_state = MQTT_QOS_STATE_NO_ACK;
+  if(mid != NULL) {
+    *mid = conn->out_packet.mid;
+  }
 
   process_post(&mqtt_process, mqtt_do_publish_event, conn);
   return MQTT_STATUS_OK;
 }
 /*----------------------------------------------------------------------------*/
+mqtt_status_t
+mqtt_publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
+             uint8_t *payload, uint32_t payload_size,
+             mqtt_qos_level_t qos_level, mqtt_retain_t retain)
+{
+  return publish(conn, mid, topic, payload, payload_size, NULL, NULL,
+                 qos_level, retain);
+}
+/*----------------------------------------------------------------------------*/
+mqtt_status_t
+mqtt_publish_stream(struct mqtt_connection *conn, uint16_t *mid, char *topic,
+                    uint32_t payload_size,
+                    mqtt_payload_callback_t payload_callback, void *ptr,
+                    mqtt_qos_level_t qos_level, mqtt_retain_t retain)
+{
+  if(payload_callback == NULL) {
+    return MQTT_STATUS_INVALID_ARGS_ERROR;
+  }
+  return publish(conn, mid, topic, NULL, payload_size, payload_callback, ptr,
+                 qos_level, retain);
+}
+/*----------------------------------------------------------------------------*/
 void
 mqtt_set_username_password(struct mqtt_connection *conn, char *username,
                            char *password)
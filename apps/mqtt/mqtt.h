@@ -105,8 +105,33 @@
 #define MQTT_CLIENT_ID_MAX_LEN 23
 
 /* Size of the underlying TCP buffers */
+#ifdef MQTT_CONF_TCP_INPUT_BUFF_SIZE
+#define MQTT_TCP_INPUT_BUFF_SIZE MQTT_CONF_TCP_INPUT_BUFF_SIZE
+#else
 #define MQTT_TCP_INPUT_BUFF_SIZE 512
+#endif
+
+/*
+ * The output buffer is the TCP socket output buffer itself, messages are
+ * written there directly and several of them can be queued at once, so a
+ * larger buffer lets more PUBLISH messages share each TCP segment.
+ */
+#ifdef MQTT_CONF_TCP_OUTPUT_BUFF_SIZE
+#define MQTT_TCP_OUTPUT_BUFF_SIZE MQTT_CONF_TCP_OUTPUT_BUFF_SIZE
+#else
 #define MQTT_TCP_OUTPUT_BUFF_SIZE 512
+#endif
+
+/*
+ * Number of QoS 1 PUBLISH messages that can wait for their PUBACK at the
+ * same time. With 1 a new QoS 1 PUBLISH is only accepted once the previous
+ * one is acknowledged (or timed out).
+ */
+#ifdef MQTT_CONF_MAX_INFLIGHT
+#define MQTT_MAX_INFLIGHT MQTT_CONF_MAX_INFLIGHT
+#else
+#define MQTT_MAX_INFLIGHT 1
+#endif
 
 #define MQTT_INPUT_BUFF_SIZE 512
 #define MQTT_MAX_TOPIC_LENGTH 64
@@ -268,6 +293,25 @@ struct mqtt_in_packet {
   uint8_t topic_received;
 };
 
+/**
+ * \brief           MQTT payload callback function
+ * \param m         A pointer to a MQTT connection
+ * \param ptr       The user-defined pointer given to mqtt_publish_stream()
+ * \param offset    Offset in the payload of the requested chunk
+ * \param buf       Where to write the chunk
+ * \param len       Maximum size of the chunk
+ * \return          The number of bytes written, 0 if no data is available
+ *                  yet or -1 to abort
+ *
+ * The payload callback function is called while a streamed PUBLISH is
+ * sent, to write the payload directly in the TCP output buffer.
+ */
+typedef int (*mqtt_payload_callback_t)(struct mqtt_connection *m,
+                                       void *ptr,
+                                       uint32_t offset,
+                                       uint8_t *buf,
+                                       uint16_t len);
+
 /* This struct represents a packet sent to the MQTT server. */
 struct mqtt_out_packet {
   uint8_t fhdr;
@@ -279,6 +323,8 @@ struct mqtt_out_packet {
   uint16_t topic_length;
   uint8_t *payload;
   uint32_t payload_size;
+  mqtt_payload_callback_t payload_callback;
+  void *payload_ptr;
   mqtt_qos_level_t qos;
   mqtt_qos_state_t qos_state;
   mqtt_retain_t retain;
@@ -312,6 +358,12 @@ struct mqtt_credentials {
   struct mqtt_string password;
 };
 
+/* A QoS 1 PUBLISH waiting for its PUBACK, a mid of 0 marks a free entry */
+struct mqtt_inflight {
+  uint16_t mid;
+  struct timer timeout;
+};
+
 struct mqtt_connection {
   /* Used by the list interface, must be first in the struct */
   struct mqtt_connection *next;
@@ -339,8 +391,12 @@ struct mqtt_connection {
   uint8_t out_queue_full;
   struct process *app_process;
 
+  /* QoS 1 PUBLISH messages waiting for their PUBACK */
+  struct mqtt_inflight inflight[MQTT_MAX_INFLIGHT];
+  uint8_t inflight_count;
+  struct ctimer inflight_timer;
+
   /* Outgoing data related */
-  uint8_t *out_buffer_ptr;
   uint8_t out_buffer[MQTT_TCP_OUTPUT_BUFF_SIZE];
   uint8_t out_buffer_sent;
   struct mqtt_out_packet out_packet;
@@ -438,7 +494,7 @@ mqtt_status_t mqtt_unsubscribe(struct mqtt_connection *conn,
 /**
  * \brief Publish to a MQTT topic.
  * \param conn A pointer to the MQTT connection.
- * \param mid A pointer to message ID.
+ * \param mid A pointer to message ID, set to the ID of the message if not NULL.
  * \param topic A pointer to the topic to subscribe to.
  * \param payload A pointer to the topic payload.
  * \param payload_size Payload size.
@@ -449,7 +505,13 @@ mqtt_status_t mqtt_unsubscribe(struct mqtt_connection *conn,
  *        subscriptions match its topic name
  * \return MQTT_STATUS_OK or some error status
  *
- * This function publishes to a topic on a MQTT broker.
+ * This function publishes to a topic on a MQTT broker. The payload is not
+ * copied, it must stay valid until the application gets the next
+ * mqtt_update_event.
+ *
+ * QoS 1 messages do not wait for their PUBACK, up to MQTT_MAX_INFLIGHT of
+ * them can be sent back to back. The PUBACK is reported with the
+ * MQTT_EVENT_PUBACK event carrying the message ID.
  */
 mqtt_status_t mqtt_publish(struct mqtt_connection *conn,
                            uint16_t *mid,
@@ -459,6 +521,34 @@ mqtt_status_t mqtt_publish(struct mqtt_connection *conn,
                            mqtt_qos_level_t qos_level,
                            mqtt_retain_t retain);
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief Publish to a MQTT topic a payload produced on the fly.
+ * \param conn A pointer to the MQTT connection.
+ * \param mid A pointer to message ID, set to the ID of the message if not NULL.
+ * \param topic A pointer to the topic to subscribe to.
+ * \param payload_size Payload size.
+ * \param payload_callback Callback writing the payload in the output buffer.
+ * \param ptr A user-defined pointer passed to the callback.
+ * \param qos_level Quality Of Service level to use. Currently supports 0, 1.
+ * \param retain The RETAIN flag, see mqtt_publish()
+ * \return MQTT_STATUS_OK or some error status
+ *
+ * This function is like mqtt_publish(), but the payload is written chunk by
+ * chunk by the callback directly in the TCP output buffer, as space becomes
+ * available. The payload can thus be larger than the output buffer and does
+ * not need to exist as a whole in memory. The callback must provide exactly
+ * payload_size bytes, returning -1 tears the connection down as the message
+ * can no longer be completed.
+ */
+mqtt_status_t mqtt_publish_stream(struct mqtt_connection *conn,
+                                  uint16_t *mid,
+                                  char *topic,
+                                  uint32_t payload_size,
+                                  mqtt_payload_callback_t payload_callback,
+                                  void *ptr,
+                                  mqtt_qos_level_t qos_level,
+                                  mqtt_retain_t retain);
+/*---------------------------------------------------------------------------*/
 /**
  * \brief Set the user name and password for a MQTT client.
  * \param conn A pointer to the MQTT connection.
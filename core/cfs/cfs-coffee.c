@@ -58,6 +58,7 @@
 #include "cfs/cfs.h"
 #include "cfs-coffee-arch.h"
 #include "cfs/cfs-coffee.h"
+#include "lib/hash-index.h"
 
 /* Micro logs enable modifications on storage types that do not support
    in-place updates. This applies primarily to flash memories. */
@@ -84,6 +85,30 @@
 #define COFFEE_EXTENDED_WEAR_LEVELLING  1
 #endif
 
+/*
+ * Keep an index of the file names and end offsets, and of the page usage
+ * of each sector in RAM, so that opening a file, finding free pages and
+ * deciding which sectors to erase do not require scanning the storage.
+ * The index is built from the file headers at the first access.
+ */
+#ifndef COFFEE_INDEX
+#ifdef COFFEE_CONF_INDEX
+#define COFFEE_INDEX COFFEE_CONF_INDEX
+#else
+#define COFFEE_INDEX 0
+#endif
+#endif
+
+/* Number of file names kept in the index. If there are more files, the
+   storage is scanned when looking up a name that is not indexed. */
+#ifndef COFFEE_INDEX_FILES
+#ifdef COFFEE_CONF_INDEX_FILES
+#define COFFEE_INDEX_FILES COFFEE_CONF_INDEX_FILES
+#else
+#define COFFEE_INDEX_FILES 32
+#endif
+#endif
+
 #if COFFEE_START & (COFFEE_SECTOR_SIZE - 1)
 #error COFFEE_START must point to the first byte in a sector.
 #endif
@@ -206,6 +231,33 @@ static struct file_desc coffee_fd_set[COFFEE_FD_SET_SIZE];
 static coffee_page_t next_free;
 static char gc_wait;
 
+#if COFFEE_INDEX
+/* An indexed file. The name is only stored as a hash, the header must be
+   read to confirm a match. */
+struct index_file {
+  cfs_offset_t end;
+  coffee_page_t page;
+  uint16_t name_hash;
+};
+
+static struct index_file index_files[COFFEE_INDEX_FILES];
+static uint16_t index_file_count;
+static char index_ready;
+/* Set when some files could not be indexed. */
+static char index_incomplete;
+/* The page usage is scanned again after a garbage collection. */
+static char sectors_ready;
+
+/* Page usage of each sector. The pages of a sector starting from
+   sector_first_free are free. sector_spill is the amount of pages at the
+   start of the sector which belong to a file starting in a previous
+   sector. */
+static coffee_page_t sector_active[COFFEE_SECTOR_COUNT];
+static coffee_page_t sector_obsolete[COFFEE_SECTOR_COUNT];
+static coffee_page_t sector_first_free[COFFEE_SECTOR_COUNT];
+static coffee_page_t sector_spill[COFFEE_SECTOR_COUNT];
+#endif /* COFFEE_INDEX */
+
 /*---------------------------------------------------------------------------*/
 static void
 write_header(struct file_header *hdr, coffee_page_t page)
@@ -229,6 +281,221 @@ absolute_offset(coffee_page_t page, cfs_offset_t offset)
   return page * COFFEE_PAGE_SIZE + sizeof(struct file_header) + offset;
 }
 /*---------------------------------------------------------------------------*/
+#if COFFEE_INDEX
+static coffee_page_t next_file(coffee_page_t page, struct file_header *hdr);
+/*---------------------------------------------------------------------------*/
+static uint16_t
+name_hash(const char *name)
+{
+  uint32_t hash;
+  int i;
+
+  /* Names longer than a header can hold are truncated when reserved. */
+  hash = HASH_FNV_INIT;
+  for(i = 0; i < COFFEE_NAME_LENGTH - 1 && name[i] != '\0'; i++) {
+    hash = HASH_FNV_BYTE(hash, name[i]);
+  }
+  return (uint16_t)(hash ^ (hash >> 16));
+}
+/*---------------------------------------------------------------------------*/
+static struct index_file *
+index_find_page(coffee_page_t page)
+{
+  int i;
+
+  for(i = 0; i < index_file_count; i++) {
+    if(index_files[i].page == page) {
+      return &index_files[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_add_file(coffee_page_t page, const char *name, cfs_offset_t end)
+{
+  if(index_file_count == COFFEE_INDEX_FILES) {
+    index_incomplete = 1;
+    return;
+  }
+  index_files[index_file_count].page = page;
+  index_files[index_file_count].name_hash = name_hash(name);
+  index_files[index_file_count].end = end;
+  index_file_count++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_set_end(coffee_page_t page, cfs_offset_t end)
+{
+  struct index_file *entry;
+
+  if(index_ready && (entry = index_find_page(page)) != NULL) {
+    entry->end = end;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Moves the pages of an extent between the page counts of the sectors. */
+static void
+index_count_pages(coffee_page_t start, coffee_page_t pages,
+                  coffee_page_t *from, coffee_page_t *to)
+{
+  coffee_page_t page, end, sector, overlap;
+
+  end = start + pages;
+  if(end > COFFEE_PAGE_COUNT || end < start) {
+    end = COFFEE_PAGE_COUNT;
+  }
+  for(page = start; page < end; page += overlap) {
+    sector = page / COFFEE_PAGES_PER_SECTOR;
+    overlap = (sector + 1) * COFFEE_PAGES_PER_SECTOR - page;
+    if(overlap > end - page) {
+      overlap = end - page;
+    }
+    if(from != NULL) {
+      from[sector] -= overlap;
+    }
+    to[sector] += overlap;
+    if(page != start) {
+      sector_spill[sector] = overlap;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_build(int with_files)
+{
+  struct file_header hdr;
+  coffee_page_t page, sector;
+
+  memset(sector_active, 0, sizeof(sector_active));
+  memset(sector_obsolete, 0, sizeof(sector_obsolete));
+  memset(sector_spill, 0, sizeof(sector_spill));
+  for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
+    sector_first_free[sector] = COFFEE_PAGES_PER_SECTOR;
+  }
+  if(with_files) {
+    index_file_count = 0;
+    index_incomplete = 0;
+  }
+
+  /* Same classification of the pages as get_sector_status(). */
+  for(page = 0; page < COFFEE_PAGE_COUNT; page = next_file(page, &hdr)) {
+    read_header(&hdr, page);
+    sector = page / COFFEE_PAGES_PER_SECTOR;
+    if(HDR_ACTIVE(hdr)) {
+      index_count_pages(page, hdr.max_pages, NULL, sector_active);
+      if(with_files && !HDR_LOG(hdr)) {
+        index_add_file(page, hdr.name, UNKNOWN_OFFSET);
+      }
+    } else if(HDR_ISOLATED(hdr)) {
+      sector_obsolete[sector]++;
+    } else if(HDR_OBSOLETE(hdr)) {
+      index_count_pages(page, hdr.max_pages, NULL, sector_obsolete);
+    } else {
+      sector_first_free[sector] = page - sector * COFFEE_PAGES_PER_SECTOR;
+    }
+  }
+  index_ready = 1;
+  sectors_ready = 1;
+  PRINTF("Coffee: Indexed %u files\n", (unsigned)index_file_count);
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_check(void)
+{
+  if(!index_ready || !sectors_ready) {
+    index_build(!index_ready);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_reserve(coffee_page_t start, struct file_header *hdr)
+{
+  coffee_page_t last, sector;
+
+  if(index_ready && !HDR_LOG(*hdr)) {
+    index_add_file(start, hdr->name, 0);
+  }
+  if(!sectors_ready) {
+    return;
+  }
+  index_count_pages(start, hdr->max_pages, NULL, sector_active);
+  /* Files are allocated in the free pages at the end of the sectors. */
+  last = start + hdr->max_pages - 1;
+  for(sector = start / COFFEE_PAGES_PER_SECTOR;
+      sector <= last / COFFEE_PAGES_PER_SECTOR && sector < COFFEE_SECTOR_COUNT;
+      sector++) {
+    sector_first_free[sector] = last >= (sector + 1) * COFFEE_PAGES_PER_SECTOR ?
+      COFFEE_PAGES_PER_SECTOR : last + 1 - sector * COFFEE_PAGES_PER_SECTOR;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_remove(coffee_page_t page, struct file_header *hdr)
+{
+  struct index_file *entry;
+
+  if(sectors_ready) {
+    index_count_pages(page, hdr->max_pages, sector_active, sector_obsolete);
+  }
+  if(index_ready && (entry = index_find_page(page)) != NULL) {
+    *entry = index_files[--index_file_count];
+  }
+}
+/*---------------------------------------------------------------------------*/
+static coffee_page_t
+index_sector_status(coffee_page_t sector, struct sector_status *stats)
+{
+  coffee_page_t spill;
+
+  stats->active = sector_active[sector];
+  stats->obsolete = sector_obsolete[sector];
+  stats->free = COFFEE_PAGES_PER_SECTOR - sector_first_free[sector];
+
+  /* Like get_sector_status(), only report the pages of an inactive file
+     ending in the next sector. */
+  spill = sector + 1 < COFFEE_SECTOR_COUNT ? sector_spill[sector + 1] : 0;
+  return stats->active == 0 && spill < COFFEE_PAGES_PER_SECTOR ? spill : 0;
+}
+/*---------------------------------------------------------------------------*/
+static coffee_page_t
+index_find_contiguous_pages(coffee_page_t amount)
+{
+  coffee_page_t sector, start, sector_start;
+
+  start = INVALID_PAGE;
+  for(sector = next_free / COFFEE_PAGES_PER_SECTOR;
+      sector < COFFEE_SECTOR_COUNT; sector++) {
+    sector_start = sector * COFFEE_PAGES_PER_SECTOR;
+    if(start != INVALID_PAGE && sector_first_free[sector] != 0) {
+      /* The free pages do not continue in this sector. */
+      start = INVALID_PAGE;
+    }
+    if(start == INVALID_PAGE) {
+      if(sector_first_free[sector] == COFFEE_PAGES_PER_SECTOR) {
+        continue;
+      }
+      start = sector_start + sector_first_free[sector];
+      if(start < next_free) {
+        start = next_free;
+      }
+      if(start + amount >= COFFEE_PAGE_COUNT) {
+        /* We can stop immediately if the remaining pages are not enough. */
+        break;
+      }
+    }
+    if(start + amount <= sector_start + COFFEE_PAGES_PER_SECTOR) {
+      if(start == next_free) {
+        next_free = start + amount;
+      }
+      return start;
+    }
+  }
+  return INVALID_PAGE;
+}
+#endif /* COFFEE_INDEX */
+/*---------------------------------------------------------------------------*/
+#if !COFFEE_INDEX
 static coffee_page_t
 get_sector_status(coffee_page_t sector, struct sector_status *stats)
 {
@@ -328,6 +595,7 @@ get_sector_status(coffee_page_t sector, struct sector_status *stats)
   return (last_pages_are_active || (skip_pages >= COFFEE_PAGES_PER_SECTOR)) ?
          0 : skip_pages;
 }
+#endif /* !COFFEE_INDEX */
 /*---------------------------------------------------------------------------*/
 static void
 isolate_pages(coffee_page_t start, coffee_page_t skip_pages)
@@ -344,6 +612,7 @@ isolate_pages(coffee_page_t start, coffee_page_t skip_pages)
   for(page = 0; page < skip_pages; page++) {
     write_header(&hdr, start + page);
   }
+
   PRINTF("Coffee: Isolated %u pages starting in sector %d\n",
          (unsigned)skip_pages, (int)start / COFFEE_PAGES_PER_SECTOR);
 }
@@ -361,8 +630,15 @@ collect_garbage(int mode)
    * The garbage collector erases as many sectors as possible. A sector is
    * erasable if there are only free or obsolete pages in it.
    */
+#if COFFEE_INDEX
+  index_check();
+#endif
   for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
+#if COFFEE_INDEX
+    isolation_count = index_sector_status(sector, &stats);
+#else
     isolation_count = get_sector_status(sector, &stats);
+#endif
     PRINTF("Coffee: Sector %u has %u active, %u obsolete, and %u free pages.\n",
            (unsigned)sector, (unsigned)stats.active,
            (unsigned)stats.obsolete, (unsigned)stats.free);
@@ -384,6 +660,15 @@ collect_garbage(int mode)
 
       COFFEE_ERASE(sector);
       PRINTF("Coffee: Erased sector %d!\n", sector);
+#if COFFEE_INDEX
+      /*
+       * The pages of the sector are counted from the status taken
+       * before the collection, like get_sector_status() does, and
+       * scanned again at the next use. Files extending over an erased
+       * sector hide its first pages until their own sector is erased.
+       */
+      sectors_ready = 0;
+#endif
 
       if(mode == GC_RELUCTANT && isolation_count > 0) {
         break;
@@ -458,6 +743,36 @@ find_file(const char *name)
   int i;
   struct file_header hdr;
   coffee_page_t page;
+#if COFFEE_INDEX
+  uint16_t hash;
+  int j;
+  struct file *file;
+
+  index_check();
+  hash = name_hash(name);
+  for(i = 0; i < index_file_count; i++) {
+    if(index_files[i].name_hash != hash) {
+      continue;
+    }
+    page = index_files[i].page;
+    read_header(&hdr, page);
+    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr) && strcmp(name, hdr.name) == 0) {
+      for(j = 0; j < COFFEE_MAX_OPEN_FILES; j++) {
+        if(!FILE_FREE(&coffee_files[j]) && coffee_files[j].page == page) {
+          return &coffee_files[j];
+        }
+      }
+      file = load_file(page, &hdr);
+      if(file != NULL) {
+        file->end = index_files[i].end;
+      }
+      return file;
+    }
+  }
+  if(!index_incomplete) {
+    return NULL;
+  }
+#endif /* COFFEE_INDEX */
 
   /* First check if the file metadata is cached. */
   for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
@@ -519,6 +834,10 @@ file_end(coffee_page_t start)
 static coffee_page_t
 find_contiguous_pages(coffee_page_t amount)
 {
+#if COFFEE_INDEX
+  index_check();
+  return index_find_contiguous_pages(amount);
+#else
   coffee_page_t page, start;
   struct file_header hdr;
 
@@ -550,6 +869,7 @@ find_contiguous_pages(coffee_page_t amount)
     }
   }
   return INVALID_PAGE;
+#endif /* COFFEE_INDEX */
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -559,6 +879,9 @@ remove_by_page(coffee_page_t page, int remove_log,
   struct file_header hdr;
   int i;
 
+#if COFFEE_INDEX
+  index_check();
+#endif
   read_header(&hdr, page);
   if(!HDR_ACTIVE(hdr)) {
     return -1;
@@ -572,6 +895,9 @@ remove_by_page(coffee_page_t page, int remove_log,
 
   hdr.flags |= HDR_FLAG_OBSOLETE;
   write_header(&hdr, page);
+#if COFFEE_INDEX
+  index_remove(page, &hdr);
+#endif
 
   gc_wait = 0;
 
@@ -636,6 +962,9 @@ reserve(const char *name, coffee_page_t pages,
   hdr.max_pages = pages;
   hdr.flags = HDR_FLAG_ALLOCATED | flags;
   write_header(&hdr, page);
+#if COFFEE_INDEX
+  index_reserve(page, &hdr);
+#endif
 
   PRINTF("Coffee: Reserved %u pages starting from %u for file %s\n",
          (unsigned)pages, (unsigned)page, name);
@@ -841,6 +1170,9 @@ merge_log(coffee_page_t file_page, int extend)
 
   new_file->flags &= ~COFFEE_FILE_MODIFIED;
   new_file->end = offset;
+#if COFFEE_INDEX
+  index_set_end(new_file->page, offset);
+#endif
 
   cfs_close(fd);
 
@@ -1001,6 +1333,9 @@ cfs_open(const char *name, int flags)
     fdp->file->end = 0;
   } else if(fdp->file->end == UNKNOWN_OFFSET) {
     fdp->file->end = file_end(fdp->file->page);
+#if COFFEE_INDEX
+    index_set_end(fdp->file->page, fdp->file->end);
+#endif
   }
 
   fdp->flags |= flags;
@@ -1014,6 +1349,10 @@ void
 cfs_close(int fd)
 {
   if(FD_VALID(fd)) {
+#if COFFEE_INDEX
+    /* Keep the end of the file in case its cache slot gets reused. */
+    index_set_end(coffee_fd_set[fd].file->page, coffee_fd_set[fd].file->end);
+#endif
     coffee_fd_set[fd].flags = COFFEE_FD_FREE;
     coffee_fd_set[fd].file->references--;
     coffee_fd_set[fd].file = NULL;
@@ -1247,6 +1586,9 @@ cfs_readdir(struct cfs_dir *dir, struct cfs_dirent *record)
   struct file_header hdr;
   coffee_page_t page;
   coffee_page_t next_page;
+#if COFFEE_INDEX
+  struct index_file *entry;
+#endif
 
   memcpy(&page, dir->state, sizeof(coffee_page_t));
 
@@ -1255,7 +1597,16 @@ cfs_readdir(struct cfs_dir *dir, struct cfs_dirent *record)
     if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr)) {
       memcpy(record->name, hdr.name, sizeof(record->name));
       record->name[sizeof(record->name) - 1] = '\0';
+#if COFFEE_INDEX
+      entry = index_ready ? index_find_page(page) : NULL;
+      if(entry != NULL && entry->end != UNKNOWN_OFFSET) {
+        record->size = entry->end;
+      } else {
+        record->size = file_end(page);
+      }
+#else
       record->size = file_end(page);
+#endif
 
       next_page = next_file(page, &hdr);
       memcpy(dir->state, &next_page, sizeof(coffee_page_t));
@@ -1338,6 +1689,10 @@ cfs_coffee_format(void)
   memset(&coffee_fd_set, 0, sizeof(coffee_fd_set));
   next_free = 0;
   gc_wait = 1;
+#if COFFEE_INDEX
+  index_ready = 0;
+  sectors_ready = 0;
+#endif
 
   PRINTF(" done!\n");
 
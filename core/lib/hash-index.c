@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Hash index library: FNV-1a hashing and an open addressing index
+ *         of items stored elsewhere
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "lib/hash-index.h"
+
+#include <string.h>
+
+/*---------------------------------------------------------------------------*/
+uint32_t
+hash_fnv(uint32_t hash, const void *data, unsigned len)
+{
+  const uint8_t *p = data;
+  while(len-- > 0) {
+    hash = HASH_FNV_BYTE(hash, *p++);
+  }
+  return hash;
+}
+/*---------------------------------------------------------------------------*/
+void
+hash_index_clear(struct hash_index *index)
+{
+  memset(index->slots, 0, index->size * sizeof(void *));
+}
+/*---------------------------------------------------------------------------*/
+int
+hash_index_add(struct hash_index *index, void *item)
+{
+  unsigned slot = index->hash(item) % index->size;
+  unsigned probes;
+
+  for(probes = 0; index->slots[slot] != NULL; probes++) {
+    if(probes == index->size) {
+      return 0;
+    }
+    slot = (slot + 1) % index->size;
+  }
+  index->slots[slot] = item;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+hash_index_remove(struct hash_index *index, const void *item)
+{
+  unsigned hole = index->hash(item) % index->size;
+  unsigned slot;
+  unsigned home;
+
+  while(index->slots[hole] != item) {
+    if(index->slots[hole] == NULL) {
+      return;
+    }
+    hole = (hole + 1) % index->size;
+  }
+  index->slots[hole] = NULL;
+  slot = hole;
+  for(;;) {
+    slot = (slot + 1) % index->size;
+    if(index->slots[slot] == NULL) {
+      break;
+    }
+    home = index->hash(index->slots[slot]) % index->size;
+    /* Move the entry if the hole lies between its home slot and its slot */
+    if((slot > hole && (home <= hole || home > slot)) ||
+       (slot < hole && (home <= hole && home > slot))) {
+      index->slots[hole] = index->slots[slot];
+      index->slots[slot] = NULL;
+      hole = slot;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void *
+hash_index_find(const struct hash_index *index, uint32_t hash,
+                int (*match)(const void *item, const void *key),
+                const void *key)
+{
+  unsigned slot = hash % index->size;
+  void *item;
+
+  while((item = index->slots[slot]) != NULL) {
+    if(match(item, key)) {
+      return item;
+    }
+    slot = (slot + 1) % index->size;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Header file for the hash index library: FNV-1a hashing and an
+ *         open addressing index of items stored elsewhere
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#ifndef HASH_INDEX_H_
+#define HASH_INDEX_H_
+
+#include "contiki-conf.h"
+
+/** FNV-1a initial value */
+#define HASH_FNV_INIT 2166136261UL
+
+/** Add one byte to a FNV-1a hash */
+#define HASH_FNV_BYTE(hash, byte) (((hash) ^ (uint8_t)(byte)) * 16777619UL)
+
+/**
+ * \brief Add len bytes to a FNV-1a hash
+ * \param hash HASH_FNV_INIT or the result of a previous call
+ * \return The new hash
+ */
+uint32_t hash_fnv(uint32_t hash, const void *data, unsigned len);
+
+/**
+ * Open addressing (linear probing) index of pointers to items. The items
+ * stay in their own table, the index only finds them. Removal shifts the
+ * following entries of the probe sequence back, so no tombstone is needed.
+ * The index must have more slots than the number of items it can hold.
+ */
+struct hash_index {
+  void **slots;
+  unsigned size;
+  /* Hash of the key of an item, used when an item is added or moved */
+  uint32_t (*hash)(const void *item);
+};
+
+/** Declare a static index of nb_slots slots */
+#define HASH_INDEX(name, nb_slots, hash_fn)                            \
+  static void *name##_slots[nb_slots];                                  \
+  static struct hash_index name = { name##_slots, nb_slots, hash_fn }
+
+/** \brief Remove all the items from the index */
+void hash_index_clear(struct hash_index *index);
+
+/**
+ * \brief Add an item to the index
+ * \retval 0 The index is full
+ */
+int hash_index_add(struct hash_index *index, void *item);
+
+/** \brief Remove an item from the index, if present */
+void hash_index_remove(struct hash_index *index, const void *item);
+
+/**
+ * \brief Find an item
+ * \param hash The hash of the key, as index->hash() would compute it
+ * \param match Returns non-zero if the item has the key
+ * \return The item or NULL
+ */
+void *hash_index_find(const struct hash_index *index, uint32_t hash,
+                      int (*match)(const void *item, const void *key),
+                      const void *key);
+
+#endif /* HASH_INDEX_H_ */
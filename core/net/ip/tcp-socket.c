@@ -76,7 +76,7 @@ acked(struct tcp_socket *s)
        outputbuf_lastsent */
 
     if(s->output_data_send_nxt > 0) {
-      memcpy(&s->output_data_ptr[0],
+      memmove(&s->output_data_ptr[0],
              &s->output_data_ptr[s->output_data_send_nxt],
              s->output_data_maxlen - s->output_data_send_nxt);
     }
@@ -338,9 +338,16 @@ tcp_socket_unlisten(struct tcp_socket *s)
   return 1;
 }
 /*---------------------------------------------------------------------------*/
+uint8_t *
+tcp_socket_output_space(struct tcp_socket *s, int *len)
+{
+  *len = s->output_data_maxlen - s->output_data_len;
+  return &s->output_data_ptr[s->output_data_len];
+}
+/*---------------------------------------------------------------------------*/
 int
-tcp_socket_send(struct tcp_socket *s,
-                const uint8_t *data, int datalen)
+tcp_socket_queue(struct tcp_socket *s,
+                 const uint8_t *data, int datalen)
 {
   int len;
 
@@ -350,15 +357,45 @@ tcp_socket_send(struct tcp_socket *s,
 
   len = MIN(datalen, s->output_data_maxlen - s->output_data_len);
 
-  memcpy(&s->output_data_ptr[s->output_data_len], data, len);
+  /* A NULL pointer means the data is already in place, written through
+     tcp_socket_output_space() */
+  if(data != NULL) {
+    memcpy(&s->output_data_ptr[s->output_data_len], data, len);
+  }
   s->output_data_len += len;
 
-  if(s->output_senddata_len == 0) {
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+int
+tcp_socket_flush(struct tcp_socket *s)
+{
+  if(s == NULL) {
+    return -1;
+  }
+
+  /* While a segment is in flight its content must not change, the
+     data queued since is picked up when it is acked */
+  if(s->output_data_send_nxt == 0) {
     s->output_senddata_len = s->output_data_len;
   }
 
   tcpip_poll_tcp(s->c);
 
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+tcp_socket_send(struct tcp_socket *s,
+                const uint8_t *data, int datalen)
+{
+  int len;
+
+  len = tcp_socket_queue(s, data, datalen);
+  if(len >= 0) {
+    tcp_socket_flush(s);
+  }
+
   return len;
 }
 /*---------------------------------------------------------------------------*/
@@ -229,6 +229,51 @@ int tcp_socket_send(struct tcp_socket *s,
                     const uint8_t *dataptr,
                     int datalen);
 
+/**
+ * \brief      Queue data on a connected TCP socket without sending it yet
+ * \param s    A pointer to a TCP socket that must have been previously registered with tcp_socket_register()
+ * \param dataptr A pointer to the data to be queued, or NULL if the data has already been written with tcp_socket_output_space()
+ * \param datalen The length of the data to be queued
+ * \retval -1  If an error occurs
+ * \return     The number of bytes that were successfully queued
+ *
+ *             This function places data in the output buffer like
+ *             tcp_socket_send() does, but does not ask the TCP/IP
+ *             stack to send it. This allows an application to build
+ *             a message piece by piece and then send it in as few
+ *             segments as possible with tcp_socket_flush().
+ */
+int tcp_socket_queue(struct tcp_socket *s,
+                     const uint8_t *dataptr,
+                     int datalen);
+
+/**
+ * \brief      Send the data queued on a connected TCP socket
+ * \param s    A pointer to a TCP socket that must have been previously registered with tcp_socket_register()
+ * \retval -1  If an error occurs
+ * \retval 1   If the operation succeeds.
+ *
+ *             This function asks the TCP/IP stack to send the data
+ *             queued with tcp_socket_queue().
+ */
+int tcp_socket_flush(struct tcp_socket *s);
+
+/**
+ * \brief      Get the free part of the output buffer
+ * \param s    A pointer to a TCP socket that must have been previously registered with tcp_socket_register()
+ * \param len  A pointer to where the size of the free space is stored
+ * \return     A pointer to the free space of the output buffer
+ *
+ *             This function gives direct access to the output
+ *             buffer, so that an application can produce its data
+ *             in place instead of copying it. The data written there
+ *             is then committed with tcp_socket_queue(s, NULL, len).
+ *             The pointer is only valid until the socket gets an
+ *             event, as acknowledged data is then removed from the
+ *             buffer.
+ */
+uint8_t *tcp_socket_output_space(struct tcp_socket *s, int *len);
+
 /**
  * \brief      Send a string on a connected TCP socket
  * \param s    A pointer to a TCP socket that must have been previously registered with tcp_socket_register()
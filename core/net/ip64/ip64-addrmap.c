@@ -31,14 +31,15 @@
  */
 #include "ip64-addrmap.h"
 
-#include "lib/memb.h"
-#include "lib/list.h"
-
 #include "ip64-conf.h"
 
 #include "lib/random.h"
+#include "lib/hash-index.h"
 
 #include <string.h>
+#if IP64_ADDRMAP_DYNAMIC
+#include <stdlib.h>
+#endif /* IP64_ADDRMAP_DYNAMIC */
 
 #ifdef IP64_ADDRMAP_CONF_ENTRIES
 #define NUM_ENTRIES IP64_ADDRMAP_CONF_ENTRIES
@@ -46,12 +47,53 @@
 #define NUM_ENTRIES 32
 #endif /* IP64_ADDRMAP_CONF_ENTRIES */
 
-MEMB(entrymemb, struct ip64_addrmap_entry, NUM_ENTRIES);
-LIST(entrylist);
+/* The mappings are expired through a timer wheel of WHEEL_SLOTS slots of
+   WHEEL_TICK each. A mapping is kept in the slot of its expiration time,
+   modulo the wheel length. Its lifetime may be changed afterwards without
+   moving it, so when its slot comes, a mapping that is not expired yet is
+   simply moved to the slot of its new expiration time. */
+#ifdef IP64_ADDRMAP_CONF_WHEEL_SLOTS
+#define WHEEL_SLOTS IP64_ADDRMAP_CONF_WHEEL_SLOTS
+#else /* IP64_ADDRMAP_CONF_WHEEL_SLOTS */
+#define WHEEL_SLOTS 64
+#endif /* IP64_ADDRMAP_CONF_WHEEL_SLOTS */
+
+#ifdef IP64_ADDRMAP_CONF_WHEEL_TICK
+#define WHEEL_TICK IP64_ADDRMAP_CONF_WHEEL_TICK
+#else /* IP64_ADDRMAP_CONF_WHEEL_TICK */
+#define WHEEL_TICK CLOCK_SECOND
+#endif /* IP64_ADDRMAP_CONF_WHEEL_TICK */
 
 #define FIRST_MAPPED_PORT 10000
 #define LAST_MAPPED_PORT  20000
-static uint16_t mapped_port = FIRST_MAPPED_PORT;
+#define NUM_MAPPED_PORTS  (LAST_MAPPED_PORT - FIRST_MAPPED_PORT)
+
+/* Default table, the hash indexes have as many buckets as there are
+   entries */
+static struct ip64_addrmap_entry default_entries[NUM_ENTRIES];
+static struct ip64_addrmap_entry *default_hash6[NUM_ENTRIES];
+static struct ip64_addrmap_entry *default_hash4[NUM_ENTRIES];
+
+#if IP64_ADDRMAP_DYNAMIC
+static struct ip64_addrmap_entry *entries = default_entries;
+static struct ip64_addrmap_entry **hash6 = default_hash6;
+static struct ip64_addrmap_entry **hash4 = default_hash4;
+static unsigned num_entries = NUM_ENTRIES;
+#else /* IP64_ADDRMAP_DYNAMIC */
+#define entries default_entries
+#define hash6 default_hash6
+#define hash4 default_hash4
+#define num_entries NUM_ENTRIES
+#endif /* IP64_ADDRMAP_DYNAMIC */
+
+static struct ip64_addrmap_entry *entrylist;
+static struct ip64_addrmap_entry *freelist;
+static struct ip64_addrmap_entry *wheel[WHEEL_SLOTS];
+/* Time of the last wheel slot processed */
+static clock_time_t wheel_time;
+
+/* Mapped ports in use, one bit per port */
+static uint8_t port_map[(NUM_MAPPED_PORTS + 7) / 8];
 
 #define printf(...)
 
@@ -59,32 +101,195 @@ static uint16_t mapped_port = FIRST_MAPPED_PORT;
 struct ip64_addrmap_entry *
 ip64_addrmap_list(void)
 {
-  return list_head(entrylist);
+  return entrylist;
 }
 /*---------------------------------------------------------------------------*/
 void
 ip64_addrmap_init(void)
 {
-  memb_init(&entrymemb);
-  list_init(entrylist);
-  mapped_port = FIRST_MAPPED_PORT;
+  unsigned i;
+
+  entrylist = NULL;
+  freelist = NULL;
+  for(i = 0; i < num_entries; i++) {
+    entries[i].next = freelist;
+    freelist = &entries[i];
+    hash6[i] = NULL;
+    hash4[i] = NULL;
+  }
+  memset(wheel, 0, sizeof(wheel));
+  memset(port_map, 0, sizeof(port_map));
+  wheel_time = clock_time() - clock_time() % WHEEL_TICK;
+}
+/*---------------------------------------------------------------------------*/
+#if IP64_ADDRMAP_DYNAMIC
+int
+ip64_addrmap_set_size(int size)
+{
+  struct ip64_addrmap_entry *new_entries;
+  struct ip64_addrmap_entry **new_hash6;
+  struct ip64_addrmap_entry **new_hash4;
+
+  /* There can not be more mappings than mapped ports */
+  if(size <= 0 || size > NUM_MAPPED_PORTS) {
+    return 0;
+  }
+  new_entries = malloc(size * sizeof(struct ip64_addrmap_entry));
+  new_hash6 = malloc(size * sizeof(struct ip64_addrmap_entry *));
+  new_hash4 = malloc(size * sizeof(struct ip64_addrmap_entry *));
+  if(new_entries == NULL || new_hash6 == NULL || new_hash4 == NULL) {
+    free(new_entries);
+    free(new_hash6);
+    free(new_hash4);
+    return 0;
+  }
+  if(entries != default_entries) {
+    free(entries);
+    free(hash6);
+    free(hash4);
+  }
+  entries = new_entries;
+  hash6 = new_hash6;
+  hash4 = new_hash4;
+  num_entries = size;
+  ip64_addrmap_init();
+  return 1;
+}
+#endif /* IP64_ADDRMAP_DYNAMIC */
+/*---------------------------------------------------------------------------*/
+static unsigned
+hash6_bucket(const uip_ip6addr_t *ip6addr, uint16_t ip6port,
+             const uip_ip4addr_t *ip4addr, uint16_t ip4port,
+             uint8_t protocol)
+{
+  uint32_t hash;
+
+  hash = hash_fnv(HASH_FNV_INIT, ip6addr, sizeof(uip_ip6addr_t));
+  hash = hash_fnv(hash, ip4addr, sizeof(uip_ip4addr_t));
+  hash = HASH_FNV_BYTE(hash, ip6port >> 8);
+  hash = HASH_FNV_BYTE(hash, ip6port & 0xff);
+  hash = HASH_FNV_BYTE(hash, ip4port >> 8);
+  hash = HASH_FNV_BYTE(hash, ip4port & 0xff);
+  hash = HASH_FNV_BYTE(hash, protocol);
+  return hash % num_entries;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned
+hash4_bucket(uint16_t mapped_port)
+{
+  /* Mapped ports are unique whatever the protocol */
+  return mapped_port % num_entries;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned
+wheel_slot(const struct timer *t)
+{
+  clock_time_t expiration = t->start + t->interval;
+  return ((expiration + WHEEL_TICK - 1) / WHEEL_TICK) % WHEEL_SLOTS;
+}
+/*---------------------------------------------------------------------------*/
+static void
+port_set(uint16_t port, int used)
+{
+  port -= FIRST_MAPPED_PORT;
+  if(used) {
+    port_map[port / 8] |= 1 << (port % 8);
+  } else {
+    port_map[port / 8] &= ~(1 << (port % 8));
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Pick a free mapped port, starting from a random one. Returns 0 if all
+   the ports are in use. */
+static uint16_t
+port_alloc(void)
+{
+  unsigned port;
+  unsigned n;
+
+  port = random_rand() % NUM_MAPPED_PORTS;
+  for(n = 0; n < NUM_MAPPED_PORTS; n++, port = (port + 1) % NUM_MAPPED_PORTS) {
+    if(port_map[port / 8] == 0xff) {
+      /* Skip the rest of a full byte at once */
+      n += 7 - port % 8;
+      port += 7 - port % 8;
+      continue;
+    }
+    if((port_map[port / 8] & (1 << (port % 8))) == 0) {
+      port_set(port + FIRST_MAPPED_PORT, 1);
+      return port + FIRST_MAPPED_PORT;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+unlink_hash(struct ip64_addrmap_entry **bucket, struct ip64_addrmap_entry *m,
+            int hash4_chain)
+{
+  struct ip64_addrmap_entry **p;
+  for(p = bucket; *p != NULL;
+      p = hash4_chain ? &(*p)->hash4_next : &(*p)->hash6_next) {
+    if(*p == m) {
+      *p = hash4_chain ? m->hash4_next : m->hash6_next;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Release a mapping, it must already be removed from the timer wheel */
+static void
+release(struct ip64_addrmap_entry *m)
+{
+  if(m->prev != NULL) {
+    m->prev->next = m->next;
+  } else {
+    entrylist = m->next;
+  }
+  if(m->next != NULL) {
+    m->next->prev = m->prev;
+  }
+  unlink_hash(&hash6[hash6_bucket(&m->ip6addr, m->ip6port, &m->ip4addr,
+                                  m->ip4port, m->protocol)], m, 0);
+  unlink_hash(&hash4[hash4_bucket(m->mapped_port)], m, 1);
+  port_set(m->mapped_port, 0);
+  m->next = freelist;
+  freelist = m;
 }
 /*---------------------------------------------------------------------------*/
 static void
 check_age(void)
 {
   struct ip64_addrmap_entry *m;
+  struct ip64_addrmap_entry **p;
+  unsigned slot;
+  unsigned new_slot;
+  clock_time_t ticks;
 
-  /* Walk through the list of address mappings, throw away the ones
-     that are too old. */
-  m = list_head(entrylist);
-  while(m != NULL) {
-    if(timer_expired(&m->timer)) {
-      list_remove(entrylist, m);
-      memb_free(&entrymemb, m);
-      m = list_head(entrylist);
-    } else {
-      m = list_item_next(m);
+  /* Process the wheel slots that have come due since the last call. A
+     full turn of the wheel looks at every mapping, so there is no need to
+     do more after a long idle period. */
+  ticks = (clock_time() - wheel_time) / WHEEL_TICK;
+  if(ticks > WHEEL_SLOTS) {
+    wheel_time += (ticks - WHEEL_SLOTS) * WHEEL_TICK;
+    ticks = WHEEL_SLOTS;
+  }
+  for(; ticks > 0; ticks--) {
+    wheel_time += WHEEL_TICK;
+    slot = (wheel_time / WHEEL_TICK) % WHEEL_SLOTS;
+    p = &wheel[slot];
+    while((m = *p) != NULL) {
+      if(timer_expired(&m->timer)) {
+        *p = m->wheel_next;
+        release(m);
+      } else if((new_slot = wheel_slot(&m->timer)) != slot) {
+        /* The lifetime was changed, move the mapping */
+        *p = m->wheel_next;
+        m->wheel_next = wheel[new_slot];
+        wheel[new_slot] = m;
+      } else {
+        p = &m->wheel_next;
+      }
     }
   }
 }
@@ -92,36 +297,24 @@ check_age(void)
 static int
 recycle(void)
 {
-  /* Find the oldest recyclable mapping and remove it. */
-  struct ip64_addrmap_entry *m, *oldest;
-
-  /* Walk through the list of address mappings, throw away the ones
-     that are too old. */
+  /* Find a mapping that is expired or recyclable and remove it. The wheel
+     is walked from the current slot on so that the mappings closest to
+     their expiration are recycled first. */
+  struct ip64_addrmap_entry *m;
+  struct ip64_addrmap_entry **p;
+  unsigned slot;
+  int n;
 
-  oldest = NULL;
-  for(m = list_head(entrylist);
-      m != NULL;
-      m = list_item_next(m)) {
-    if(m->flags & FLAGS_RECYCLABLE) {
-      if(oldest == NULL) {
-        oldest = m;
-      } else {
-        if(timer_remaining(&m->timer) <
-           timer_remaining(&oldest->timer)) {
-          oldest = m;
-        }
+  slot = (wheel_time / WHEEL_TICK) % WHEEL_SLOTS;
+  for(n = 0; n < WHEEL_SLOTS; n++, slot = (slot + 1) % WHEEL_SLOTS) {
+    for(p = &wheel[slot]; (m = *p) != NULL; p = &m->wheel_next) {
+      if((m->flags & FLAGS_RECYCLABLE) || timer_expired(&m->timer)) {
+        *p = m->wheel_next;
+        release(m);
+        return 1;
       }
     }
   }
-
-  /* If we found an oldest recyclable entry, remove it and return
-     non-zero. */
-  if(oldest != NULL) {
-    list_remove(entrylist, oldest);
-    memb_free(&entrymemb, oldest);
-    return 1;
-  }
-
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -137,18 +330,21 @@ ip64_addrmap_lookup(const uip_ip6addr_t *ip6addr,
   printf("lookup ip4port %d ip6port %d\n", uip_htons(ip4port),
 	 uip_htons(ip6port));
   check_age();
-  for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
+  for(m = hash6[hash6_bucket(ip6addr, ip6port, ip4addr, ip4port, protocol)];
+      m != NULL; m = m->hash6_next) {
     printf("protocol %d %d, ip4port %d %d, ip6port %d %d, ip4 %d ip6 %d\n",
 	   m->protocol, protocol,
 	   m->ip4port, ip4port,
 	   m->ip6port, ip6port,
 	   uip_ip4addr_cmp(&m->ip4addr, ip4addr),
 	   uip_ip6addr_cmp(&m->ip6addr, ip6addr));
+    /* Expired mappings wait for their wheel slot to be released */
     if(m->protocol == protocol &&
        m->ip4port == ip4port &&
        m->ip6port == ip6port &&
        uip_ip4addr_cmp(&m->ip4addr, ip4addr) &&
-       uip_ip6addr_cmp(&m->ip6addr, ip6addr)) {
+       uip_ip6addr_cmp(&m->ip6addr, ip6addr) &&
+       !timer_expired(&m->timer)) {
       m->ip6to4++;
       return m;
     }
@@ -162,12 +358,13 @@ ip64_addrmap_lookup_port(uint16_t mapped_port, uint8_t protocol)
   struct ip64_addrmap_entry *m;
 
   check_age();
-  for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
+  for(m = hash4[hash4_bucket(mapped_port)]; m != NULL; m = m->hash4_next) {
     printf("mapped port %d %d, protocol %d %d\n",
 	   m->mapped_port, mapped_port,
 	   m->protocol, protocol);
     if(m->mapped_port == mapped_port &&
-       m->protocol == protocol) {
+       m->protocol == protocol &&
+       !timer_expired(&m->timer)) {
       m->ip4to6++;
       return m;
     }
@@ -175,13 +372,6 @@ ip64_addrmap_lookup_port(uint16_t mapped_port, uint8_t protocol)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
-static void
-increase_mapped_port(void)
-{
-  mapped_port = (random_rand() % (LAST_MAPPED_PORT - FIRST_MAPPED_PORT)) +
-    FIRST_MAPPED_PORT;
-}
-/*---------------------------------------------------------------------------*/
 struct ip64_addrmap_entry *
 ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
 		    uint16_t ip6port,
@@ -190,17 +380,23 @@ ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
 		    uint8_t protocol)
 {
   struct ip64_addrmap_entry *m;
+  unsigned bucket;
 
   check_age();
-  m = memb_alloc(&entrymemb);
-  if(m == NULL) {
+  if(freelist == NULL) {
     /* We could not allocate an entry, try to recycle one and try to
        allocate again. */
-    if(recycle()) {
-      m = memb_alloc(&entrymemb);
-    }
+    recycle();
   }
+  m = freelist;
   if(m != NULL) {
+    /* Pick a new, unused local port. */
+    m->mapped_port = port_alloc();
+    if(m->mapped_port == 0) {
+      return NULL;
+    }
+    freelist = m->next;
+
     uip_ip4addr_copy(&m->ip4addr, ip4addr);
     m->ip4port = ip4port;
     uip_ip6addr_copy(&m->ip6addr, ip6addr);
@@ -211,25 +407,25 @@ ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
     m->ip4to6 = 0;
     timer_set(&m->timer, 0);
 
-    /* Pick a new, unused local port. First make sure that the
-       mapped_port number does not belong to any active connection. If
-       so, we keep increasing the mapped_port until we're free. */
-    {
-      struct ip64_addrmap_entry *n;
-      n = list_head(entrylist);
-      while(n != NULL) {
-	if(n->mapped_port == mapped_port) {
-	  increase_mapped_port();
-	  n = list_head(entrylist);
-	} else {
-	  n = list_item_next(m);
-	}
-      }
+    m->prev = NULL;
+    m->next = entrylist;
+    if(entrylist != NULL) {
+      entrylist->prev = m;
     }
-    m->mapped_port = mapped_port;
-    increase_mapped_port();
+    entrylist = m;
+
+    bucket = hash6_bucket(ip6addr, ip6port, ip4addr, ip4port, protocol);
+    m->hash6_next = hash6[bucket];
+    hash6[bucket] = m;
+    bucket = hash4_bucket(m->mapped_port);
+    m->hash4_next = hash4[bucket];
+    hash4[bucket] = m;
 
-    list_add(entrylist, m);
+    /* The lifetime is set just after, the mapping will be moved to the
+       right slot when the next one is processed */
+    bucket = (wheel_time / WHEEL_TICK + 1) % WHEEL_SLOTS;
+    m->wheel_next = wheel[bucket];
+    wheel[bucket] = m;
     return m;
   }
   return NULL;
@@ -36,8 +36,23 @@
 #include "sys/timer.h"
 #include "net/ip/uip.h"
 
+/* Allocate the address mapping table dynamically, so that its size can be
+   changed at runtime with ip64_addrmap_set_size() */
+#ifdef IP64_ADDRMAP_CONF_DYNAMIC
+#define IP64_ADDRMAP_DYNAMIC IP64_ADDRMAP_CONF_DYNAMIC
+#else /* IP64_ADDRMAP_CONF_DYNAMIC */
+#define IP64_ADDRMAP_DYNAMIC 0
+#endif /* IP64_ADDRMAP_CONF_DYNAMIC */
+
 struct ip64_addrmap_entry {
+  /* Active mappings, see ip64_addrmap_list() */
   struct ip64_addrmap_entry *next;
+  struct ip64_addrmap_entry *prev;
+  /* Chaining in the IPv6 and IPv4 side hash indexes */
+  struct ip64_addrmap_entry *hash6_next;
+  struct ip64_addrmap_entry *hash4_next;
+  /* Chaining in the expiration timer wheel */
+  struct ip64_addrmap_entry *wheel_next;
   struct timer timer;
   uip_ip6addr_t ip6addr;
   uip_ip4addr_t ip4addr;
@@ -100,4 +115,13 @@ void ip64_addrmap_set_recycleble(struct ip64_addrmap_entry *e);
  * Obtain the list of all address mappings.
  */
 struct ip64_addrmap_entry *ip64_addrmap_list(void);
+
+#if IP64_ADDRMAP_DYNAMIC
+/**
+ * Change the maximum number of address mappings. All the current mappings
+ * are dropped. Returns 0 if the new table could not be allocated, the
+ * previous one being kept.
+ */
+int ip64_addrmap_set_size(int entries);
+#endif /* IP64_ADDRMAP_DYNAMIC */
 #endif /* IP64_ADDRMAP_H */
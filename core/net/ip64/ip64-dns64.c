@@ -198,8 +198,7 @@ ip64_dns64_4to6(const uint8_t *ipv4data, int ipv4datalen,
       /* Name spelled out */
       do {
         n = *adata;
-        adata++;
-        acopy++;
+        *acopy++ = *adata++;
         for(j = 0; j < n; j++) {
           *acopy++ = *adata++;
         }
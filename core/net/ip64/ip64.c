@@ -186,6 +186,8 @@ ip64_init(void)
   uip_ipaddr(&ipv4_broadcast_addr, 255,255,255,255);
   ip64_hostaddr_configured = 0;
 
+  ip64_addrmap_init();
+
   PRINTF("ip64_init\n");
   IP64_ETH_DRIVER.init();
 #if IP64_DHCP
@@ -59,6 +59,7 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 
 #include "contiki.h"
 #include "dev/watchdog.h"
@@ -67,6 +68,7 @@
 #include "net/ip/uip.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/rime/rime.h"
+#include "lib/hash-index.h"
 #include "net/ipv6/sicslowpan.h"
 #include "net/netstack.h"
 
@@ -248,6 +250,7 @@ static uint16_t my_tag;
 #define SICSLOWPAN_FRAGMENT_SIZE 110
 #endif
 
+#if !SICSLOWPAN_REASS_HASH
 /* Assuming that the worst growth for uncompression is 38 bytes */
 #define SICSLOWPAN_FIRST_FRAGMENT_SIZE (SICSLOWPAN_FRAGMENT_SIZE + 38)
 
@@ -433,6 +436,285 @@ copy_frags2uip(int context)
   /* deallocate all the fragments for this context */
   clear_fragments(context);
 }
+#else /* !SICSLOWPAN_REASS_HASH */
+/* Each reassembly has a buffer for the whole packet, fragments are written
+   at their offset as they arrive and the received 8-byte units are tracked
+   to detect duplicate and overlapping fragments */
+#define REASS_BUF_SIZE (UIP_BUFSIZE - UIP_LLH_LEN)
+#define REASS_UNITS ((REASS_BUF_SIZE + 7) / 8)
+
+#define REASS_NEW 0
+#define REASS_DUPLICATE 1
+#define REASS_OVERLAP 2
+
+struct sicslowpan_reass {
+  /** Next context in the hash bucket, or in the free list */
+  struct sicslowpan_reass *hash_next;
+  /** Contexts in use, oldest first as they all expire after the same time */
+  struct sicslowpan_reass *prev;
+  struct sicslowpan_reass *next;
+  linkaddr_t sender;
+  uint16_t tag;
+  /** Total length of the fragmented packet */
+  uint16_t len;
+  /** Length of the packet received so far */
+  uint16_t reassembled_len;
+  struct timer reass_timer;
+  /** Bitmap of the received 8-byte units */
+  uint8_t received[(REASS_UNITS + 7) / 8];
+  uint8_t buf[REASS_BUF_SIZE];
+};
+
+static struct sicslowpan_reass default_reass[SICSLOWPAN_REASS_CONTEXTS];
+static struct sicslowpan_reass *default_reass_hash[SICSLOWPAN_REASS_CONTEXTS];
+
+#if SICSLOWPAN_REASS_DYNAMIC
+static struct sicslowpan_reass *reass_contexts = default_reass;
+static struct sicslowpan_reass **reass_hash = default_reass_hash;
+static unsigned reass_nb = SICSLOWPAN_REASS_CONTEXTS;
+#else /* SICSLOWPAN_REASS_DYNAMIC */
+#define reass_contexts default_reass
+#define reass_hash default_reass_hash
+#define reass_nb SICSLOWPAN_REASS_CONTEXTS
+#endif /* SICSLOWPAN_REASS_DYNAMIC */
+
+static struct sicslowpan_reass *reass_free;
+static struct sicslowpan_reass *reass_oldest;
+static struct sicslowpan_reass *reass_newest;
+static struct ctimer reass_ctimer;
+
+struct sicslowpan_reass_stats sicslowpan_reass_stats;
+
+/*---------------------------------------------------------------------------*/
+static void
+reass_init(void)
+{
+  unsigned i;
+
+  ctimer_stop(&reass_ctimer);
+  reass_free = NULL;
+  reass_oldest = NULL;
+  reass_newest = NULL;
+  for(i = 0; i < reass_nb; i++) {
+    reass_contexts[i].hash_next = reass_free;
+    reass_free = &reass_contexts[i];
+    reass_hash[i] = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+#if SICSLOWPAN_REASS_DYNAMIC
+int
+sicslowpan_reass_set_contexts(int contexts)
+{
+  struct sicslowpan_reass *new_contexts;
+  struct sicslowpan_reass **new_hash;
+
+  if(contexts <= 0) {
+    return 0;
+  }
+  new_contexts = malloc(contexts * sizeof(struct sicslowpan_reass));
+  new_hash = malloc(contexts * sizeof(struct sicslowpan_reass *));
+  if(new_contexts == NULL || new_hash == NULL) {
+    free(new_contexts);
+    free(new_hash);
+    return 0;
+  }
+  if(reass_contexts != default_reass) {
+    free(reass_contexts);
+    free(reass_hash);
+  }
+  reass_contexts = new_contexts;
+  reass_hash = new_hash;
+  reass_nb = contexts;
+  reass_init();
+  return 1;
+}
+#endif /* SICSLOWPAN_REASS_DYNAMIC */
+/*---------------------------------------------------------------------------*/
+/* FNV-1a hash of the sender address and tag */
+static unsigned
+reass_bucket(const linkaddr_t *sender, uint16_t tag)
+{
+  uint32_t hash = hash_fnv(HASH_FNV_INIT, sender, LINKADDR_SIZE);
+  hash = HASH_FNV_BYTE(hash, tag >> 8);
+  hash = HASH_FNV_BYTE(hash, tag & 0xff);
+  return hash % reass_nb;
+}
+/*---------------------------------------------------------------------------*/
+static void reass_expire(void *ptr);
+
+static void
+reass_schedule(void)
+{
+  if(reass_oldest != NULL) {
+    /* timer_remaining() wraps around once the timer has expired */
+    ctimer_set(&reass_ctimer,
+               timer_expired(&reass_oldest->reass_timer) ? 0 :
+               timer_remaining(&reass_oldest->reass_timer),
+               reass_expire, NULL);
+  } else {
+    ctimer_stop(&reass_ctimer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+reass_release(struct sicslowpan_reass *reass)
+{
+  struct sicslowpan_reass **r;
+
+  for(r = &reass_hash[reass_bucket(&reass->sender, reass->tag)];
+      *r != NULL; r = &(*r)->hash_next) {
+    if(*r == reass) {
+      *r = reass->hash_next;
+      break;
+    }
+  }
+  if(reass->prev != NULL) {
+    reass->prev->next = reass->next;
+  } else {
+    reass_oldest = reass->next;
+  }
+  if(reass->next != NULL) {
+    reass->next->prev = reass->prev;
+  } else {
+    reass_newest = reass->prev;
+  }
+  reass->hash_next = reass_free;
+  reass_free = reass;
+}
+/*---------------------------------------------------------------------------*/
+static void
+reass_expire(void *ptr)
+{
+  while(reass_oldest != NULL &&
+        timer_expired(&reass_oldest->reass_timer)) {
+    PRINTF("*** Reassembly timeout - tag: %d\n", reass_oldest->tag);
+    sicslowpan_reass_stats.timeouts++;
+    reass_release(reass_oldest);
+  }
+  reass_schedule();
+}
+/*---------------------------------------------------------------------------*/
+/* Find the reassembly of a fragment, or start a new one */
+static struct sicslowpan_reass *
+reass_get(uint16_t tag, uint16_t frag_size)
+{
+  const linkaddr_t *sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+  unsigned bucket = reass_bucket(sender, tag);
+  struct sicslowpan_reass *reass;
+
+  for(reass = reass_hash[bucket]; reass != NULL; reass = reass->hash_next) {
+    if(reass->tag == tag && linkaddr_cmp(&reass->sender, sender)) {
+      if(reass->len != frag_size) {
+        PRINTF("*** Fragment size mismatch - tag: %d\n", tag);
+        sicslowpan_reass_stats.overlaps++;
+        reass_release(reass);
+        reass_schedule();
+        return NULL;
+      }
+      return reass;
+    }
+  }
+
+  if(frag_size > REASS_BUF_SIZE) {
+    PRINTF("*** Fragmented packet too big - tag: %d size: %d\n", tag, frag_size);
+    return NULL;
+  }
+  reass = reass_free;
+  if(reass == NULL) {
+    PRINTF("*** Failed to store new fragment session - tag: %d\n", tag);
+    sicslowpan_reass_stats.overflows++;
+    return NULL;
+  }
+  reass_free = reass->hash_next;
+
+  linkaddr_copy(&reass->sender, sender);
+  reass->tag = tag;
+  reass->len = frag_size;
+  reass->reassembled_len = 0;
+  memset(reass->received, 0, sizeof(reass->received));
+  timer_set(&reass->reass_timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16);
+
+  reass->hash_next = reass_hash[bucket];
+  reass_hash[bucket] = reass;
+  reass->next = NULL;
+  reass->prev = reass_newest;
+  if(reass_newest != NULL) {
+    reass_newest->next = reass;
+  } else {
+    reass_oldest = reass;
+    reass_schedule();
+  }
+  reass_newest = reass;
+  return reass;
+}
+/*---------------------------------------------------------------------------*/
+/* Check a fragment against the units already received. The fragment starts
+   with hdr_len bytes already uncompressed in the buffer, followed by len
+   bytes of data. The data overlapping received units must be identical to
+   what was received, otherwise the reassembly is aborted. A fragment with
+   only received units is a duplicate */
+static int
+reass_check(struct sicslowpan_reass *reass, uint16_t start, uint16_t hdr_len,
+            const uint8_t *data, uint16_t len)
+{
+  uint16_t unit;
+  uint16_t end;
+  uint16_t lo;
+  uint16_t hi;
+  uint16_t data_start = start + hdr_len;
+  int received = 0;
+
+  if(hdr_len + len == 0 || start >= reass->len) {
+    sicslowpan_reass_stats.overlaps++;
+    reass_release(reass);
+    reass_schedule();
+    return REASS_OVERLAP;
+  }
+  /* Be liberal with extraneous bytes at the end of the last fragment */
+  end = start + hdr_len + len > reass->len ? reass->len : start + hdr_len + len;
+  for(unit = start / 8; unit <= (end - 1) / 8; unit++) {
+    if(!(reass->received[unit / 8] & (1 << (unit % 8)))) {
+      continue;
+    }
+    received++;
+    lo = unit * 8 > data_start ? unit * 8 : data_start;
+    hi = unit * 8 + 8 < end ? unit * 8 + 8 : end;
+    if(lo < hi && memcmp(reass->buf + lo, data + (lo - data_start), hi - lo) != 0) {
+      PRINTF("*** Overlapping fragment - tag: %d offset: %d\n", reass->tag, start);
+      sicslowpan_reass_stats.overlaps++;
+      reass_release(reass);
+      reass_schedule();
+      return REASS_OVERLAP;
+    }
+  }
+  if(received == (end - 1) / 8 - start / 8 + 1) {
+    PRINTF("*** Duplicate fragment - tag: %d offset: %d\n", reass->tag, start);
+    sicslowpan_reass_stats.duplicates++;
+    return REASS_DUPLICATE;
+  }
+  return REASS_NEW;
+}
+/*---------------------------------------------------------------------------*/
+/* Record a fragment written in the reassembly buffer, returns 1 once the
+   whole packet has been received. Units already received are only counted
+   once */
+static int
+reass_mark(struct sicslowpan_reass *reass, uint16_t start, uint16_t len)
+{
+  uint16_t unit;
+  uint16_t end;
+
+  end = start + len > reass->len ? reass->len : start + len;
+  for(unit = start / 8; unit <= (end - 1) / 8; unit++) {
+    if(!(reass->received[unit / 8] & (1 << (unit % 8)))) {
+      reass->received[unit / 8] |= 1 << (unit % 8);
+      reass->reassembled_len += (unit * 8 + 8 < reass->len ? unit * 8 + 8 : reass->len) - unit * 8;
+    }
+  }
+  return reass->reassembled_len >= reass->len;
+}
+#endif /* !SICSLOWPAN_REASS_HASH */
 #endif /* SICSLOWPAN_CONF_FRAG */
 
 /* -------------------------------------------------------------------------- */
@@ -1288,7 +1570,7 @@ output(const uip_lladdr_t *localdest)
   packetbuf_clear();
   packetbuf_ptr = packetbuf_dataptr();
 
-  if(callback) {
+  if(callback || SICSLOWPAN_PACKET_ATTRS) {
     /* call the attribution when the callback comes, but set attributes
        here ! */
     set_packet_attrs();
@@ -1510,7 +1792,12 @@ input(void)
 
 #if SICSLOWPAN_CONF_FRAG
   uint8_t is_fragment = 0;
+#if SICSLOWPAN_REASS_HASH
+  struct sicslowpan_reass *reass = NULL;
+  uint16_t frag_start = 0;
+#else
   int8_t frag_context = 0;
+#endif
 
   /* tag of the fragment */
   uint16_t frag_tag = 0;
@@ -1555,6 +1842,20 @@ input(void)
       first_fragment = 1;
       is_fragment = 1;
 
+#if SICSLOWPAN_REASS_HASH
+      reass = reass_get(frag_tag, frag_size);
+      if(reass == NULL) {
+        return;
+      }
+      if(reass->received[0] & 1) {
+        /* The headers are uncompressed in place, check for a duplicate
+           first fragment before overwriting them */
+        PRINTFI("sicslowpan input: duplicate FRAG1\n");
+        sicslowpan_reass_stats.duplicates++;
+        return;
+      }
+      buffer = reass->buf;
+#else
       /* Add the fragment to the fragmentation context */
       frag_context = add_fragment(frag_tag, frag_size, frag_offset);
 
@@ -1563,6 +1864,7 @@ input(void)
       }
 
       buffer = frag_info[frag_context].first_frag;
+#endif
 
       break;
     case SICSLOWPAN_DISPATCH_FRAGN:
@@ -1583,6 +1885,14 @@ input(void)
       PRINTFI("last_fragment?: packetbuf_payload_len %d frag_size %d\n",
               packetbuf_datalen() - packetbuf_hdr_len, frag_size);
 
+#if SICSLOWPAN_REASS_HASH
+      reass = reass_get(frag_tag, frag_size);
+      if(reass == NULL) {
+        return;
+      }
+      /* The payload is copied below directly at its offset */
+      buffer = reass->buf + (uint16_t)(frag_offset << 3);
+#else
       /* Add the fragment to the fragmentation context (this will also
          copy the payload) */
       frag_context = add_fragment(frag_tag, frag_size, frag_offset);
@@ -1598,6 +1908,7 @@ input(void)
       if(frag_info[frag_context].reassembled_len >= frag_size) {
         last_fragment = 1;
       }
+#endif
       is_fragment = 1;
       break;
     default:
@@ -1666,6 +1977,17 @@ input(void)
     }
   }
 
+#if SICSLOWPAN_CONF_FRAG && SICSLOWPAN_REASS_HASH
+  if(is_fragment) {
+    frag_start = first_fragment ? 0 : (uint16_t)(frag_offset << 3);
+    if(reass_check(reass, frag_start, uncomp_hdr_len,
+                   packetbuf_ptr + packetbuf_hdr_len,
+                   packetbuf_payload_len) != REASS_NEW) {
+      return;
+    }
+  }
+#endif /* SICSLOWPAN_CONF_FRAG && SICSLOWPAN_REASS_HASH */
+
   /* copy the payload if buffer is non-null - which is only the case with first fragment
      or packets that are non fragmented */
   if(buffer != NULL) {
@@ -1675,6 +1997,17 @@ input(void)
   /* update processed_ip_in_len if fragment, sicslowpan_len otherwise */
 
 #if SICSLOWPAN_CONF_FRAG
+#if SICSLOWPAN_REASS_HASH
+  if(is_fragment &&
+     reass_mark(reass, frag_start, uncomp_hdr_len + packetbuf_payload_len)) {
+    /* The packet is complete, move it to uip */
+    memcpy((uint8_t *)UIP_IP_BUF, reass->buf, reass->len);
+    sicslowpan_reass_stats.reassembled++;
+    reass_release(reass);
+    reass_schedule();
+    last_fragment = 1;
+  }
+#else
   if(frag_size > 0) {
     /* Add the size of the header only for the first fragment. */
     if(first_fragment != 0) {
@@ -1689,6 +2022,7 @@ input(void)
       copy_frags2uip(frag_context);
     }
   }
+#endif /* SICSLOWPAN_REASS_HASH */
 
   /*
    * If we have a full IP packet in sicslowpan_buf, deliver it to
@@ -1745,6 +2079,10 @@ sicslowpan_init(void)
 
   tcpip_set_outputfunc(output);
 
+#if SICSLOWPAN_CONF_FRAG && SICSLOWPAN_REASS_HASH
+  reass_init();
+#endif
+
 #if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
 /* Preinitialize any address contexts for better header compression
  * (Saves up to 13 bytes per 6lowpan packet)
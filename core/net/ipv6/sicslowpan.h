@@ -324,6 +324,62 @@ struct sicslowpan_nh_compressor {
 
 };
 
+/**
+ * \name Fragment reassembly
+ * @{
+ */
+/** Reassemble each packet in its own buffer, looked up by (sender, tag),
+    instead of storing the fragments in a shared pool of small buffers */
+#ifdef SICSLOWPAN_CONF_REASS_HASH
+#define SICSLOWPAN_REASS_HASH SICSLOWPAN_CONF_REASS_HASH
+#else
+#define SICSLOWPAN_REASS_HASH 0
+#endif
+
+/** Allocate the reassembly contexts dynamically, so that their number can
+    be changed at runtime with sicslowpan_reass_set_contexts() */
+#ifdef SICSLOWPAN_CONF_REASS_DYNAMIC
+#define SICSLOWPAN_REASS_DYNAMIC SICSLOWPAN_CONF_REASS_DYNAMIC
+#else
+#define SICSLOWPAN_REASS_DYNAMIC 0
+#endif
+
+struct sicslowpan_reass_stats {
+  /** Packets successfully reassembled */
+  uint32_t reassembled;
+  /** Reassemblies dropped after SICSLOWPAN_REASS_MAXAGE */
+  uint32_t timeouts;
+  /** New reassemblies dropped because no context was free */
+  uint32_t overflows;
+  /** Duplicate fragments ignored */
+  uint32_t duplicates;
+  /** Reassemblies dropped because of overlapping or inconsistent fragments */
+  uint32_t overlaps;
+};
+
+#if SICSLOWPAN_REASS_HASH
+extern struct sicslowpan_reass_stats sicslowpan_reass_stats;
+
+#if SICSLOWPAN_REASS_DYNAMIC
+/** Set the number of reassembly contexts, the reassemblies in progress are
+    dropped. Returns 0 if the contexts could not be allocated. */
+int sicslowpan_reass_set_contexts(int contexts);
+#endif
+#endif /* SICSLOWPAN_REASS_HASH */
+/** @} */
+
+/** Tag every outgoing packet with its protocol and its port or ICMPv6 type
+    and code (PACKETBUF_ATTR_NETWORK_ID and PACKETBUF_ATTR_CHANNEL), and not
+    only when a sniffer is registered. The CSMA scheduler uses them to send
+    the control traffic first */
+#ifdef SICSLOWPAN_CONF_PACKET_ATTRS
+#define SICSLOWPAN_PACKET_ATTRS SICSLOWPAN_CONF_PACKET_ATTRS
+#elif defined(CSMA_CONF_WITH_DRR)
+#define SICSLOWPAN_PACKET_ATTRS CSMA_CONF_WITH_DRR
+#else
+#define SICSLOWPAN_PACKET_ATTRS 0
+#endif
+
 int sicslowpan_get_last_rssi(void);
 
 extern const struct network_driver sicslowpan_driver;
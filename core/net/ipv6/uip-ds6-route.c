@@ -46,6 +46,7 @@
 
 #include "lib/list.h"
 #include "lib/memb.h"
+#include "lib/hash-index.h"
 #include "net/nbr-table.h"
 
 #include <string.h>
@@ -78,6 +79,22 @@ MEMB(routememb, uip_ds6_route_t, UIP_DS6_ROUTE_NB);
 static int num_routes = 0;
 static void rm_routelist_callback(nbr_table_item_t *ptr);
 
+#if UIP_DS6_ROUTE_LPM_INDEX
+#if UIP_DS6_ROUTE_LPM_HASH_SIZE <= UIP_DS6_ROUTE_NB
+#error "UIP_DS6_ROUTE_LPM_HASH_SIZE must be larger than UIP_DS6_ROUTE_NB"
+#endif
+/* Routes are also kept in a hash table keyed on their prefix length and on
+   the prefix bytes compared by uip_ipaddr_prefixcmp(). A lookup probes it
+   for each prefix length in use, starting with the longest one. */
+static uint32_t lpm_route_hash(const void *route);
+HASH_INDEX(lpm_index, UIP_DS6_ROUTE_LPM_HASH_SIZE, lpm_route_hash);
+/* Number of routes for each prefix length */
+static uint16_t lpm_length_count[256];
+/* Prefix lengths in use, sorted from the longest to the shortest */
+static uint8_t lpm_lengths[256];
+static int lpm_nb_lengths;
+#endif /* UIP_DS6_ROUTE_LPM_INDEX */
+
 #endif /* (UIP_CONF_MAX_ROUTES != 0) */
 
 /* Default routes are held on the defaultrouterlist and their
@@ -85,6 +102,8 @@ static void rm_routelist_callback(nbr_table_item_t *ptr);
 LIST(defaultrouterlist);
 MEMB(defaultroutermemb, uip_ds6_defrt_t, UIP_DS6_DEFRT_NB);
 
+uint32_t uip_ds6_route_version;
+
 #if UIP_DS6_NOTIFICATIONS
 LIST(notificationlist);
 #endif
@@ -122,6 +141,86 @@ assert_nbr_routes_list_sane(void)
 }
 #endif /* DEBUG != DEBUG_NONE */
 /*---------------------------------------------------------------------------*/
+#if (UIP_CONF_MAX_ROUTES != 0) && UIP_DS6_ROUTE_LPM_INDEX
+/* Hash of the length and of the significant bytes of a prefix */
+static uint32_t
+lpm_hash(const uip_ipaddr_t *addr, uint8_t length)
+{
+  return hash_fnv(HASH_FNV_BYTE(HASH_FNV_INIT, length), addr, length >> 3);
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+lpm_route_hash(const void *route)
+{
+  return lpm_hash(&((const uip_ds6_route_t *)route)->ipaddr,
+                  ((const uip_ds6_route_t *)route)->length);
+}
+/*---------------------------------------------------------------------------*/
+struct lpm_key {
+  const uip_ipaddr_t *addr;
+  uint8_t length;
+};
+
+static int
+lpm_matches(const void *route, const void *key)
+{
+  const uip_ds6_route_t *r = route;
+  const struct lpm_key *k = key;
+  return r->length == k->length && uip_ipaddr_prefixcmp(k->addr, &r->ipaddr, k->length);
+}
+/*---------------------------------------------------------------------------*/
+static void
+lpm_insert(uip_ds6_route_t *route)
+{
+  int i;
+
+  hash_index_add(&lpm_index, route);
+
+  if(lpm_length_count[route->length]++ == 0) {
+    /* New prefix length, keep the list sorted */
+    for(i = lpm_nb_lengths; i > 0 && lpm_lengths[i - 1] < route->length; i--) {
+      lpm_lengths[i] = lpm_lengths[i - 1];
+    }
+    lpm_lengths[i] = route->length;
+    lpm_nb_lengths++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+lpm_remove(uip_ds6_route_t *route)
+{
+  int i;
+
+  hash_index_remove(&lpm_index, route);
+
+  if(--lpm_length_count[route->length] == 0) {
+    for(i = 0; lpm_lengths[i] != route->length; i++);
+    lpm_nb_lengths--;
+    for(; i < lpm_nb_lengths; i++) {
+      lpm_lengths[i] = lpm_lengths[i + 1];
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uip_ds6_route_t *
+lpm_lookup(const uip_ipaddr_t *addr)
+{
+  uip_ds6_route_t *r;
+  struct lpm_key key;
+  int i;
+
+  key.addr = addr;
+  for(i = 0; i < lpm_nb_lengths; i++) {
+    key.length = lpm_lengths[i];
+    r = hash_index_find(&lpm_index, lpm_hash(addr, key.length), lpm_matches, &key);
+    if(r != NULL) {
+      return r;
+    }
+  }
+  return NULL;
+}
+#endif /* (UIP_CONF_MAX_ROUTES != 0) && UIP_DS6_ROUTE_LPM_INDEX */
+/*---------------------------------------------------------------------------*/
 #if UIP_DS6_NOTIFICATIONS
 static void
 call_route_callback(int event, uip_ipaddr_t *route,
@@ -165,6 +264,11 @@ uip_ds6_route_init(void)
 #if (UIP_CONF_MAX_ROUTES != 0)
   memb_init(&routememb);
   list_init(routelist);
+#if UIP_DS6_ROUTE_LPM_INDEX
+  hash_index_clear(&lpm_index);
+  memset(lpm_length_count, 0, sizeof(lpm_length_count));
+  lpm_nb_lengths = 0;
+#endif /* UIP_DS6_ROUTE_LPM_INDEX */
   nbr_table_register(nbr_routes,
                      (nbr_table_callback *)rm_routelist_callback);
 #endif /* (UIP_CONF_MAX_ROUTES != 0) */
@@ -262,15 +366,20 @@ uip_ds6_route_t *
 uip_ds6_route_lookup(uip_ipaddr_t *addr)
 {
 #if (UIP_CONF_MAX_ROUTES != 0)
-  uip_ds6_route_t *r;
   uip_ds6_route_t *found_route;
+#if !UIP_DS6_ROUTE_LPM_INDEX
+  uip_ds6_route_t *r;
   uint8_t longestmatch;
+#endif /* !UIP_DS6_ROUTE_LPM_INDEX */
 
   PRINTF("uip-ds6-route: Looking up route for ");
   PRINT6ADDR(addr);
   PRINTF("\n");
 
 
+#if UIP_DS6_ROUTE_LPM_INDEX
+  found_route = lpm_lookup(addr);
+#else /* UIP_DS6_ROUTE_LPM_INDEX */
   found_route = NULL;
   longestmatch = 0;
   for(r = uip_ds6_route_head();
@@ -286,6 +395,7 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
       }
     }
   }
+#endif /* UIP_DS6_ROUTE_LPM_INDEX */
 
   if(found_route != NULL) {
     PRINTF("uip-ds6-route: Found route: ");
@@ -297,6 +407,10 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
     PRINTF("uip-ds6-route: No route found\n");
   }
 
+#if !UIP_DS6_ROUTE_LPM_INDEX || UIP_DS6_ROUTE_REMOVE_LEAST_RECENTLY_USED
+  /* With the route index, the list order only matters for the eviction of
+     the least recently used route, and moving the route, which walks the
+     list, is skipped otherwise */
   if(found_route != NULL && found_route != list_head(routelist)) {
     /* If we found a route, we put it at the start of the routeslist
        list. The list is ordered by how recently we looked them up:
@@ -306,6 +420,7 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
     list_remove(routelist, found_route);
     list_push(routelist, found_route);
   }
+#endif /* !UIP_DS6_ROUTE_LPM_INDEX || UIP_DS6_ROUTE_REMOVE_LEAST_RECENTLY_USED */
 
   return found_route;
 #else /* (UIP_CONF_MAX_ROUTES != 0) */
@@ -444,6 +559,9 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 
   uip_ipaddr_copy(&(r->ipaddr), ipaddr);
   r->length = length;
+#if UIP_DS6_ROUTE_LPM_INDEX
+  lpm_insert(r);
+#endif /* UIP_DS6_ROUTE_LPM_INDEX */
 
 #ifdef UIP_DS6_ROUTE_STATE_TYPE
   memset(&r->state, 0, sizeof(UIP_DS6_ROUTE_STATE_TYPE));
@@ -455,6 +573,7 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
   PRINT6ADDR(nexthop);
   PRINTF("\n");
   ANNOTATE("#L %u 1;blue\n", nexthop->u8[sizeof(uip_ipaddr_t) - 1]);
+  uip_ds6_route_version++;
 
 #if UIP_DS6_NOTIFICATIONS
   call_route_callback(UIP_DS6_NOTIFICATION_ROUTE_ADD, ipaddr, nexthop);
@@ -522,6 +641,9 @@ uip_ds6_route_add_static(uip_ipaddr_t *ipaddr, uint8_t length,
   uip_ipaddr_copy(&(r->ipaddr), ipaddr);
   uip_ipaddr_copy(&(r->nexthop), nexthop);
   r->length = length;
+#if UIP_DS6_ROUTE_LPM_INDEX
+  lpm_insert(r);
+#endif /* UIP_DS6_ROUTE_LPM_INDEX */
 
 #ifdef UIP_DS6_ROUTE_STATE_TYPE
   memset(&r->state, 0, sizeof(UIP_DS6_ROUTE_STATE_TYPE));
@@ -535,6 +657,7 @@ uip_ds6_route_add_static(uip_ipaddr_t *ipaddr, uint8_t length,
   PRINTF(" via ");
   PRINT6ADDR(nexthop);
   PRINTF("\n");
+  uip_ds6_route_version++;
 
 #if DEBUG != DEBUG_NONE
   assert_nbr_routes_list_sane();
@@ -559,6 +682,9 @@ uip_ds6_route_rm(uip_ds6_route_t *route)
 
     /* Remove the route from the route list */
     list_remove(routelist, route);
+#if UIP_DS6_ROUTE_LPM_INDEX
+    lpm_remove(route);
+#endif /* UIP_DS6_ROUTE_LPM_INDEX */
     if(route->neighbor_routes != NULL) {
       /* Find the corresponding neighbor_route and remove it. */
       for(neighbor_route = list_head(route->neighbor_routes->route_list);
@@ -592,6 +718,7 @@ uip_ds6_route_rm(uip_ds6_route_t *route)
     memb_free(&routememb, route);
 
     num_routes--;
+    uip_ds6_route_version++;
 
     PRINTF("uip_ds6_route_rm num %d\n", num_routes);
 
@@ -695,6 +822,7 @@ uip_ds6_defrt_add(uip_ipaddr_t *ipaddr, unsigned long interval)
   }
 
   ANNOTATE("#L %u 1\n", ipaddr->u8[sizeof(uip_ipaddr_t) - 1]);
+  uip_ds6_route_version++;
 
 #if UIP_DS6_NOTIFICATIONS
   call_route_callback(UIP_DS6_NOTIFICATION_DEFRT_ADD, ipaddr, ipaddr);
@@ -725,6 +853,7 @@ uip_ds6_defrt_rm(uip_ds6_defrt_t *defrt)
       list_remove(defaultrouterlist, defrt);
       memb_free(&defaultroutermemb, defrt);
       ANNOTATE("#L %u 0\n", defrt->ipaddr.u8[sizeof(uip_ipaddr_t) - 1]);
+      uip_ds6_route_version++;
 #if UIP_DS6_NOTIFICATIONS
       call_route_callback(UIP_DS6_NOTIFICATION_DEFRT_RM,
 			  &defrt->ipaddr, &defrt->ipaddr);
@@ -91,6 +91,23 @@ void uip_ds6_notification_rm(struct uip_ds6_notification *n);
 #define UIP_DS6_ROUTE_NB 4
 #endif /* UIP_CONF_MAX_ROUTES */
 
+/* Index the routes by prefix and prefix length with a hash table, so that
+   uip_ds6_route_lookup() probes it once per prefix length in use instead of
+   walking the whole route list */
+#ifdef UIP_DS6_ROUTE_CONF_LPM_INDEX
+#define UIP_DS6_ROUTE_LPM_INDEX UIP_DS6_ROUTE_CONF_LPM_INDEX
+#else /* UIP_DS6_ROUTE_CONF_LPM_INDEX */
+#define UIP_DS6_ROUTE_LPM_INDEX 0
+#endif /* UIP_DS6_ROUTE_CONF_LPM_INDEX */
+
+/* Number of slots of the route index, must be larger than the number of
+   routes */
+#ifdef UIP_DS6_ROUTE_CONF_LPM_HASH_SIZE
+#define UIP_DS6_ROUTE_LPM_HASH_SIZE UIP_DS6_ROUTE_CONF_LPM_HASH_SIZE
+#else /* UIP_DS6_ROUTE_CONF_LPM_HASH_SIZE */
+#define UIP_DS6_ROUTE_LPM_HASH_SIZE (2 * UIP_DS6_ROUTE_NB)
+#endif /* UIP_DS6_ROUTE_CONF_LPM_HASH_SIZE */
+
 #ifndef UIP_CONF_DS6_STATIC_ROUTES
 #define UIP_DS6_STATIC_ROUTES 0
 #else
@@ -220,5 +237,8 @@ uip_ds6_route_t *uip_ds6_route_next(uip_ds6_route_t *);
 int uip_ds6_route_is_nexthop(const uip_ipaddr_t *ipaddr);
 /** @} */
 
+/* Incremented each time a route or a default route is added or removed */
+extern uint32_t uip_ds6_route_version;
+
 #endif /* UIP_DS6_ROUTE_H */
 /** @} */
@@ -48,12 +48,18 @@
 
 #include "net/netstack.h"
 
+#if CSMA_WITH_DRR && NETSTACK_CONF_WITH_IPV6
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-icmp6.h"
+#endif
+
 #if CETIC_6LBR_MULTI_RADIO
 #include "multi-radio.h"
 #endif
 
 #include "lib/list.h"
 #include "lib/memb.h"
+#include "lib/hash-index.h"
 
 #include <string.h>
 
@@ -105,15 +111,47 @@ struct qbuf_metadata {
 #if CETIC_6LBR_MULTI_RADIO
   uint8_t ifindex;
 #endif
+#if CSMA_WITH_DRR
+  clock_time_t enqueued;
+  uint16_t len;
+  uint8_t control;
+#endif
+};
+
+#if CSMA_WITH_DRR
+enum {
+  /* Nothing queued, the queue is only kept for its statistics */
+  NEIGHBOR_IDLE,
+  /* Waiting in one of the rings for its turn */
+  NEIGHBOR_READY,
+  /* The head packet is being sent */
+  NEIGHBOR_ACTIVE,
 };
+#endif
 
 /* Every neighbor has its own packet queue */
 struct neighbor_queue {
+  /* With CSMA_WITH_DRR, link in the control or data ring */
   struct neighbor_queue *next;
+#if CSMA_WITH_DRR
+  struct neighbor_queue *hash_next;
+  clock_time_t last_used;
+  uint16_t deficit;
+  uint16_t control_count;
+  uint8_t state;
+  uint16_t max_queued;
+  uint32_t enqueued;
+  uint32_t overflows;
+  uint32_t dequeued;
+  uint32_t sojourn_total;
+  clock_time_t sojourn_max;
+#endif
   linkaddr_t addr;
   struct ctimer transmit_timer;
   uint8_t transmissions;
   uint8_t collisions;
+  /* Length of queued_packet_list */
+  uint16_t count;
   LIST_STRUCT(queued_packet_list);
 };
 
@@ -132,10 +170,56 @@ struct neighbor_queue {
 #endif /* CSMA_CONF_MAX_PACKET_PER_NEIGHBOR */
 
 #define MAX_QUEUED_PACKETS QUEUEBUF_NUM
+
+#if CSMA_WITH_DRR
+/* The maximum number of neighbor queues transmitting at the same time */
+#ifdef CSMA_CONF_MAX_ACTIVE_NEIGHBORS
+#define CSMA_MAX_ACTIVE_NEIGHBORS CSMA_CONF_MAX_ACTIVE_NEIGHBORS
+#else
+#define CSMA_MAX_ACTIVE_NEIGHBORS 1
+#endif /* CSMA_CONF_MAX_ACTIVE_NEIGHBORS */
+
+/* The bytes credited to a neighbor queue at each round, not less than a frame */
+#ifdef CSMA_CONF_DRR_QUANTUM
+#define CSMA_DRR_QUANTUM CSMA_CONF_DRR_QUANTUM
+#else
+#define CSMA_DRR_QUANTUM PACKETBUF_SIZE
+#endif /* CSMA_CONF_DRR_QUANTUM */
+
+/* The number of packets that only the control packets can use */
+#ifdef CSMA_CONF_CONTROL_RESERVE
+#define CSMA_CONTROL_RESERVE CSMA_CONF_CONTROL_RESERVE
+#else
+#define CSMA_CONTROL_RESERVE (MAX_QUEUED_PACKETS / 8)
+#endif /* CSMA_CONF_CONTROL_RESERVE */
+
+/* The number of buckets of the neighbor queue hash table */
+#ifdef CSMA_CONF_HASH_SIZE
+#define CSMA_HASH_SIZE CSMA_CONF_HASH_SIZE
+#else
+#define CSMA_HASH_SIZE CSMA_MAX_NEIGHBOR_QUEUES
+#endif /* CSMA_CONF_HASH_SIZE */
+#endif /* CSMA_WITH_DRR */
+
 MEMB(neighbor_memb, struct neighbor_queue, CSMA_MAX_NEIGHBOR_QUEUES);
 MEMB(packet_memb, struct rdc_buf_list, MAX_QUEUED_PACKETS);
 MEMB(metadata_memb, struct qbuf_metadata, MAX_QUEUED_PACKETS);
+#if CSMA_WITH_DRR
+/* FIFO of neighbor queues linked through their next field */
+struct neighbor_ring {
+  struct neighbor_queue *head;
+  struct neighbor_queue *tail;
+};
+/* Queues whose next packet is a control packet, served first */
+static struct neighbor_ring control_ring;
+/* Queues whose next packet is a data packet, served in deficit round robin */
+static struct neighbor_ring data_ring;
+static struct neighbor_queue *neighbor_hash[CSMA_HASH_SIZE];
+static uint8_t active_neighbors;
+static uint16_t queued_packets;
+#else
 LIST(neighbor_list);
+#endif
 
 static void packet_sent(void *ptr, int status, int num_transmissions);
 static void transmit_packet_list(void *ptr);
@@ -149,6 +233,9 @@ uint32_t csma_collisions;
 uint32_t csma_deferred;
 uint32_t csma_retransmissions;
 uint32_t csma_dropped;
+#if CSMA_WITH_DRR
+uint32_t csma_control_packets;
+#endif
 
 /*---------------------------------------------------------------------------*/
 int csma_allocated_packets(void)
@@ -160,9 +247,40 @@ int csma_allocated_neighbors(void)
   return CSMA_MAX_NEIGHBOR_QUEUES - memb_numfree(&neighbor_memb);
 }
 /*---------------------------------------------------------------------------*/
+#if CSMA_WITH_DRR
+/* FNV-1a hash of a link-layer address */
+static unsigned
+hash_bucket(const linkaddr_t *addr)
+{
+  return hash_fnv(HASH_FNV_INIT, addr, LINKADDR_SIZE) % CSMA_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_remove(struct neighbor_queue *n)
+{
+  struct neighbor_queue **p = &neighbor_hash[hash_bucket(&n->addr)];
+  while(*p != NULL) {
+    if(*p == n) {
+      *p = n->hash_next;
+      return;
+    }
+    p = &(*p)->hash_next;
+  }
+}
+#endif /* CSMA_WITH_DRR */
+/*---------------------------------------------------------------------------*/
 static struct neighbor_queue *
 neighbor_queue_from_addr(const linkaddr_t *addr)
 {
+#if CSMA_WITH_DRR
+  struct neighbor_queue *n = neighbor_hash[hash_bucket(addr)];
+  while(n != NULL) {
+    if(linkaddr_cmp(&n->addr, addr)) {
+      return n;
+    }
+    n = n->hash_next;
+  }
+#else
   struct neighbor_queue *n = list_head(neighbor_list);
   while(n != NULL) {
     if(linkaddr_cmp(&n->addr, addr)) {
@@ -170,6 +288,7 @@ neighbor_queue_from_addr(const linkaddr_t *addr)
     }
     n = list_item_next(n);
   }
+#endif
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
@@ -198,7 +317,7 @@ transmit_packet_list(void *ptr)
     struct rdc_buf_list *q = list_head(n->queued_packet_list);
     if(q != NULL) {
       PRINTF("csma: preparing number %d %p, queue len %d\n", n->transmissions, q,
-          list_length(n->queued_packet_list));
+          n->count);
 #if CETIC_6LBR_MULTI_RADIO
       /* Find out what interface we should use... */
       struct qbuf_metadata *metadata = (struct qbuf_metadata *)q->ptr;
@@ -230,18 +349,278 @@ schedule_transmission(struct neighbor_queue *n)
   ctimer_set(&n->transmit_timer, delay, transmit_packet_list, n);
 }
 /*---------------------------------------------------------------------------*/
+#if CSMA_WITH_DRR
+static void
+ring_append(struct neighbor_ring *ring, struct neighbor_queue *n)
+{
+  n->next = NULL;
+  if(ring->tail != NULL) {
+    ring->tail->next = n;
+  } else {
+    ring->head = n;
+  }
+  ring->tail = n;
+}
+/*---------------------------------------------------------------------------*/
+static void
+ring_push(struct neighbor_ring *ring, struct neighbor_queue *n)
+{
+  n->next = ring->head;
+  ring->head = n;
+  if(ring->tail == NULL) {
+    ring->tail = n;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct neighbor_queue *
+ring_pop(struct neighbor_ring *ring)
+{
+  struct neighbor_queue *n = ring->head;
+  if(n != NULL) {
+    ring->head = n->next;
+    if(ring->head == NULL) {
+      ring->tail = NULL;
+    }
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static void
+ring_remove(struct neighbor_ring *ring, struct neighbor_queue *n)
+{
+  struct neighbor_queue *prev = NULL;
+  struct neighbor_queue *p;
+
+  for(p = ring->head; p != NULL; prev = p, p = p->next) {
+    if(p == n) {
+      if(prev != NULL) {
+        prev->next = n->next;
+      } else {
+        ring->head = n->next;
+      }
+      if(ring->tail == n) {
+        ring->tail = prev;
+      }
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct qbuf_metadata *
+head_metadata(struct neighbor_queue *n)
+{
+  return ((struct rdc_buf_list *)list_head(n->queued_packet_list))->ptr;
+}
+/*---------------------------------------------------------------------------*/
+/* Control packets are the ICMPv6 messages others than the errors and echos,
+   i.e. ND, MLD and RPL, as tagged by sicslowpan */
+static int
+packet_is_control(void)
+{
+#if PACKETBUF_WITH_PACKET_TYPE
+  if(packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE) ==
+     PACKETBUF_ATTR_PACKET_TYPE_ACK) {
+    return 1;
+  }
+#endif
+#if NETSTACK_CONF_WITH_IPV6
+  return packetbuf_attr(PACKETBUF_ATTR_NETWORK_ID) == UIP_PROTO_ICMP6 &&
+    (packetbuf_attr(PACKETBUF_ATTR_CHANNEL) >> 8) > ICMP6_ECHO_REPLY;
+#else
+  return 0;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+/* Put a queue in the ring matching its next packet. A queue which has not
+   used its deficit yet goes back to the head of the data ring */
+static void
+make_ready(struct neighbor_queue *n, int continue_round)
+{
+  n->state = NEIGHBOR_READY;
+  if(head_metadata(n)->control) {
+    ring_append(&control_ring, n);
+  } else if(continue_round) {
+    ring_push(&data_ring, n);
+  } else {
+    ring_append(&data_ring, n);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Start the transmission of the next packets until all the transmit slots
+   are used */
+static void
+drr_schedule(void)
+{
+  struct neighbor_queue *n;
+  struct qbuf_metadata *metadata;
+  clock_time_t sojourn;
+
+  while(active_neighbors < CSMA_MAX_ACTIVE_NEIGHBORS) {
+    n = ring_pop(&control_ring);
+    if(n != NULL) {
+      metadata = head_metadata(n);
+    } else {
+      n = ring_pop(&data_ring);
+      if(n == NULL) {
+        break;
+      }
+      metadata = head_metadata(n);
+      if(n->deficit < metadata->len) {
+        /* New round for this queue */
+        n->deficit += CSMA_DRR_QUANTUM;
+        if(n->deficit < metadata->len) {
+          ring_append(&data_ring, n);
+          continue;
+        }
+      }
+      n->deficit -= metadata->len;
+    }
+
+    sojourn = clock_time() - metadata->enqueued;
+    n->dequeued++;
+    n->sojourn_total += sojourn;
+    if(sojourn > n->sojourn_max) {
+      n->sojourn_max = sojourn;
+    }
+    n->state = NEIGHBOR_ACTIVE;
+    active_neighbors++;
+    n->transmissions = 0;
+    n->collisions = CSMA_MIN_BE;
+    schedule_transmission(n);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Queue a packet, the control packets go after the packet being sent and
+   the other control packets */
+static void
+drr_enqueue(struct neighbor_queue *n, struct rdc_buf_list *q)
+{
+  struct qbuf_metadata *metadata = q->ptr;
+  struct rdc_buf_list *prev = NULL;
+  struct rdc_buf_list *p;
+
+  if(metadata->control) {
+    p = list_head(n->queued_packet_list);
+    if(n->state == NEIGHBOR_ACTIVE) {
+      prev = p;
+      p = list_item_next(p);
+    }
+    while(p != NULL && ((struct qbuf_metadata *)p->ptr)->control) {
+      prev = p;
+      p = list_item_next(p);
+    }
+    list_insert(n->queued_packet_list, prev, q);
+    n->control_count++;
+    csma_control_packets++;
+  } else {
+    list_add(n->queued_packet_list, q);
+  }
+  queued_packets++;
+  n->enqueued++;
+  if(n->count > n->max_queued) {
+    n->max_queued = n->count;
+  }
+  n->last_used = clock_time();
+
+  if(n->state == NEIGHBOR_IDLE) {
+    make_ready(n, 0);
+    drr_schedule();
+  } else if(n->state == NEIGHBOR_READY && metadata->control &&
+            list_head(n->queued_packet_list) == q) {
+    /* The queue was waiting for its turn in the data ring */
+    ring_remove(&data_ring, n);
+    ring_append(&control_ring, n);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The head packet of a queue is done, release its transmit slot */
+static void
+drr_dequeue(struct neighbor_queue *n, struct rdc_buf_list *p)
+{
+  queued_packets--;
+  if(((struct qbuf_metadata *)p->ptr)->control) {
+    n->control_count--;
+  }
+  n->last_used = clock_time();
+  if(n->state == NEIGHBOR_ACTIVE) {
+    active_neighbors--;
+  }
+  if(list_head(n->queued_packet_list) != NULL) {
+    make_ready(n, n->deficit >= head_metadata(n)->len);
+  } else {
+    /* The queue is kept, with its statistics, until its slot is needed */
+    ctimer_stop(&n->transmit_timer);
+    n->state = NEIGHBOR_IDLE;
+    n->deficit = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Take back the queue of the neighbor idle for the longest time */
+static struct neighbor_queue *
+reclaim_idle_neighbor(void)
+{
+  struct neighbor_queue *n;
+  struct neighbor_queue *oldest = NULL;
+  clock_time_t now = clock_time();
+  int i;
+
+  for(i = 0; i < CSMA_MAX_NEIGHBOR_QUEUES; i++) {
+    n = &((struct neighbor_queue *)neighbor_memb.mem)[i];
+    if(neighbor_memb.count[i] != 0 && n->state == NEIGHBOR_IDLE &&
+       (oldest == NULL || now - n->last_used > now - oldest->last_used)) {
+      oldest = n;
+    }
+  }
+  if(oldest != NULL) {
+    hash_remove(oldest);
+  }
+  return oldest;
+}
+/*---------------------------------------------------------------------------*/
+int
+csma_neighbor_stats(int index, struct csma_neighbor_stats *stats)
+{
+  struct neighbor_queue *n;
+
+  if(index < 0 || index >= CSMA_MAX_NEIGHBOR_QUEUES) {
+    return -1;
+  }
+  if(neighbor_memb.count[index] == 0) {
+    return 0;
+  }
+  n = &((struct neighbor_queue *)neighbor_memb.mem)[index];
+  linkaddr_copy(&stats->addr, &n->addr);
+  stats->queued = n->count;
+  stats->control_queued = n->control_count;
+  stats->max_queued = n->max_queued;
+  stats->enqueued = n->enqueued;
+  stats->overflows = n->overflows;
+  stats->dequeued = n->dequeued;
+  stats->sojourn_total = n->sojourn_total;
+  stats->sojourn_max = n->sojourn_max;
+  return 1;
+}
+#endif /* CSMA_WITH_DRR */
+/*---------------------------------------------------------------------------*/
 static void
 free_packet(struct neighbor_queue *n, struct rdc_buf_list *p, int status)
 {
   if(p != NULL) {
     /* Remove packet from list and deallocate */
     list_remove(n->queued_packet_list, p);
+    n->count--;
+#if CSMA_WITH_DRR
+    drr_dequeue(n, p);
+#endif
 
     queuebuf_free(p->buf);
     memb_free(&metadata_memb, p->ptr);
     memb_free(&packet_memb, p);
     PRINTF("csma: free_queued_packet, queue length %d, free packets %d\n",
-           list_length(n->queued_packet_list), memb_numfree(&packet_memb));
+           n->count, memb_numfree(&packet_memb));
+#if CSMA_WITH_DRR
+    drr_schedule();
+#else
     if(list_head(n->queued_packet_list) != NULL) {
       /* There is a next packet. We reset current tx information */
       n->transmissions = 0;
@@ -254,6 +633,7 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p, int status)
       list_remove(neighbor_list, n);
       memb_free(&neighbor_memb, n);
     }
+#endif
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -413,27 +793,54 @@ send_packet(mac_callback_t sent, void *ptr)
   struct rdc_buf_list *q;
   struct neighbor_queue *n;
   const linkaddr_t *addr = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
+#if CSMA_WITH_DRR
+  int control = packet_is_control();
+#endif
 
   /* Look for the neighbor entry */
   n = neighbor_queue_from_addr(addr);
   if(n == NULL) {
     /* Allocate a new neighbor entry */
     n = memb_alloc(&neighbor_memb);
+#if CSMA_WITH_DRR
+    if(n == NULL) {
+      n = reclaim_idle_neighbor();
+    }
+    if(n != NULL) {
+      memset(n, 0, sizeof(struct neighbor_queue));
+      n->state = NEIGHBOR_IDLE;
+    }
+#endif
     if(n != NULL) {
       /* Init neighbor entry */
       linkaddr_copy(&n->addr, addr);
       n->transmissions = 0;
       n->collisions = CSMA_MIN_BE;
+      n->count = 0;
       /* Init packet list for this neighbor */
       LIST_STRUCT_INIT(n, queued_packet_list);
+#if CSMA_WITH_DRR
+      /* Add neighbor to the hash table */
+      n->hash_next = neighbor_hash[hash_bucket(addr)];
+      neighbor_hash[hash_bucket(addr)] = n;
+#else
       /* Add neighbor to the list */
       list_add(neighbor_list, n);
+#endif
     }
   }
 
   if(n != NULL) {
-    /* Add packet to the neighbor's queue */
-    if(list_length(n->queued_packet_list) < CSMA_MAX_PACKET_PER_NEIGHBOR) {
+    /* Add packet to the neighbor's queue. With CSMA_WITH_DRR, the control
+       packets are only limited by the packet pool, part of it being kept
+       for them */
+#if CSMA_WITH_DRR
+    if(control ? queued_packets < MAX_QUEUED_PACKETS :
+       n->count - n->control_count < CSMA_MAX_PACKET_PER_NEIGHBOR &&
+       queued_packets + CSMA_CONTROL_RESERVE < MAX_QUEUED_PACKETS) {
+#else
+    if(n->count < CSMA_MAX_PACKET_PER_NEIGHBOR) {
+#endif
       q = memb_alloc(&packet_memb);
       if(q != NULL) {
         q->ptr = memb_alloc(&metadata_memb);
@@ -454,6 +861,13 @@ send_packet(mac_callback_t sent, void *ptr)
 #if CETIC_6LBR_MULTI_RADIO
             metadata->ifindex = multi_radio_output_ifindex;
 #endif
+            n->count++;
+#if CSMA_WITH_DRR
+            metadata->enqueued = clock_time();
+            metadata->len = packetbuf_totlen();
+            metadata->control = control;
+            drr_enqueue(n, q);
+#else
 #if PACKETBUF_WITH_PACKET_TYPE
             if(packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE) ==
                PACKETBUF_ATTR_PACKET_TYPE_ACK) {
@@ -463,13 +877,16 @@ send_packet(mac_callback_t sent, void *ptr)
             {
               list_add(n->queued_packet_list, q);
             }
+#endif
 
             PRINTF("csma: send_packet, queue length %d, free packets %d\n",
-                   list_length(n->queued_packet_list), memb_numfree(&packet_memb));
+                   n->count, memb_numfree(&packet_memb));
+#if !CSMA_WITH_DRR
             /* If q is the first packet in the neighbor's queue, send asap */
             if(list_head(n->queued_packet_list) == q) {
               schedule_transmission(n);
             }
+#endif
             return;
           }
           memb_free(&metadata_memb, q->ptr);
@@ -478,14 +895,19 @@ send_packet(mac_callback_t sent, void *ptr)
         memb_free(&packet_memb, q);
         PRINTF("csma: could not allocate queuebuf, dropping packet\n");
       }
+#if !CSMA_WITH_DRR
       /* The packet allocation failed. Remove and free neighbor entry if empty. */
-      if(list_length(n->queued_packet_list) == 0) {
+      if(n->count == 0) {
         list_remove(neighbor_list, n);
         memb_free(&neighbor_memb, n);
       }
+#endif
     } else {
       PRINTF("csma: Neighbor queue full\n");
     }
+#if CSMA_WITH_DRR
+    n->overflows++;
+#endif
     PRINTF("csma: could not allocate packet, dropping packet\n");
     csma_packet_overflow++;
   } else {
@@ -529,6 +951,13 @@ init(void)
   memb_init(&packet_memb);
   memb_init(&metadata_memb);
   memb_init(&neighbor_memb);
+#if CSMA_WITH_DRR
+  memset(neighbor_hash, 0, sizeof(neighbor_hash));
+  memset(&control_ring, 0, sizeof(control_ring));
+  memset(&data_ring, 0, sizeof(data_ring));
+  active_neighbors = 0;
+  queued_packets = 0;
+#endif
 }
 /*---------------------------------------------------------------------------*/
 const struct mac_driver csma_driver = {
@@ -43,6 +43,17 @@
 
 #include "net/mac/mac.h"
 #include "dev/radio.h"
+#include "net/linkaddr.h"
+#include "sys/clock.h"
+
+/* Serve the neighbor queues with a deficit round robin scheduler, sending
+   the control packets (RPL, ND) before the data packets, instead of letting
+   each queue transmit on its own timer */
+#ifdef CSMA_CONF_WITH_DRR
+#define CSMA_WITH_DRR CSMA_CONF_WITH_DRR
+#else
+#define CSMA_WITH_DRR 0
+#endif
 
 extern const struct mac_driver csma_driver;
 
@@ -60,4 +71,29 @@ extern uint32_t csma_collisions;
 extern uint32_t csma_retransmissions;
 extern uint32_t csma_dropped;
 
+#if CSMA_WITH_DRR
+struct csma_neighbor_stats {
+  linkaddr_t addr;
+  /* Packets currently queued, control packets included */
+  uint16_t queued;
+  uint16_t control_queued;
+  uint16_t max_queued;
+  uint32_t enqueued;
+  /* Packets refused because the queue or the packet pool was full */
+  uint32_t overflows;
+  /* Packets that left the queue for their first transmission */
+  uint32_t dequeued;
+  /* Time spent in the queue before the first transmission, in clock ticks */
+  uint32_t sojourn_total;
+  clock_time_t sojourn_max;
+};
+
+extern uint32_t csma_control_packets;
+
+/* Copy the statistics of the neighbor queue in slot index. Returns 1 if the
+   slot is used, 0 if it is free and -1 past the last slot. The queues of the
+   idle neighbors are kept until their slot is needed */
+int csma_neighbor_stats(int index, struct csma_neighbor_stats *stats);
+#endif /* CSMA_WITH_DRR */
+
 #endif /* CSMA_H_ */
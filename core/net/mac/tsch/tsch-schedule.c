@@ -69,6 +69,55 @@ MEMB(slotframe_memb, struct tsch_slotframe, TSCH_SCHEDULE_MAX_SLOTFRAMES);
 /* List of slotframes (each slotframe holds its own list of links) */
 LIST(slotframe_list);
 
+#if TSCH_SCHEDULE_SORTED
+/*---------------------------------------------------------------------------*/
+/* Returns the index of the first link of the slotframe whose timeslot is not
+ * lower than the given one */
+static int
+sorted_links_lower_bound(struct tsch_slotframe *sf, uint16_t timeslot)
+{
+  int low = 0;
+  int high = sf->links_count;
+  int mid;
+  while(low < high) {
+    mid = (low + high) / 2;
+    if(sf->sorted_links[mid]->timeslot < timeslot) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+/*---------------------------------------------------------------------------*/
+static void
+sorted_links_add(struct tsch_slotframe *sf, struct tsch_link *l)
+{
+  int i = sorted_links_lower_bound(sf, l->timeslot);
+  memmove(&sf->sorted_links[i + 1], &sf->sorted_links[i],
+          (sf->links_count - i) * sizeof(struct tsch_link *));
+  sf->sorted_links[i] = l;
+  sf->links_count++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+sorted_links_remove(struct tsch_slotframe *sf, struct tsch_link *l)
+{
+  int i = sorted_links_lower_bound(sf, l->timeslot);
+  /* Several links could share the timeslot if the previous one could not be
+   * removed when the new one was added */
+  while(i < sf->links_count && sf->sorted_links[i] != l) {
+    i++;
+  }
+  if(i < sf->links_count) {
+    sf->links_count--;
+    memmove(&sf->sorted_links[i], &sf->sorted_links[i + 1],
+            (sf->links_count - i) * sizeof(struct tsch_link *));
+  }
+}
+#endif /* TSCH_SCHEDULE_SORTED */
+/*---------------------------------------------------------------------------*/
+
 /* Adds and returns a slotframe (NULL if failure) */
 struct tsch_slotframe *
 tsch_schedule_add_slotframe(uint16_t handle, uint16_t size)
@@ -89,6 +138,9 @@ tsch_schedule_add_slotframe(uint16_t handle, uint16_t size)
       sf->handle = handle;
       TSCH_ASN_DIVISOR_INIT(sf->size, size);
       LIST_STRUCT_INIT(sf, links_list);
+#if TSCH_SCHEDULE_SORTED
+      sf->links_count = 0;
+#endif
       /* Add the slotframe to the global list */
       list_add(slotframe_list, sf);
     }
@@ -209,6 +261,9 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
           address = &linkaddr_null;
         }
         linkaddr_copy(&l->addr, address);
+#if TSCH_SCHEDULE_SORTED
+        sorted_links_add(slotframe, l);
+#endif
 
         PRINTF("TSCH-schedule: add_link %u %u %u %u %u %u\n",
                slotframe->handle, link_options, link_type, timeslot, channel_offset, TSCH_LOG_ID_FROM_LINKADDR(address));
@@ -256,6 +311,9 @@ tsch_schedule_remove_link(struct tsch_slotframe *slotframe, struct tsch_link *l)
              TSCH_LOG_ID_FROM_LINKADDR(&l->addr));
 
       list_remove(slotframe->links_list, l);
+#if TSCH_SCHEDULE_SORTED
+      sorted_links_remove(slotframe, l);
+#endif
       memb_free(&link_memb, l);
 
       /* Release the lock before we update the neighbor (will take the lock) */
@@ -294,6 +352,13 @@ tsch_schedule_get_link_by_timeslot(struct tsch_slotframe *slotframe, uint16_t ti
 {
   if(!tsch_is_locked()) {
     if(slotframe != NULL) {
+#if TSCH_SCHEDULE_SORTED
+      int i = sorted_links_lower_bound(slotframe, timeslot);
+      if(i < slotframe->links_count && slotframe->sorted_links[i]->timeslot == timeslot) {
+        return slotframe->sorted_links[i];
+      }
+      return NULL;
+#else
       struct tsch_link *l = list_head(slotframe->links_list);
       /* Loop over all items. Assume there is max one link per timeslot */
       while(l != NULL) {
@@ -303,11 +368,58 @@ tsch_schedule_get_link_by_timeslot(struct tsch_slotframe *slotframe, uint16_t ti
         l = list_item_next(l);
       }
       return l;
+#endif
     }
   }
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+/* Considers a link occurring in time_to_timeslot slots as the next active
+ * link, the current best and backup links are updated accordingly */
+static void
+select_link(struct tsch_link *l, uint16_t time_to_timeslot,
+    struct tsch_link **curr_best, uint16_t *time_to_curr_best,
+    struct tsch_link **curr_backup)
+{
+  if(*curr_best == NULL || time_to_timeslot < *time_to_curr_best) {
+    *time_to_curr_best = time_to_timeslot;
+    *curr_best = l;
+    *curr_backup = NULL;
+  } else if(time_to_timeslot == *time_to_curr_best) {
+    struct tsch_link *new_best = NULL;
+    /* Two links are overlapping, we need to select one of them.
+     * By standard: prioritize Tx links first, second by lowest handle */
+    if(((*curr_best)->link_options & LINK_OPTION_TX) == (l->link_options & LINK_OPTION_TX)) {
+      /* Both or neither links have Tx, select the one with lowest handle */
+      if(l->slotframe_handle < (*curr_best)->slotframe_handle) {
+        new_best = l;
+      }
+    } else {
+      /* Select the link that has the Tx option */
+      if(l->link_options & LINK_OPTION_TX) {
+        new_best = l;
+      }
+    }
+
+    /* Maintain backup_link */
+    if(*curr_backup == NULL) {
+      /* Check if 'l' best can be used as backup */
+      if(new_best != l && (l->link_options & LINK_OPTION_RX)) { /* Does 'l' have Rx flag? */
+        *curr_backup = l;
+      }
+      /* Check if curr_best can be used as backup */
+      if(new_best != *curr_best && ((*curr_best)->link_options & LINK_OPTION_RX)) { /* Does curr_best have Rx flag? */
+        *curr_backup = *curr_best;
+      }
+    }
+
+    /* Maintain curr_best */
+    if(new_best != NULL) {
+      *curr_best = new_best;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 /* Returns the next active link after a given ASN, and a backup link (for the same ASN, with Rx flag) */
 struct tsch_link *
 tsch_schedule_get_next_active_link(struct tsch_asn_t *asn, uint16_t *time_offset,
@@ -325,52 +437,28 @@ tsch_schedule_get_next_active_link(struct tsch_asn_t *asn, uint16_t *time_offset
     while(sf != NULL) {
       /* Get timeslot from ASN, given the slotframe length */
       uint16_t timeslot = TSCH_ASN_MOD(*asn, sf->size);
+#if TSCH_SCHEDULE_SORTED
+      /* There is at most one link per timeslot, so only the first link after
+       * the current timeslot, wrapping around, can be selected */
+      if(sf->links_count > 0) {
+        int i = sorted_links_lower_bound(sf, timeslot + 1);
+        struct tsch_link *l = sf->sorted_links[i < sf->links_count ? i : 0];
+        select_link(l, l->timeslot > timeslot ?
+                    l->timeslot - timeslot :
+                    sf->size.val + l->timeslot - timeslot,
+                    &curr_best, &time_to_curr_best, &curr_backup);
+      }
+#else
       struct tsch_link *l = list_head(sf->links_list);
       while(l != NULL) {
         uint16_t time_to_timeslot =
           l->timeslot > timeslot ?
           l->timeslot - timeslot :
           sf->size.val + l->timeslot - timeslot;
-        if(curr_best == NULL || time_to_timeslot < time_to_curr_best) {
-          time_to_curr_best = time_to_timeslot;
-          curr_best = l;
-          curr_backup = NULL;
-        } else if(time_to_timeslot == time_to_curr_best) {
-          struct tsch_link *new_best = NULL;
-          /* Two links are overlapping, we need to select one of them.
-           * By standard: prioritize Tx links first, second by lowest handle */
-          if((curr_best->link_options & LINK_OPTION_TX) == (l->link_options & LINK_OPTION_TX)) {
-            /* Both or neither links have Tx, select the one with lowest handle */
-            if(l->slotframe_handle < curr_best->slotframe_handle) {
-              new_best = l;
-            }
-          } else {
-            /* Select the link that has the Tx option */
-            if(l->link_options & LINK_OPTION_TX) {
-              new_best = l;
-            }
-          }
-
-          /* Maintain backup_link */
-          if(curr_backup == NULL) {
-            /* Check if 'l' best can be used as backup */
-            if(new_best != l && (l->link_options & LINK_OPTION_RX)) { /* Does 'l' have Rx flag? */
-              curr_backup = l;
-            }
-            /* Check if curr_best can be used as backup */
-            if(new_best != curr_best && (curr_best->link_options & LINK_OPTION_RX)) { /* Does curr_best have Rx flag? */
-              curr_backup = curr_best;
-            }
-          }
-
-          /* Maintain curr_best */
-          if(new_best != NULL) {
-            curr_best = new_best;
-          }
-        }
-
+        select_link(l, time_to_timeslot, &curr_best, &time_to_curr_best, &curr_backup);
         l = list_item_next(l);
       }
+#endif
       sf = list_item_next(sf);
     }
     if(time_offset != NULL) {
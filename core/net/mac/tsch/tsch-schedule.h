@@ -72,6 +72,14 @@
 #define TSCH_SCHEDULE_MAX_LINKS 32
 #endif
 
+/* Keep, for each slotframe, its links sorted by timeslot so that the next
+ * active link is found with a binary search instead of a scan of all links */
+#ifdef TSCH_SCHEDULE_CONF_SORTED
+#define TSCH_SCHEDULE_SORTED TSCH_SCHEDULE_CONF_SORTED
+#else
+#define TSCH_SCHEDULE_SORTED 0
+#endif
+
 /********** Constants *********/
 
 /* Link options */
@@ -122,6 +130,11 @@ struct tsch_slotframe {
   struct tsch_asn_divisor_t size;
   /* List of links belonging to this slotframe */
   LIST_STRUCT(links_list);
+#if TSCH_SCHEDULE_SORTED
+  /* Links of links_list, by increasing timeslot */
+  struct tsch_link *sorted_links[TSCH_SCHEDULE_MAX_LINKS];
+  uint16_t links_count;
+#endif
 };
 
 /********** Functions *********/
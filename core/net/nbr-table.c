@@ -38,6 +38,7 @@
 #include <string.h>
 #include "lib/memb.h"
 #include "lib/list.h"
+#include "lib/hash-index.h"
 #include "net/nbr-table.h"
 
 #define DEBUG 0
@@ -79,10 +80,21 @@ static struct nbr_table *all_tables[MAX_NUM_TABLES];
 /* The current number of tables */
 static unsigned num_tables;
 
+uint32_t nbr_table_version;
+
 /* The neighbor address table */
 MEMB(neighbor_addr_mem, nbr_table_key_t, NBR_TABLE_MAX_NEIGHBORS);
 LIST(nbr_table_keys);
 
+#if NBR_TABLE_WITH_HASH
+#if NBR_TABLE_HASH_SIZE <= NBR_TABLE_MAX_NEIGHBORS
+#error "NBR_TABLE_HASH_SIZE must be larger than NBR_TABLE_MAX_NEIGHBORS"
+#endif
+static uint32_t key_hash(const void *key);
+/* Hash index of the keys */
+HASH_INDEX(hash_index, NBR_TABLE_HASH_SIZE, key_hash);
+#endif /* NBR_TABLE_WITH_HASH */
+
 /*---------------------------------------------------------------------------*/
 /* Get a key from a neighbor index */
 static nbr_table_key_t *
@@ -126,16 +138,38 @@ key_from_item(nbr_table_t *table, const nbr_table_item_t *item)
   return key_from_index(index_from_item(table, item));
 }
 /*---------------------------------------------------------------------------*/
+#if NBR_TABLE_WITH_HASH
+/* Hash of a key, from its link-layer address */
+static uint32_t
+key_hash(const void *key)
+{
+  return hash_fnv(HASH_FNV_INIT, &((const nbr_table_key_t *)key)->lladdr, LINKADDR_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+static int
+key_matches(const void *key, const void *lladdr)
+{
+  return linkaddr_cmp(lladdr, &((const nbr_table_key_t *)key)->lladdr);
+}
+#endif /* NBR_TABLE_WITH_HASH */
+/*---------------------------------------------------------------------------*/
 /* Get the index of a neighbor from its link-layer address */
 static int
 index_from_lladdr(const linkaddr_t *lladdr)
 {
+#if !NBR_TABLE_WITH_HASH
   nbr_table_key_t *key;
+#endif /* !NBR_TABLE_WITH_HASH */
   /* Allow lladdr-free insertion, useful e.g. for IPv6 ND.
    * Only one such entry is possible at a time, indexed by linkaddr_null. */
   if(lladdr == NULL) {
     lladdr = &linkaddr_null;
   }
+#if NBR_TABLE_WITH_HASH
+  return index_from_key(hash_index_find(&hash_index,
+                                        hash_fnv(HASH_FNV_INIT, lladdr, LINKADDR_SIZE),
+                                        key_matches, lladdr));
+#else /* NBR_TABLE_WITH_HASH */
   key = list_head(nbr_table_keys);
   while(key != NULL) {
     if(lladdr && linkaddr_cmp(lladdr, &key->lladdr)) {
@@ -144,6 +178,7 @@ index_from_lladdr(const linkaddr_t *lladdr)
     key = list_item_next(key);
   }
   return -1;
+#endif /* NBR_TABLE_WITH_HASH */
 }
 /*---------------------------------------------------------------------------*/
 /* Get bit from "used" or "locked" bitmap */
@@ -193,6 +228,10 @@ remove_key(nbr_table_key_t *least_used_key)
   }
   /* Empty used map */
   used_map[index_from_key(least_used_key)] = 0;
+  nbr_table_version++;
+#if NBR_TABLE_WITH_HASH
+  hash_index_remove(&hash_index, least_used_key);
+#endif /* NBR_TABLE_WITH_HASH */
   /* Remove neighbor from list */
   list_remove(nbr_table_keys, least_used_key);
 }
@@ -359,6 +398,9 @@ nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lladdr, nbr_table_rea
 
     /* Set link-layer address */
     linkaddr_copy(&key->lladdr, lladdr);
+#if NBR_TABLE_WITH_HASH
+    hash_index_add(&hash_index, key);
+#endif /* NBR_TABLE_WITH_HASH */
   }
 
   /* Get item in the current table */
@@ -367,6 +409,7 @@ nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lladdr, nbr_table_rea
   /* Initialize item data and set "used" bit */
   memset(item, 0, table->item_size);
   nbr_set_bit(used_map, table, item, 1);
+  nbr_table_version++;
 
 #if DEBUG
   print_table();
@@ -388,6 +431,7 @@ nbr_table_remove(nbr_table_t *table, void *item)
 {
   int ret = nbr_set_bit(used_map, table, item, 0);
   nbr_set_bit(locked_map, table, item, 0);
+  nbr_table_version++;
   return ret;
 }
 /*---------------------------------------------------------------------------*/
@@ -446,11 +490,18 @@ nbr_table_update_lladdr(const linkaddr_t *old_addr, const linkaddr_t *new_addr,
     return 0;
   }
   key = key_from_index(index);
+#if NBR_TABLE_WITH_HASH
+  hash_index_remove(&hash_index, key);
+#endif /* NBR_TABLE_WITH_HASH */
   /**
    * Copy the new lladdr into the key - since we know that there is no
    * conflicting entry.
    */
   memcpy(&key->lladdr, new_addr, sizeof(linkaddr_t));
+#if NBR_TABLE_WITH_HASH
+  hash_index_add(&hash_index, key);
+#endif /* NBR_TABLE_WITH_HASH */
+  nbr_table_version++;
   return 1;
 }
 /*---------------------------------------------------------------------------*/
@@ -46,6 +46,22 @@
 #define NBR_TABLE_MAX_NEIGHBORS 8
 #endif /* NBR_TABLE_CONF_MAX_NEIGHBORS */
 
+/* Index the neighbors by link-layer address with an open-addressing hash
+ * table, instead of walking the neighbor list on each lookup */
+#ifdef NBR_TABLE_CONF_WITH_HASH
+#define NBR_TABLE_WITH_HASH NBR_TABLE_CONF_WITH_HASH
+#else /* NBR_TABLE_CONF_WITH_HASH */
+#define NBR_TABLE_WITH_HASH 0
+#endif /* NBR_TABLE_CONF_WITH_HASH */
+
+/* Number of slots of the hash index, must be larger than the number of
+ * neighbors. Twice the number of neighbors keeps the probe sequences short */
+#ifdef NBR_TABLE_CONF_HASH_SIZE
+#define NBR_TABLE_HASH_SIZE NBR_TABLE_CONF_HASH_SIZE
+#else /* NBR_TABLE_CONF_HASH_SIZE */
+#define NBR_TABLE_HASH_SIZE (2 * NBR_TABLE_MAX_NEIGHBORS)
+#endif /* NBR_TABLE_CONF_HASH_SIZE */
+
 /* An item in a neighbor table */
 typedef void nbr_table_item_t;
 
@@ -113,4 +129,8 @@ linkaddr_t *nbr_table_get_lladdr(nbr_table_t *table, const nbr_table_item_t *ite
 int nbr_table_update_lladdr(const linkaddr_t *old_addr, const linkaddr_t *new_addr, int remove_if_duplicate);
 /** @} */
 
+/* Incremented each time a neighbor is added to or removed from a table,
+   lets the readers detect that the tables have changed */
+extern uint32_t nbr_table_version;
+
 #endif /* NBR_TABLE_H_ */
@@ -322,11 +322,28 @@ count_matching_bytes(const void *p1, const void *p2, size_t n)
   return n;
 }
 /*---------------------------------------------------------------------------*/
+/* Account for an extension header of ext_len bytes inserted after the
+ * IPv6 header */
+static void
+update_ip_len(uint8_t ext_len)
+{
+  uint8_t temp_len;
+
+  /* In-place update of IPv6 length field */
+  temp_len = UIP_IP_BUF->len[1];
+  UIP_IP_BUF->len[1] += ext_len;
+  if(UIP_IP_BUF->len[1] < temp_len) {
+    UIP_IP_BUF->len[0]++;
+  }
+
+  uip_ext_len += ext_len;
+  uip_len += ext_len;
+}
+/*---------------------------------------------------------------------------*/
 static int
 insert_srh_header(void)
 {
   /* Implementation of RFC6554 */
-  uint8_t temp_len;
   uint8_t path_len;
   uint8_t ext_len;
   uint8_t cmpri, cmpre; /* ComprI and ComprE fields of the RPL Source Routing Header */
@@ -358,6 +375,25 @@ insert_srh_header(void)
     return 1;
   }
 
+#if RPL_NS_SRH_CACHE
+  if(dest_node->srh_len != 0 && dest_node->srh_version == rpl_ns_topology_version()) {
+    /* The path did not change since the header was built, reuse it */
+    ext_len = dest_node->srh_len;
+    if(uip_len + ext_len > UIP_BUFSIZE) {
+      PRINTF("RPL: Packet too long: impossible to add source routing header (%u bytes)\n", ext_len);
+      return 1;
+    }
+    memmove(uip_buf + uip_l2_l3_hdr_len + ext_len,
+        uip_buf + uip_l2_l3_hdr_len, uip_len - UIP_IPH_LEN);
+    memcpy(UIP_RH_BUF, dest_node->srh, ext_len);
+    UIP_RH_BUF->next = UIP_IP_BUF->proto;
+    UIP_IP_BUF->proto = UIP_PROTO_ROUTING;
+    rpl_ns_get_node_global_addr(&UIP_IP_BUF->destipaddr, dest_node->srh_first_hop);
+    update_ip_len(ext_len);
+    return 1;
+  }
+#endif /* RPL_NS_SRH_CACHE */
+
   root_node = rpl_ns_get_node(dag, &dag->dag_id);
   if(root_node == NULL) {
     PRINTF("RPL: SRH root node not found\n");
@@ -449,15 +485,16 @@ insert_srh_header(void)
   rpl_ns_get_node_global_addr(&node_addr, node);
   uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &node_addr);
 
-  /* In-place update of IPv6 length field */
-  temp_len = UIP_IP_BUF->len[1];
-  UIP_IP_BUF->len[1] += ext_len;
-  if(UIP_IP_BUF->len[1] < temp_len) {
-    UIP_IP_BUF->len[0]++;
+#if RPL_NS_SRH_CACHE
+  if(ext_len <= RPL_NS_SRH_CACHE_MAX_LEN) {
+    memcpy(dest_node->srh, UIP_RH_BUF, ext_len);
+    dest_node->srh_len = ext_len;
+    dest_node->srh_first_hop = node;
+    dest_node->srh_version = rpl_ns_topology_version();
   }
+#endif /* RPL_NS_SRH_CACHE */
 
-  uip_ext_len += ext_len;
-  uip_len += ext_len;
+  update_ip_len(ext_len);
 
   return 1;
 }
@@ -47,6 +47,7 @@
 #include "net/rpl/rpl-ns.h"
 #include "lib/list.h"
 #include "lib/memb.h"
+#include "lib/hash-index.h"
 
 #if RPL_WITH_NON_STORING
 
@@ -63,6 +64,18 @@ static int num_nodes;
 LIST(nodelist);
 MEMB(nodememb, rpl_ns_node_t, RPL_NS_LINK_NUM);
 
+/* Bumped each time a node is removed or gets a new parent */
+static uint32_t topology_version;
+
+#if RPL_NS_WITH_HASH
+#if RPL_NS_HASH_SIZE <= RPL_NS_LINK_NUM
+#error "RPL_NS_HASH_SIZE must be larger than RPL_NS_LINK_NUM"
+#endif
+/* Hash index of the nodes, keyed on their link identifier */
+static uint32_t node_hash(const void *node);
+HASH_INDEX(node_index, RPL_NS_HASH_SIZE, node_hash);
+#endif /* RPL_NS_WITH_HASH */
+
 /*---------------------------------------------------------------------------*/
 int
 rpl_ns_num_nodes(void)
@@ -81,10 +94,47 @@ node_matches_address(const rpl_dag_t *dag, const rpl_ns_node_t *node, const uip_
       && !memcmp(((const unsigned char *)addr) + 8, node->link_identifier, 8);
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_NS_WITH_HASH
+static uint32_t
+node_hash(const void *node)
+{
+  return hash_fnv(HASH_FNV_INIT, ((const rpl_ns_node_t *)node)->link_identifier, 8);
+}
+/*---------------------------------------------------------------------------*/
+struct node_key {
+  const rpl_dag_t *dag;
+  const uip_ipaddr_t *addr;
+};
+
+static int
+node_matches_key(const void *node, const void *key)
+{
+  const struct node_key *k = key;
+  return node_matches_address(k->dag, node, k->addr);
+}
+#endif /* RPL_NS_WITH_HASH */
+/*---------------------------------------------------------------------------*/
+uint32_t
+rpl_ns_topology_version(void)
+{
+  return topology_version;
+}
+/*---------------------------------------------------------------------------*/
 rpl_ns_node_t *
 rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
 {
   rpl_ns_node_t *l;
+#if RPL_NS_WITH_HASH
+  struct node_key key;
+
+  if(addr == NULL) {
+    return NULL;
+  }
+  key.dag = dag;
+  key.addr = addr;
+  return hash_index_find(&node_index, hash_fnv(HASH_FNV_INIT, ((const unsigned char *)addr) + 8, 8),
+                         node_matches_key, &key);
+#endif /* RPL_NS_WITH_HASH */
   for(l = list_head(nodelist); l != NULL; l = list_item_next(l)) {
     /* Compare prefix and node identifier */
     if(node_matches_address(dag, l, addr)) {
@@ -123,6 +173,8 @@ rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child, const uip_ipaddr_t
   rpl_ns_node_t *child_node = rpl_ns_get_node(dag, child);
   rpl_ns_node_t *parent_node = rpl_ns_get_node(dag, parent);
   rpl_ns_node_t *old_parent_node;
+  rpl_ns_node_t *previous_parent_node;
+  rpl_dag_t *previous_dag;
 
   if(parent != NULL) {
     /* No node for the parent, add one with infinite lifetime */
@@ -142,14 +194,23 @@ rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child, const uip_ipaddr_t
       return NULL;
     }
     child_node->parent = NULL;
+    child_node->dag = NULL;
+#if RPL_NS_SRH_CACHE
+    child_node->srh_len = 0;
+#endif /* RPL_NS_SRH_CACHE */
+    memcpy(child_node->link_identifier, ((const unsigned char *)child) + 8, 8);
     list_add(nodelist, child_node);
+#if RPL_NS_WITH_HASH
+    hash_index_add(&node_index, child_node);
+#endif /* RPL_NS_WITH_HASH */
     num_nodes++;
   }
+  previous_parent_node = child_node->parent;
+  previous_dag = child_node->dag;
 
   /* Initialize node */
   child_node->dag = dag;
   child_node->lifetime = lifetime;
-  memcpy(child_node->link_identifier, ((const unsigned char *)child) + 8, 8);
 
   /* Is the node reachable before the update? */
   if(rpl_ns_is_node_reachable(dag, child)) {
@@ -167,6 +228,10 @@ rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child, const uip_ipaddr_t
     child_node->parent = parent_node;
   }
 
+  if(child_node->parent != previous_parent_node || child_node->dag != previous_dag) {
+    topology_version++;
+  }
+
   return child_node;
 }
 /*---------------------------------------------------------------------------*/
@@ -176,6 +241,10 @@ rpl_ns_init(void)
   num_nodes = 0;
   memb_init(&nodememb);
   list_init(nodelist);
+#if RPL_NS_WITH_HASH
+  hash_index_clear(&node_index);
+#endif /* RPL_NS_WITH_HASH */
+  topology_version++;
 }
 /*---------------------------------------------------------------------------*/
 rpl_ns_node_t *
@@ -221,8 +290,12 @@ rpl_ns_periodic(void)
       }
       /* No child found, deallocate node */
       list_remove(nodelist, l);
+#if RPL_NS_WITH_HASH
+      hash_index_remove(&node_index, l);
+#endif /* RPL_NS_WITH_HASH */
       memb_free(&nodememb, l);
       num_nodes--;
+      topology_version++;
     }
   }
 }
@@ -49,6 +49,37 @@
 #define RPL_NS_LINK_NUM 32
 #endif /* RPL_NS_CONF_LINK_NUM */
 
+/* Index the nodes by link identifier with an open-addressing hash table,
+ * instead of walking the node list on each lookup */
+#ifdef RPL_NS_CONF_WITH_HASH
+#define RPL_NS_WITH_HASH RPL_NS_CONF_WITH_HASH
+#else /* RPL_NS_CONF_WITH_HASH */
+#define RPL_NS_WITH_HASH 0
+#endif /* RPL_NS_CONF_WITH_HASH */
+
+/* Number of slots of the hash index, must be larger than the number of
+ * nodes */
+#ifdef RPL_NS_CONF_HASH_SIZE
+#define RPL_NS_HASH_SIZE RPL_NS_CONF_HASH_SIZE
+#else /* RPL_NS_CONF_HASH_SIZE */
+#define RPL_NS_HASH_SIZE (2 * RPL_NS_LINK_NUM)
+#endif /* RPL_NS_CONF_HASH_SIZE */
+
+/* Keep, for each destination, the last source routing header built for it.
+ * The header is reused as long as the topology does not change */
+#ifdef RPL_NS_CONF_SRH_CACHE
+#define RPL_NS_SRH_CACHE RPL_NS_CONF_SRH_CACHE
+#else /* RPL_NS_CONF_SRH_CACHE */
+#define RPL_NS_SRH_CACHE 0
+#endif /* RPL_NS_CONF_SRH_CACHE */
+
+/* Longest source routing header kept in the cache */
+#ifdef RPL_NS_CONF_SRH_CACHE_MAX_LEN
+#define RPL_NS_SRH_CACHE_MAX_LEN RPL_NS_CONF_SRH_CACHE_MAX_LEN
+#else /* RPL_NS_CONF_SRH_CACHE_MAX_LEN */
+#define RPL_NS_SRH_CACHE_MAX_LEN 64
+#endif /* RPL_NS_CONF_SRH_CACHE_MAX_LEN */
+
 typedef struct rpl_ns_node {
   struct rpl_ns_node *next;
   uint32_t lifetime;
@@ -59,6 +90,15 @@ typedef struct rpl_ns_node {
 #if RPL_DAO_PATH_SEQUENCE
   uint8_t path_sequence;
 #endif
+#if RPL_NS_SRH_CACHE
+  /* Topology version the cached header was built for */
+  uint32_t srh_version;
+  /* First hop of the source route, used as IPv6 destination */
+  struct rpl_ns_node *srh_first_hop;
+  /* Length of the cached header, 0 if there is none */
+  uint8_t srh_len;
+  uint8_t srh[RPL_NS_SRH_CACHE_MAX_LEN];
+#endif
 } rpl_ns_node_t;
 
 int rpl_ns_num_nodes(void);
@@ -71,5 +111,7 @@ rpl_ns_node_t *rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
 int rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
 void rpl_ns_get_node_global_addr(uip_ipaddr_t *addr, rpl_ns_node_t *node);
 void rpl_ns_periodic(void);
+/* Changes each time a node is removed or gets a new parent */
+uint32_t rpl_ns_topology_version(void);
 
 #endif /* RPL_NS_H */
@@ -46,6 +46,8 @@
 #include "contiki.h"
 #include "lib/list.h"
 
+#include <stddef.h>
+
 LIST(ctimer_list);
 
 static char initialized;
@@ -69,9 +71,27 @@ PROCESS_THREAD(ctimer_process, ev, data)
     etimer_set(&c->etimer, c->etimer.timer.interval);
   }
   initialized = 1;
+#if ETIMER_WHEEL
+  /* From now on, the callback timers are only tracked by the armed flag */
+  list_init(ctimer_list);
+#endif
 
   while(1) {
     PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_TIMER);
+#if ETIMER_WHEEL
+    /* The event timer is embedded in the callback timer. A timer restarted
+       after its event was posted is pending again and the stale event is
+       ignored */
+    c = (struct ctimer *)((char *)data - offsetof(struct ctimer, etimer));
+    if(c->armed && etimer_expired(&c->etimer)) {
+      c->armed = 0;
+      PROCESS_CONTEXT_BEGIN(c->p);
+      if(c->f != NULL) {
+        c->f(c->ptr);
+      }
+      PROCESS_CONTEXT_END(c->p);
+    }
+#else /* ETIMER_WHEEL */
     for(c = list_head(ctimer_list); c != NULL; c = c->next) {
       if(&c->etimer == data) {
 	list_remove(ctimer_list, c);
@@ -83,6 +103,7 @@ PROCESS_THREAD(ctimer_process, ev, data)
 	break;
       }
     }
+#endif /* ETIMER_WHEEL */
   }
   PROCESS_END();
 }
@@ -118,6 +139,12 @@ ctimer_set_with_process(struct ctimer *c, clock_time_t t,
     c->etimer.timer.interval = t;
   }
 
+#if ETIMER_WHEEL
+  c->armed = 1;
+  if(initialized) {
+    return;
+  }
+#endif
   list_add(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
@@ -130,6 +157,12 @@ ctimer_reset(struct ctimer *c)
     PROCESS_CONTEXT_END(&ctimer_process);
   }
 
+#if ETIMER_WHEEL
+  c->armed = 1;
+  if(initialized) {
+    return;
+  }
+#endif
   list_add(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
@@ -142,6 +175,12 @@ ctimer_restart(struct ctimer *c)
     PROCESS_CONTEXT_END(&ctimer_process);
   }
 
+#if ETIMER_WHEEL
+  c->armed = 1;
+  if(initialized) {
+    return;
+  }
+#endif
   list_add(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
@@ -154,6 +193,12 @@ ctimer_stop(struct ctimer *c)
     c->etimer.next = NULL;
     c->etimer.p = PROCESS_NONE;
   }
+#if ETIMER_WHEEL
+  c->armed = 0;
+  if(initialized) {
+    return;
+  }
+#endif
   list_remove(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
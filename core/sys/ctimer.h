@@ -62,6 +62,10 @@ struct ctimer {
   struct process *p;
   void (*f)(void *);
   void *ptr;
+#if ETIMER_WHEEL
+  /* Set while the callback is due, replaces the walk of the timer list */
+  uint8_t armed;
+#endif
 };
 
 /**
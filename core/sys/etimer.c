@@ -49,11 +49,241 @@
 #include "sys/etimer.h"
 #include "sys/process.h"
 
+#if ETIMER_WHEEL
+/*
+ * Hierarchical timer wheel. Level 0 has one slot per clock tick for the
+ * next WHEEL_SIZE ticks, each upper level has slots covering a whole
+ * turn of the level below. When the lower level wraps, the slot of the
+ * upper level that becomes current is cascaded down. Timers beyond the
+ * span of the wheel are kept in the last slot of the top level until
+ * they get closer.
+ */
+#ifdef ETIMER_CONF_WHEEL_LEVELS
+#define WHEEL_LEVELS ETIMER_CONF_WHEEL_LEVELS
+#else
+#define WHEEL_LEVELS 5
+#endif
+
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+/* Number of ticks covered by a slot of the given level */
+#define WHEEL_SPAN(level) ((clock_time_t)1 << (WHEEL_BITS * (level)))
+/* Differences above this value are negative, i.e. in the past */
+#define WHEEL_PAST ((clock_time_t)~0 >> 1)
+
+static struct etimer *wheel[WHEEL_LEVELS][WHEEL_SIZE];
+/* One bit per non-empty slot */
+static uint64_t wheel_map[WHEEL_LEVELS];
+/* Next tick to be processed, all the previous ones are done */
+static clock_time_t wheel_time;
+static unsigned int wheel_count;
+#else
 static struct etimer *timerlist;
 static clock_time_t next_expiration;
+#endif
 
 PROCESS(etimer_process, "Event timer");
 /*---------------------------------------------------------------------------*/
+#if ETIMER_WHEEL
+static int
+first_slot(uint64_t map)
+{
+#ifdef __GNUC__
+  return __builtin_ctzll(map);
+#else
+  int slot;
+
+  for(slot = 0; !(map & 1); slot++) {
+    map >>= 1;
+  }
+  return slot;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_link(struct etimer *t)
+{
+  clock_time_t expiration;
+  clock_time_t tdist;
+  int level;
+  int slot;
+
+  expiration = t->timer.start + t->timer.interval;
+  tdist = expiration - wheel_time;
+  if(tdist > WHEEL_PAST) {
+    /* Already expired, handle it with the next tick */
+    level = 0;
+    slot = wheel_time & WHEEL_MASK;
+  } else {
+    for(level = 0; level < WHEEL_LEVELS - 1 && tdist >= WHEEL_SPAN(level + 1); level++);
+    if(tdist >= WHEEL_SPAN(WHEEL_LEVELS)) {
+      expiration = wheel_time + WHEEL_SPAN(WHEEL_LEVELS) - 1;
+    }
+    slot = (expiration >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  }
+
+  t->next = wheel[level][slot];
+  if(t->next != NULL) {
+    t->next->pprev = &t->next;
+  }
+  t->pprev = &wheel[level][slot];
+  wheel[level][slot] = t;
+  wheel_map[level] |= (uint64_t)1 << slot;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_unlink(struct etimer *t)
+{
+  int index;
+
+  *t->pprev = t->next;
+  if(t->next != NULL) {
+    t->next->pprev = t->pprev;
+  } else if(t->pprev >= &wheel[0][0] && t->pprev < &wheel[0][0] + WHEEL_LEVELS * WHEEL_SIZE
+            && *t->pprev == NULL) {
+    /* The slot is now empty */
+    index = t->pprev - &wheel[0][0];
+    wheel_map[index / WHEEL_SIZE] &= ~((uint64_t)1 << (index % WHEEL_SIZE));
+  }
+  t->next = NULL;
+  t->pprev = NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_cascade(int level, int slot)
+{
+  struct etimer *t;
+  struct etimer *next;
+
+  t = wheel[level][slot];
+  wheel[level][slot] = NULL;
+  wheel_map[level] &= ~((uint64_t)1 << slot);
+  for(; t != NULL; t = next) {
+    next = t->next;
+    wheel_link(t);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_run(void)
+{
+  clock_time_t now;
+  clock_time_t skip;
+  struct etimer *t;
+  int level;
+  int slot;
+
+  now = clock_time();
+  if(wheel_count == 0) {
+    wheel_time = now;
+    return;
+  }
+
+  while(now - wheel_time <= WHEEL_PAST) {
+    slot = wheel_time & WHEEL_MASK;
+    if(slot == 0) {
+      /* Level 0 wrapped, bring down the timers of the next slot of each
+         level that wrapped too. Cascading is idempotent, so the tick can
+         safely be processed again if an event could not be posted. */
+      for(level = 1; level < WHEEL_LEVELS; level++) {
+        slot = (wheel_time >> (WHEEL_BITS * level)) & WHEEL_MASK;
+        wheel_cascade(level, slot);
+        if(slot != 0) {
+          break;
+        }
+      }
+      slot = 0;
+    }
+
+    while((t = wheel[0][slot]) != NULL) {
+      if(process_post(t->p, PROCESS_EVENT_TIMER, t) != PROCESS_ERR_OK) {
+        /* Event queue full, retry this tick later */
+        etimer_request_poll();
+        return;
+      }
+      wheel_unlink(t);
+      wheel_count--;
+      /* Reset the process ID of the event timer, to signal that the
+         etimer has expired. This is later checked in the
+         etimer_expired() function. */
+      t->p = PROCESS_NONE;
+    }
+
+    wheel_time++;
+    slot = wheel_time & WHEEL_MASK;
+    if(slot != 0) {
+      /* Jump over the empty slots up to the end of the turn */
+      skip = (wheel_map[0] >> slot) != 0 ?
+        (clock_time_t)first_slot(wheel_map[0] >> slot) : (clock_time_t)(WHEEL_SIZE - slot);
+      if(skip > now - wheel_time + 1) {
+        skip = now - wheel_time + 1;
+      }
+      wheel_time += skip;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+wheel_next_expiration(void)
+{
+  clock_time_t next;
+  clock_time_t expiration;
+  clock_time_t turn;
+  uint64_t map;
+  int level;
+  int current;
+
+  next = wheel_time + WHEEL_SPAN(WHEEL_LEVELS);
+  for(level = 0; level < WHEEL_LEVELS; level++) {
+    if(wheel_map[level] == 0) {
+      continue;
+    }
+    current = (wheel_time >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    turn = wheel_time & ~(WHEEL_SPAN(level + 1) - 1);
+    /* The current slot of level 0 holds the timers due now. The current
+       slot of an upper level is cascaded when the next tick to process
+       starts it, afterwards it only holds timers for the next turn */
+    map = wheel_map[level] >> current;
+    if((wheel_time & (WHEEL_SPAN(level) - 1)) != 0) {
+      map &= ~(uint64_t)1;
+    }
+    if(map != 0) {
+      expiration = turn + ((clock_time_t)(current + first_slot(map)) << (WHEEL_BITS * level));
+    } else {
+      expiration = turn + WHEEL_SPAN(level + 1) +
+        ((clock_time_t)first_slot(wheel_map[level]) << (WHEEL_BITS * level));
+    }
+    /* Upper levels give the time of the cascade, a lower bound of the
+       expiration of their timers */
+    if(expiration - wheel_time < next - wheel_time) {
+      next = expiration;
+    }
+  }
+  return next;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_remove_process(struct process *p)
+{
+  struct etimer *t;
+  struct etimer *next;
+  int level;
+  int slot;
+
+  for(level = 0; level < WHEEL_LEVELS; level++) {
+    for(slot = 0; slot < WHEEL_SIZE; slot++) {
+      for(t = wheel[level][slot]; t != NULL; t = next) {
+        next = t->next;
+        if(t->p == p) {
+          wheel_unlink(t);
+          wheel_count--;
+        }
+      }
+    }
+  }
+}
+#else /* ETIMER_WHEEL */
 static void
 update_time(void)
 {
@@ -76,18 +306,32 @@ update_time(void)
     next_expiration = now + tdist;
   }
 }
+#endif /* ETIMER_WHEEL */
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(etimer_process, ev, data)
 {
+#if !ETIMER_WHEEL
   struct etimer *t, *u;
+#endif
 	
   PROCESS_BEGIN();
 
+#if ETIMER_WHEEL
+  wheel_time = clock_time();
+#else
   timerlist = NULL;
+#endif
   
   while(1) {
     PROCESS_YIELD();
 
+#if ETIMER_WHEEL
+    if(ev == PROCESS_EVENT_EXITED) {
+      wheel_remove_process(data);
+    } else if(ev == PROCESS_EVENT_POLL) {
+      wheel_run();
+    }
+#else /* ETIMER_WHEEL */
     if(ev == PROCESS_EVENT_EXITED) {
       struct process *p = data;
 
@@ -135,7 +379,7 @@ PROCESS_THREAD(etimer_process, ev, data)
       }
       u = t;
     }
-    
+#endif /* ETIMER_WHEEL */
   }
   
   PROCESS_END();
@@ -150,10 +394,22 @@ etimer_request_poll(void)
 static void
 add_timer(struct etimer *timer)
 {
+#if !ETIMER_WHEEL
   struct etimer *t;
+#endif
 
   etimer_request_poll();
 
+#if ETIMER_WHEEL
+  if(timer->p != PROCESS_NONE && timer->pprev != NULL) {
+    /* Timer already pending, move it to its new slot */
+    wheel_unlink(timer);
+  } else {
+    wheel_count++;
+  }
+  timer->p = PROCESS_CURRENT();
+  wheel_link(timer);
+#else /* ETIMER_WHEEL */
   if(timer->p != PROCESS_NONE) {
     for(t = timerlist; t != NULL; t = t->next) {
       if(t == timer) {
@@ -171,6 +427,7 @@ add_timer(struct etimer *timer)
   timerlist = timer;
 
   update_time();
+#endif /* ETIMER_WHEEL */
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -205,8 +462,18 @@ etimer_restart(struct etimer *et)
 void
 etimer_adjust(struct etimer *et, int timediff)
 {
+#if ETIMER_WHEEL
+  if(et->p != PROCESS_NONE && et->pprev != NULL) {
+    wheel_unlink(et);
+    et->timer.start += timediff;
+    wheel_link(et);
+  } else {
+    et->timer.start += timediff;
+  }
+#else
   et->timer.start += timediff;
   update_time();
+#endif
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -230,18 +497,34 @@ etimer_start_time(struct etimer *et)
 int
 etimer_pending(void)
 {
+#if ETIMER_WHEEL
+  return wheel_count != 0;
+#else
   return timerlist != NULL;
+#endif
 }
 /*---------------------------------------------------------------------------*/
 clock_time_t
 etimer_next_expiration_time(void)
 {
+#if ETIMER_WHEEL
+  return etimer_pending() ? wheel_next_expiration() : 0;
+#else
   return etimer_pending() ? next_expiration : 0;
+#endif
 }
 /*---------------------------------------------------------------------------*/
 void
 etimer_stop(struct etimer *et)
 {
+#if ETIMER_WHEEL
+  if(et->p != PROCESS_NONE && et->pprev != NULL) {
+    wheel_unlink(et);
+    wheel_count--;
+  }
+  et->next = NULL;
+  et->p = PROCESS_NONE;
+#else
   struct etimer *t;
 
   /* First check if et is the first event timer on the list. */
@@ -267,6 +550,7 @@ etimer_stop(struct etimer *et)
   et->next = NULL;
   /* Set the timer as expired */
   et->p = PROCESS_NONE;
+#endif
 }
 /*---------------------------------------------------------------------------*/
 /** @} */
@@ -65,6 +65,19 @@
 #include "sys/timer.h"
 #include "sys/process.h"
 
+/*
+ * Keep the pending event timers in a hierarchical timer wheel instead
+ * of a single list, so that setting and stopping a timer no longer
+ * walks all the pending timers. It requires a clock_time_t of at least
+ * 32 bits and event timers that are zeroed or stopped before their
+ * first use, which is the case for static timers.
+ */
+#ifdef ETIMER_CONF_WHEEL
+#define ETIMER_WHEEL ETIMER_CONF_WHEEL
+#else
+#define ETIMER_WHEEL 0
+#endif
+
 /**
  * A timer.
  *
@@ -76,6 +89,10 @@
 struct etimer {
   struct timer timer;
   struct etimer *next;
+#if ETIMER_WHEEL
+  /* Link pointing to this timer in its wheel slot, NULL if not pending */
+  struct etimer **pprev;
+#endif
   struct process *p;
 };
 
@@ -0,0 +1,889 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         6LBR logging ring buffer
+ *
+ *         The log macros only copy the format string pointer and the raw
+ *         arguments in a lock-free ring buffer. A drain thread formats the
+ *         records and writes them on stdout in large blocks. Packet dumps
+ *         are written as raw frames in a pcapng side file, one interface
+ *         per log service.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "log-6lbr.h"
+
+#if LOG6LBR_RING && !LOG6LBR_STATIC
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+/* Largest record, longer strings and packets are truncated */
+#define RING_MAX_PAYLOAD 2048
+/* Largest string argument */
+#define RING_MAX_STRING 256
+#define RING_OUT_BUF_SIZE 65536
+#define RING_READY 0x80000000UL
+#define RING_PAD 0xff
+
+#define RING_ALIGN(size) (((size) + 7) & ~7)
+
+/* Drain thread sleep time when the ring is empty */
+#define RING_IDLE_MIN_US 1000
+#define RING_IDLE_MAX_US 20000
+
+typedef struct log_record {
+  /* Total size of the record, with RING_READY once committed */
+  uint32_t size;
+  uint8_t kind;
+  uint8_t timestamp;
+  uint16_t len;
+  uint32_t service;
+  /* Length of the address stored before the arguments, 0 if NULL */
+  uint32_t addr_len;
+  uint64_t time;
+  const char *prefix;
+  const char *fmt;
+  uint8_t payload[];
+} log_record_t;
+
+uint8_t Log6lbr_ring = 0;
+uint32_t log6lbr_ring_dropped = 0;
+
+static uint8_t *ring;
+static uint32_t ring_size;
+/* Free running positions, the producers reserve space by moving the head */
+static uint32_t ring_head;
+static uint32_t ring_tail;
+static uint8_t consumer_lock;
+
+static char out_buf[RING_OUT_BUF_SIZE];
+static int out_len;
+
+static char *pcap_file_name = NULL;
+static FILE *pcap_stream = NULL;
+static int pcap_interfaces[32];
+static int pcap_interface_count = 0;
+static uint32_t pcap_packets = 0;
+
+static uint32_t dropped_reported = 0;
+
+/*---------------------------------------------------------------------------*/
+static uint64_t
+now_us(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+/*---------------------------------------------------------------------------*/
+static log_record_t *
+ring_reserve(uint32_t payload_size)
+{
+  uint32_t size = RING_ALIGN(sizeof(log_record_t) + payload_size);
+  uint32_t head;
+  uint32_t offset;
+  uint32_t needed;
+  log_record_t *pad;
+
+  head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+  do {
+    offset = head & (ring_size - 1);
+    needed = size;
+    if(offset + size > ring_size) {
+      /* Records never wrap, skip the end of the ring */
+      needed += ring_size - offset;
+    }
+    if(head + needed - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) > ring_size) {
+      __atomic_add_fetch(&log6lbr_ring_dropped, 1, __ATOMIC_RELAXED);
+      return NULL;
+    }
+  } while(!__atomic_compare_exchange_n(&ring_head, &head, head + needed, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+  if(needed != size) {
+    pad = (log_record_t *)(ring + offset);
+    pad->kind = RING_PAD;
+    __atomic_store_n(&pad->size, (ring_size - offset) | RING_READY, __ATOMIC_RELEASE);
+    offset = 0;
+  }
+  return (log_record_t *)(ring + offset);
+}
+/*---------------------------------------------------------------------------*/
+static void
+ring_commit(log_record_t *record, uint32_t payload_size)
+{
+  __atomic_store_n(&record->size, RING_ALIGN(sizeof(log_record_t) + payload_size) | RING_READY, __ATOMIC_RELEASE);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Parses a conversion specification, returns a pointer past the conversion
+ * character. The length modifiers are returned in 'length': 'H' for hh, 'h',
+ * 'l', 'q' for ll, 'L', 'j', 'z' or 't', or 0.
+ */
+static const char *
+parse_spec(const char *p, char *length, int *stars)
+{
+  *length = 0;
+  *stars = 0;
+  p++;
+  while(*p && strchr("-+ #0'", *p)) {
+    p++;
+  }
+  while(*p && (strchr("0123456789.", *p) || *p == '*')) {
+    if(*p == '*') {
+      (*stars)++;
+    }
+    p++;
+  }
+  if(*p == 'h') {
+    *length = 'h';
+    if(*++p == 'h') {
+      *length = 'H';
+      p++;
+    }
+  } else if(*p == 'l') {
+    *length = 'l';
+    if(*++p == 'l') {
+      *length = 'q';
+      p++;
+    }
+  } else if(*p && strchr("Ljzt", *p)) {
+    *length = *p++;
+  }
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+/* Copies the arguments of the format in the payload, returns its size */
+static uint32_t
+encode_args(uint8_t *payload, uint32_t max, const char *fmt, va_list ap)
+{
+  uint32_t pos = 0;
+  const char *p = fmt;
+  char length;
+  int stars;
+  char conv;
+  int64_t value;
+  double real;
+  const char *str;
+  uint32_t str_len;
+
+  while((p = strchr(p, '%')) != NULL) {
+    if(p[1] == '%') {
+      p += 2;
+      continue;
+    }
+    p = parse_spec(p, &length, &stars);
+    conv = *p;
+    if(conv == '\0') {
+      break;
+    }
+    p++;
+    while(stars-- > 0) {
+      value = va_arg(ap, int);
+      if(pos + 8 <= max) {
+        memcpy(payload + pos, &value, 8);
+      }
+      pos += 8;
+    }
+    if(strchr("diouxXc", conv)) {
+      switch(length) {
+      case 'l':
+        value = va_arg(ap, long);
+        break;
+      case 'q':
+        value = va_arg(ap, long long);
+        break;
+      case 'j':
+        value = va_arg(ap, intmax_t);
+        break;
+      case 'z':
+        value = va_arg(ap, size_t);
+        break;
+      case 't':
+        value = va_arg(ap, ptrdiff_t);
+        break;
+      default:
+        value = va_arg(ap, int);
+        break;
+      }
+      if(pos + 8 <= max) {
+        memcpy(payload + pos, &value, 8);
+      }
+      pos += 8;
+    } else if(strchr("eEfFgGaA", conv)) {
+      real = length == 'L' ? (double)va_arg(ap, long double) : va_arg(ap, double);
+      if(pos + 8 <= max) {
+        memcpy(payload + pos, &real, 8);
+      }
+      pos += 8;
+    } else if(conv == 'p') {
+      value = (intptr_t)va_arg(ap, void *);
+      if(pos + 8 <= max) {
+        memcpy(payload + pos, &value, 8);
+      }
+      pos += 8;
+    } else if(conv == 's') {
+      str = va_arg(ap, const char *);
+      if(str == NULL) {
+        str = "(null)";
+      }
+      str_len = strnlen(str, RING_MAX_STRING);
+      if(pos + 8 + str_len > max) {
+        str_len = pos + 8 < max ? max - pos - 8 : 0;
+      }
+      if(pos + 8 <= max) {
+        memcpy(payload + pos, &str_len, sizeof(str_len));
+        memcpy(payload + pos + 8, str, str_len);
+      }
+      pos += 8 + RING_ALIGN(str_len);
+    } else if(conv == 'n') {
+      (void)va_arg(ap, int *);
+    }
+  }
+  return pos < max ? pos : max;
+}
+/*---------------------------------------------------------------------------*/
+static void
+out_flush(void)
+{
+  if(out_len > 0) {
+    fwrite(out_buf, out_len, 1, stdout);
+    fflush(stdout);
+    out_len = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+out_reserve(int size)
+{
+  if(out_len + size > RING_OUT_BUF_SIZE) {
+    out_flush();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+out_add(const char *fmt, ...)
+{
+  va_list ap;
+  int len;
+
+  out_reserve(RING_MAX_STRING * 2);
+  va_start(ap, fmt);
+  len = vsnprintf(out_buf + out_len, RING_OUT_BUF_SIZE - out_len, fmt, ap);
+  va_end(ap);
+  if(len > 0) {
+    out_len += len < RING_OUT_BUF_SIZE - out_len ? len : RING_OUT_BUF_SIZE - out_len - 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+out_write(const void *data, int len)
+{
+  if(len > RING_OUT_BUF_SIZE) {
+    out_flush();
+    fwrite(data, len, 1, stdout);
+    return;
+  }
+  out_reserve(len);
+  memcpy(out_buf + out_len, data, len);
+  out_len += len;
+}
+/*---------------------------------------------------------------------------*/
+static void
+out_timestamp(uint64_t time)
+{
+  time_t sec = time / 1000000;
+  struct tm date;
+
+  localtime_r(&sec, &date);
+  out_add("%d-%02d-%02d %d:%02d:%02d.%06"PRId32": ",
+      date.tm_year+1900, date.tm_mon + 1, date.tm_mday,
+      date.tm_hour, date.tm_min, date.tm_sec, (int32_t)(time % 1000000));
+}
+/*---------------------------------------------------------------------------*/
+/* Formats the record arguments, returns the position after the arguments */
+static uint32_t
+decode_args(const char *fmt, uint8_t const *payload, uint32_t len)
+{
+  char spec[32];
+  uint32_t pos = 0;
+  const char *p = fmt;
+  const char *start;
+  char length;
+  int stars;
+  int star_values[2];
+  int i;
+  char conv;
+  int64_t value;
+  double real;
+  uint32_t str_len;
+  char str[RING_MAX_STRING + 1];
+
+  while(*p) {
+    start = strchr(p, '%');
+    if(start == NULL) {
+      out_write(p, strlen(p));
+      break;
+    }
+    out_write(p, start - p);
+    if(start[1] == '%') {
+      out_write("%", 1);
+      p = start + 2;
+      continue;
+    }
+    p = parse_spec(start, &length, &stars);
+    conv = *p;
+    if(conv == '\0') {
+      break;
+    }
+    p++;
+    if(p - start >= sizeof(spec) || stars > 2) {
+      /* Not produced by the encoder either, give up on the record */
+      break;
+    }
+    memcpy(spec, start, p - start);
+    spec[p - start] = '\0';
+    for(i = 0; i < stars; i++) {
+      value = 0;
+      if(pos + 8 <= len) {
+        memcpy(&value, payload + pos, 8);
+      }
+      star_values[i] = value;
+      pos += 8;
+    }
+    if(conv == 's') {
+      str_len = 0;
+      if(pos + 8 <= len) {
+        memcpy(&str_len, payload + pos, sizeof(str_len));
+        if(str_len > RING_MAX_STRING || pos + 8 + str_len > len) {
+          str_len = 0;
+        }
+        memcpy(str, payload + pos + 8, str_len);
+      }
+      str[str_len] = '\0';
+      pos += 8 + RING_ALIGN(str_len);
+      if(stars == 0) {
+        out_add(spec, str);
+      } else if(stars == 1) {
+        out_add(spec, star_values[0], str);
+      } else {
+        out_add(spec, star_values[0], star_values[1], str);
+      }
+      continue;
+    }
+    if(conv == 'n') {
+      continue;
+    }
+    value = 0;
+    if(pos + 8 <= len) {
+      memcpy(&value, payload + pos, 8);
+    }
+    pos += 8;
+    if(strchr("eEfFgGaA", conv)) {
+      memcpy(&real, &value, 8);
+      /* Long doubles are stored as doubles */
+      if(length == 'L') {
+        spec[p - start - 2] = conv;
+        spec[p - start - 1] = '\0';
+      }
+      if(stars == 0) {
+        out_add(spec, real);
+      } else if(stars == 1) {
+        out_add(spec, star_values[0], real);
+      } else {
+        out_add(spec, star_values[0], star_values[1], real);
+      }
+    } else if(conv == 'p') {
+      if(stars == 0) {
+        out_add(spec, (void *)(intptr_t)value);
+      } else if(stars == 1) {
+        out_add(spec, star_values[0], (void *)(intptr_t)value);
+      } else {
+        out_add(spec, star_values[0], star_values[1], (void *)(intptr_t)value);
+      }
+    } else {
+      /* Integers are passed back with the size the format expects */
+#define OUT_INT(type) \
+      if(stars == 0) { \
+        out_add(spec, (type)value); \
+      } else if(stars == 1) { \
+        out_add(spec, star_values[0], (type)value); \
+      } else { \
+        out_add(spec, star_values[0], star_values[1], (type)value); \
+      }
+      switch(length) {
+      case 'l':
+        OUT_INT(long);
+        break;
+      case 'q':
+        OUT_INT(long long);
+        break;
+      case 'j':
+        OUT_INT(intmax_t);
+        break;
+      case 'z':
+        OUT_INT(size_t);
+        break;
+      case 't':
+        OUT_INT(ptrdiff_t);
+        break;
+      default:
+        OUT_INT(int);
+        break;
+      }
+#undef OUT_INT
+    }
+  }
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+/* Same output as uip_debug_ipaddr_print() */
+static void
+out_ipaddr(uint8_t const *addr)
+{
+  uint16_t a;
+  unsigned int i;
+  int f;
+  static const uint8_t mapped_prefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+
+  if(memcmp(addr, mapped_prefix, sizeof(mapped_prefix)) == 0) {
+    out_add("::FFFF:%u.%u.%u.%u", addr[12], addr[13], addr[14], addr[15]);
+    return;
+  }
+  for(i = 0, f = 0; i < sizeof(uip_ipaddr_t); i += 2) {
+    a = (addr[i] << 8) + addr[i + 1];
+    if(a == 0 && f >= 0) {
+      if(f++ == 0) {
+        out_write("::", 2);
+      }
+    } else {
+      if(f > 0) {
+        f = -1;
+      } else if(i > 0) {
+        out_write(":", 1);
+      }
+      out_add("%x", a);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+out_hexaddr(uint8_t const *addr, int len)
+{
+  int i;
+  for(i = 0; i < len; i++) {
+    out_add(i > 0 ? ":%02x" : "%02x", addr[i]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Same output as log6lbr_dump_packet() */
+static void
+out_dump(uint8_t const *data, uint32_t len)
+{
+  int i;
+#if WIRESHARK_IMPORT_FORMAT
+  out_write("0000", 4);
+  for(i = 0; i < len; i++) {
+    out_add(" %02x", data[i]);
+  }
+#else
+  out_write("\n         ", 10);
+  for(i = 0; i < len; i++) {
+    out_add("%02x", data[i]);
+    if((i & 3) == 3) {
+      out_write(" ", 1);
+    }
+    if((i & 15) == 15) {
+      out_write("\n         ", 10);
+    }
+  }
+#endif
+  out_write("\n", 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+pcap_write_block(uint32_t type, void const *body, uint32_t body_len, void const *data, uint32_t data_len)
+{
+  static const uint8_t padding[4];
+  uint32_t total = 12 + body_len + ((data_len + 3) & ~3);
+
+  fwrite(&type, 4, 1, pcap_stream);
+  fwrite(&total, 4, 1, pcap_stream);
+  fwrite(body, body_len, 1, pcap_stream);
+  if(data_len > 0) {
+    fwrite(data, data_len, 1, pcap_stream);
+    fwrite(padding, ((data_len + 3) & ~3) - data_len, 1, pcap_stream);
+  }
+  fwrite(&total, 4, 1, pcap_stream);
+}
+/*---------------------------------------------------------------------------*/
+static int
+pcap_open(void)
+{
+  struct {
+    uint32_t magic;
+    uint16_t major;
+    uint16_t minor;
+    int64_t section_length;
+  } shb = { 0x1A2B3C4D, 1, 0, -1 };
+  int i;
+
+  pcap_stream = fopen(pcap_file_name, "wb");
+  if(pcap_stream == NULL) {
+    out_add("ERROR: LOG: Can not open pcap file %s : %s\n", pcap_file_name, strerror(errno));
+    free(pcap_file_name);
+    pcap_file_name = NULL;
+    return 0;
+  }
+  pcap_write_block(0x0A0D0D0A, &shb, sizeof(shb), NULL, 0);
+  for(i = 0; i < 32; i++) {
+    pcap_interfaces[i] = -1;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Each service is written as a separate interface, created on first use */
+static int
+pcap_interface(uint32_t service)
+{
+  static const char *names[] = {
+    "global", "eth-in", "eth-out", "radio-in", "radio-out", "tap-in", "tap-out",
+    "slip-in", "slip-out", "pf-in", "pf-out", "slip-dbg"
+  };
+  struct {
+    uint16_t link_type;
+    uint16_t reserved;
+    uint32_t snap_len;
+    /* if_name option */
+    uint16_t option_code;
+    uint16_t option_len;
+    char name[12];
+    uint32_t end_of_options;
+  } idb;
+  int bit;
+
+  for(bit = 0; bit < 31 && (service & (1UL << bit)) == 0; bit++);
+  if(pcap_interfaces[bit] < 0) {
+    memset(&idb, 0, sizeof(idb));
+    /* Ethernet frames for the Ethernet services, 'user 0' otherwise */
+    idb.link_type = (service & (Log6lbr_Service_ETH_IN | Log6lbr_Service_ETH_OUT |
+        Log6lbr_Service_TAP_IN | Log6lbr_Service_TAP_OUT)) ? 1 : 147;
+    idb.snap_len = RING_MAX_PAYLOAD;
+    idb.option_code = 2;
+    if(bit < sizeof(names) / sizeof(names[0])) {
+      strcpy(idb.name, names[bit]);
+    } else {
+      snprintf(idb.name, sizeof(idb.name), "service-%d", bit);
+    }
+    idb.option_len = strlen(idb.name);
+    pcap_write_block(1, &idb, sizeof(idb), NULL, 0);
+    pcap_interfaces[bit] = pcap_interface_count++;
+  }
+  return pcap_interfaces[bit];
+}
+/*---------------------------------------------------------------------------*/
+static int
+pcap_write(log_record_t const *record)
+{
+  struct {
+    uint32_t interface_id;
+    uint32_t time_high;
+    uint32_t time_low;
+    uint32_t captured_len;
+    uint32_t original_len;
+  } epb;
+
+  if(pcap_stream == NULL && (pcap_file_name == NULL || !pcap_open())) {
+    return 0;
+  }
+  epb.interface_id = pcap_interface(record->service);
+  epb.time_high = record->time >> 32;
+  epb.time_low = record->time;
+  epb.captured_len = record->len;
+  memcpy(&epb.original_len, record->payload, sizeof(uint32_t));
+  pcap_write_block(6, &epb, sizeof(epb), record->payload + 8, record->len);
+  pcap_packets++;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+format_record(log_record_t const *record)
+{
+  uint32_t pos;
+  uint32_t original_len;
+
+  if(record->prefix != NULL) {
+    if(record->timestamp) {
+      out_timestamp(record->time);
+    }
+    out_write(record->prefix, strlen(record->prefix));
+  }
+  switch(record->kind) {
+  case LOG6LBR_RING_PRINTF:
+    decode_args(record->fmt, record->payload, record->len);
+    break;
+  case LOG6LBR_RING_6ADDR:
+  case LOG6LBR_RING_4ADDR:
+  case LOG6LBR_RING_LLADDR:
+  case LOG6LBR_RING_ETHADDR:
+    /* The address is stored before the arguments */
+    pos = RING_ALIGN(record->addr_len);
+    decode_args(record->fmt, record->payload + pos, record->len - pos);
+    if(record->addr_len == 0) {
+      out_add(record->kind == LOG6LBR_RING_6ADDR ? "(NULL IP addr)" : "(NULL LL addr)");
+    } else if(record->kind == LOG6LBR_RING_6ADDR) {
+      out_ipaddr(record->payload);
+    } else if(record->kind == LOG6LBR_RING_4ADDR) {
+      out_add("%u.%u.%u.%u", record->payload[0], record->payload[1], record->payload[2], record->payload[3]);
+    } else {
+      out_hexaddr(record->payload, record->addr_len);
+    }
+    out_write("\n", 1);
+    break;
+  case LOG6LBR_RING_WRITE:
+    out_write(record->payload, record->len);
+    break;
+  case LOG6LBR_RING_PACKET:
+    if(pcap_write(record)) {
+      memcpy(&original_len, record->payload, sizeof(uint32_t));
+      out_add("pcap packet %" PRIu32 " (%" PRIu32 " bytes)\n", pcap_packets, original_len);
+    } else {
+      out_dump(record->payload + 8, record->len);
+    }
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Formats all the committed records, returns the number of records */
+static int
+drain(void)
+{
+  log_record_t *record;
+  uint32_t tail;
+  uint32_t size;
+  uint32_t dropped;
+  int count = 0;
+
+  while(__atomic_test_and_set(&consumer_lock, __ATOMIC_ACQUIRE)) {
+    usleep(RING_IDLE_MIN_US);
+  }
+  tail = ring_tail;
+  while(tail != __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE)) {
+    record = (log_record_t *)(ring + (tail & (ring_size - 1)));
+    size = __atomic_load_n(&record->size, __ATOMIC_ACQUIRE);
+    if((size & RING_READY) == 0) {
+      /* Still being written */
+      break;
+    }
+    size &= ~RING_READY;
+    if(record->kind != RING_PAD) {
+      format_record(record);
+      count++;
+    }
+    /* Cleared so that stale data is never taken for a record header */
+    memset(record, 0, size);
+    tail += size;
+    __atomic_store_n(&ring_tail, tail, __ATOMIC_RELEASE);
+  }
+  dropped = __atomic_load_n(&log6lbr_ring_dropped, __ATOMIC_RELAXED);
+  if(dropped != dropped_reported) {
+    out_add("WARN: LOG: %" PRIu32 " log records dropped\n", dropped - dropped_reported);
+    dropped_reported = dropped;
+  }
+  out_flush();
+  if(pcap_stream != NULL) {
+    fflush(pcap_stream);
+  }
+  __atomic_clear(&consumer_lock, __ATOMIC_RELEASE);
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+static void *
+drain_thread(void *arg)
+{
+  int idle = RING_IDLE_MIN_US;
+  while(1) {
+    if(drain() > 0) {
+      idle = RING_IDLE_MIN_US;
+    } else if(idle < RING_IDLE_MAX_US) {
+      idle *= 2;
+    }
+    usleep(idle);
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static log_record_t *
+record_new(const char *prefix, int kind, uint32_t payload_size)
+{
+  log_record_t *record = ring_reserve(payload_size);
+  if(record != NULL) {
+    record->kind = kind;
+    record->timestamp = prefix != NULL && Log6lbr_timestamp;
+    record->time = now_us();
+    record->prefix = prefix;
+    record->len = payload_size;
+  }
+  return record;
+}
+/*---------------------------------------------------------------------------*/
+void
+log6lbr_ring_printf(const char *prefix, const char *fmt, ...)
+{
+  uint8_t payload[RING_MAX_PAYLOAD];
+  log_record_t *record;
+  uint32_t len;
+  va_list ap;
+
+  va_start(ap, fmt);
+  len = encode_args(payload, sizeof(payload), fmt, ap);
+  va_end(ap);
+  record = record_new(prefix, LOG6LBR_RING_PRINTF, len);
+  if(record != NULL) {
+    record->fmt = fmt;
+    memcpy(record->payload, payload, len);
+    ring_commit(record, len);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+log6lbr_ring_addr(const char *prefix, int kind, const void *addr, int addr_len, const char *fmt, ...)
+{
+  uint8_t payload[RING_MAX_PAYLOAD];
+  log_record_t *record;
+  uint32_t pos = RING_ALIGN(addr_len);
+  uint32_t len;
+  va_list ap;
+
+  va_start(ap, fmt);
+  len = pos + encode_args(payload + pos, sizeof(payload) - pos, fmt, ap);
+  va_end(ap);
+  record = record_new(prefix, kind, len);
+  if(record != NULL) {
+    record->fmt = fmt;
+    record->addr_len = addr != NULL ? addr_len : 0;
+    if(addr != NULL) {
+      memcpy(payload, addr, addr_len);
+    }
+    memcpy(record->payload, payload, len);
+    ring_commit(record, len);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+log6lbr_ring_write(const char *prefix, const void *data, uint32_t len)
+{
+  log_record_t *record;
+
+  if(len > RING_MAX_PAYLOAD) {
+    len = RING_MAX_PAYLOAD;
+  }
+  record = record_new(prefix, LOG6LBR_RING_WRITE, len);
+  if(record != NULL) {
+    memcpy(record->payload, data, len);
+    ring_commit(record, len);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+log6lbr_ring_packet(const char *prefix, uint32_t service, const void *data, uint32_t len)
+{
+  log_record_t *record;
+  uint32_t captured = len < RING_MAX_PAYLOAD ? len : RING_MAX_PAYLOAD;
+
+  /* The original length is stored before the data */
+  record = record_new(prefix, LOG6LBR_RING_PACKET, 8 + captured);
+  if(record != NULL) {
+    record->service = service;
+    record->len = captured;
+    memcpy(record->payload, &len, sizeof(uint32_t));
+    memcpy(record->payload + 8, data, captured);
+    ring_commit(record, 8 + captured);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+log6lbr_ring_set_pcap(const char *file_name)
+{
+  free(pcap_file_name);
+  pcap_file_name = strdup(file_name);
+}
+/*---------------------------------------------------------------------------*/
+void
+log6lbr_ring_flush(void)
+{
+  if(Log6lbr_ring) {
+    drain();
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+log6lbr_ring_start(uint32_t size)
+{
+  pthread_t thread;
+
+  if(Log6lbr_ring) {
+    /* The ring can not be resized once in use */
+    return size == ring_size;
+  }
+  if(size < 4 * RING_MAX_PAYLOAD || (size & (size - 1)) != 0 || size > (1UL << 30)) {
+    return 0;
+  }
+  ring = calloc(size, 1);
+  if(ring == NULL) {
+    return 0;
+  }
+  ring_size = size;
+  if(pthread_create(&thread, NULL, drain_thread, NULL) != 0) {
+    free(ring);
+    ring = NULL;
+    return 0;
+  }
+  pthread_detach(thread);
+  /* Pending records are formatted when exiting, e.g. after a fatal error */
+  atexit(log6lbr_ring_flush);
+  fflush(stdout);
+  Log6lbr_ring = 1;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* LOG6LBR_RING && !LOG6LBR_STATIC */
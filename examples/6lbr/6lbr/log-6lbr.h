@@ -53,6 +53,11 @@
 #define LOG6LBR_STATIC 0
 #endif
 
+/* Binary ring buffer backend, the log records are formatted by a drain thread */
+#ifndef LOG6LBR_RING
+#define LOG6LBR_RING 0
+#endif
+
 #if WITH_CONTIKI
 //From "uip-debug.h"
 extern void uip_debug_ipaddr_print(const uip_ipaddr_t *addr);
@@ -129,6 +134,61 @@ extern void log6lbr_timestamp();
     func\
   }
 
+#if LOG6LBR_RING
+extern uint8_t Log6lbr_ring;
+
+/* Kind of the records in the ring buffer */
+#define LOG6LBR_RING_PRINTF   0
+#define LOG6LBR_RING_6ADDR    1
+#define LOG6LBR_RING_4ADDR    2
+#define LOG6LBR_RING_LLADDR   3
+#define LOG6LBR_RING_ETHADDR  4
+#define LOG6LBR_RING_WRITE    5
+#define LOG6LBR_RING_PACKET   6
+
+extern void log6lbr_ring_printf(const char *prefix, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+extern void log6lbr_ring_addr(const char *prefix, int kind, const void *addr, int addr_len, const char *fmt, ...) __attribute__((format(printf, 5, 6)));
+extern void log6lbr_ring_write(const char *prefix, const void *data, uint32_t len);
+extern void log6lbr_ring_packet(const char *prefix, uint32_t service, const void *data, uint32_t len);
+
+/* Ring buffer version of the functions used in the log macros */
+#define _LOG6LBR_RING_printf(prefix, service, ...) log6lbr_ring_printf(prefix, __VA_ARGS__)
+#define _LOG6LBR_RING__PRINTF_6ADDR(prefix, service, addr, ...) log6lbr_ring_addr(prefix, LOG6LBR_RING_6ADDR, addr, sizeof(uip_ipaddr_t), __VA_ARGS__)
+#define _LOG6LBR_RING__PRINTF_4ADDR(prefix, service, addr, ...) log6lbr_ring_addr(prefix, LOG6LBR_RING_4ADDR, addr, 4, __VA_ARGS__)
+#define _LOG6LBR_RING__PRINTF_LLADDR(prefix, service, addr, ...) log6lbr_ring_addr(prefix, LOG6LBR_RING_LLADDR, addr, sizeof(uip_lladdr_t), __VA_ARGS__)
+#define _LOG6LBR_RING__PRINTF_ETHADDR(prefix, service, addr, ...) log6lbr_ring_addr(prefix, LOG6LBR_RING_ETHADDR, addr, sizeof(uip_eth_addr), __VA_ARGS__)
+#define _LOG6LBR_RING_fwrite(prefix, service, buffer, size, nmemb, stream) log6lbr_ring_write(prefix, buffer, (size) * (nmemb))
+#define _LOG6LBR_RING_log6lbr_dump_packet(prefix, service, data, len) log6lbr_ring_packet(prefix, service, data, len)
+
+extern void log6lbr_ring_set_pcap(const char *file_name);
+/* Switches to the ring buffer backend, returns 0 if the size is invalid */
+extern int log6lbr_ring_start(uint32_t size);
+extern void log6lbr_ring_flush(void);
+
+extern uint32_t log6lbr_ring_dropped;
+
+#define _LOG6LBR_LEVEL_F(level, service, func, ...) { \
+  if (LOG6LBR_COND(level, service)) { \
+    if (Log6lbr_ring) { \
+      _LOG6LBR_RING_##func(#level ": " LOG6LBR_MODULE ": ", Log6lbr_Service_##service, __VA_ARGS__); \
+    } else { \
+      _LOG6LBR_ADD_TIMESTAMP \
+      printf( #level ": " LOG6LBR_MODULE ": " ); \
+      func(__VA_ARGS__); \
+    } \
+  } \
+  }
+
+#define _LOG6LBR_LEVEL_A(level, service, func, ...) { \
+  if (Log6lbr_Level_##level <= Log6lbr_level && (Log6lbr_Service_##service & Log6lbr_services) != 0 ) { \
+    if (Log6lbr_ring) { \
+      _LOG6LBR_RING_##func(NULL, Log6lbr_Service_##service, __VA_ARGS__); \
+    } else { \
+      func(__VA_ARGS__); \
+    } \
+  } \
+  }
+#else
 #define _LOG6LBR_LEVEL_F(level, service, func, ...) { \
   if (LOG6LBR_COND(level, service)) { \
     _LOG6LBR_ADD_TIMESTAMP \
@@ -142,6 +202,7 @@ extern void log6lbr_timestamp();
     func(__VA_ARGS__); \
   } \
   }
+#endif
 
 #else
 
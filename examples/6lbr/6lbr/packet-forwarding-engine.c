@@ -72,6 +72,7 @@
 #include "native-rdc.h"
 #endif
 #include "6lbr-hooks.h"
+#include "packet-trace.h"
 
 #if CETIC_6LBR_NODE_INFO
 #include "node-info.h"
@@ -125,6 +126,7 @@ static int packet_handled = 0;
 static void
 send_to_uip(void)
 {
+  PACKET_TRACE_ENTER(PACKET_TRACE_TCPIP);
 #if WITH_CONTIKI
   if(tcpip_inputfunc != NULL) {
     tcpip_inputfunc();
@@ -167,6 +169,8 @@ wireless_input(void)
   // Flag that the packet has entered the PFE to avoid infinite recursion
   packet_handled = 1;
 
+  PACKET_TRACE_ENTER(PACKET_TRACE_WIRELESS_INPUT);
+
 #if CETIC_6LBR_WITH_IP64
   if(ip64_addr_is_ip64(&UIP_IP_BUF->srcipaddr)) {
     send_to_uip();
@@ -256,6 +260,8 @@ wireless_output(const uip_lladdr_t * src, const uip_lladdr_t * dest)
 {
   int ret = 0;
 
+  PACKET_TRACE_ENTER(PACKET_TRACE_SICSLOWPAN_OUTPUT);
+
   //Packet filtering
   //----------------
   if(uip_len == 0) {
@@ -339,6 +345,8 @@ eth_input(void)
   packet_filter_wsn_packet = 0;
   packet_handled = 1;
 
+  PACKET_TRACE_ENTER(PACKET_TRACE_ETH_INPUT);
+
   //Packet type filtering
   //---------------------
   //Keep only IPv6 traffic
@@ -387,7 +395,9 @@ eth_input(void)
   //Packet content rewriting
   //------------------------
   //Some IP packets have link layer in them, need to change them around!
+  PACKET_TRACE_ENTER(PACKET_TRACE_MAC_TRANSLATE);
   uint8_t transReturn = mac_translateIPLinkLayer(ll_802154_type);
+  PACKET_TRACE_ENTER(PACKET_TRACE_ETH_INPUT);
 
   if(transReturn != 0) {
     LOG6LBR_WARN("eth_input: IPTranslation returns %d\n", transReturn);
@@ -465,6 +475,8 @@ eth_input(void)
 static int
 eth_output(const uip_lladdr_t * src, const uip_lladdr_t * dest)
 {
+  PACKET_TRACE_ENTER(PACKET_TRACE_ETH_OUTPUT);
+
   if(IS_BROADCAST_ADDR(dest)) {
     LOG6LBR_PRINTF(PACKET, PF_OUT, "eth_output: broadcast\n");
   } else {
@@ -558,7 +570,9 @@ eth_output(const uip_lladdr_t * src, const uip_lladdr_t * dest)
   }
 #endif
   //Some IP packets have link layer in them, need to change them around!
+  PACKET_TRACE_ENTER(PACKET_TRACE_MAC_TRANSLATE);
   mac_translateIPLinkLayer(ll_8023_type);
+  PACKET_TRACE_ENTER(PACKET_TRACE_ETH_OUTPUT);
 
   //Create packet header
   //--------------------
@@ -600,6 +614,8 @@ eth_output(const uip_lladdr_t * src, const uip_lladdr_t * dest)
 #endif
   LOG6LBR_PRINTF(PACKET, PF_OUT, "eth_output: Sending packet to Ethernet\n");
   eth_drv_send(uip_buf, uip_len + UIP_LLH_LEN);
+  PACKET_TRACE_QUEUED();
+  PACKET_TRACE_END();
 
   return 1;
 }
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Per-stage latency tracing of the packets going through the 6LBR
+ *         forwarding path
+ *
+ *         The processing of a packet is single threaded and synchronous,
+ *         from its reception on one interface until it is queued on the
+ *         other one, so only one trace is active at a time. The time spent
+ *         in each stage is accumulated in the trace and added to the stage
+ *         histograms when the trace ends.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "packet-trace.h"
+
+#if CETIC_6LBR_PACKET_TRACE
+
+#include <string.h>
+#if CONTIKI_TARGET_NATIVE
+#include <time.h>
+#endif
+
+static const char *stage_names[PACKET_TRACE_STAGE_NB] = {
+  "eth_dev_input",
+  "eth_input",
+  "mac_translateIPLinkLayer",
+  "tcpip",
+  "sicslowpan_output",
+  "write_to_slip",
+  "slip_flush",
+  "radio_ack",
+  "slip_input",
+  "sicslowpan_input",
+  "wireless_input",
+  "eth_output",
+  "eth_to_wsn",
+  "wsn_to_eth",
+};
+
+static packet_trace_stats_t stats[PACKET_TRACE_STAGE_NB];
+
+static struct {
+  uint8_t active;
+  packet_trace_stage_t origin;
+  packet_trace_stage_t stage;
+  packet_trace_time_t start;
+  packet_trace_time_t last;
+  packet_trace_time_t queued;
+  uint8_t nb_queued;
+  uint32_t visited;
+  uint32_t elapsed[PACKET_TRACE_STAGE_NB];
+} trace;
+
+/*---------------------------------------------------------------------------*/
+packet_trace_time_t
+packet_trace_now(void)
+{
+#if CONTIKI_TARGET_NATIVE
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (packet_trace_time_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+  return (packet_trace_time_t)clock_time() * (1000000 / CLOCK_SECOND);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+void
+packet_trace_sample(packet_trace_stage_t stage, uint32_t delay)
+{
+  packet_trace_stats_t *stage_stats = &stats[stage];
+  uint32_t us = delay;
+  int bucket = 0;
+
+  while(us > 0 && bucket < PACKET_TRACE_HISTOGRAM_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+  }
+  stage_stats->histogram[bucket]++;
+  stage_stats->count++;
+  stage_stats->total += delay;
+  if(delay > stage_stats->max) {
+    stage_stats->max = delay;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+close_stage(packet_trace_time_t now)
+{
+  trace.elapsed[trace.stage] += now - trace.last;
+  trace.visited |= 1UL << trace.stage;
+  trace.last = now;
+}
+/*---------------------------------------------------------------------------*/
+static void
+commit(void)
+{
+  int stage;
+
+  for(stage = 0; stage < PACKET_TRACE_STAGE_NB; stage++) {
+    if((trace.visited & (1UL << stage)) != 0) {
+      packet_trace_sample(stage, trace.elapsed[stage]);
+    }
+  }
+  trace.active = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+packet_trace_begin(packet_trace_stage_t stage, packet_trace_time_t start)
+{
+  if(trace.active) {
+    /* The previous packet was dropped without closing its trace, its
+       current stage can not be measured */
+    commit();
+  }
+  trace.active = 1;
+  trace.origin = stage;
+  trace.stage = stage;
+  trace.start = start;
+  trace.last = start;
+  trace.nb_queued = 0;
+  trace.visited = 0;
+  memset(trace.elapsed, 0, sizeof(trace.elapsed));
+}
+/*---------------------------------------------------------------------------*/
+void
+packet_trace_enter(packet_trace_stage_t stage)
+{
+  if(!trace.active) {
+    /* Locally generated packet */
+    return;
+  }
+  close_stage(packet_trace_now());
+  trace.stage = stage;
+}
+/*---------------------------------------------------------------------------*/
+void
+packet_trace_queued(void)
+{
+  if(!trace.active) {
+    return;
+  }
+  close_stage(packet_trace_now());
+  trace.queued = trace.last;
+  if(trace.nb_queued < 0xff) {
+    trace.nb_queued++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+packet_trace_end(void)
+{
+  if(!trace.active) {
+    return;
+  }
+  close_stage(packet_trace_now());
+  if(trace.nb_queued > 0) {
+    if(trace.origin == PACKET_TRACE_ETH_DEV_INPUT) {
+      packet_trace_sample(PACKET_TRACE_ETH_TO_WSN, trace.queued - trace.start);
+    } else if(trace.origin == PACKET_TRACE_SLIP_INPUT) {
+      packet_trace_sample(PACKET_TRACE_WSN_TO_ETH, trace.queued - trace.start);
+    }
+  }
+  commit();
+}
+/*---------------------------------------------------------------------------*/
+const char *
+packet_trace_stage_name(packet_trace_stage_t stage)
+{
+  return stage < PACKET_TRACE_STAGE_NB ? stage_names[stage] : NULL;
+}
+/*---------------------------------------------------------------------------*/
+const packet_trace_stats_t *
+packet_trace_get_stats(packet_trace_stage_t stage)
+{
+  return stage < PACKET_TRACE_STAGE_NB ? &stats[stage] : NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+packet_trace_reset(void)
+{
+  memset(stats, 0, sizeof(stats));
+}
+/*---------------------------------------------------------------------------*/
+#endif
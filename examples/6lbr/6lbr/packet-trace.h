@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Per-stage latency tracing of the packets going through the 6LBR
+ *         forwarding path
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#ifndef PACKET_TRACE_H_
+#define PACKET_TRACE_H_
+
+#include "contiki.h"
+
+#ifndef CETIC_6LBR_PACKET_TRACE
+#define CETIC_6LBR_PACKET_TRACE 0
+#endif
+
+/* Histogram bucket 0 counts the delays below 1 us, bucket i the delays
+   between (1 << (i - 1)) and (1 << i) us and the last bucket all the larger
+   delays */
+#define PACKET_TRACE_HISTOGRAM_BUCKETS 20
+
+/*
+ * A packet received on one interface goes through a chain of synchronous
+ * stages until it is queued on the other interface. Each stage lasts until
+ * the next one is entered, the last one until the end of the trace. A
+ * fragmented packet goes through write_to_slip once per fragment.
+ * The slip flush and the radio ack are sampled asynchronously, for every
+ * frame sent to the slip-radio.
+ */
+typedef enum {
+  /* Ethernet to WSN */
+  PACKET_TRACE_ETH_DEV_INPUT,
+  PACKET_TRACE_ETH_INPUT,
+  PACKET_TRACE_MAC_TRANSLATE,
+  PACKET_TRACE_TCPIP,
+  PACKET_TRACE_SICSLOWPAN_OUTPUT,
+  PACKET_TRACE_WRITE_TO_SLIP,
+  PACKET_TRACE_SLIP_FLUSH,
+  PACKET_TRACE_RADIO_ACK,
+  /* WSN to Ethernet */
+  PACKET_TRACE_SLIP_INPUT,
+  PACKET_TRACE_SICSLOWPAN_INPUT,
+  PACKET_TRACE_WIRELESS_INPUT,
+  PACKET_TRACE_ETH_OUTPUT,
+  /* Whole synchronous path */
+  PACKET_TRACE_ETH_TO_WSN,
+  PACKET_TRACE_WSN_TO_ETH,
+  PACKET_TRACE_STAGE_NB
+} packet_trace_stage_t;
+
+typedef struct {
+  uint32_t count;
+  uint32_t max;
+  uint64_t total;
+  uint32_t histogram[PACKET_TRACE_HISTOGRAM_BUCKETS];
+} packet_trace_stats_t;
+
+/* Timestamp in us, wraps around after ~71 minutes */
+typedef uint32_t packet_trace_time_t;
+
+#if CETIC_6LBR_PACKET_TRACE
+
+packet_trace_time_t packet_trace_now(void);
+
+/* Start the trace of a new packet in the given stage, any unfinished trace
+   is closed */
+void packet_trace_begin(packet_trace_stage_t stage, packet_trace_time_t start);
+void packet_trace_enter(packet_trace_stage_t stage);
+/* The packet, or one of its fragments, has been queued on the output
+   interface. The whole synchronous path lasts until the last one */
+void packet_trace_queued(void);
+/* Close the current stage and add the trace to the statistics */
+void packet_trace_end(void);
+/* Add a delay measured outside of a trace */
+void packet_trace_sample(packet_trace_stage_t stage, uint32_t delay);
+
+const char *packet_trace_stage_name(packet_trace_stage_t stage);
+const packet_trace_stats_t *packet_trace_get_stats(packet_trace_stage_t stage);
+void packet_trace_reset(void);
+
+#define PACKET_TRACE_NOW() packet_trace_now()
+#define PACKET_TRACE_BEGIN(stage, start) packet_trace_begin(stage, start)
+#define PACKET_TRACE_ENTER(stage) packet_trace_enter(stage)
+#define PACKET_TRACE_QUEUED() packet_trace_queued()
+#define PACKET_TRACE_END() packet_trace_end()
+#define PACKET_TRACE_SAMPLE(stage, delay) packet_trace_sample(stage, delay)
+
+#else
+
+#define PACKET_TRACE_NOW() 0
+#define PACKET_TRACE_BEGIN(stage, start) (void)(start)
+#define PACKET_TRACE_ENTER(stage)
+#define PACKET_TRACE_QUEUED()
+#define PACKET_TRACE_END()
+#define PACKET_TRACE_SAMPLE(stage, delay)
+
+#endif
+
+#endif /* PACKET_TRACE_H_ */
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Render cache of the web server pages
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#define LOG6LBR_MODULE "HTTP"
+
+#include "contiki.h"
+#include "log-6lbr.h"
+#include "httpd.h"
+#include "httpd-cgi.h"
+#include "httpd-cache.h"
+#include "lib/hash-index.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if WEBSERVER_CACHE
+
+#define INITIAL_SIZE 4096
+
+httpd_cache_stats_t httpd_cache_stats;
+
+struct httpd_cache_entry *httpd_render_entry;
+
+/* Incremented by httpd_cache_invalidate() */
+static uint32_t generation;
+
+/*---------------------------------------------------------------------------*/
+static void
+entry_free(httpd_cache_entry_t *entry)
+{
+  free(entry->query);
+  free(entry->data);
+  free(entry);
+}
+/*---------------------------------------------------------------------------*/
+static int
+query_cmp(const char *a, const char *b)
+{
+  if(a == NULL || b == NULL) {
+    return a != b;
+  }
+  return strcmp(a, b);
+}
+/*---------------------------------------------------------------------------*/
+/* FNV-1a hash of the content, used as strong validator */
+static uint32_t
+compute_etag(const char *data, int len)
+{
+  return hash_fnv(HASH_FNV_INIT, data, len);
+}
+/*---------------------------------------------------------------------------*/
+httpd_cache_entry_t *
+httpd_cache_lookup(httpd_cgi_call_t *page, const char *query)
+{
+  httpd_cache_entry_t *entry = page->cache;
+
+  if(page->version == NULL) {
+    return NULL;
+  }
+  if(entry == NULL || entry->generation != generation
+     || entry->version != page->version()
+     || clock_time() - entry->rendered >= WEBSERVER_CACHE_MAX_AGE * CLOCK_SECOND
+     || query_cmp(entry->query, query) != 0) {
+    httpd_cache_stats.misses++;
+    return NULL;
+  }
+  httpd_cache_stats.hits++;
+  entry->refcount++;
+  return entry;
+}
+/*---------------------------------------------------------------------------*/
+httpd_cache_entry_t *
+httpd_cache_render_begin(void)
+{
+  httpd_cache_entry_t *entry;
+
+  entry = calloc(1, sizeof(httpd_cache_entry_t));
+  if(entry == NULL) {
+    return NULL;
+  }
+  entry->data = malloc(INITIAL_SIZE);
+  if(entry->data == NULL) {
+    free(entry);
+    return NULL;
+  }
+  entry->size = INITIAL_SIZE;
+  entry->refcount = 1;
+  entry->generation = generation;
+  entry->rendered = clock_time();
+  httpd_render_entry = entry;
+  return entry;
+}
+/*---------------------------------------------------------------------------*/
+void
+httpd_render_add(const char *str)
+{
+  httpd_cache_entry_t *entry = httpd_render_entry;
+  int len = strlen(str);
+  char *data;
+  int size;
+
+  if(entry->size < 0) {
+    /* Already out of memory */
+    return;
+  }
+  if(entry->len + len > entry->size) {
+    size = entry->size;
+    while(entry->len + len > size) {
+      size *= 2;
+    }
+    data = realloc(entry->data, size);
+    if(data == NULL) {
+      entry->size = -1;
+      return;
+    }
+    entry->data = data;
+    entry->size = size;
+  }
+  memcpy(entry->data + entry->len, str, len);
+  entry->len += len;
+}
+/*---------------------------------------------------------------------------*/
+httpd_cache_entry_t *
+httpd_cache_render_end(httpd_cgi_call_t *page, const char *query)
+{
+  httpd_cache_entry_t *entry = httpd_render_entry;
+
+  httpd_render_entry = NULL;
+  httpd_cache_stats.renders++;
+  if(entry->size < 0) {
+    LOG6LBR_ERROR("Not enough memory to render %s\n", page->name);
+    httpd_cache_stats.render_errors++;
+    entry_free(entry);
+    return NULL;
+  }
+  entry->etag = compute_etag(entry->data, entry->len);
+  if(page->version != NULL) {
+    /* The version is read after rendering as the page may update the data */
+    entry->version = page->version();
+    if(query != NULL) {
+      entry->query = strdup(query);
+    }
+    if(query == NULL || entry->query != NULL) {
+      httpd_cache_release(page->cache);
+      page->cache = entry;
+      entry->refcount++;
+    }
+  }
+  return entry;
+}
+/*---------------------------------------------------------------------------*/
+void
+httpd_cache_release(httpd_cache_entry_t *entry)
+{
+  if(entry != NULL && --entry->refcount == 0) {
+    entry_free(entry);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+httpd_cache_invalidate(void)
+{
+  httpd_cgi_call_t *page;
+
+  generation++;
+  for(page = httpd_cgi_head(); page != NULL; page = page->next) {
+    httpd_cache_release(page->cache);
+    page->cache = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+#endif /* WEBSERVER_CACHE */
+/*---------------------------------------------------------------------------*/
+uint32_t
+httpd_cache_timed(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
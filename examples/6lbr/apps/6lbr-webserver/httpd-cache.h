@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Render cache of the web server pages
+ *
+ *         A page is rendered in memory before being sent, so that the
+ *         response has a Content-Length and an ETag and the connection can
+ *         be kept alive. The pages declared with a version function are kept
+ *         in the cache until the version changes, a command is executed or
+ *         WEBSERVER_CACHE_MAX_AGE seconds have elapsed.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#ifndef HTTPD_CACHE_H_
+#define HTTPD_CACHE_H_
+
+#include "contiki.h"
+#include "httpd-cgi.h"
+
+typedef struct httpd_cache_entry {
+  /* Number of connections sending the entry, plus one while cached */
+  int refcount;
+  uint32_t generation;
+  uint32_t version;
+  clock_time_t rendered;
+  char *query;
+  uint32_t etag;
+  int len;
+  int size;
+  char *data;
+} httpd_cache_entry_t;
+
+typedef struct {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t renders;
+  uint32_t not_modified;
+  uint32_t render_errors;
+} httpd_cache_stats_t;
+
+extern httpd_cache_stats_t httpd_cache_stats;
+
+/* Return the cached rendering of the page, or NULL if it must be rendered */
+httpd_cache_entry_t *httpd_cache_lookup(httpd_cgi_call_t *page, const char *query);
+
+/* Start rendering, the output of SEND_STRING() is appended to the entry
+   until httpd_cache_render_end() is called */
+httpd_cache_entry_t *httpd_cache_render_begin(void);
+
+/* Return NULL if the page could not be rendered, otherwise the entry is
+   stored in the cache if the page has a version function */
+httpd_cache_entry_t *httpd_cache_render_end(httpd_cgi_call_t *page, const char *query);
+
+void httpd_cache_release(httpd_cache_entry_t *entry);
+
+/* Drop all the cached pages */
+void httpd_cache_invalidate(void);
+
+/* Version function of the pages which only depend on time */
+uint32_t httpd_cache_timed(void);
+
+#endif /* HTTPD_CACHE_H_ */
@@ -39,6 +39,11 @@
 
 typedef PT_THREAD((* httpd_cgifunction)(struct httpd_state *));
 
+/* Return the version of the data shown by a page */
+typedef uint32_t (* httpd_cgi_version_function)(void);
+
+struct httpd_cache_entry;
+
 struct httpd_cgi_call;
 
 struct httpd_group {
@@ -62,6 +67,10 @@ struct httpd_cgi_call {
 
   uint32_t numtimes;
   clock_time_t numticks;
+
+  /* The rendered page is cached as long as the version does not change */
+  httpd_cgi_version_function version;
+  struct httpd_cache_entry *cache;
 };
 typedef struct httpd_cgi_call httpd_cgi_call_t;
 
@@ -78,6 +87,8 @@ typedef struct httpd_cgi_command httpd_cgi_command_t;
 #define HTTPD_CUSTOM_HEADER 0x00000001
 #define HTTPD_CUSTOM_TOP    0x00000002
 #define HTTPD_CUSTOM_BOTTOM 0x00000004
+/* The page sends raw data, it can not be rendered in memory */
+#define HTTPD_STREAM        0x00000008
 
 void httpd_group_add(httpd_group_t *group);
 void httpd_group_add_page(httpd_group_t *group, httpd_cgi_call_t *c);
@@ -101,7 +112,10 @@ extern struct httpd_cgi_call name;
 httpd_group_t name = {NULL, str, NULL, 0}
 
 #define HTTPD_CGI_CALL(name, str, title, function, flags) \
-struct httpd_cgi_call name = {NULL, str, title, flags, function, NULL, NULL, 0, 0}
+struct httpd_cgi_call name = {NULL, str, title, flags, function, NULL, NULL, 0, 0, NULL, NULL}
+
+#define HTTPD_CGI_CACHED_CALL(name, str, title, function, flags, version) \
+struct httpd_cgi_call name = {NULL, str, title, flags, function, NULL, NULL, 0, 0, version, NULL}
 
 #define HTTPD_CGI_CMD_NAME(name) \
 extern struct httpd_cgi_command name;
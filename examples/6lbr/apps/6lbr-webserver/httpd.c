@@ -50,6 +50,7 @@
 
 #include "httpd.h"
 #include "httpd-cgi.h"
+#include "httpd-cache.h"
 
 #if CONTIKI_TARGET_NATIVE
 #include "native-config.h"
@@ -61,6 +62,12 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#if WEBSERVER_CACHE
+#include <stdlib.h>
+#include <strings.h>
 #endif
 
 #ifndef WEBSERVER_CONF_CFS_CONNS
@@ -125,6 +132,92 @@ const char http_header_200[] =
   "HTTP/1.0 200 OK\r\nServer: Contiki/2.4 http://www.sics.se/contiki/\r\nConnection: close\r\n";
 const char http_header_404[] =
   "HTTP/1.0 404 Not found\r\nServer: Contiki/2.4 http://www.sics.se/contiki/\r\nConnection: close\r\n";
+#if WEBSERVER_CACHE
+static const char http_header_keep_alive[] =
+  "HTTP/1.1 %s\r\nServer: Contiki/2.4 http://www.sics.se/contiki/\r\nETag: \"%08lx\"\r\nConnection: %s\r\n";
+/*---------------------------------------------------------------------------*/
+static void
+format_header(struct httpd_state *s)
+{
+  int len;
+
+  if(s->has_etag && s->if_none_match == s->etag) {
+    snprintf(s->header, sizeof(s->header), http_header_keep_alive, "304 Not Modified",
+             (unsigned long)s->etag, s->keep_alive ? "keep-alive" : "close");
+    strcat(s->header, "\r\n");
+    s->content_length = 0;
+    httpd_cache_stats.not_modified++;
+  } else {
+    len = snprintf(s->header, sizeof(s->header), http_header_keep_alive, "200 OK",
+                   (unsigned long)s->etag, s->keep_alive ? "keep-alive" : "close");
+    snprintf(s->header + len, sizeof(s->header) - len, "Content-Length: %d\r\n%s",
+             s->content_length, http_content_type_html);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(send_response(struct httpd_state *s))
+{
+  PSOCK_BEGIN(&s->sout);
+  SEND_STRING(&s->sout, s->header);
+  if(s->response != NULL && s->content_length > 0) {
+    PSOCK_SEND(&s->sout, (uint8_t *)s->response->data, s->response->len);
+  }
+  PSOCK_END(&s->sout);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Render the page in memory, the page threads never block as SEND_STRING()
+ * only appends to the rendered page.
+ */
+static httpd_cache_entry_t *
+render_page(struct httpd_state *s)
+{
+  httpd_cache_entry_t *entry;
+
+  entry = httpd_cache_lookup(s->script, s->query);
+  if(entry != NULL) {
+    return entry;
+  }
+  if(httpd_cache_render_begin() == NULL) {
+    return NULL;
+  }
+  if((s->script->flags & HTTPD_CUSTOM_TOP) == 0) {
+    while(PT_SCHEDULE(generate_top(s)));
+  }
+  while(PT_SCHEDULE(s->script->function(s)));
+  if((s->script->flags & HTTPD_CUSTOM_BOTTOM) == 0) {
+    while(PT_SCHEDULE(generate_bottom(s)));
+  }
+  return httpd_cache_render_end(s->script, s->query);
+}
+/*---------------------------------------------------------------------------*/
+#if CONTIKI_TARGET_NATIVE
+static uint32_t
+file_etag(struct httpd_state *s)
+{
+  char filepath[HTTPD_PATHLEN];
+  struct stat st;
+
+  s->content_length = 0;
+  strcpy(filepath, sixlbr_config_www_root);
+  strcat(filepath, s->filename);
+  if(stat(filepath, &st) == -1) {
+    return 0;
+  }
+  s->content_length = st.st_size;
+  return (uint32_t)st.st_mtime ^ ((uint32_t)st.st_size << 16) ^ (uint32_t)st.st_ino;
+}
+#endif
+/*---------------------------------------------------------------------------*/
+static void
+next_request(struct httpd_state *s)
+{
+  s->state = STATE_WAITING;
+  PSOCK_INIT(&s->sin, (uint8_t *) s->inputbuf, sizeof(s->inputbuf) - 1);
+}
+#endif /* WEBSERVER_CACHE */
+/*---------------------------------------------------------------------------*/
 static
 PT_THREAD(handle_output(struct httpd_state *s))
 {
@@ -133,10 +226,35 @@ PT_THREAD(handle_output(struct httpd_state *s))
   if(!s->script) {
     httpd_cgi_command_t *cmd = httpd_cgi_command(&s->filename[1]);
     if(cmd) {
+#if WEBSERVER_CACHE
+      /* The command may change anything shown by the pages */
+      httpd_cache_invalidate();
+#endif
       s->script = cmd->function(s);
     }
   }
   if(s->script) {
+#if WEBSERVER_CACHE
+    if((s->script->flags & (HTTPD_CUSTOM_HEADER | HTTPD_STREAM)) == 0) {
+      s->response = render_page(s);
+    }
+    if(s->response != NULL) {
+      s->etag = s->response->etag;
+      s->content_length = s->response->len;
+      format_header(s);
+      PT_WAIT_THREAD(&s->outputpt, send_response(s));
+      httpd_cache_release(s->response);
+      s->response = NULL;
+      if(s->keep_alive) {
+        next_request(s);
+        PT_EXIT(&s->outputpt);
+      }
+      PSOCK_CLOSE(&s->sout);
+      PT_EXIT(&s->outputpt);
+    }
+    /* The page is streamed, the end of the response is the end of the connection */
+    s->keep_alive = 0;
+#endif
     if((s->script->flags & HTTPD_CUSTOM_HEADER) == 0) {
       PT_WAIT_THREAD(&s->outputpt, send_headers(s, http_header_200));
     }
@@ -149,8 +267,21 @@ PT_THREAD(handle_output(struct httpd_state *s))
     }
 #if CONTIKI_TARGET_NATIVE
   } else if (httpd_is_file(s->filename)){
+#if WEBSERVER_CACHE
+    s->etag = file_etag(s);
+    format_header(s);
+    PT_WAIT_THREAD(&s->outputpt, send_response(s));
+    if(s->content_length > 0) {
+      PT_WAIT_THREAD(&s->outputpt, send_file(s));
+    }
+    if(s->keep_alive) {
+      next_request(s);
+      PT_EXIT(&s->outputpt);
+    }
+#else
     PT_WAIT_THREAD(&s->outputpt, send_headers(s, http_header_200));
     PT_WAIT_THREAD(&s->outputpt, send_file(s));
+#endif
 #endif
   } else {
     LOG6LBR_6ADDR(WARN, &uip_conn->ripaddr, "File '%s' not found, from ", s->filename);
@@ -166,6 +297,32 @@ const char http_put[] = "PUT ";
 const char http_post[] = "POST ";
 const char http_delete[] = "DELETE ";
 const char http_index_html[] = "/index.html";
+#if WEBSERVER_CACHE
+static const char http_11[] = "HTTP/1.1";
+static const char http_connection[] = "Connection:";
+static const char http_if_none_match[] = "If-None-Match:";
+
+static void
+parse_header(struct httpd_state *s)
+{
+  char *value;
+
+  if(strncasecmp(s->inputbuf, http_connection, sizeof(http_connection) - 1) == 0) {
+    value = s->inputbuf + sizeof(http_connection) - 1;
+    if(strstr(value, "close") != NULL || strstr(value, "Close") != NULL) {
+      s->keep_alive = 0;
+    } else if(strstr(value, "keep-alive") != NULL || strstr(value, "Keep-Alive") != NULL) {
+      s->keep_alive = 1;
+    }
+  } else if(strncasecmp(s->inputbuf, http_if_none_match, sizeof(http_if_none_match) - 1) == 0) {
+    value = strchr(s->inputbuf, '"');
+    if(value != NULL) {
+      s->if_none_match = strtoul(value + 1, NULL, 16);
+      s->has_etag = 1;
+    }
+  }
+}
+#endif
 
 static
 PT_THREAD(handle_input(struct httpd_state *s))
@@ -211,11 +368,34 @@ PT_THREAD(handle_input(struct httpd_state *s))
     LOG6LBR_6ADDR(DEBUG, &uip_conn->ripaddr, "Request for '%s' from ", s->filename);
   }
 
+#if WEBSERVER_CACHE
+  s->keep_alive = 0;
+  s->has_etag = 0;
+  s->response = NULL;
+  /* Rest of the request line, HTTP/1.1 connections are persistent */
+  PSOCK_READTO(&s->sin, ISO_nl);
+  s->keep_alive = strncmp(s->inputbuf, http_11, sizeof(http_11) - 1) == 0;
+  /* Headers, up to the empty line */
+  while(1) {
+    PSOCK_READTO(&s->sin, ISO_nl);
+    if(PSOCK_DATALEN(&s->sin) <= 2) {
+      break;
+    }
+    s->inputbuf[PSOCK_DATALEN(&s->sin) - 1] = 0;
+    parse_header(s);
+  }
+  if(s->request_type != REQUEST_TYPE_GET) {
+    /* The request body is not parsed */
+    s->keep_alive = 0;
+  }
+  s->state = STATE_OUTPUT;
+#else
   s->state = STATE_OUTPUT;
 
   while(1) {
     PSOCK_READTO(&s->sin, ISO_nl);
   }
+#endif
 
   PSOCK_END(&s->sin);
 }
@@ -223,10 +403,36 @@ PT_THREAD(handle_input(struct httpd_state *s))
 static void
 handle_connection(struct httpd_state *s)
 {
+#if WEBSERVER_CACHE
+  if(s->state == STATE_WAITING) {
+    handle_input(s);
+  }
+  if(s->state == STATE_OUTPUT) {
+    handle_output(s);
+    if(s->state == STATE_WAITING && uip_newdata()) {
+      /* The next request came with the ack of the response */
+      handle_input(s);
+      if(s->state == STATE_OUTPUT) {
+        handle_output(s);
+      }
+    }
+  }
+#else
   handle_input(s);
   if(s->state == STATE_OUTPUT) {
     handle_output(s);
   }
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static void
+httpd_state_free(struct httpd_state *s)
+{
+#if WEBSERVER_CACHE
+  /* The connection may be closed while sending a page */
+  httpd_cache_release(s->response);
+#endif
+  memb_free(&conns, s);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -236,7 +442,7 @@ httpd_appcall(void *state)
 
   if(uip_closed() || uip_aborted() || uip_timedout()) {
     if(s != NULL) {
-      memb_free(&conns, s);
+      httpd_state_free(s);
     }
   } else if(uip_connected()) {
     s = (struct httpd_state *)memb_alloc(&conns);
@@ -250,13 +456,16 @@ httpd_appcall(void *state)
     PSOCK_INIT(&s->sout, (uint8_t *) s->inputbuf, sizeof(s->inputbuf) - 1);
     PT_INIT(&s->outputpt);
     s->state = STATE_WAITING;
+#if WEBSERVER_CACHE
+    s->response = NULL;
+#endif
     timer_set(&s->timer, CLOCK_SECOND * 10);
     handle_connection(s);
   } else if(s != NULL) {
     if(uip_poll()) {
       if(timer_expired(&s->timer)) {
         uip_abort();
-        memb_free(&conns, s);
+        httpd_state_free(s);
         LOG6LBR_6ADDR(DEBUG, &uip_conn->ripaddr, "reset (timeout)");
       }
     } else {
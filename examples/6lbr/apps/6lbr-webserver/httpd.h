@@ -51,6 +51,23 @@ struct httpd_cgi_call;
 #define HTTPD_PATHLEN WEBSERVER_CONF_CFS_PATHLEN
 #endif /* WEBSERVER_CONF_CFS_CONNS */
 
+/* Render the pages in memory before sending them, keep the connections
+   alive and cache the pages which declare a version function. The pages are
+   allocated with malloc() */
+#ifdef WEBSERVER_CONF_CACHE
+#define WEBSERVER_CACHE WEBSERVER_CONF_CACHE
+#else
+#define WEBSERVER_CACHE 0
+#endif
+
+/* Maximum age of a cached page in seconds, it bounds the staleness of the
+   data which is not covered by the version of the page */
+#ifdef WEBSERVER_CONF_CACHE_MAX_AGE
+#define WEBSERVER_CACHE_MAX_AGE WEBSERVER_CONF_CACHE_MAX_AGE
+#else
+#define WEBSERVER_CACHE_MAX_AGE 10
+#endif
+
 #define REQUEST_TYPE_GET 0x1
 #define REQUEST_TYPE_PUT 0x2
 #define REQUEST_TYPE_POST 0x4
@@ -75,10 +92,35 @@ struct httpd_state {
   char request_type;
   struct httpd_cgi_call *script;
   char state;
+#if WEBSERVER_CACHE
+  uint8_t keep_alive;
+  uint8_t has_etag;
+  uint32_t if_none_match;
+  uint32_t etag;
+  int content_length;
+  struct httpd_cache_entry *response;
+  char header[200];
+#endif
 };
 
 void httpd_init(void);
 
+extern const char http_header_200[];
+
+#if WEBSERVER_CACHE
+/* Page being rendered in memory, see httpd-cache.h */
+extern struct httpd_cache_entry *httpd_render_entry;
+void httpd_render_add(const char *str);
+
+#define SEND_STRING(s, str) do {                          \
+    if(httpd_render_entry != NULL) {                      \
+      httpd_render_add(str);                              \
+    } else {                                              \
+      PSOCK_SEND(s, (uint8_t *)str, strlen(str));         \
+    }                                                     \
+  } while(0)
+#else
 #define SEND_STRING(s, str) PSOCK_SEND(s, (uint8_t *)str, strlen(str))
+#endif
 
 #endif /* __HTTPD_H__ */
@@ -576,7 +576,7 @@ webserver_network_nbr_rm(struct httpd_state *s)
   return &webserver_result_page;
 }
 
-HTTPD_CGI_CALL(webserver_network, "network.html", "IPv6", generate_network, 0);
+HTTPD_CGI_CACHED_CALL(webserver_network, "network.html", "IPv6", generate_network, 0, webserver_tables_version);
 #if CETIC_6LBR_WITH_IP64
 HTTPD_CGI_CALL(webserver_ip64, "ip64.html", "IP64", generate_ip64, 0);
 #endif
@@ -208,7 +208,7 @@ webserver_rpl_child(struct httpd_state *s)
   return &webserver_result_page;
 }
 
-HTTPD_CGI_CALL(webserver_rpl, "rpl.html", "RPL", generate_rpl, 0);
+HTTPD_CGI_CACHED_CALL(webserver_rpl, "rpl.html", "RPL", generate_rpl, 0, webserver_tables_version);
 HTTPD_CGI_CMD(webserver_rpl_gr_cmd, "rpl-gr", webserver_rpl_gr, 0);
 HTTPD_CGI_CMD(webserver_rpl_reset_cmd, "rpl-reset", webserver_rpl_reset, 0);
 HTTPD_CGI_CMD(webserver_rpl_child_cmd, "rpl-child", webserver_rpl_child, 0);
@@ -198,6 +198,12 @@ webserver_sensor_delete_node(struct httpd_state *s)
   return &webserver_result_page;
 }
 
-HTTPD_CGI_CALL(webserver_sensor, "sensor", "Sensor", generate_sensor, WEBSERVER_NOMENU);
+static uint32_t
+sensor_version(void)
+{
+  return node_info_version;
+}
+
+HTTPD_CGI_CACHED_CALL(webserver_sensor, "sensor", "Sensor", generate_sensor, WEBSERVER_NOMENU, sensor_version);
 HTTPD_CGI_CMD(webserver_sensor_reset_stats_cmd, "reset-stats", webserver_sensor_reset_stats, 0);
 HTTPD_CGI_CMD(webserver_sensor_delete_node_cmd, "rm-node", webserver_sensor_delete_node, 0);
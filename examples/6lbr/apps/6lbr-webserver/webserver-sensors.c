@@ -456,6 +456,20 @@ PT_THREAD(generate_sensors_traffic(struct httpd_state *s))
 }
 #endif
 
+static uint32_t
+sensors_version(void)
+{
+  return node_info_version;
+}
+
+static uint32_t
+sensors_info_version(void)
+{
+  //The page shows the non automatic status too
+  node_info_update_all();
+  return node_info_version;
+}
+
 static httpd_cgi_call_t *
 webserver_sensors_reset_stats_all(struct httpd_state *s)
 {
@@ -464,12 +478,12 @@ webserver_sensors_reset_stats_all(struct httpd_state *s)
   webserver_result_text = "All statistics reset";
   return &webserver_result_page;
 }
-HTTPD_CGI_CALL(webserver_sensors_info, "sensors.html", "Sensors", generate_sensors_info, 0);
-HTTPD_CGI_CALL(webserver_sensors_tree, "sensors_tree.html", "Node tree", generate_sensors_tree, 0);
-HTTPD_CGI_CALL(webserver_sensors_prr, "sensors_prr.html", "PRR", generate_sensors_prr, 0);
-HTTPD_CGI_CALL(webserver_sensors_ps, "sensors_ps.html", "Parent switch", generate_sensors_parent_switch, 0);
-HTTPD_CGI_CALL(webserver_sensors_hc, "sensors_hc.html", "Hop count", generate_sensors_hop_count, 0);
+HTTPD_CGI_CACHED_CALL(webserver_sensors_info, "sensors.html", "Sensors", generate_sensors_info, 0, sensors_info_version);
+HTTPD_CGI_CACHED_CALL(webserver_sensors_tree, "sensors_tree.html", "Node tree", generate_sensors_tree, 0, sensors_version);
+HTTPD_CGI_CACHED_CALL(webserver_sensors_prr, "sensors_prr.html", "PRR", generate_sensors_prr, 0, sensors_version);
+HTTPD_CGI_CACHED_CALL(webserver_sensors_ps, "sensors_ps.html", "Parent switch", generate_sensors_parent_switch, 0, sensors_version);
+HTTPD_CGI_CACHED_CALL(webserver_sensors_hc, "sensors_hc.html", "Hop count", generate_sensors_hop_count, 0, sensors_version);
 #if NODE_INFO_PER_NODE_STATS
-HTTPD_CGI_CALL(webserver_sensors_traffic, "sensors_traffic.html", "Traffic", generate_sensors_traffic, 0);
+HTTPD_CGI_CACHED_CALL(webserver_sensors_traffic, "sensors_traffic.html", "Traffic", generate_sensors_traffic, 0, sensors_version);
 #endif
 HTTPD_CGI_CMD(webserver_sensors_reset_stats_all_cmd, "reset-stats-all", webserver_sensors_reset_stats_all, 0);
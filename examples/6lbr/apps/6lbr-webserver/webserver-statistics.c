@@ -43,21 +43,30 @@
 #endif
 #include "httpd.h"
 #include "httpd-cgi.h"
+#include "httpd-cache.h"
 #include "webserver-utils.h"
+#include "net/ipv6/sicslowpan.h"
 
 #if CONTIKI_TARGET_NATIVE
 #include "native-config.h"
 #include "native-rdc.h"
 #include "network-itf.h"
 #include "slip-dev.h"
+#include "raw-tap-dev.h"
 #endif
 
 #include "log-6lbr.h"
+#include "packet-trace.h"
 
 #if CETIC_CSMA_STATS
 #include "csma.h"
 #endif
 
+#if CETIC_6LBR_WITH_DNS_PROXY
+#include "dns-proxy.h"
+#include "dns-cache.h"
+#endif
+
 #if CETIC_6LBR_LLSEC_STATS
 #if CETIC_6LBR_WITH_NONCORESEC
 #include "noncoresec/noncoresec.h"
@@ -74,6 +83,18 @@ PT_THREAD(generate_statistics(struct httpd_state *s))
 #if CONTIKI_TARGET_NATIVE
   static uint8_t ifindex;
   static slip_descr_t *slip_device;
+  static native_rdc_stats_t const *rdc_stats;
+  int i;
+#endif
+#if CETIC_6LBR_PACKET_TRACE
+  static int stage;
+  static packet_trace_stats_t const *trace_stats;
+  int bucket;
+#endif
+#if CETIC_CSMA_STATS && CSMA_WITH_DRR
+  static int queue;
+  struct csma_neighbor_stats queue_stats;
+  int used;
 #endif
   PSOCK_BEGIN(&s->sout);
 
@@ -143,6 +164,61 @@ PT_THREAD(generate_statistics(struct httpd_state *s))
 #else
   add("<h3>IP statistics are deactivated</h3>");
 #endif /* UIP_STATISTICS */
+#if SICSLOWPAN_REASS_HASH
+  add("<h2>6LoWPAN reassembly</h2>");
+  add("Reassembled packets : %lu<br />", (unsigned long)sicslowpan_reass_stats.reassembled);
+  add("Timeouts : %lu<br />", (unsigned long)sicslowpan_reass_stats.timeouts);
+  add("Context overflows : %lu<br />", (unsigned long)sicslowpan_reass_stats.overflows);
+  SEND_STRING(&s->sout, buf);
+  reset_buf();
+  add("Duplicate fragments : %lu<br />", (unsigned long)sicslowpan_reass_stats.duplicates);
+  add("Overlapping fragments : %lu<br />", (unsigned long)sicslowpan_reass_stats.overlaps);
+  add("<br />");
+  SEND_STRING(&s->sout, buf);
+  reset_buf();
+#endif
+#if WEBSERVER_CACHE
+  add("<h2>Web cache</h2>");
+  add("Hits : %lu<br />", (unsigned long)httpd_cache_stats.hits);
+  add("Misses : %lu<br />", (unsigned long)httpd_cache_stats.misses);
+  add("Renders : %lu<br />", (unsigned long)httpd_cache_stats.renders);
+  add("Not modified : %lu<br />", (unsigned long)httpd_cache_stats.not_modified);
+  add("Render errors : %lu<br />", (unsigned long)httpd_cache_stats.render_errors);
+  add("<br />");
+  SEND_STRING(&s->sout, buf);
+  reset_buf();
+#endif
+#if CETIC_6LBR_WITH_DNS_PROXY
+  add("<h2>DNS proxy</h2>");
+  add("Queries : %lu<br />", (unsigned long)dns_proxy_stats.queries);
+  add("Cache hits : %lu (%lu negative)<br />",
+      (unsigned long)(dns_cache_stats.hits + dns_cache_stats.negative_hits),
+      (unsigned long)dns_cache_stats.negative_hits);
+  if(dns_proxy_stats.queries > 0) {
+    add("Hit rate : %lu %%<br />",
+        (unsigned long)((dns_cache_stats.hits + dns_cache_stats.negative_hits) * 100 / dns_proxy_stats.queries));
+  }
+  SEND_STRING(&s->sout, buf);
+  reset_buf();
+  add("Merged queries : %lu<br />", (unsigned long)dns_proxy_stats.coalesced);
+  add("Dropped queries : %lu<br />", (unsigned long)dns_proxy_stats.dropped);
+  add("Evicted answers : %lu<br />", (unsigned long)dns_cache_stats.evicted);
+  SEND_STRING(&s->sout, buf);
+  reset_buf();
+  add("Upstream queries : %lu (%lu answers, %lu timeouts)<br />",
+      (unsigned long)dns_proxy_stats.upstream_queries,
+      (unsigned long)dns_proxy_stats.upstream_answers,
+      (unsigned long)dns_proxy_stats.timeouts);
+  add("DNS64 answers : %lu<br />", (unsigned long)dns_proxy_stats.dns64);
+  if(dns_proxy_stats.resolved > 0) {
+    add("Upstream latency : %lu ms average, %lu ms max<br />",
+        (unsigned long)(dns_proxy_stats.latency_total / dns_proxy_stats.resolved),
+        (unsigned long)dns_proxy_stats.latency_max);
+  }
+  add("<br />");
+  SEND_STRING(&s->sout, buf);
+  reset_buf();
+#endif
 #if CETIC_6LBR_WITH_RPL
   add("<h2>RPL</h2>");
 #if RPL_CONF_STATS
@@ -196,6 +272,33 @@ PT_THREAD(generate_statistics(struct httpd_state *s))
   add("<br />");
   SEND_STRING(&s->sout, buf);
   reset_buf();
+#if CSMA_WITH_DRR
+  add("Control packets : %lu<br />", (unsigned long)csma_control_packets);
+  add("<table>"
+      "<theader><tr class=\"row_first\"><td>Neighbor</td><td>Queued</td><td>Control</td>"
+      "<td>Max queued</td><td>Sent</td><td>Overflows</td><td>Sojourn (ms)</td><td>Max sojourn (ms)</td>"
+      "</tr></theader><tbody>");
+  SEND_STRING(&s->sout, buf);
+  reset_buf();
+  for(queue = 0; (used = csma_neighbor_stats(queue, &queue_stats)) >= 0; queue++) {
+    if(!used) {
+      continue;
+    }
+    add("<tr><td>");
+    lladdr_add((uip_lladdr_t *)&queue_stats.addr);
+    add("</td><td>%u</td><td>%u</td><td>%u</td><td>%lu</td><td>%lu</td>",
+        queue_stats.queued, queue_stats.control_queued, queue_stats.max_queued,
+        (unsigned long)queue_stats.dequeued, (unsigned long)queue_stats.overflows);
+    add("<td>%lu</td><td>%lu</td></tr>",
+        queue_stats.dequeued ? (unsigned long)(queue_stats.sojourn_total * 1000 / CLOCK_SECOND / queue_stats.dequeued) : 0,
+        (unsigned long)queue_stats.sojourn_max * 1000 / CLOCK_SECOND);
+    SEND_STRING(&s->sout, buf);
+    reset_buf();
+  }
+  add("</tbody></table><br />");
+  SEND_STRING(&s->sout, buf);
+  reset_buf();
+#endif
 #endif
   }
 #if CETIC_6LBR_LLSEC_STATS
@@ -221,6 +324,18 @@ PT_THREAD(generate_statistics(struct httpd_state *s))
   SEND_STRING(&s->sout, buf);
   reset_buf();
 #endif
+#if CONTIKI_TARGET_NATIVE
+  if(sixlbr_config_pipeline) {
+    add("<h2>Ethernet pipeline</h2>");
+    add("RX queue : %d<br />", eth_dev_rx_queue_length());
+    add("RX dropped : %lu<br />", (unsigned long)__atomic_load_n(&eth_dev_rx_dropped, __ATOMIC_RELAXED));
+    add("TX queue : %d<br />", eth_dev_tx_queue_length());
+    add("TX dropped : %lu<br />", (unsigned long)__atomic_load_n(&eth_dev_tx_dropped, __ATOMIC_RELAXED));
+    add("<br />");
+    SEND_STRING(&s->sout, buf);
+    reset_buf();
+  }
+#endif
 #if CONTIKI_TARGET_NATIVE
   add("<h2>SLIP</h2>");
 #if CETIC_6LBR_MULTI_RADIO
@@ -237,21 +352,131 @@ PT_THREAD(generate_statistics(struct httpd_state *s))
         add("Messages sent : %d<br />", slip_device->message_sent);
         add("Messages received : %d<br />", slip_device->message_received);
         add("Bytes sent : %d<br />", slip_device->bytes_sent);
-        add("Bytes received : %d<br />", slip_device->bytes_received);
+        add("Bytes received : %d<br />", __atomic_load_n(&slip_device->bytes_received, __ATOMIC_RELAXED));
         if(slip_device->crc8) {
           add("CRC errors : %d<br />", slip_device->crc_errors);
         }
+        add("TX queue : %d<br />", slip_tx_queue_length(slip_device));
+        add("TX queue full : %d<br />", slip_device->tx_queue_full);
+        if(sixlbr_config_pipeline) {
+          add("RX queue full : %d<br />", __atomic_load_n(&slip_device->rx_queue_full, __ATOMIC_RELAXED));
+        }
         add("<br />");
         SEND_STRING(&s->sout, buf);
         reset_buf();
+        rdc_stats = native_rdc_get_stats(ifindex);
+        if(rdc_stats != NULL) {
+          add("In flight : %d (window %d, max %lu)<br />", native_rdc_in_flight(ifindex),
+              slip_device->window, (unsigned long)rdc_stats->max_in_flight);
+          add("Frames : %lu<br />", (unsigned long)rdc_stats->frames);
+          add("Acks : %lu<br />", (unsigned long)rdc_stats->acks);
+          add("Retransmissions : %lu<br />", (unsigned long)rdc_stats->retransmissions);
+          SEND_STRING(&s->sout, buf);
+          reset_buf();
+          add("Ack timeouts : %lu<br />", (unsigned long)rdc_stats->timeouts);
+          add("Stale acks : %lu<br />", (unsigned long)rdc_stats->stale_acks);
+          add("Window full : %lu<br />", (unsigned long)rdc_stats->window_full);
+          SEND_STRING(&s->sout, buf);
+          reset_buf();
+          add("RTT (ms) :");
+          for(i = 0; i < NATIVE_RDC_HISTOGRAM_BUCKETS - 1; i++) {
+            add(" &lt;%d: %lu", 1 << i, (unsigned long)rdc_stats->rtt[i]);
+          }
+          add(" &ge;%d: %lu<br />", 1 << (i - 1), (unsigned long)rdc_stats->rtt[i]);
+          SEND_STRING(&s->sout, buf);
+          reset_buf();
+          add("Ack latency (ms) :");
+          for(i = 0; i < NATIVE_RDC_HISTOGRAM_BUCKETS - 1; i++) {
+            add(" &lt;%d: %lu", 1 << i, (unsigned long)rdc_stats->ack_latency[i]);
+          }
+          add(" &ge;%d: %lu<br /><br />", 1 << (i - 1), (unsigned long)rdc_stats->ack_latency[i]);
+          SEND_STRING(&s->sout, buf);
+          reset_buf();
+        }
 #if CETIC_6LBR_MULTI_RADIO
       }
     }
   }
 #endif
 #endif
+#if CETIC_6LBR_PACKET_TRACE
+  add("<h2>Packet latency</h2>");
+  add("<a href=\"packet_trace.json\">JSON</a><br /><br />");
+  SEND_STRING(&s->sout, buf);
+  reset_buf();
+  for(stage = 0; stage < PACKET_TRACE_STAGE_NB; stage++) {
+    trace_stats = packet_trace_get_stats(stage);
+    if(trace_stats->count == 0) {
+      continue;
+    }
+    add("%s (us) : %lu packets, mean %lu, max %lu<br />",
+        packet_trace_stage_name(stage), (unsigned long)trace_stats->count,
+        (unsigned long)(trace_stats->total / trace_stats->count),
+        (unsigned long)trace_stats->max);
+    SEND_STRING(&s->sout, buf);
+    reset_buf();
+    for(bucket = 0; bucket < PACKET_TRACE_HISTOGRAM_BUCKETS - 1; bucket++) {
+      if(trace_stats->histogram[bucket] > 0) {
+        add(" &lt;%d: %lu", 1 << bucket, (unsigned long)trace_stats->histogram[bucket]);
+      }
+    }
+    if(trace_stats->histogram[bucket] > 0) {
+      add(" &ge;%d: %lu", 1 << (bucket - 1), (unsigned long)trace_stats->histogram[bucket]);
+    }
+    add("<br /><br />");
+    SEND_STRING(&s->sout, buf);
+    reset_buf();
+  }
+#endif
+
+  PSOCK_END(&s->sout);
+}
+#if CETIC_6LBR_PACKET_TRACE
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(generate_packet_trace(struct httpd_state *s))
+{
+  static int stage;
+  static packet_trace_stats_t const *trace_stats;
+  int bucket;
+
+  PSOCK_BEGIN(&s->sout);
+
+  SEND_STRING(&s->sout, http_header_200);
+  SEND_STRING(&s->sout, "Content-type: application/json\r\n\r\n");
+  /* Bucket i counts the delays below bounds[i], the last one the others */
+  add("{\"unit\":\"us\",\"bounds\":[");
+  for(bucket = 0; bucket < PACKET_TRACE_HISTOGRAM_BUCKETS - 1; bucket++) {
+    add("%s%lu", bucket > 0 ? "," : "", 1UL << bucket);
+  }
+  add("],\"stages\":[");
+  SEND_STRING(&s->sout, buf);
+  reset_buf();
+  for(stage = 0; stage < PACKET_TRACE_STAGE_NB; stage++) {
+    trace_stats = packet_trace_get_stats(stage);
+    add("%s{\"name\":\"%s\",\"count\":%lu,\"total\":%llu,\"max\":%lu,\"histogram\":[",
+        stage > 0 ? "," : "", packet_trace_stage_name(stage),
+        (unsigned long)trace_stats->count, (unsigned long long)trace_stats->total,
+        (unsigned long)trace_stats->max);
+    for(bucket = 0; bucket < PACKET_TRACE_HISTOGRAM_BUCKETS; bucket++) {
+      add("%s%lu", bucket > 0 ? "," : "", (unsigned long)trace_stats->histogram[bucket]);
+    }
+    add("]}");
+    SEND_STRING(&s->sout, buf);
+    reset_buf();
+  }
+  add("]}\n");
+  SEND_STRING(&s->sout, buf);
+  reset_buf();
 
   PSOCK_END(&s->sout);
 }
+#endif
+/*---------------------------------------------------------------------------*/
 
-HTTPD_CGI_CALL(webserver_statistics, "statistics.html", "Statistics", generate_statistics, 0);
+/* The counters change all the time, the page is only refreshed every WEBSERVER_CACHE_MAX_AGE */
+HTTPD_CGI_CACHED_CALL(webserver_statistics, "statistics.html", "Statistics", generate_statistics, 0, httpd_cache_timed);
+#if CETIC_6LBR_PACKET_TRACE
+HTTPD_CGI_CALL(webserver_packet_trace, "packet_trace.json", NULL, generate_packet_trace,
+               HTTPD_CUSTOM_HEADER | HTTPD_CUSTOM_TOP | HTTPD_CUSTOM_BOTTOM);
+#endif
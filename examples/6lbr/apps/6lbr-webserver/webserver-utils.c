@@ -42,6 +42,8 @@
 #include "httpd.h"
 #include "httpd-cgi.h"
 #include "webserver-utils.h"
+#include "net/nbr-table.h"
+#include "uip-ds6-route.h"
 
 #include <stdarg.h>
 
@@ -388,6 +390,12 @@ add_div_footer()
   add("<div id=\"footer\">6LBR By CETIC (<a href=\"http://cetic.github.com/6lbr\">documentation</a>)");
 }
 /*---------------------------------------------------------------------------*/
+uint32_t
+webserver_tables_version(void)
+{
+  return uip_ds6_route_version + nbr_table_version;
+}
+/*---------------------------------------------------------------------------*/
 void
 reset_buf()
 {
@@ -49,4 +49,8 @@ add_key(const uint8_t * key, int size);
 int
 key_conv(const char *str, uint8_t * key, int size);
 
+/* Changes each time the routing or the neighbor tables are modified */
+uint32_t
+webserver_tables_version(void);
+
 #endif
@@ -86,6 +86,9 @@ HTTPD_CGI_CALL_NAME(webserver_config_services)
 HTTPD_CGI_CMD_NAME(webserver_config_set_cmd)
 HTTPD_CGI_CMD_NAME(webserver_config_reset_cmd)
 HTTPD_CGI_CALL_NAME(webserver_statistics)
+#if CETIC_6LBR_PACKET_TRACE
+HTTPD_CGI_CALL_NAME(webserver_packet_trace)
+#endif
 HTTPD_CGI_CALL_NAME(webserver_admin)
 HTTPD_CGI_CMD_NAME(webserver_admin_restart_cmd)
 #if CONTIKI_TARGET_NATIVE
@@ -156,6 +159,9 @@ webserver_init(void)
   httpd_group_add_page(&status_group, &webserver_rpl);
 #endif
   httpd_group_add_page(&statistics_group, &webserver_statistics);
+#if CETIC_6LBR_PACKET_TRACE
+  httpd_cgi_add(&webserver_packet_trace);
+#endif
   if ((cetic_6lbr_global_flags & CETIC_GLOBAL_DISABLE_CONFIG) == 0) {
 #if CETIC_6LBR_WITH_RPL
     httpd_cgi_command_add(&webserver_rpl_gr_cmd);
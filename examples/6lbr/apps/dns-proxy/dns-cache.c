@@ -0,0 +1,531 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Cache of the DNS answers relayed by the DNS proxy
+ *
+ *         The answers are kept as received, with the question in front, so
+ *         that name compression pointers stay valid. When an answer is
+ *         served, the identifier and question of the query are copied over
+ *         and the TTLs are decreased by the time spent in the cache.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "contiki.h"
+#include "dns-cache.h"
+#include "lib/hash-index.h"
+#if DNS_CACHE_DNS64
+#include "ip64-addr.h"
+#endif
+
+#include <string.h>
+
+#define DNS_FLAG1_OPCODE_MASK 0x78
+#define DNS_FLAG1_TRUNC       0x02
+#define DNS_FLAG1_RD          0x01
+#define DNS_FLAG2_ERR_MASK    0x0f
+#define DNS_FLAG2_ERR_NONE    0x00
+#define DNS_FLAG2_ERR_NAME    0x03
+
+#define DNS_TYPE_CNAME 5
+#define DNS_TYPE_SOA  6
+#define DNS_TYPE_OPT 41
+
+#define DNS_CACHE_HASH_SIZE (2 * DNS_CACHE_SIZE)
+
+struct dns_cache_entry {
+  struct dns_cache_entry *next;
+  uint32_t hash;
+  unsigned long stored;
+  unsigned long expires;
+  unsigned long last_used;
+  uint16_t len;
+  uint16_t question_len;
+  uint8_t negative;
+  uint8_t msg[DNS_CACHE_MESSAGE_SIZE];
+};
+
+static struct dns_cache_entry entries[DNS_CACHE_SIZE];
+static struct dns_cache_entry *hash_table[DNS_CACHE_HASH_SIZE];
+
+struct dns_cache_stats dns_cache_stats;
+
+/*---------------------------------------------------------------------------*/
+static uint16_t
+get16(const uint8_t *p)
+{
+  return (p[0] << 8) | p[1];
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+get32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+/*---------------------------------------------------------------------------*/
+static void
+put32(uint8_t *p, uint32_t value)
+{
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+lower(uint8_t c)
+{
+  return c >= 'A' && c <= 'Z' ? c + 'a' - 'A' : c;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the offset following the name, or -1 if it overflows the message */
+static int
+skip_name(const uint8_t *msg, int len, int offset)
+{
+  while(offset < len) {
+    if((msg[offset] & 0xc0) == 0xc0) {
+      /* Compression pointer ends the name */
+      return offset + 2 <= len ? offset + 2 : -1;
+    } else if(msg[offset] == 0) {
+      return offset + 1;
+    }
+    offset += 1 + msg[offset];
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the offset of the next resource record, or -1 if the record
+   overflows the message */
+static int
+next_record(const uint8_t *msg, int len, int offset, uint16_t *type, int *ttl_offset,
+            int *rdata_offset)
+{
+  offset = skip_name(msg, len, offset);
+  if(offset < 0 || offset + 10 > len) {
+    return -1;
+  }
+  *type = get16(msg + offset);
+  *ttl_offset = offset + 4;
+  *rdata_offset = offset + 10;
+  offset += 10 + get16(msg + offset + 8);
+  return offset <= len ? offset : -1;
+}
+/*---------------------------------------------------------------------------*/
+int
+dns_cache_parse(const uint8_t *msg, int len, struct dns_question *question)
+{
+  int offset;
+  int i;
+  uint32_t hash;
+
+  if(len < DNS_HEADER_SIZE || (msg[2] & DNS_FLAG1_OPCODE_MASK) != 0 || get16(msg + 4) != 1) {
+    return 0;
+  }
+  offset = DNS_HEADER_SIZE;
+  while(offset < len && msg[offset] != 0) {
+    if((msg[offset] & 0xc0) != 0) {
+      /* No compression in the question of a query */
+      return 0;
+    }
+    offset += 1 + msg[offset];
+  }
+  offset++;
+  if(offset + 4 > len || offset - DNS_HEADER_SIZE > DNS_MAX_NAME_SIZE) {
+    return 0;
+  }
+  question->data = msg + DNS_HEADER_SIZE;
+  question->len = offset + 4 - DNS_HEADER_SIZE;
+  question->type = get16(msg + offset);
+
+  /* FNV-1a, the name is not case sensitive */
+  hash = HASH_FNV_INIT;
+  for(i = 0; i < question->len - 4; i++) {
+    hash = HASH_FNV_BYTE(hash, lower(question->data[i]));
+  }
+  question->hash = hash_fnv(hash, question->data + question->len - 4, 4);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+dns_cache_name_equal(const struct dns_question *a, const struct dns_question *b)
+{
+  int i;
+
+  if(a->len != b->len) {
+    return 0;
+  }
+  for(i = 0; i < a->len - 4; i++) {
+    if(lower(a->data[i]) != lower(b->data[i])) {
+      return 0;
+    }
+  }
+  /* Class */
+  return memcmp(a->data + a->len - 2, b->data + b->len - 2, 2) == 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+dns_cache_question_equal(const struct dns_question *a, const struct dns_question *b)
+{
+  return a->hash == b->hash && a->type == b->type && dns_cache_name_equal(a, b);
+}
+/*---------------------------------------------------------------------------*/
+void
+dns_cache_init(void)
+{
+  memset(entries, 0, sizeof(entries));
+  memset(hash_table, 0, sizeof(hash_table));
+}
+/*---------------------------------------------------------------------------*/
+static void
+entry_remove(struct dns_cache_entry *e)
+{
+  struct dns_cache_entry **link;
+
+  for(link = &hash_table[e->hash % DNS_CACHE_HASH_SIZE]; *link != NULL; link = &(*link)->next) {
+    if(*link == e) {
+      *link = e->next;
+      break;
+    }
+  }
+  e->next = NULL;
+  e->len = 0;
+}
+/*---------------------------------------------------------------------------*/
+static struct dns_cache_entry *
+entry_find(const struct dns_question *question)
+{
+  struct dns_cache_entry *e;
+  struct dns_question cached;
+
+  for(e = hash_table[question->hash % DNS_CACHE_HASH_SIZE]; e != NULL; e = e->next) {
+    cached.data = e->msg + DNS_HEADER_SIZE;
+    cached.len = e->question_len;
+    cached.type = (cached.data[cached.len - 4] << 8) | cached.data[cached.len - 3];
+    cached.hash = e->hash;
+    if(dns_cache_question_equal(question, &cached)) {
+      return e;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Minimum TTL of the answers, or of the SOA record of the authority section
+   for a negative answer. Returns -1 if the response can not be cached */
+static long
+response_ttl(const uint8_t *msg, int len, int question_len, int negative)
+{
+  int offset;
+  int ttl_offset;
+  int rdata_offset;
+  int next;
+  int i;
+  int nb_answers;
+  int nb_records;
+  uint16_t type;
+  long ttl;
+  long min_ttl;
+
+  nb_answers = get16(msg + 6);
+  nb_records = nb_answers + (negative ? get16(msg + 8) : 0);
+  min_ttl = -1;
+  offset = DNS_HEADER_SIZE + question_len;
+  for(i = 0; i < nb_records; i++) {
+    next = next_record(msg, len, offset, &type, &ttl_offset, &rdata_offset);
+    if(next < 0) {
+      return -1;
+    }
+    if(i < nb_answers) {
+      ttl = get32(msg + ttl_offset);
+    } else if(type == DNS_TYPE_SOA && next - rdata_offset >= 20) {
+      /* RFC 2308, the lowest of the SOA TTL and minimum fields */
+      ttl = get32(msg + ttl_offset);
+      if(get32(msg + next - 4) < ttl) {
+        ttl = get32(msg + next - 4);
+      }
+    } else {
+      ttl = -1;
+    }
+    if(ttl >= 0 && (min_ttl < 0 || ttl < min_ttl)) {
+      min_ttl = ttl;
+    }
+    offset = next;
+  }
+  return min_ttl;
+}
+/*---------------------------------------------------------------------------*/
+static void
+age_response(uint8_t *msg, int len, int question_len, unsigned long elapsed)
+{
+  int offset;
+  int ttl_offset;
+  int rdata_offset;
+  int i;
+  int nb_records;
+  uint16_t type;
+  uint32_t ttl;
+
+  nb_records = get16(msg + 6) + get16(msg + 8) + get16(msg + 10);
+  offset = DNS_HEADER_SIZE + question_len;
+  for(i = 0; i < nb_records; i++) {
+    offset = next_record(msg, len, offset, &type, &ttl_offset, &rdata_offset);
+    if(offset < 0) {
+      return;
+    }
+    /* The TTL field of the EDNS pseudo record holds flags */
+    if(type != DNS_TYPE_OPT) {
+      ttl = get32(msg + ttl_offset);
+      put32(msg + ttl_offset, ttl > elapsed ? ttl - elapsed : 0);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+dns_cache_lookup(const uint8_t *query, const struct dns_question *question,
+                 uint8_t *out, int size)
+{
+  struct dns_cache_entry *e;
+  unsigned long now;
+
+  now = clock_seconds();
+  e = entry_find(question);
+  if(e != NULL && (long)(e->expires - now) <= 0) {
+    entry_remove(e);
+    e = NULL;
+  }
+  if(e == NULL || e->len > size) {
+    dns_cache_stats.misses++;
+    return 0;
+  }
+
+  memcpy(out, e->msg, e->len);
+  /* Identifier, recursion desired flag and question of the query */
+  out[0] = query[0];
+  out[1] = query[1];
+  out[2] = (out[2] & ~DNS_FLAG1_RD) | (query[2] & DNS_FLAG1_RD);
+  memcpy(out + DNS_HEADER_SIZE, question->data, question->len);
+  age_response(out, e->len, e->question_len, now - e->stored);
+
+  e->last_used = now;
+  if(e->negative) {
+    dns_cache_stats.negative_hits++;
+  } else {
+    dns_cache_stats.hits++;
+  }
+  return e->len;
+}
+/*---------------------------------------------------------------------------*/
+void
+dns_cache_store(const struct dns_question *question, const uint8_t *response, int len)
+{
+  struct dns_cache_entry *e;
+  struct dns_cache_entry *candidate;
+  unsigned long now;
+  long ttl;
+  uint8_t rcode;
+  int negative;
+  int i;
+
+  if(len < DNS_HEADER_SIZE + question->len || len > DNS_CACHE_MESSAGE_SIZE ||
+     (response[2] & DNS_FLAG1_TRUNC) != 0) {
+    return;
+  }
+  rcode = response[3] & DNS_FLAG2_ERR_MASK;
+  if(rcode == DNS_FLAG2_ERR_NONE) {
+    negative = get16(response + 6) == 0;
+  } else if(rcode == DNS_FLAG2_ERR_NAME) {
+    negative = 1;
+  } else {
+    /* Server failures and refusals are not cached */
+    return;
+  }
+  ttl = response_ttl(response, len, question->len, negative);
+  if(ttl > (negative ? DNS_CACHE_MAX_NEGATIVE_TTL : DNS_CACHE_MAX_TTL)) {
+    ttl = negative ? DNS_CACHE_MAX_NEGATIVE_TTL : DNS_CACHE_MAX_TTL;
+  }
+  if(ttl <= 0) {
+    /* Includes the negative answers without SOA record */
+    return;
+  }
+
+  now = clock_seconds();
+  e = entry_find(question);
+  if(e == NULL) {
+    /* Take a free or expired entry, else the least recently used one */
+    candidate = NULL;
+    for(i = 0; i < DNS_CACHE_SIZE; i++) {
+      e = &entries[i];
+      if(e->len == 0 || (long)(e->expires - now) <= 0) {
+        candidate = e;
+        break;
+      }
+      if(candidate == NULL || (long)(e->last_used - candidate->last_used) < 0) {
+        candidate = e;
+      }
+    }
+    e = candidate;
+    if(e->len != 0) {
+      if((long)(e->expires - now) > 0) {
+        dns_cache_stats.evicted++;
+      }
+      entry_remove(e);
+    }
+    e->hash = question->hash;
+    e->next = hash_table[e->hash % DNS_CACHE_HASH_SIZE];
+    hash_table[e->hash % DNS_CACHE_HASH_SIZE] = e;
+  }
+
+  memcpy(e->msg, response, len);
+  e->len = len;
+  e->question_len = question->len;
+  e->negative = negative;
+  e->stored = now;
+  e->expires = now + ttl;
+  e->last_used = now;
+  dns_cache_stats.stored++;
+}
+/*---------------------------------------------------------------------------*/
+int
+dns_cache_is_aaaa_nodata(const uint8_t *response, int len)
+{
+  struct dns_question question;
+  int offset;
+  int ttl_offset;
+  int rdata_offset;
+  int i;
+  uint16_t type;
+
+  if(!dns_cache_parse(response, len, &question) || question.type != DNS_TYPE_AAAA ||
+     (response[3] & DNS_FLAG2_ERR_MASK) != DNS_FLAG2_ERR_NONE) {
+    return 0;
+  }
+  offset = DNS_HEADER_SIZE + question.len;
+  for(i = 0; i < get16(response + 6); i++) {
+    offset = next_record(response, len, offset, &type, &ttl_offset, &rdata_offset);
+    if(offset < 0 || type == DNS_TYPE_AAAA) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+#if DNS_CACHE_DNS64
+/* Returns 1 if the name at offset fits in the message and its compression
+   pointer, if any, points before limit */
+static int
+name_points_before(const uint8_t *msg, int len, int offset, int limit)
+{
+  while(offset < len) {
+    if((msg[offset] & 0xc0) == 0xc0) {
+      return offset + 2 <= len && (((msg[offset] & 0x3f) << 8) | msg[offset + 1]) < limit;
+    } else if(msg[offset] == 0) {
+      return 1;
+    }
+    offset += 1 + msg[offset];
+  }
+  return 0;
+}
+#endif
+/*---------------------------------------------------------------------------*/
+int
+dns_cache_dns64(const struct dns_question *question, const uint8_t *response, int len,
+                uint8_t *out, int size)
+{
+#if DNS_CACHE_DNS64
+  int offset;
+  int next;
+  int ttl_offset;
+  int rdata_offset;
+  int out_len;
+  int limit;
+  int i;
+  uint16_t type;
+  uip_ip4addr_t ip4addr;
+  uip_ip6addr_t ip6addr;
+
+  if(len < DNS_HEADER_SIZE + question->len || DNS_HEADER_SIZE + question->len > size) {
+    return 0;
+  }
+  /* Only the answers are kept. Each address grows by 12 bytes and shifts
+     the data that follows it, so the compression pointers must point
+     before the first address */
+  out_len = DNS_HEADER_SIZE + question->len;
+  memcpy(out, response, out_len);
+  out[8] = out[9] = out[10] = out[11] = 0;
+  limit = len;
+  offset = out_len;
+  for(i = 0; i < get16(response + 6); i++) {
+    next = next_record(response, len, offset, &type, &ttl_offset, &rdata_offset);
+    if(next < 0 || !name_points_before(response, len, offset, limit) ||
+       (type == DNS_TYPE_CNAME && !name_points_before(response, next, rdata_offset, limit))) {
+      return 0;
+    }
+    if(type == DNS_TYPE_A && next - rdata_offset == 4) {
+      if(out_len + rdata_offset - offset + sizeof(ip6addr) > size) {
+        return 0;
+      }
+      memcpy(out + out_len, response + offset, rdata_offset - offset);
+      out_len += rdata_offset - offset;
+      /* Type and data length */
+      out[out_len - 10] = 0;
+      out[out_len - 9] = DNS_TYPE_AAAA;
+      out[out_len - 2] = 0;
+      out[out_len - 1] = sizeof(ip6addr);
+      memcpy(&ip4addr, response + rdata_offset, sizeof(ip4addr));
+      ip64_addr_4to6(&ip4addr, &ip6addr);
+      memcpy(out + out_len, &ip6addr, sizeof(ip6addr));
+      out_len += sizeof(ip6addr);
+      if(limit == len) {
+        limit = rdata_offset;
+      }
+    } else {
+      if(out_len + next - offset > size) {
+        return 0;
+      }
+      memcpy(out + out_len, response + offset, next - offset);
+      out_len += next - offset;
+    }
+    offset = next;
+  }
+  if(limit == len) {
+    /* No address either, the A response is also the AAAA response */
+    if(len > size) {
+      return 0;
+    }
+    memcpy(out, response, len);
+    out_len = len;
+  }
+  memcpy(out + DNS_HEADER_SIZE, question->data, question->len);
+  return out_len;
+#else
+  return 0;
+#endif
+}
+/*---------------------------------------------------------------------------*/
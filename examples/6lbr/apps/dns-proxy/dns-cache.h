@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Cache of the DNS answers relayed by the DNS proxy
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include "contiki.h"
+
+/* Number of cached answers */
+#ifdef DNS_CACHE_CONF_SIZE
+#define DNS_CACHE_SIZE DNS_CACHE_CONF_SIZE
+#else
+#define DNS_CACHE_SIZE 8
+#endif
+
+/* Largest DNS message handled by the proxy and kept in the cache */
+#ifdef DNS_CACHE_CONF_MESSAGE_SIZE
+#define DNS_CACHE_MESSAGE_SIZE DNS_CACHE_CONF_MESSAGE_SIZE
+#else
+#define DNS_CACHE_MESSAGE_SIZE 256
+#endif
+
+/* Upper bound of the time an answer is kept, in seconds */
+#ifdef DNS_CACHE_CONF_MAX_TTL
+#define DNS_CACHE_MAX_TTL DNS_CACHE_CONF_MAX_TTL
+#else
+#define DNS_CACHE_MAX_TTL 86400
+#endif
+
+/* Upper bound of the time a negative answer is kept, in seconds */
+#ifdef DNS_CACHE_CONF_MAX_NEGATIVE_TTL
+#define DNS_CACHE_MAX_NEGATIVE_TTL DNS_CACHE_CONF_MAX_NEGATIVE_TTL
+#else
+#define DNS_CACHE_MAX_NEGATIVE_TTL 300
+#endif
+
+/* Synthesize AAAA answers from the A records when the name has no AAAA
+   record, using the NAT64 prefix */
+#ifdef DNS_CACHE_CONF_DNS64
+#define DNS_CACHE_DNS64 DNS_CACHE_CONF_DNS64
+#else
+#define DNS_CACHE_DNS64 CETIC_6LBR_WITH_IP64
+#endif
+
+#define DNS_HEADER_SIZE 12
+#define DNS_PORT 53
+
+#define DNS_MAX_NAME_SIZE 255
+/* Name, type and class */
+#define DNS_MAX_QUESTION_SIZE (DNS_MAX_NAME_SIZE + 4)
+
+#define DNS_TYPE_A      1
+#define DNS_TYPE_AAAA  28
+
+/* Question of a DNS message: the name, type and class as found in the
+   message */
+struct dns_question {
+  const uint8_t *data;
+  uint16_t len;
+  uint16_t type;
+  uint32_t hash;
+};
+
+struct dns_cache_stats {
+  uint32_t hits;
+  uint32_t negative_hits;
+  uint32_t misses;
+  uint32_t stored;
+  uint32_t evicted;
+};
+
+extern struct dns_cache_stats dns_cache_stats;
+
+void dns_cache_init(void);
+
+/* Parse the single question of a standard query or response, returns 0
+   if the message is not supported */
+int dns_cache_parse(const uint8_t *msg, int len, struct dns_question *question);
+
+/* Compare two questions, ignoring the case of the names */
+int dns_cache_question_equal(const struct dns_question *a, const struct dns_question *b);
+
+/* Compare the names and classes of two questions, ignoring their types */
+int dns_cache_name_equal(const struct dns_question *a, const struct dns_question *b);
+
+/* Build in out the answer to the query from the cache, returns its length
+   or 0 if no valid answer is cached */
+int dns_cache_lookup(const uint8_t *query, const struct dns_question *question,
+                     uint8_t *out, int size);
+
+/* Store the response to the question if it can be cached */
+void dns_cache_store(const struct dns_question *question, const uint8_t *response, int len);
+
+/* Check that the response answers a AAAA query without any AAAA record,
+   i.e. DNS64 should be tried */
+int dns_cache_is_aaaa_nodata(const uint8_t *response, int len);
+
+/* Build in out the AAAA response to the question from the response to the
+   A query of the same name, the addresses are mapped with the ip64 prefix.
+   Returns the length of the response or 0 if it could not be built */
+int dns_cache_dns64(const struct dns_question *question, const uint8_t *response, int len,
+                    uint8_t *out, int size);
+
+#endif /* DNS_CACHE_H */
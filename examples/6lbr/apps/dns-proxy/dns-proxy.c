@@ -28,6 +28,14 @@
  */
 
 /**
+ * \file
+ *         Caching DNS proxy
+ *
+ *         The queries of the nodes are answered from the cache when
+ *         possible, otherwise they are sent to the upstream name server.
+ *         Identical queries waiting for the same upstream answer are merged.
+ *         When NAT64 is enabled and a name has no AAAA record, the AAAA
+ *         answer is synthesized from its A records.
  * \author
  *         6LBR Team <6lbr@cetic.be>
  */
@@ -39,65 +47,340 @@
 #include "contiki-net.h"
 #include "log-6lbr.h"
 #include "ip64-addr.h"
+#include "dns-proxy.h"
+#include "dns-cache.h"
 
 #include <string.h>
 
-static struct uip_udp_conn *server_conn;
-
 #define UIP_IP_BUF   ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
 #define UIP_UDP_BUF  ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
-extern uint16_t uip_slen;
+
+#define DNS_FLAG1_RESPONSE 0x80
+#define DNS_FLAG1_RD       0x01
+
+struct dns_waiter {
+  uip_ipaddr_t addr;
+  uint16_t port;
+  uint8_t id[2];
+  uint8_t rd;
+};
+
+struct dns_pending {
+  uint8_t used;
+  /* Waiting for the A answer to synthesize the AAAA one */
+  uint8_t dns64;
+  uint8_t retransmitted;
+  uint8_t nb_waiters;
+  uint16_t id;
+  clock_time_t start;
+  clock_time_t sent;
+  struct dns_question question;
+  uint8_t question_data[DNS_MAX_QUESTION_SIZE];
+  struct dns_waiter waiters[DNS_PROXY_WAITERS];
+};
+
+static struct uip_udp_conn *server_conn;
+static struct uip_udp_conn *upstream_conn;
+static struct dns_pending pending[DNS_PROXY_PENDING];
+static struct etimer pending_timer;
+static uint8_t in_buf[DNS_CACHE_MESSAGE_SIZE];
+static uint8_t out_buf[DNS_CACHE_MESSAGE_SIZE];
+
+struct dns_proxy_stats dns_proxy_stats;
 
 PROCESS(dns_proxy_process, "DNS proxy process");
 
+/*---------------------------------------------------------------------------*/
+static int
+dns64_enabled(void)
+{
+#if DNS_CACHE_DNS64
+  return (nvm_data.global_flags & CETIC_GLOBAL_IP64) != 0;
+#else
+  return 0;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static struct dns_pending *
+pending_find(const struct dns_question *question)
+{
+  int i;
+
+  for(i = 0; i < DNS_PROXY_PENDING; i++) {
+    if(pending[i].used && dns_cache_question_equal(&pending[i].question, question)) {
+      return &pending[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static struct dns_pending *
+pending_new(const struct dns_question *question)
+{
+  struct dns_pending *p;
+  int i;
+
+  for(i = 0; i < DNS_PROXY_PENDING; i++) {
+    p = &pending[i];
+    if(!p->used) {
+      memcpy(p->question_data, question->data, question->len);
+      p->question = *question;
+      p->question.data = p->question_data;
+      p->used = 1;
+      p->dns64 = 0;
+      p->retransmitted = 0;
+      p->nb_waiters = 0;
+      p->start = clock_time();
+      return p;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+pending_add_waiter(struct dns_pending *p, const uint8_t *query)
+{
+  struct dns_waiter *w;
+
+  if(p->nb_waiters == DNS_PROXY_WAITERS) {
+    return 0;
+  }
+  w = &p->waiters[p->nb_waiters++];
+  uip_ipaddr_copy(&w->addr, &UIP_IP_BUF->srcipaddr);
+  w->port = UIP_UDP_BUF->srcport;
+  w->id[0] = query[0];
+  w->id[1] = query[1];
+  w->rd = query[2] & DNS_FLAG1_RD;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 static void
-tcpip_handler(void)
+upstream_send(struct dns_pending *p)
 {
-  if(uip_newdata()) {
-    uip_ipaddr_t * nameserver = uip_nameserver_get(0);
-    if(!uip_is_addr_unspecified(nameserver)) {
-      LOG6LBR_6ADDR(DEBUG, &UIP_IP_BUF->srcipaddr, "Forwarding DNS request from ");
-      uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, nameserver);
-      uip_slen = uip_len;
-      uip_len = uip_slen + UIP_IPUDPH_LEN;
-      UIP_UDP_BUF->udpchksum = 0;
-  #if UIP_UDP_CHECKSUMS
-      /* Calculate UDP checksum. */
-      UIP_UDP_BUF->udpchksum = ~(uip_udpchksum());
-      if(UIP_UDP_BUF->udpchksum == 0) {
-        UIP_UDP_BUF->udpchksum = 0xffff;
-      }
-  #endif /* UIP_UDP_CHECKSUMS */
-      uip_flags = 0;
-      tcpip_ipv6_output();
-      uip_slen = 0;
+  int len;
+
+  /* A fresh query, the options of the clients are not relayed */
+  memset(out_buf, 0, DNS_HEADER_SIZE);
+  out_buf[0] = p->id >> 8;
+  out_buf[1] = p->id & 0xff;
+  out_buf[2] = DNS_FLAG1_RD;
+  out_buf[5] = 1;
+  memcpy(out_buf + DNS_HEADER_SIZE, p->question.data, p->question.len);
+  len = DNS_HEADER_SIZE + p->question.len;
+  if(p->dns64) {
+    out_buf[len - 4] = 0;
+    out_buf[len - 3] = DNS_TYPE_A;
+  }
+  uip_udp_packet_sendto(upstream_conn, out_buf, len, uip_nameserver_get(0), UIP_HTONS(DNS_PORT));
+  p->sent = clock_time();
+  dns_proxy_stats.upstream_queries++;
+  if(etimer_expired(&pending_timer)) {
+    etimer_set(&pending_timer, CLOCK_SECOND / 2);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+pending_answer(struct dns_pending *p, uint8_t *response, int len)
+{
+  struct dns_waiter *w;
+  int i;
+
+  for(i = 0; i < p->nb_waiters; i++) {
+    w = &p->waiters[i];
+    response[0] = w->id[0];
+    response[1] = w->id[1];
+    response[2] = (response[2] & ~DNS_FLAG1_RD) | w->rd;
+    uip_udp_packet_sendto(server_conn, response, len, &w->addr, w->port);
+  }
+  p->used = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+pending_periodic(void)
+{
+  struct dns_pending *p;
+  int active;
+  int i;
+
+  active = 0;
+  for(i = 0; i < DNS_PROXY_PENDING; i++) {
+    p = &pending[i];
+    if(!p->used) {
+      continue;
+    }
+    if(clock_time() - p->start >= DNS_PROXY_TIMEOUT) {
+      LOG6LBR_DEBUG("No answer from name server, %d queries dropped\n", p->nb_waiters);
+      dns_proxy_stats.timeouts++;
+      p->used = 0;
+      continue;
+    }
+    if(!p->retransmitted && clock_time() - p->sent >= DNS_PROXY_RETRANSMIT &&
+       !uip_is_addr_unspecified(uip_nameserver_get(0))) {
+      p->retransmitted = 1;
+      upstream_send(p);
+    }
+    active = 1;
+  }
+  if(active) {
+    etimer_reset(&pending_timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+query_input(void)
+{
+  struct dns_question question;
+  struct dns_pending *p;
+  int len;
+
+  dns_proxy_stats.queries++;
+  len = uip_datalen();
+  if(len > sizeof(in_buf)) {
+    dns_proxy_stats.dropped++;
+    return;
+  }
+  memcpy(in_buf, uip_appdata, len);
+  if((in_buf[2] & DNS_FLAG1_RESPONSE) != 0 || !dns_cache_parse(in_buf, len, &question)) {
+    LOG6LBR_6ADDR(DEBUG, &UIP_IP_BUF->srcipaddr, "Unsupported DNS request dropped from ");
+    dns_proxy_stats.dropped++;
+    return;
+  }
+
+  len = dns_cache_lookup(in_buf, &question, out_buf, sizeof(out_buf));
+  if(len > 0) {
+    LOG6LBR_6ADDR(DEBUG, &UIP_IP_BUF->srcipaddr, "Cached DNS answer sent to ");
+    uip_udp_packet_sendto(server_conn, out_buf, len, &UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport);
+    return;
+  }
+
+  p = pending_find(&question);
+  if(p != NULL) {
+    /* Same query already sent upstream */
+    if(pending_add_waiter(p, in_buf)) {
+      dns_proxy_stats.coalesced++;
     } else {
-      LOG6LBR_DEBUG( "DNS request dropped, not name server configured\n");
+      dns_proxy_stats.dropped++;
     }
+    return;
+  }
+
+  if(uip_is_addr_unspecified(uip_nameserver_get(0))) {
+    LOG6LBR_DEBUG("DNS request dropped, not name server configured\n");
+    dns_proxy_stats.dropped++;
+    return;
   }
+  p = pending_new(&question);
+  if(p == NULL) {
+    LOG6LBR_DEBUG("DNS request dropped, too many pending requests\n");
+    dns_proxy_stats.dropped++;
+    return;
+  }
+  LOG6LBR_6ADDR(DEBUG, &UIP_IP_BUF->srcipaddr, "Forwarding DNS request from ");
+  pending_add_waiter(p, in_buf);
+  p->id = random_rand();
+  upstream_send(p);
 }
+/*---------------------------------------------------------------------------*/
+static void
+response_input(void)
+{
+  struct dns_question question;
+  struct dns_pending *p;
+  clock_time_t latency;
+  uint8_t *response;
+  uint16_t id;
+  int len;
+  int i;
+
+  len = uip_datalen();
+  if(len > sizeof(in_buf) || !uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, uip_nameserver_get(0))) {
+    dns_proxy_stats.dropped++;
+    return;
+  }
+  memcpy(in_buf, uip_appdata, len);
+  if(!dns_cache_parse(in_buf, len, &question)) {
+    dns_proxy_stats.dropped++;
+    return;
+  }
+  id = (in_buf[0] << 8) | in_buf[1];
+  for(i = 0; i < DNS_PROXY_PENDING; i++) {
+    p = &pending[i];
+    if(p->used && p->id == id && dns_cache_name_equal(&p->question, &question) &&
+       question.type == (p->dns64 ? DNS_TYPE_A : p->question.type)) {
+      break;
+    }
+  }
+  if(i == DNS_PROXY_PENDING) {
+    /* Late answer to a query that timed out, or spoofing attempt */
+    dns_proxy_stats.dropped++;
+    return;
+  }
+  dns_proxy_stats.upstream_answers++;
 
+  if(!p->dns64 && dns64_enabled() && dns_cache_is_aaaa_nodata(in_buf, len)) {
+    /* Ask for the IPv4 addresses, the pending query keeps its waiters */
+    p->dns64 = 1;
+    p->retransmitted = 0;
+    p->id = random_rand();
+    upstream_send(p);
+    return;
+  }
+
+  latency = clock_time() - p->start;
+  dns_proxy_stats.resolved++;
+  dns_proxy_stats.latency_total += latency * 1000 / CLOCK_SECOND;
+  if(latency * 1000 / CLOCK_SECOND > dns_proxy_stats.latency_max) {
+    dns_proxy_stats.latency_max = latency * 1000 / CLOCK_SECOND;
+  }
+
+  if(p->dns64) {
+    len = dns_cache_dns64(&p->question, in_buf, len, out_buf, sizeof(out_buf));
+    if(len == 0) {
+      LOG6LBR_DEBUG("DNS64 answer too large, %d queries dropped\n", p->nb_waiters);
+      dns_proxy_stats.dropped += p->nb_waiters;
+      p->used = 0;
+      return;
+    }
+    dns_proxy_stats.dns64++;
+    response = out_buf;
+  } else {
+    response = in_buf;
+  }
+  dns_cache_store(&p->question, response, len);
+  pending_answer(p, response, len);
+}
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(dns_proxy_process, ev, data)
 {
   PROCESS_BEGIN();
   LOG6LBR_INFO("DNS proxy started\n");
 
+  dns_cache_init();
   server_conn = udp_new(NULL, 0, NULL);
-  udp_bind(server_conn, UIP_HTONS(53));
+  udp_bind(server_conn, UIP_HTONS(DNS_PORT));
+  upstream_conn = udp_new(NULL, UIP_HTONS(DNS_PORT), NULL);
 
   while(1) {
     PROCESS_YIELD();
-    if(ev == tcpip_event) {
-      tcpip_handler();
+    if(ev == tcpip_event && uip_newdata()) {
+      if(uip_udp_conn == server_conn) {
+        query_input();
+      } else if(uip_udp_conn == upstream_conn) {
+        response_input();
+      }
+    } else if(ev == PROCESS_EVENT_TIMER && data == &pending_timer) {
+      pending_periodic();
     }
   }
 
   PROCESS_END();
 }
-
-void dns_proxy_init(void)
+/*---------------------------------------------------------------------------*/
+void
+dns_proxy_init(void)
 {
   if((nvm_data.global_flags & CETIC_GLOBAL_DISABLE_DNS_PROXY) == 0) {
     process_start(&dns_proxy_process, NULL);
   }
 }
+/*---------------------------------------------------------------------------*/
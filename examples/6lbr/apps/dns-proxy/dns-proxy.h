@@ -29,7 +29,7 @@
 
 /**
  * \file
- *         6LBR NVM configuration proxy
+ *         6LBR caching DNS proxy
  * \author
  *         6LBR Team <6lbr@cetic.be>
  */
@@ -37,6 +37,53 @@
 #ifndef DNS_PROXY_H
 #define DNS_PROXY_H
 
+#include "contiki.h"
+
+/* Number of distinct queries waiting for the upstream name server */
+#ifdef DNS_PROXY_CONF_PENDING
+#define DNS_PROXY_PENDING DNS_PROXY_CONF_PENDING
+#else
+#define DNS_PROXY_PENDING 4
+#endif
+
+/* Number of clients waiting for the same answer */
+#ifdef DNS_PROXY_CONF_WAITERS
+#define DNS_PROXY_WAITERS DNS_PROXY_CONF_WAITERS
+#else
+#define DNS_PROXY_WAITERS 4
+#endif
+
+/* The upstream query is sent again once after this delay */
+#ifdef DNS_PROXY_CONF_RETRANSMIT
+#define DNS_PROXY_RETRANSMIT DNS_PROXY_CONF_RETRANSMIT
+#else
+#define DNS_PROXY_RETRANSMIT (2 * CLOCK_SECOND)
+#endif
+
+/* The waiting clients are forgotten after this delay */
+#ifdef DNS_PROXY_CONF_TIMEOUT
+#define DNS_PROXY_TIMEOUT DNS_PROXY_CONF_TIMEOUT
+#else
+#define DNS_PROXY_TIMEOUT (5 * CLOCK_SECOND)
+#endif
+
+struct dns_proxy_stats {
+  uint32_t queries;
+  uint32_t coalesced;
+  uint32_t dropped;
+  uint32_t upstream_queries;
+  uint32_t upstream_answers;
+  uint32_t timeouts;
+  uint32_t dns64;
+  /* Queries resolved upstream, and the time between the first query and
+     the upstream answer, in ms */
+  uint32_t resolved;
+  uint32_t latency_total;
+  uint32_t latency_max;
+};
+
+extern struct dns_proxy_stats dns_proxy_stats;
+
 void dns_proxy_init(void);
 
-#endif /* NVM_PROXY_H */
+#endif /* DNS_PROXY_H */
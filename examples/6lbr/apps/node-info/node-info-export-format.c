@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Node info export file format
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "node-info-export-format.h"
+
+#include <string.h>
+
+/*---------------------------------------------------------------------------*/
+static void
+put_u16(uint8_t *buf, uint16_t value)
+{
+  buf[0] = value;
+  buf[1] = value >> 8;
+}
+/*---------------------------------------------------------------------------*/
+static void
+put_u32(uint8_t *buf, uint32_t value)
+{
+  put_u16(buf, value);
+  put_u16(buf + 2, value >> 16);
+}
+/*---------------------------------------------------------------------------*/
+static void
+put_u64(uint8_t *buf, uint64_t value)
+{
+  put_u32(buf, value);
+  put_u32(buf + 4, value >> 32);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+get_u16(uint8_t const *buf)
+{
+  return buf[0] | (buf[1] << 8);
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+get_u32(uint8_t const *buf)
+{
+  return get_u16(buf) | ((uint32_t)get_u16(buf + 2) << 16);
+}
+/*---------------------------------------------------------------------------*/
+static uint64_t
+get_u64(uint8_t const *buf)
+{
+  return get_u32(buf) | ((uint64_t)get_u32(buf + 4) << 32);
+}
+/*---------------------------------------------------------------------------*/
+void
+node_info_export_write_file_header(uint8_t *buf)
+{
+  memcpy(buf, NODE_INFO_EXPORT_FILE_MAGIC, 8);
+  put_u16(buf + 8, NODE_INFO_EXPORT_FILE_VERSION);
+  put_u16(buf + 10, NODE_INFO_EXPORT_RECORD_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+int
+node_info_export_read_file_header(uint8_t const *buf)
+{
+  int record_size;
+  if(memcmp(buf, NODE_INFO_EXPORT_FILE_MAGIC, 8) != 0 ||
+     get_u16(buf + 8) != NODE_INFO_EXPORT_FILE_VERSION) {
+    return -1;
+  }
+  record_size = get_u16(buf + 10);
+  /* Newer records may only append fields */
+  return record_size >= NODE_INFO_EXPORT_RECORD_SIZE ? record_size : -1;
+}
+/*---------------------------------------------------------------------------*/
+void
+node_info_export_write_batch_header(uint8_t *buf, uint32_t count, uint64_t time)
+{
+  put_u32(buf, NODE_INFO_EXPORT_BATCH_MAGIC);
+  put_u32(buf + 4, count);
+  put_u64(buf + 8, time);
+}
+/*---------------------------------------------------------------------------*/
+int
+node_info_export_read_batch_header(uint8_t const *buf, uint32_t *count, uint64_t *time)
+{
+  if(get_u32(buf) != NODE_INFO_EXPORT_BATCH_MAGIC) {
+    return -1;
+  }
+  *count = get_u32(buf + 4);
+  *time = get_u64(buf + 8);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+node_info_export_write_record(uint8_t *buf, node_info_export_record_t const *record)
+{
+  put_u64(buf, record->timestamp);
+  memcpy(buf + 8, record->ipaddr, 16);
+  memcpy(buf + 24, record->ip_parent, 16);
+  put_u32(buf + 40, record->flags);
+  put_u32(buf + 44, record->messages_received);
+  put_u32(buf + 48, record->messages_sent);
+  put_u32(buf + 52, record->up_messages_lost);
+  put_u32(buf + 56, record->down_messages_lost);
+  put_u32(buf + 60, record->stats_age);
+  put_u32(buf + 64, record->last_seen_age);
+  put_u16(buf + 68, record->parent_switch);
+  buf[70] = record->hop_count;
+  buf[71] = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+node_info_export_read_record(uint8_t const *buf, node_info_export_record_t *record)
+{
+  record->timestamp = get_u64(buf);
+  memcpy(record->ipaddr, buf + 8, 16);
+  memcpy(record->ip_parent, buf + 24, 16);
+  record->flags = get_u32(buf + 40);
+  record->messages_received = get_u32(buf + 44);
+  record->messages_sent = get_u32(buf + 48);
+  record->up_messages_lost = get_u32(buf + 52);
+  record->down_messages_lost = get_u32(buf + 56);
+  record->stats_age = get_u32(buf + 60);
+  record->last_seen_age = get_u32(buf + 64);
+  record->parent_switch = get_u16(buf + 68);
+  record->hop_count = buf[70];
+}
+/*---------------------------------------------------------------------------*/
+int
+node_info_export_print_ipaddr(char *buffer, uint8_t const *addr)
+{
+  uint16_t a;
+  unsigned int i;
+  int f;
+  char * p = buffer;
+
+  for(i = 0, f = 0; i < 16; i += 2) {
+    a = (addr[i] << 8) + addr[i + 1];
+    if(a == 0 && f >= 0) {
+      if(f++ == 0) {
+        p += sprintf(p, "::");
+      }
+    } else {
+      if(f > 0) {
+        f = -1;
+      } else if(i > 0) {
+        p += sprintf(p, ":");
+      }
+      p += sprintf(p, "%04x", a);
+    }
+  }
+  return p - buffer;
+}
+/*---------------------------------------------------------------------------*/
+static char const *
+flags_text(uint32_t flags)
+{
+  if((flags & NODE_INFO_EXPORT_FLAG_REJECTED) != 0) {
+    return "REJECTED";
+  } else if((flags & NODE_INFO_EXPORT_FLAG_HAS_ROUTE) != 0) {
+    return "OK";
+  } else {
+    return "NR";
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+node_info_export_print_csv_header(FILE *stream, int timestamp)
+{
+  fprintf(stream, "%sip\tparent\tsend\tup_lost\tdown_lost\tparent_switch\thop_count\tstart_time\tlast_seen\tstatus\n",
+          timestamp ? "timestamp\t" : "");
+}
+/*---------------------------------------------------------------------------*/
+void
+node_info_export_print_csv(FILE *stream, node_info_export_record_t const *record, int timestamp)
+{
+  /* Large enough for two addresses */
+  char addr[2 * 40 + 2];
+  int len;
+
+  if(timestamp) {
+    fprintf(stream, "%lu\t", (unsigned long)record->timestamp);
+  }
+  len = node_info_export_print_ipaddr(addr, record->ipaddr);
+  addr[len++] = '\t';
+  node_info_export_print_ipaddr(addr + len, record->ip_parent);
+  fputs(addr, stream);
+
+  if(record->messages_received > 0) {
+    fprintf(stream, "\t%u\t%u\t%u", record->messages_sent, record->up_messages_lost, record->down_messages_lost);
+    fprintf(stream, "\t%u", record->parent_switch);
+    fprintf(stream, "\t%u", record->hop_count);
+  } else {
+    fprintf(stream, "\t\t\t\t\t");
+  }
+  fprintf(stream, "\t%lu", (unsigned long)record->stats_age);
+  fprintf(stream, "\t%lu", (unsigned long)record->last_seen_age);
+  fprintf(stream, "\t%s", flags_text(record->flags));
+  fprintf(stream, "\n");
+}
+/*---------------------------------------------------------------------------*/
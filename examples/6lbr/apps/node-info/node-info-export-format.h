@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Node info export file format
+ *
+ *         The binary export is a single append-only file: a file header
+ *         followed by batches, each batch holding a header and the records
+ *         of all the nodes known at the time of the snapshot. All the fields
+ *         are stored in little-endian order.
+ *
+ *         This module does not depend on Contiki so that it can be shared
+ *         with the reader tool.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#ifndef NODE_INFO_EXPORT_FORMAT_H
+#define NODE_INFO_EXPORT_FORMAT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define NODE_INFO_EXPORT_FILE_MAGIC "6LBRNODE"
+#define NODE_INFO_EXPORT_FILE_VERSION 1
+
+/* Magic (8 bytes), version (2 bytes), record size (2 bytes) */
+#define NODE_INFO_EXPORT_FILE_HEADER_SIZE 12
+
+/* Magic (4 bytes), record count (4 bytes), wall clock time in ms (8 bytes) */
+#define NODE_INFO_EXPORT_BATCH_MAGIC 0x4e424c36UL
+#define NODE_INFO_EXPORT_BATCH_HEADER_SIZE 16
+
+#define NODE_INFO_EXPORT_RECORD_SIZE 72
+
+/* Same values as the node info flags */
+#define NODE_INFO_EXPORT_FLAG_HAS_ROUTE 1
+#define NODE_INFO_EXPORT_FLAG_REJECTED 0x10
+
+/* Snapshot of a node info entry */
+typedef struct node_info_export_record {
+  /* clock_time() when the snapshot was taken */
+  uint64_t timestamp;
+  uint8_t ipaddr[16];
+  uint8_t ip_parent[16];
+  uint32_t flags;
+  uint32_t messages_received;
+  uint32_t messages_sent;
+  uint32_t up_messages_lost;
+  uint32_t down_messages_lost;
+  /* Age of the statistics and of the last packet seen, in seconds */
+  uint32_t stats_age;
+  uint32_t last_seen_age;
+  uint16_t parent_switch;
+  uint8_t hop_count;
+} node_info_export_record_t;
+
+void
+node_info_export_write_file_header(uint8_t *buf);
+
+/* Returns the record size, or -1 if the header is invalid */
+int
+node_info_export_read_file_header(uint8_t const *buf);
+
+void
+node_info_export_write_batch_header(uint8_t *buf, uint32_t count, uint64_t time);
+
+/* Returns 0 on success, -1 if the header is invalid */
+int
+node_info_export_read_batch_header(uint8_t const *buf, uint32_t *count, uint64_t *time);
+
+void
+node_info_export_write_record(uint8_t *buf, node_info_export_record_t const *record);
+
+void
+node_info_export_read_record(uint8_t const *buf, node_info_export_record_t *record);
+
+/* Header line of the CSV files, with or without a timestamp column */
+void
+node_info_export_print_csv_header(FILE *stream, int timestamp);
+
+/* Prints a record in the CSV layout used by the legacy export */
+void
+node_info_export_print_csv(FILE *stream, node_info_export_record_t const *record, int timestamp);
+
+/* Prints an address as in the legacy export, returns the number of chars */
+int
+node_info_export_print_ipaddr(char *buffer, uint8_t const *addr);
+
+#endif
@@ -34,6 +34,7 @@
 #define LOG6LBR_MODULE "NODE"
 
 #include <errno.h>
+#include <limits.h>
 
 #include "contiki.h"
 #include "log-6lbr.h"
@@ -41,16 +42,61 @@
 #include "native-config-file.h"
 #include "node-info.h"
 #include "node-info-export.h"
+#include "node-info-export-format.h"
 #include <unistd.h>
 #include "string.h"
 #include "stdlib.h"
 #include <sys/stat.h>
+#include <sys/time.h>
+#if NODE_INFO_EXPORT_THREAD
+#include <pthread.h>
+#endif
 
 int node_info_export_interval = 5;
 char * node_info_export_file_name = NULL;
 char * node_info_export_path = NULL;
+char * node_info_export_binary_file_name = NULL;
 int node_info_export_enable = 0;
 int node_info_export_global = 0;
+int node_info_export_format = NODE_INFO_EXPORT_FORMAT_CSV;
+uint32_t node_info_export_batches = 0;
+uint32_t node_info_export_dropped = 0;
+
+/*
+ * The export process only takes a snapshot of the node info table in a ring
+ * of records, the files are written by a separate writer thread, or right
+ * after the snapshot when threads are not available.
+ */
+typedef struct {
+  uint32_t start;
+  uint32_t count;
+  uint64_t time;
+  int format;
+  int global;
+  char target[PATH_MAX];
+} export_batch_t;
+
+#define NODE_INFO_EXPORT_MAX_BATCHES 8
+
+static node_info_export_record_t ring[NODE_INFO_EXPORT_RING_SIZE];
+static uint32_t ring_start;
+static uint32_t ring_used;
+static export_batch_t batches[NODE_INFO_EXPORT_MAX_BATCHES];
+static int batch_head;
+static int batch_count;
+
+#if NODE_INFO_EXPORT_THREAD
+static pthread_t writer;
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_cond = PTHREAD_COND_INITIALIZER;
+#define WRITER_LOCK() pthread_mutex_lock(&writer_mutex)
+#define WRITER_UNLOCK() pthread_mutex_unlock(&writer_mutex)
+#define WRITER_SIGNAL() pthread_cond_signal(&writer_cond)
+#else
+#define WRITER_LOCK()
+#define WRITER_UNLOCK()
+#define WRITER_SIGNAL()
+#endif
 
 static native_config_callback_t node_info_export_config_cb;
 
@@ -102,96 +148,141 @@ node_info_export_config_handler(config_level_t level, void* user, const char* se
     node_info_export_global = atoi(value);
     return 1;
   }
+  if(strcmp(name, "format") == 0) {
+    if(strcmp(value, "csv") == 0) {
+      node_info_export_format = NODE_INFO_EXPORT_FORMAT_CSV;
+    } else if(strcmp(value, "binary") == 0) {
+      node_info_export_format = NODE_INFO_EXPORT_FORMAT_BINARY;
+    } else {
+      return 0;
+    }
+    return 1;
+  }
+  if(strcmp(name, "binary_file") == 0) {
+    free(node_info_export_binary_file_name);
+    node_info_export_binary_file_name = strdup(value);
+    return 1;
+  }
   return 0;
 }
 /*---------------------------------------------------------------------------*/
 static void
-add_ipaddr(FILE* stream, const uip_ipaddr_t *addr)
+take_snapshot(void)
 {
-  uint16_t a;
-  unsigned int i;
-  int f;
+  export_batch_t *batch;
+  node_info_export_record_t *record;
+  node_info_t *node;
+  clock_time_t now;
+  struct timeval tv;
+  int count;
+  int i;
+  int n;
 
-  for(i = 0, f = 0; i < sizeof(uip_ipaddr_t); i += 2) {
-    a = (addr->u8[i] << 8) + addr->u8[i + 1];
-    if(a == 0 && f >= 0) {
-      if(f++ == 0) {
-        fprintf(stream, "::");
-      }
-    } else {
-      if(f > 0) {
-        f = -1;
-      } else if(i > 0) {
-        fprintf(stream, ":");
-      }
-      fprintf(stream, "%04x", a);
-    }
+  count = node_info_count();
+  WRITER_LOCK();
+  if(batch_count == NODE_INFO_EXPORT_MAX_BATCHES || NODE_INFO_EXPORT_RING_SIZE - ring_used < count) {
+    WRITER_UNLOCK();
+    node_info_export_dropped++;
+    LOG6LBR_WARN("Export queue full, snapshot dropped\n");
+    return;
   }
-}
-/*---------------------------------------------------------------------------*/
-static char *
-add_ipaddr_str(char *buffer, const uip_ipaddr_t *addr)
-{
-  uint16_t a;
-  unsigned int i;
-  int f;
-  char * p = buffer;
+  batch = &batches[(batch_head + batch_count) % NODE_INFO_EXPORT_MAX_BATCHES];
+  batch->start = (ring_start + ring_used) % NODE_INFO_EXPORT_RING_SIZE;
+  WRITER_UNLOCK();
 
-  for(i = 0, f = 0; i < sizeof(uip_ipaddr_t); i += 2) {
-    a = (addr->u8[i] << 8) + addr->u8[i + 1];
-    if(a == 0 && f >= 0) {
-      if(f++ == 0) {
-        p += sprintf(p, "::");
-      }
-    } else {
-      if(f > 0) {
-        f = -1;
-      } else if(i > 0) {
-        p += sprintf(p, ":");
-      }
-      p += sprintf(p, "%04x", a);
+  /* The reserved batch and ring slots are not visible to the writer until
+   * the batch is committed */
+  gettimeofday(&tv, NULL);
+  batch->time = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+  batch->format = node_info_export_format;
+  batch->global = node_info_export_global;
+  strncpy(batch->target, node_info_export_format == NODE_INFO_EXPORT_FORMAT_BINARY ? node_info_export_binary_file_name :
+          node_info_export_global ? node_info_export_file_name : node_info_export_path, sizeof(batch->target) - 1);
+  batch->target[sizeof(batch->target) - 1] = '\0';
+  now = clock_time();
+  n = 0;
+  for(i = 0; i < UIP_DS6_ROUTE_NB && n < count; i++) {
+    node = node_info_get(i);
+    if(node == NULL) {
+      continue;
     }
+    record = &ring[(batch->start + n) % NODE_INFO_EXPORT_RING_SIZE];
+    record->timestamp = now;
+    memcpy(record->ipaddr, &node->ipaddr, sizeof(record->ipaddr));
+    memcpy(record->ip_parent, &node->ip_parent, sizeof(record->ip_parent));
+    record->flags = node->flags;
+    record->messages_received = node->messages_received;
+    record->messages_sent = node->messages_sent;
+    record->up_messages_lost = node->up_messages_lost;
+    record->down_messages_lost = node->down_messages_lost;
+    record->stats_age = (now - node->stats_start) / CLOCK_SECOND;
+    record->last_seen_age = (now - node->last_seen) / CLOCK_SECOND;
+    record->parent_switch = node->parent_switch;
+    record->hop_count = node->hop_count;
+    n++;
   }
-  return p;
+  batch->count = n;
+
+  WRITER_LOCK();
+  ring_used += n;
+  batch_count++;
+  WRITER_SIGNAL();
+  WRITER_UNLOCK();
 }
 /*---------------------------------------------------------------------------*/
 static void
-dump_info_node(FILE* stream, int node_index, int timestamp)
+write_binary(export_batch_t *batch)
 {
-  if(timestamp) {
-    fprintf(stream, "%lu\t", clock_time());
-  }
-  add_ipaddr(stream, &node_info_table[node_index].ipaddr);
-  fprintf(stream, "\t");
-  add_ipaddr(stream, &node_info_table[node_index].ip_parent);
+  static FILE *stream = NULL;
+  static char stream_name[sizeof(batch->target)];
+  uint8_t buf[NODE_INFO_EXPORT_BATCH_HEADER_SIZE > NODE_INFO_EXPORT_FILE_HEADER_SIZE ?
+              NODE_INFO_EXPORT_BATCH_HEADER_SIZE : NODE_INFO_EXPORT_FILE_HEADER_SIZE];
+  uint8_t record_buf[NODE_INFO_EXPORT_RECORD_SIZE];
+  uint32_t i;
 
-  if(node_info_table[node_index].messages_received > 0) {
-    fprintf(stream, "\t%d\t%d\t%d", node_info_table[node_index].messages_sent, node_info_table[node_index].up_messages_lost, node_info_table[node_index].down_messages_lost);
-    fprintf(stream, "\t%d", node_info_table[node_index].parent_switch);
-    fprintf(stream, "\t%d", node_info_table[node_index].hop_count);
-  } else {
-    fprintf(stream, "\t\t\t\t\t");
+  /* The file is kept open between batches */
+  if(stream != NULL && strcmp(stream_name, batch->target) != 0) {
+    fclose(stream);
+    stream = NULL;
+  }
+  if(stream == NULL) {
+    LOG6LBR_DEBUG("Opening export file %s\n", batch->target);
+    stream = fopen(batch->target, "ab");
+    if(stream == NULL) {
+      LOG6LBR_ERROR("Can not open file : %s\n", strerror(errno));
+      return;
+    }
+    strcpy(stream_name, batch->target);
+    if(ftell(stream) == 0) {
+      node_info_export_write_file_header(buf);
+      fwrite(buf, NODE_INFO_EXPORT_FILE_HEADER_SIZE, 1, stream);
+    }
+  }
+  node_info_export_write_batch_header(buf, batch->count, batch->time);
+  fwrite(buf, NODE_INFO_EXPORT_BATCH_HEADER_SIZE, 1, stream);
+  for(i = 0; i < batch->count; i++) {
+    node_info_export_write_record(record_buf, &ring[(batch->start + i) % NODE_INFO_EXPORT_RING_SIZE]);
+    fwrite(record_buf, NODE_INFO_EXPORT_RECORD_SIZE, 1, stream);
+  }
+  if(fflush(stream) != 0) {
+    LOG6LBR_ERROR("Can not write export file : %s\n", strerror(errno));
+    fclose(stream);
+    stream = NULL;
   }
-  fprintf(stream, "\t%lu", (clock_time() - node_info_table[node_index].stats_start) / CLOCK_SECOND);
-  fprintf(stream, "\t%lu", (clock_time() - node_info_table[node_index].last_seen) / CLOCK_SECOND);
-  fprintf(stream, "\t%s", node_info_flags_text(node_info_table[node_index].flags));
-  fprintf(stream, "\n");
 }
 /*---------------------------------------------------------------------------*/
 static void
-dump_info_global(char const * file)
+write_csv_global(export_batch_t *batch)
 {
   FILE* stream;
-  LOG6LBR_DEBUG("Dumping info to %s\n", file);
-  stream = fopen(file, "a");
+  uint32_t i;
+
+  LOG6LBR_DEBUG("Dumping info to %s\n", batch->target);
+  stream = fopen(batch->target, "a");
   if(stream != NULL) {
-    int i;
-    fprintf(stream, "ip\tparent\tsend\tup_lost\tdown_lost\tparent_switch\thop_count\tstart_time\tlast_seen\tstatus\n");
-    for(i = 0; i < UIP_DS6_ROUTE_NB; i++) {
-      if(!node_info_table[i].isused) {
-        continue;
-      }
-      dump_info_node(stream, i, 0);
+    node_info_export_print_csv_header(stream, 0);
+    for(i = 0; i < batch->count; i++) {
+      node_info_export_print_csv(stream, &ring[(batch->start + i) % NODE_INFO_EXPORT_RING_SIZE], 0);
     }
     fclose(stream);
   } else {
@@ -200,44 +291,95 @@ dump_info_global(char const * file)
 }
 /*---------------------------------------------------------------------------*/
 static void
-dump_info_per_node(char const * path)
+write_csv_per_node(export_batch_t *batch)
 {
-  int i;
-  int len = strlen(path);
+  /* '/' + :XXXX times 8 + '.csv' */
+  char full_path[sizeof(batch->target) + 8*5 + 4 + 1];
+  node_info_export_record_t *record;
+  int len = strlen(batch->target);
+  int existing_file;
+  FILE* stream;
+  uint32_t i;
+
   LOG6LBR_DEBUG("Dump info per node\n");
-  if(access(path, X_OK) < 0) {
-    if(mkdir(path, 0755) < 0) {
-      LOG6LBR_ERROR("Can not create path '%s': %s\n", path, strerror(errno));
+  if(access(batch->target, X_OK) < 0) {
+    if(mkdir(batch->target, 0755) < 0) {
+      LOG6LBR_ERROR("Can not create path '%s': %s\n", batch->target, strerror(errno));
       return;
     }
   }
-  for(i = 0; i < UIP_DS6_ROUTE_NB; i++) {
-    if(!node_info_table[i].isused) {
-      continue;
-    }
-    char *full_path = (char *)malloc(len + 8*5 + 4 + 1);  // '/' + :XXXX times 8 + '.csv'
-    char *p;
-    int existing_file;
-    strcpy(full_path, path);
-    full_path[len] = '/';
-    p = add_ipaddr_str(full_path + len + 1, &node_info_table[i].ipaddr);
-    strcpy(p, ".csv");
+  strcpy(full_path, batch->target);
+  full_path[len] = '/';
+  for(i = 0; i < batch->count; i++) {
+    record = &ring[(batch->start + i) % NODE_INFO_EXPORT_RING_SIZE];
+    strcpy(full_path + len + 1 + node_info_export_print_ipaddr(full_path + len + 1, record->ipaddr), ".csv");
     LOG6LBR_DEBUG("Dumping info to %s\n", full_path);
     existing_file = access(full_path, W_OK) == 0;
-    FILE* stream = fopen(full_path, "a");
+    stream = fopen(full_path, "a");
     if(stream != NULL) {
       if(!existing_file) {
-        fprintf(stream, "timestamp\tip\tparent\tsend\tup_lost\tdown_lost\tparent_switch\thop_count\tstart_time\tlast_seen\tstatus\n");
+        node_info_export_print_csv_header(stream, 1);
       }
-      dump_info_node(stream, i, 1);
+      node_info_export_print_csv(stream, record, 1);
       fclose(stream);
     } else {
       LOG6LBR_ERROR("Can not open file : %s\n", strerror(errno));
     }
-    free(full_path);
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Writes the oldest committed batch and releases it */
+static void
+write_batch(void)
+{
+  export_batch_t *batch = &batches[batch_head];
+
+  if(batch->format == NODE_INFO_EXPORT_FORMAT_BINARY) {
+    write_binary(batch);
+  } else if(batch->global) {
+    write_csv_global(batch);
+  } else {
+    write_csv_per_node(batch);
+  }
+
+  WRITER_LOCK();
+  ring_start = (ring_start + batch->count) % NODE_INFO_EXPORT_RING_SIZE;
+  ring_used -= batch->count;
+  batch_head = (batch_head + 1) % NODE_INFO_EXPORT_MAX_BATCHES;
+  batch_count--;
+  node_info_export_batches++;
+  WRITER_UNLOCK();
+}
+/*---------------------------------------------------------------------------*/
+#if NODE_INFO_EXPORT_THREAD
+static void *
+writer_thread(void *arg)
+{
+  while(1) {
+    pthread_mutex_lock(&writer_mutex);
+    while(batch_count == 0) {
+      pthread_cond_wait(&writer_cond, &writer_mutex);
+    }
+    pthread_mutex_unlock(&writer_mutex);
+    write_batch();
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+start_writer(void)
+{
+  static int started = 0;
+  if(!started) {
+    if(pthread_create(&writer, NULL, writer_thread, NULL) != 0) {
+      LOG6LBR_FATAL("Can not start node info export writer : %s\n", strerror(errno));
+      exit(1);
+    }
+    started = 1;
+  }
+}
+#endif
+/*---------------------------------------------------------------------------*/
 void
 node_info_export_set_interval(int interval)
 {
@@ -259,6 +401,13 @@ node_info_export_set_global(int global)
   process_poll(&node_info_export_process);
 }
 /*---------------------------------------------------------------------------*/
+void
+node_info_export_set_format(int format)
+{
+  node_info_export_format = format;
+  process_poll(&node_info_export_process);
+}
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(node_info_export_process, ev, data)
 {
   static struct etimer et;
@@ -271,11 +420,12 @@ PROCESS_THREAD(node_info_export_process, ev, data)
   while(1) {
     PROCESS_YIELD();
     if(node_info_export_enable && etimer_expired(&et)) {
-      if(node_info_export_global) {
-        dump_info_global(node_info_export_file_name);
-      } else {
-        dump_info_per_node(node_info_export_path);
+      take_snapshot();
+#if !NODE_INFO_EXPORT_THREAD
+      while(batch_count > 0) {
+        write_batch();
       }
+#endif
       etimer_set(&et, node_info_export_interval * CLOCK_SECOND);
     } else if(ev == PROCESS_EVENT_POLL) {
       if(node_info_export_enable) {
@@ -294,12 +444,16 @@ node_info_export_config(void)
 {
   node_info_export_file_name = strdup("/tmp/node-info.csv");
   node_info_export_path = strdup("/tmp/node-info");
+  node_info_export_binary_file_name = strdup("/tmp/node-info.bin");
   native_config_add_callback(&node_info_export_config_cb, "node-info.export", node_info_export_config_handler, NULL);
 }
 /*---------------------------------------------------------------------------*/
 void
 node_info_export_init(void)
 {
+#if NODE_INFO_EXPORT_THREAD
+  start_writer();
+#endif
   process_start(&node_info_export_process, NULL);
 #if CETIC_6LBR_WITH_WEBSERVER
   httpd_group_add_page(&sensors_group, &webserver_node_info_export);
@@ -36,13 +36,34 @@
 #define NODE_INFO_EXPORT_H
 
 #include "contiki.h"
+#include "net/ipv6/uip-ds6-route.h"
 
+#define NODE_INFO_EXPORT_FORMAT_CSV 0
+#define NODE_INFO_EXPORT_FORMAT_BINARY 1
+
+/* Number of node snapshots that can wait for the writer */
+#ifdef NODE_INFO_EXPORT_CONF_RING_SIZE
+#define NODE_INFO_EXPORT_RING_SIZE NODE_INFO_EXPORT_CONF_RING_SIZE
+#else
+#define NODE_INFO_EXPORT_RING_SIZE (4 * UIP_DS6_ROUTE_NB)
+#endif
+
+/* Write the export files from a separate thread */
+#ifdef NODE_INFO_EXPORT_CONF_THREAD
+#define NODE_INFO_EXPORT_THREAD NODE_INFO_EXPORT_CONF_THREAD
+#else
+#define NODE_INFO_EXPORT_THREAD CONTIKI_TARGET_NATIVE
+#endif
 
 extern int node_info_export_interval;
 extern char * node_info_export_file_name;
 extern char * node_info_export_path;
+extern char * node_info_export_binary_file_name;
 extern int node_info_export_enable;
 extern int node_info_export_global;
+extern int node_info_export_format;
+extern uint32_t node_info_export_batches;
+extern uint32_t node_info_export_dropped;
 
 void
 node_info_export_init(void);
@@ -59,5 +80,8 @@ node_info_export_set_enable(int enable);
 void
 node_info_export_set_global(int global);
 
+void
+node_info_export_set_format(int format);
+
 
 #endif
@@ -40,6 +40,7 @@
 #include "uip-ds6-route.h"
 #include "string.h"
 #include "stdlib.h"
+#include "lib/hash-index.h"
 
 #if CETIC_6LBR_WITH_RPL
 #include "rpl-private.h"
@@ -66,6 +67,42 @@
 
 node_info_t node_info_table[UIP_DS6_ROUTE_NB];          /** \brief Node info table */
 
+static int node_info_nb;
+uint32_t node_info_version;
+
+#if NODE_INFO_WITH_HASH
+#if NODE_INFO_HASH_SIZE <= UIP_DS6_ROUTE_NB
+#error "NODE_INFO_HASH_SIZE must be larger than UIP_DS6_ROUTE_NB"
+#endif
+/* The hash covers the interface identifier, the prefix is usually shared by
+   all the nodes */
+static uint32_t
+ipaddr_hash(const uip_ipaddr_t *ipaddr)
+{
+  return hash_fnv(HASH_FNV_INIT, &ipaddr->u8[8], 8);
+}
+
+static uint32_t
+node_hash(const void *node)
+{
+  return ipaddr_hash(&((const node_info_t *)node)->ipaddr);
+}
+
+static int
+node_matches(const void *node, const void *ipaddr)
+{
+  return uip_ipaddr_cmp((const uip_ipaddr_t *)ipaddr, &((const node_info_t *)node)->ipaddr);
+}
+
+HASH_INDEX(hash_index, NODE_INFO_HASH_SIZE, node_hash);
+
+static node_info_t *
+hash_find(const uip_ipaddr_t *ipaddr)
+{
+  return hash_index_find(&hash_index, ipaddr_hash(ipaddr), node_matches, ipaddr);
+}
+#endif
+
 static struct uip_ds6_notification node_info_route_notification;
 
 void
@@ -92,6 +129,10 @@ void
 node_info_init(void)
 {
   memset(node_info_table, 0, sizeof(node_info_table));
+  node_info_nb = 0;
+#if NODE_INFO_WITH_HASH
+  hash_index_clear(&hash_index);
+#endif
   uip_ds6_notification_add(&node_info_route_notification,
                            node_info_route_notification_cb);
 #if CETIC_6LBR_NODE_INFO_EXPORT
@@ -138,16 +179,39 @@ node_info_t *
 node_info_add(uip_ipaddr_t * ipaddr)
 {
   node_info_t *node = NULL;
+  int found;
+
+#if NODE_INFO_WITH_HASH
+  int i;
 
-  if(uip_ds6_list_loop
+  found = FOUND;
+  if(hash_find(ipaddr) == NULL) {
+    found = NOSPACE;
+    for(i = 0; i < UIP_DS6_ROUTE_NB; ++i) {
+      if(!node_info_table[i].isused) {
+        node = &node_info_table[i];
+        found = FREESPACE;
+        break;
+      }
+    }
+  }
+#else
+  found = uip_ds6_list_loop
      ((uip_ds6_element_t *) node_info_table, UIP_DS6_ROUTE_NB,
       sizeof(node_info_t), ipaddr, 128,
-      (uip_ds6_element_t **) & node) == FREESPACE) {
+      (uip_ds6_element_t **) & node);
+#endif
+  if(found == FREESPACE) {
     memset(node, 0, sizeof(node_info_t));
     node->isused = 1;
     uip_ipaddr_copy(&(node->ipaddr), ipaddr);
     node->stats_start = clock_time();
     node->last_seen = clock_time();
+    node_info_nb++;
+    node_info_version++;
+#if NODE_INFO_WITH_HASH
+    hash_index_add(&hash_index, node);
+#endif
     LOG6LBR_6ADDR(DEBUG, ipaddr, "New node created ");
   } else {
     LOG6LBR_6ADDR(ERROR, ipaddr, "Not enough memory to create node ");
@@ -161,12 +225,16 @@ node_info_update(uip_ipaddr_t * ipaddr, char * info)
   node_info_t *node = NULL;
   char *  sep;
   uip_ipaddr_t ip_parent;
+  uip_ipaddr_t old_parent;
+  uint32_t old_flags;
 
   node = node_info_lookup(ipaddr);
   if (node == NULL) {
     node = node_info_add(ipaddr);
   }
   if ( node != NULL ) {
+    old_flags = node->flags;
+    uip_ipaddr_copy(&old_parent, &node->ip_parent);
     node->last_seen = clock_time();
     node->last_message = clock_time();
     uint16_t up_sequence = 0;
@@ -237,6 +305,10 @@ node_info_update(uip_ipaddr_t * ipaddr, char * info)
       node->last_down_sequence = 0;
       uip_create_unspecified(&node->ip_parent);
     }
+    /* The counters are not versioned, only the topology */
+    if(node->flags != old_flags || !uip_ipaddr_cmp(&node->ip_parent, &old_parent)) {
+      node_info_version++;
+    }
   }
   return node;
 }
@@ -247,8 +319,9 @@ node_info_node_seen(uip_ipaddr_t * ipaddr, int hop_count)
   node_info_t *node = NULL;
   node = node_info_lookup(ipaddr);
   if ( node != NULL ) {
-    if(hop_count != -1) {
+    if(hop_count != -1 && node->hop_count != hop_count) {
       node->hop_count = hop_count;
+      node_info_version++;
     }
   }
 }
@@ -261,8 +334,9 @@ node_info_set_flags(uip_ipaddr_t * ipaddr, uint32_t flags)
   if(node == NULL) {
     node = node_info_add(ipaddr);
   }
-  if ( node != NULL ) {
+  if ( node != NULL && (node->flags & flags) != flags) {
     node->flags |= flags;
+    node_info_version++;
   }
 }
 
@@ -274,8 +348,9 @@ node_info_clear_flags(uip_ipaddr_t * ipaddr, uint32_t flags)
   if(node == NULL) {
     node = node_info_add(ipaddr);
   }
-  if ( node != NULL ) {
+  if ( node != NULL && (node->flags & flags) != 0) {
     node->flags &= ~flags;
+    node_info_version++;
   }
 }
 
@@ -303,6 +378,9 @@ node_info_analyze_packet(void)
   uint8_t uip_ext_len = 0;
   int done = 0;
 
+  if(node_info_nb == 0) {
+    return;
+  }
   node = node_info_lookup(&UIP_IP_BUF->srcipaddr);
   if(node != NULL) {
     stat = &node->sent;
@@ -350,8 +428,13 @@ node_info_analyze_packet(void)
 void
 node_info_rm(node_info_t *node_info)
 {
-  if(node_info != NULL) {
+  if(node_info != NULL && node_info->isused) {
+#if NODE_INFO_WITH_HASH
+    hash_index_remove(&hash_index, node_info);
+#endif
     node_info->isused = 0;
+    node_info_nb--;
+    node_info_version++;
     LOG6LBR_6ADDR(DEBUG, &node_info->ipaddr, "Removing node ");
   }
 }
@@ -359,16 +442,15 @@ node_info_rm(node_info_t *node_info)
 void
 node_info_rm_by_addr(uip_ipaddr_t * ipaddr)
 {
-  node_info_t *node_info = node_info_lookup(ipaddr);
-
-  if(node_info != NULL) {
-    node_info->isused = 0;
-  }
+  node_info_rm(node_info_lookup(ipaddr));
 }
 
 node_info_t *
 node_info_lookup(uip_ipaddr_t * ipaddr)
 {
+#if NODE_INFO_WITH_HASH
+  return hash_find(ipaddr);
+#else
   node_info_t *node;
 
   if(uip_ds6_list_loop((uip_ds6_element_t *) node_info_table,
@@ -377,11 +459,34 @@ node_info_lookup(uip_ipaddr_t * ipaddr)
     return node;
   }
   return NULL;
+#endif
+}
+
+int
+node_info_index(node_info_t const * node_info)
+{
+  return node_info != NULL ? node_info - node_info_table : -1;
+}
+
+node_info_t *
+node_info_get(int index)
+{
+  if(index < 0 || index >= UIP_DS6_ROUTE_NB || !node_info_table[index].isused) {
+    return NULL;
+  }
+  return &node_info_table[index];
+}
+
+int
+node_info_count(void)
+{
+  return node_info_nb;
 }
 
 void
 node_info_reset_statistics(node_info_t * node_info)
 {
+  node_info_version++;
   node_info->stats_start = clock_time();
   node_info->flags &= ~NODE_INFO_UPSTREAM_VALID;
   node_info->flags &= ~NODE_INFO_DOWNSTREAM_VALID;
@@ -38,6 +38,22 @@
 #include <contiki.h>
 #include <contiki-net.h>
 
+/* Index the node info table by IPv6 address with a hash table instead of
+   walking the whole table on each lookup */
+#ifdef NODE_INFO_CONF_WITH_HASH
+#define NODE_INFO_WITH_HASH NODE_INFO_CONF_WITH_HASH
+#else
+#define NODE_INFO_WITH_HASH 0
+#endif
+
+/* Number of slots of the address index, must be larger than the node info
+   table */
+#ifdef NODE_INFO_CONF_HASH_SIZE
+#define NODE_INFO_HASH_SIZE NODE_INFO_CONF_HASH_SIZE
+#else
+#define NODE_INFO_HASH_SIZE (2 * UIP_DS6_ROUTE_NB)
+#endif
+
 typedef struct node_stat {
   uint32_t size;
   uint32_t tcp;
@@ -85,6 +101,10 @@ typedef struct node_info {
 #define NODE_INFO_REJECTED 0x10
 
 extern node_info_t node_info_table[UIP_DS6_ROUTE_NB];          /** \brief Node info table */
+/* Incremented when a node is added or removed, or when its flags, parent or
+   hop count change. The traffic counters are not versioned, the pages
+   showing them rely on the cache max-age */
+extern uint32_t node_info_version;
 
 void
 node_info_init(void);
@@ -105,6 +125,17 @@ node_info_rm_by_addr(uip_ipaddr_t * ipaddr);
 
 node_info_t *node_info_lookup(uip_ipaddr_t * ipaddr);
 
+/* A node keeps its slot in node_info_table until it is removed, its index
+   can be used to reference it */
+int
+node_info_index(node_info_t const * node_info);
+
+node_info_t *
+node_info_get(int index);
+
+int
+node_info_count(void);
+
 node_info_t *
 node_info_update(uip_ipaddr_t * ipaddr, char * info);
 
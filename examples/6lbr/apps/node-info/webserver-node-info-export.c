@@ -59,11 +59,16 @@ PT_THREAD(generate_node_info_export(struct httpd_state *s))
   add("Status : %s<br />", node_info_export_enable ? "Enabled" : "Disabled");
   add("Mode : %s<br />", node_info_export_global ? "Global" : "Per node");
   add("Interval : %d s<br />", node_info_export_interval);
-  if(node_info_export_global) {
+  add("Format : %s<br />", node_info_export_format == NODE_INFO_EXPORT_FORMAT_BINARY ? "Binary" : "CSV");
+  if(node_info_export_format == NODE_INFO_EXPORT_FORMAT_BINARY) {
+    add("File : %s<br />", node_info_export_binary_file_name);
+  } else if(node_info_export_global) {
     add("File : %s<br />", node_info_export_file_name);
   } else {
     add("Path : %s<br />", node_info_export_path);
   }
+  add("Snapshots written : %u<br />", node_info_export_batches);
+  add("Snapshots dropped : %u<br />", node_info_export_dropped);
   add("<form action=\"node-info-export-toggle\" method=\"get\">");
   add("<br /><input type=\"submit\" value=\"%s\"/></form><br />", node_info_export_enable ? "Disable" : "Enable");
   SEND_STRING(&s->sout, buf);
@@ -74,6 +79,10 @@ PT_THREAD(generate_node_info_export(struct httpd_state *s))
   add("Interval: <input type=\"text\" name=\"interval\" value=\"%d\" /><br />", node_info_export_interval);
   add("File: <input type=\"text\" name=\"file\" value=\"%s\" /><br />", node_info_export_file_name);
   add("Path: <input type=\"text\" name=\"path\" value=\"%s\" /><br />", node_info_export_path);
+  add("Format: <select name=\"format\">");
+  add("<option value=\"csv\"%s>CSV</option>", node_info_export_format == NODE_INFO_EXPORT_FORMAT_CSV ? " selected" : "");
+  add("<option value=\"binary\"%s>Binary</option>", node_info_export_format == NODE_INFO_EXPORT_FORMAT_BINARY ? " selected" : "");
+  add("</select><br />");
   add("<br /><input type=\"submit\" value=\"Config\"/></form><br />");
   SEND_STRING(&s->sout, buf);
   reset_buf();
@@ -119,6 +128,12 @@ webserver_node_info_export_config(struct httpd_state *s)
       node_info_export_set_interval(atoi(value));
     } else if(strcmp(param, "file") == 0) {
       node_info_export_file_name = strdup(value);
+    } else if(strcmp(param, "format") == 0) {
+      if(strcmp(value, "binary") == 0) {
+        node_info_export_set_format(NODE_INFO_EXPORT_FORMAT_BINARY);
+      } else {
+        node_info_export_set_format(NODE_INFO_EXPORT_FORMAT_CSV);
+      }
     } else {
       LOG6LBR_INFO("Invalid param: '%s'", param);
     }
@@ -53,20 +53,36 @@
 #undef SICSLOWPAN_CONF_FRAGMENT_BUFFERS
 #define SICSLOWPAN_CONF_FRAGMENT_BUFFERS    (SICSLOWPAN_CONF_REASS_CONTEXTS * 16)
 
+// Reassemble each packet in its own buffer, contexts can be resized at startup
+#define SICSLOWPAN_CONF_REASS_HASH      1
+#define SICSLOWPAN_CONF_REASS_DYNAMIC   1
+
 
 #undef NBR_TABLE_CONF_MAX_NEIGHBORS
 #define NBR_TABLE_CONF_MAX_NEIGHBORS     200
 
+#define NBR_TABLE_CONF_WITH_HASH         1
+
 #undef UIP_CONF_MAX_ROUTES
 #define UIP_CONF_MAX_ROUTES   200
 
+#define UIP_DS6_ROUTE_CONF_LPM_INDEX 1
+
 #undef RPL_NS_CONF_LINK_NUM
 #define RPL_NS_CONF_LINK_NUM  200
 
+#define RPL_NS_CONF_WITH_HASH 1
+
+#define RPL_NS_CONF_SRH_CACHE 1
+
+#define IP64_ADDRMAP_CONF_DYNAMIC 1
+
 #define WEBSERVER_CONF_CFS_PATHLEN 1000
 
 #define WEBSERVER_CONF_CFS_URLCONV 1
 
+#define WEBSERVER_CONF_CACHE 1
+
 //Use the whole uip buffer
 #undef UIP_CONF_TCP_MSS
 
@@ -74,11 +90,22 @@
 
 #define CETIC_6LBR_LLSEC_STATS      1
 
-// Support up to 16 parallel transmissions
+// Cached key schedules and AES-NI for the link-layer security
+#define AES_128_CONF native_aes_128_driver
+
+#define CCM_STAR_CONF native_ccm_star_driver
+
+// Support up to 16 neighbor queues
 #define CSMA_CONF_MAX_NEIGHBOR_QUEUES 16
 
 #define CSMA_CONF_MAX_PACKET_PER_NEIGHBOR (QUEUEBUF_CONF_NUM/CSMA_CONF_MAX_NEIGHBOR_QUEUES)
 
+// Round robin between the neighbor queues, RPL and ND packets first
+#define CSMA_CONF_WITH_DRR 1
+
+// Keep the slip-radio busy without queuing too much ahead of the control packets
+#define CSMA_CONF_MAX_ACTIVE_NEIGHBORS 4
+
 #undef UIP_CONF_STATISTICS
 #define UIP_CONF_STATISTICS         1
 
@@ -87,8 +114,28 @@
 
 #define NODE_INFO_PER_NODE_STATS    1
 
+#define NODE_INFO_CONF_WITH_HASH    1
+
 #define CETIC_6LBR_RPL_RUNTIME_MOP    1
 
+// Timer wheel, etimers and ctimers are set and stopped in constant time
+#define ETIMER_CONF_WHEEL             1
+
+// DNS proxy answers cache
+#define DNS_CACHE_CONF_SIZE           64
+
+#define DNS_CACHE_CONF_MESSAGE_SIZE   512
+
+#define DNS_PROXY_CONF_PENDING        16
+
+#define DNS_PROXY_CONF_WAITERS        8
+
+// Logs can be sent through a ring buffer and a drain thread, see log.ring_size
+#define LOG6LBR_RING                  1
+
+// Per-stage latency histograms of the forwarded packets, see statistics.html
+#define CETIC_6LBR_PACKET_TRACE       1
+
 #define UIP_MCAST6_ROUTE_CONF_ROUTES UIP_CONF_MAX_ROUTES
 
 #undef RPL_CONF_MAX_DAG_PER_INSTANCE
@@ -102,6 +149,10 @@
 
 #define SELECT_CONF_MAX FD_SETSIZE
 
+#ifdef __linux__
+#define SELECT_CONF_EPOLL 1
+#endif
+
 #define CMD_CONF_OUTPUT border_router_cmd_output
 
 #undef NETSTACK_CONF_FRAMER
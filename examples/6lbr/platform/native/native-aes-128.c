@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         AES-128 driver of the native platform
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "native-aes-128.h"
+#include "lib/hash-index.h"
+
+#include <string.h>
+#if NATIVE_AES_128_WITH_AESNI
+#include <cpuid.h>
+#include <wmmintrin.h>
+#endif
+
+#define GETU32(p) (((uint32_t)(p)[0] << 24) ^ ((uint32_t)(p)[1] << 16) ^ ((uint32_t)(p)[2] << 8) ^ ((uint32_t)(p)[3]))
+#define PUTU32(p, v) do { (p)[0] = (uint8_t)((v) >> 24); (p)[1] = (uint8_t)((v) >> 16); (p)[2] = (uint8_t)((v) >> 8); (p)[3] = (uint8_t)(v); } while(0)
+
+typedef struct {
+  /* Round keys as bytes, used by AES-NI */
+  uint8_t round_keys[11][AES_128_BLOCK_SIZE] __attribute__((aligned(16)));
+  /* Round keys as big endian words, used by the T-tables */
+  uint32_t rk[44];
+  uint8_t key[AES_128_KEY_LENGTH];
+  uint8_t valid;
+  uint32_t last_use;
+} key_schedule_t;
+
+/* The cache is set associative, a key can be stored in any of the
+   KEY_CACHE_WAYS entries of its set */
+#define KEY_CACHE_WAYS 4
+
+native_aes_128_stats_t native_aes_128_stats;
+
+static key_schedule_t key_cache[NATIVE_AES_128_KEY_CACHE_SIZE];
+static key_schedule_t *current;
+static uint32_t use_count;
+
+static int initialized;
+static int use_aesni;
+
+static const uint8_t sbox[256] = {
+0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16 };
+
+/* SubBytes and MixColumns combined, Te1 to Te3 are Te0 rotated */
+static uint32_t Te0[256];
+static uint32_t Te1[256];
+static uint32_t Te2[256];
+static uint32_t Te3[256];
+
+/*---------------------------------------------------------------------------*/
+/* multiplies by 2 in GF(2) */
+static uint8_t
+galois_mul2(uint8_t value)
+{
+  uint8_t xor_val = (value >> 7) * 0x1b;
+  return ((value << 1) ^ xor_val);
+}
+/*---------------------------------------------------------------------------*/
+#if NATIVE_AES_128_WITH_AESNI
+static int
+cpu_has_aesni(void)
+{
+  unsigned int eax, ebx, ecx, edx;
+
+  if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return 0;
+  }
+  return (ecx & bit_AES) != 0;
+}
+#else
+#define cpu_has_aesni() 0
+#endif
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+  int i;
+  uint8_t s, s2, s3;
+  uint32_t t;
+
+  for(i = 0; i < 256; i++) {
+    s = sbox[i];
+    s2 = galois_mul2(s);
+    s3 = s2 ^ s;
+    t = ((uint32_t)s2 << 24) | ((uint32_t)s << 16) | ((uint32_t)s << 8) | s3;
+    Te0[i] = t;
+    Te1[i] = (t >> 8) | (t << 24);
+    Te2[i] = (t >> 16) | (t << 16);
+    Te3[i] = (t >> 24) | (t << 8);
+  }
+  use_aesni = cpu_has_aesni();
+  initialized = 1;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+key_hash(const uint8_t *key)
+{
+  return hash_fnv(HASH_FNV_INIT, key, AES_128_KEY_LENGTH);
+}
+/*---------------------------------------------------------------------------*/
+static void
+expand_key(key_schedule_t *ks, const uint8_t *key)
+{
+  uint8_t i;
+  uint8_t j;
+  uint8_t rcon;
+
+  rcon = 0x01;
+  memcpy(ks->round_keys[0], key, AES_128_KEY_LENGTH);
+  for(i = 1; i <= 10; i++) {
+    ks->round_keys[i][0] = sbox[ks->round_keys[i - 1][13]] ^ ks->round_keys[i - 1][0] ^ rcon;
+    ks->round_keys[i][1] = sbox[ks->round_keys[i - 1][14]] ^ ks->round_keys[i - 1][1];
+    ks->round_keys[i][2] = sbox[ks->round_keys[i - 1][15]] ^ ks->round_keys[i - 1][2];
+    ks->round_keys[i][3] = sbox[ks->round_keys[i - 1][12]] ^ ks->round_keys[i - 1][3];
+    for(j = 4; j < AES_128_BLOCK_SIZE; j++) {
+      ks->round_keys[i][j] = ks->round_keys[i - 1][j] ^ ks->round_keys[i][j - 4];
+    }
+    rcon = galois_mul2(rcon);
+  }
+  for(i = 0; i < 44; i++) {
+    ks->rk[i] = GETU32(&ks->round_keys[i >> 2][(i & 3) << 2]);
+  }
+  memcpy(ks->key, key, AES_128_KEY_LENGTH);
+  ks->valid = 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_key(const uint8_t *key)
+{
+  key_schedule_t *set;
+  key_schedule_t *ks;
+  int i;
+
+  if(current != NULL && memcmp(current->key, key, AES_128_KEY_LENGTH) == 0) {
+    native_aes_128_stats.key_hits++;
+    return;
+  }
+  if(!initialized) {
+    init();
+  }
+  set = &key_cache[key_hash(key) & (NATIVE_AES_128_KEY_CACHE_SIZE - KEY_CACHE_WAYS)];
+  ks = NULL;
+  for(i = 0; i < KEY_CACHE_WAYS; i++) {
+    if(set[i].valid && memcmp(set[i].key, key, AES_128_KEY_LENGTH) == 0) {
+      ks = &set[i];
+      break;
+    }
+  }
+  if(ks != NULL) {
+    native_aes_128_stats.key_hits++;
+  } else {
+    native_aes_128_stats.key_misses++;
+    /* Replace the least recently used entry of the set */
+    ks = &set[0];
+    for(i = 1; i < KEY_CACHE_WAYS; i++) {
+      if(!set[i].valid || (ks->valid && (int32_t)(set[i].last_use - ks->last_use) < 0)) {
+        ks = &set[i];
+      }
+    }
+    expand_key(ks, key);
+  }
+  ks->last_use = ++use_count;
+  current = ks;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_key(void)
+{
+  static const uint8_t zero_key[AES_128_KEY_LENGTH];
+
+  /* Like the default driver, encrypt with an all zero key if none is set */
+  if(current == NULL) {
+    set_key(zero_key);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+encrypt_ttable(const key_schedule_t *ks, uint8_t *block)
+{
+  const uint32_t *rk = ks->rk;
+  uint32_t s0, s1, s2, s3;
+  uint32_t t0, t1, t2, t3;
+  int round;
+
+  s0 = GETU32(block) ^ rk[0];
+  s1 = GETU32(block + 4) ^ rk[1];
+  s2 = GETU32(block + 8) ^ rk[2];
+  s3 = GETU32(block + 12) ^ rk[3];
+
+  for(round = 1; round < 10; round++) {
+    rk += 4;
+    t0 = Te0[s0 >> 24] ^ Te1[(s1 >> 16) & 0xff] ^ Te2[(s2 >> 8) & 0xff] ^ Te3[s3 & 0xff] ^ rk[0];
+    t1 = Te0[s1 >> 24] ^ Te1[(s2 >> 16) & 0xff] ^ Te2[(s3 >> 8) & 0xff] ^ Te3[s0 & 0xff] ^ rk[1];
+    t2 = Te0[s2 >> 24] ^ Te1[(s3 >> 16) & 0xff] ^ Te2[(s0 >> 8) & 0xff] ^ Te3[s1 & 0xff] ^ rk[2];
+    t3 = Te0[s3 >> 24] ^ Te1[(s0 >> 16) & 0xff] ^ Te2[(s1 >> 8) & 0xff] ^ Te3[s2 & 0xff] ^ rk[3];
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
+  }
+
+  /* last round skips MixColumn */
+  rk += 4;
+  t0 = ((uint32_t)sbox[s0 >> 24] << 24) ^ ((uint32_t)sbox[(s1 >> 16) & 0xff] << 16) ^
+    ((uint32_t)sbox[(s2 >> 8) & 0xff] << 8) ^ sbox[s3 & 0xff] ^ rk[0];
+  t1 = ((uint32_t)sbox[s1 >> 24] << 24) ^ ((uint32_t)sbox[(s2 >> 16) & 0xff] << 16) ^
+    ((uint32_t)sbox[(s3 >> 8) & 0xff] << 8) ^ sbox[s0 & 0xff] ^ rk[1];
+  t2 = ((uint32_t)sbox[s2 >> 24] << 24) ^ ((uint32_t)sbox[(s3 >> 16) & 0xff] << 16) ^
+    ((uint32_t)sbox[(s0 >> 8) & 0xff] << 8) ^ sbox[s1 & 0xff] ^ rk[2];
+  t3 = ((uint32_t)sbox[s3 >> 24] << 24) ^ ((uint32_t)sbox[(s0 >> 16) & 0xff] << 16) ^
+    ((uint32_t)sbox[(s1 >> 8) & 0xff] << 8) ^ sbox[s2 & 0xff] ^ rk[3];
+  PUTU32(block, t0);
+  PUTU32(block + 4, t1);
+  PUTU32(block + 8, t2);
+  PUTU32(block + 12, t3);
+}
+/*---------------------------------------------------------------------------*/
+#if NATIVE_AES_128_WITH_AESNI
+__attribute__((target("aes,sse2")))
+static void
+encrypt_aesni(const key_schedule_t *ks, uint8_t *block)
+{
+  const __m128i *rk = (const __m128i *)ks->round_keys;
+  __m128i s;
+  int round;
+
+  s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)block), _mm_load_si128(&rk[0]));
+  for(round = 1; round < 10; round++) {
+    s = _mm_aesenc_si128(s, _mm_load_si128(&rk[round]));
+  }
+  s = _mm_aesenclast_si128(s, _mm_load_si128(&rk[10]));
+  _mm_storeu_si128((__m128i *)block, s);
+}
+/*---------------------------------------------------------------------------*/
+__attribute__((target("aes,sse2")))
+static void
+encrypt2_aesni(const key_schedule_t *ks, uint8_t *block1, uint8_t *block2)
+{
+  const __m128i *rk = (const __m128i *)ks->round_keys;
+  __m128i k;
+  __m128i s1;
+  __m128i s2;
+  int round;
+
+  k = _mm_load_si128(&rk[0]);
+  s1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)block1), k);
+  s2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)block2), k);
+  for(round = 1; round < 10; round++) {
+    k = _mm_load_si128(&rk[round]);
+    s1 = _mm_aesenc_si128(s1, k);
+    s2 = _mm_aesenc_si128(s2, k);
+  }
+  k = _mm_load_si128(&rk[10]);
+  _mm_storeu_si128((__m128i *)block1, _mm_aesenclast_si128(s1, k));
+  _mm_storeu_si128((__m128i *)block2, _mm_aesenclast_si128(s2, k));
+}
+#endif
+/*---------------------------------------------------------------------------*/
+static void
+encrypt(uint8_t *plaintext_and_result)
+{
+  check_key();
+#if NATIVE_AES_128_WITH_AESNI
+  if(use_aesni) {
+    encrypt_aesni(current, plaintext_and_result);
+    return;
+  }
+#endif
+  encrypt_ttable(current, plaintext_and_result);
+}
+/*---------------------------------------------------------------------------*/
+void
+native_aes_128_encrypt2(uint8_t *block1, uint8_t *block2)
+{
+  check_key();
+#if NATIVE_AES_128_WITH_AESNI
+  if(use_aesni) {
+    encrypt2_aesni(current, block1, block2);
+    return;
+  }
+#endif
+  encrypt_ttable(current, block1);
+  encrypt_ttable(current, block2);
+}
+/*---------------------------------------------------------------------------*/
+int
+native_aes_128_set_aesni(int enable)
+{
+  if(!initialized) {
+    init();
+  }
+  use_aesni = enable && cpu_has_aesni();
+  return use_aesni;
+}
+/*---------------------------------------------------------------------------*/
+const struct aes_128_driver native_aes_128_driver = {
+  set_key,
+  encrypt
+};
+/*---------------------------------------------------------------------------*/
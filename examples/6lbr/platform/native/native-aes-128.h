@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         AES-128 driver of the native platform
+ *
+ *         The expanded key schedules are kept in a cache indexed by the
+ *         key, so that switching between the pairwise keys of the neighbors
+ *         does not expand the key again for each frame. Blocks are encrypted
+ *         with the AES-NI instructions when the CPU supports them, otherwise
+ *         with a T-table implementation.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#ifndef NATIVE_AES_128_H_
+#define NATIVE_AES_128_H_
+
+#include "lib/aes-128.h"
+
+/* Number of expanded keys kept in the cache, must be a power of two and
+   at least 4 */
+#ifdef NATIVE_AES_128_CONF_KEY_CACHE_SIZE
+#define NATIVE_AES_128_KEY_CACHE_SIZE NATIVE_AES_128_CONF_KEY_CACHE_SIZE
+#else
+#define NATIVE_AES_128_KEY_CACHE_SIZE 1024
+#endif
+
+#ifdef NATIVE_AES_128_CONF_WITH_AESNI
+#define NATIVE_AES_128_WITH_AESNI NATIVE_AES_128_CONF_WITH_AESNI
+#elif defined(__x86_64__) || defined(__i386__)
+#define NATIVE_AES_128_WITH_AESNI 1
+#else
+#define NATIVE_AES_128_WITH_AESNI 0
+#endif
+
+typedef struct {
+  uint32_t key_hits;
+  uint32_t key_misses;
+} native_aes_128_stats_t;
+
+extern native_aes_128_stats_t native_aes_128_stats;
+
+extern const struct aes_128_driver native_aes_128_driver;
+
+/* Encrypts two blocks with the current key, the two encryptions are
+   interleaved when AES-NI is used */
+void native_aes_128_encrypt2(uint8_t *block1, uint8_t *block2);
+
+/* Enables or disables the use of AES-NI, returns 1 if AES-NI is now used */
+int native_aes_128_set_aesni(int enable);
+
+#endif /* NATIVE_AES_128_H_ */
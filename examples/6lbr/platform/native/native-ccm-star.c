@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         CCM* driver of the native platform
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "native-ccm-star.h"
+#include "native-aes-128.h"
+
+#include <string.h>
+
+/* see RFC 3610 */
+#define CCM_STAR_AUTH_FLAGS(Adata, M) ((Adata ? (1u << 6) : 0) | (((M - 2u) >> 1) << 3) | 1u)
+#define CCM_STAR_ENCRYPTION_FLAGS     1
+
+/*---------------------------------------------------------------------------*/
+static void
+set_iv(uint8_t *iv,
+    uint8_t flags,
+    const uint8_t *nonce,
+    uint8_t counter)
+{
+  iv[0] = flags;
+  memcpy(iv + 1, nonce, CCM_STAR_NONCE_LENGTH);
+  iv[14] = 0;
+  iv[15] = counter;
+}
+/*---------------------------------------------------------------------------*/
+static void
+xor_block(uint8_t *dst, const uint8_t *src, uint8_t len)
+{
+  uint8_t i;
+
+  for(i = 0; i < len; i++) {
+    dst[i] ^= src[i];
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_key(const uint8_t *key)
+{
+  native_aes_128_driver.set_key(key);
+}
+/*---------------------------------------------------------------------------*/
+static void
+aead(const uint8_t* nonce,
+    uint8_t* m, uint8_t m_len,
+    const uint8_t* a, uint8_t a_len,
+    uint8_t *result, uint8_t mic_len,
+    int forward)
+{
+  /* x is the next input of the CBC-MAC, s the counter block */
+  uint8_t x[AES_128_BLOCK_SIZE];
+  uint8_t s[AES_128_BLOCK_SIZE];
+  unsigned int pos;
+  uint8_t len;
+  uint8_t counter;
+
+  if(mic_len == 0) {
+    /* Encryption only */
+    counter = 1;
+    for(pos = 0; pos < m_len; pos += AES_128_BLOCK_SIZE) {
+      len = m_len - pos < AES_128_BLOCK_SIZE ? m_len - pos : AES_128_BLOCK_SIZE;
+      set_iv(s, CCM_STAR_ENCRYPTION_FLAGS, nonce, counter++);
+      native_aes_128_driver.encrypt(s);
+      xor_block(m + pos, s, len);
+    }
+    return;
+  }
+
+  set_iv(x, CCM_STAR_AUTH_FLAGS(a_len, mic_len), nonce, m_len);
+
+  if(a_len) {
+    native_aes_128_driver.encrypt(x);
+    x[1] ^= a_len;
+    len = a_len < AES_128_BLOCK_SIZE - 2 ? a_len : AES_128_BLOCK_SIZE - 2;
+    xor_block(x + 2, a, len);
+    for(pos = len; pos < a_len; pos += AES_128_BLOCK_SIZE) {
+      native_aes_128_driver.encrypt(x);
+      len = a_len - pos < AES_128_BLOCK_SIZE ? a_len - pos : AES_128_BLOCK_SIZE;
+      xor_block(x, a + pos, len);
+    }
+  }
+
+  counter = 1;
+  for(pos = 0; pos < m_len; pos += AES_128_BLOCK_SIZE) {
+    len = m_len - pos < AES_128_BLOCK_SIZE ? m_len - pos : AES_128_BLOCK_SIZE;
+    set_iv(s, CCM_STAR_ENCRYPTION_FLAGS, nonce, counter++);
+    native_aes_128_encrypt2(x, s);
+    if(forward) {
+      /* MAC the plaintext, then encrypt it */
+      xor_block(x, m + pos, len);
+      xor_block(m + pos, s, len);
+    } else {
+      /* Decrypt, then MAC the plaintext */
+      xor_block(m + pos, s, len);
+      xor_block(x, m + pos, len);
+    }
+  }
+
+  /* The MIC is encrypted with the counter 0 */
+  set_iv(s, CCM_STAR_ENCRYPTION_FLAGS, nonce, 0);
+  native_aes_128_encrypt2(x, s);
+  xor_block(x, s, mic_len);
+  memcpy(result, x, mic_len);
+}
+/*---------------------------------------------------------------------------*/
+const struct ccm_star_driver native_ccm_star_driver = {
+  set_key,
+  aead
+};
+/*---------------------------------------------------------------------------*/
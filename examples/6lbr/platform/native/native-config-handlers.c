@@ -42,6 +42,10 @@
 #include "uip-mcast6.h"
 #include "uip-mcast6-route.h"
 #endif
+#if CETIC_6LBR_WITH_IP64
+#include "ip64-addrmap.h"
+#endif
+#include "net/ipv6/sicslowpan.h"
 #include "native-config.h"
 #include "native-config-file.h"
 #include "slip-dev.h"
@@ -82,6 +86,36 @@ static int native_config_native_handler(config_level_t level, void* user, const
   if(strcmp(name, "select.timeout") == 0) {
     sixlbr_config_select_timeout = atoi(value);
     return 1;
+  } else if(strcmp(name, "pipeline") == 0) {
+    sixlbr_config_pipeline = atoi(value);
+    return 1;
+#if CETIC_6LBR_WITH_IP64 && IP64_ADDRMAP_DYNAMIC
+  } else if(strcmp(name, "ip64.addrmap_size") == 0) {
+    if(!ip64_addrmap_set_size(atoi(value))) {
+      LOG6LBR_ERROR("Invalid NAT64 table size : %s\n", value);
+      return 0;
+    }
+    return 1;
+#endif
+#if SICSLOWPAN_REASS_HASH && SICSLOWPAN_REASS_DYNAMIC
+  } else if(strcmp(name, "sicslowpan.reass_contexts") == 0) {
+    if(!sicslowpan_reass_set_contexts(atoi(value))) {
+      LOG6LBR_ERROR("Invalid 6LoWPAN reassembly contexts : %s\n", value);
+      return 0;
+    }
+    return 1;
+#endif
+#if LOG6LBR_RING && !LOG6LBR_STATIC
+  } else if(strcmp(name, "log.ring_size") == 0) {
+    if(atoi(value) > 0 && !log6lbr_ring_start(atoi(value))) {
+      LOG6LBR_ERROR("Invalid log ring size : %s\n", value);
+      return 0;
+    }
+    return 1;
+  } else if(strcmp(name, "log.pcap") == 0) {
+    log6lbr_ring_set_pcap(value);
+    return 1;
+#endif
 #if !CONTIKI_TARGET_COOJA
   } else if(strcmp(name, "slip.timeout") == 0) {
     if(slip_default_device) {
@@ -93,6 +127,15 @@ static int native_config_native_handler(config_level_t level, void* user, const
       slip_default_device->retransmit = atoi(value);
     }
     return 1;
+  } else if(strcmp(name, "slip.window") == 0) {
+    if(atoi(value) <= 0) {
+      LOG6LBR_ERROR("Invalid SLIP window : %s\n", value);
+      return 0;
+    }
+    if(slip_default_device) {
+      slip_default_device->window = atoi(value);
+    }
+    return 1;
   } else if(strcmp(name, "slip.serialize_tx_attrs") == 0) {
     if(slip_default_device) {
       slip_default_device->serialize_tx_attrs = atoi(value);
@@ -188,6 +231,13 @@ static int native_config_slip_radio_handler(config_level_t level, void* user, co
   } else if(strcmp(name, "retransmit") == 0) {
     slip_device->retransmit = atoi(value);
     return 1;
+  } else if(strcmp(name, "window") == 0) {
+    if(atoi(value) <= 0) {
+      LOG6LBR_ERROR("Invalid SLIP window : %s\n", value);
+      return 0;
+    }
+    slip_device->window = atoi(value);
+    return 1;
   } else if(strcmp(name, "serialize_tx_attrs") == 0) {
     slip_device->serialize_tx_attrs = atoi(value);
     return 1;
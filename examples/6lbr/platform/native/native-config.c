@@ -48,6 +48,7 @@ char *sixlbr_config_eth_device = SIXLBR_CONFIG_DEFAULT_ETH_DEVICE;
 int sixlbr_config_eth_basedelay = SIXLBR_CONFIG_DEFAULT_ETH_BASE_DELAY;
 uint8_t sixlbr_config_use_raw_ethernet = SIXLBR_CONFIG_DEFAULT_USE_RAW_ETH;
 uint8_t sixlbr_config_ethernet_has_fcs = SIXLBR_CONFIG_DEFAULT_ETH_HAS_FCS;
+uint8_t sixlbr_config_pipeline = SIXLBR_CONFIG_DEFAULT_PIPELINE;
 
 const char *sixlbr_config_ifup_script = SIXLBR_CONFIG_DEFAULT_IFUP_SCRIPT;
 const char *sixlbr_config_ifdown_script = SIXLBR_CONFIG_DEFAULT_IFDOWN_SCRIPT;
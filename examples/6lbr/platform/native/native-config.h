@@ -47,6 +47,8 @@ extern char *sixlbr_config_eth_device;
 extern int sixlbr_config_eth_basedelay;
 extern uint8_t sixlbr_config_use_raw_ethernet;
 extern uint8_t sixlbr_config_ethernet_has_fcs;
+/* The Ethernet and SLIP devices are read and written by their own threads */
+extern uint8_t sixlbr_config_pipeline;
 
 extern char const *sixlbr_config_ifup_script;
 extern char const *sixlbr_config_ifdown_script;
@@ -82,6 +84,7 @@ extern int sixlbr_config_log_services;
 
 #define SIXLBR_CONFIG_DEFAULT_SLIP_TIMEOUT         (CLOCK_SECOND / 5)
 #define SIXLBR_CONFIG_DEFAULT_SLIP_RETRANSMIT      0
+#define SIXLBR_CONFIG_DEFAULT_SLIP_WINDOW          16
 #define SIXLBR_CONFIG_DEFAULT_SLIP_SERIALIZE_TX    1
 #define SIXLBR_CONFIG_DEFAULT_SLIP_DESERIALIZE_RX  0
 #define SIXLBR_CONFIG_DEFAULT_SLIP_CRC8            0
@@ -99,6 +102,8 @@ extern int sixlbr_config_log_services;
 #define SIXLBR_CONFIG_DEFAULT_ETH_BASE_DELAY     0
 #define SIXLBR_CONFIG_DEFAULT_USE_RAW_ETH        1
 #define SIXLBR_CONFIG_DEFAULT_ETH_HAS_FCS        0
+/* The I/O threads need spare cores, see tools/pipeline_bench */
+#define SIXLBR_CONFIG_DEFAULT_PIPELINE           0
 
 #define SIXLBR_CONFIG_DEFAULT_NVM_FILE       "nvm.dat"
 #define SIXLBR_CONFIG_DEFAULT_FACTORY_NVM_FILE     "factory.dat"
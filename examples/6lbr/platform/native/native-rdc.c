@@ -55,6 +55,7 @@
 #include "multi-radio.h"
 #include "native-rdc.h"
 #include "log-6lbr.h"
+#include "packet-trace.h"
 #if CETIC_6LBR_MULTI_RADIO
 #include "multi-radio.h"
 #endif
@@ -68,8 +69,6 @@ static int report_slip_error = 0;
  /* Below define allows importing saved output into Wireshark as "Raw IP" packet type */
 #define WIRESHARK_IMPORT_FORMAT 0
 
-#define MAX_CALLBACKS 16
-static int callback_pos;
 int callback_count;
 int native_rdc_ack_timeout;
 int native_rdc_parse_error;
@@ -78,19 +77,44 @@ int native_rdc_parse_error;
    from radio... */
 struct tx_callback {
   uint8_t isused;
+  uint8_t sid;
   mac_callback_t cback;
   void *ptr;
   struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
   struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
-  slip_descr_t *slip_device;
+  struct tx_session *session;
   struct ctimer timeout;
-  int sid;
   int retransmit;
+  int transmissions;
+  clock_time_t first_tx;
+  clock_time_t last_tx;
+#if CETIC_6LBR_PACKET_TRACE
+  packet_trace_time_t queued;
+#endif
+  /* The frame is kept in the session frame buffer until it is acked */
+  int buf_offset;
   int buf_len;
-  uint8_t buf[UIP_BUFSIZE + 3 + sizeof(uip_lladdr_t) * 2];
 };
 
-static struct tx_callback callbacks[MAX_CALLBACKS];
+/*
+ * Frames sent to a slip-radio are numbered with consecutive session ids,
+ * the frames in flight are those between oldest_sid and next_sid. They are
+ * stored in the window slot given by their session id, so the acks, which
+ * can arrive in any order, are matched without search.
+ */
+struct tx_session {
+  slip_descr_t *slip_device;
+  uint8_t next_sid;
+  uint8_t oldest_sid;
+  int in_flight;
+  struct tx_callback window[NATIVE_RDC_MAX_WINDOW];
+  /* Frames waiting for an ack, stored in sequence in a ring */
+  uint8_t frames[NATIVE_RDC_FRAME_BUF_SIZE];
+  int frames_head;
+  native_rdc_stats_t stats;
+};
+
+static struct tx_session sessions[SLIP_MAX_DEVICE];
 
 /*---------------------------------------------------------------------------*/
 static slip_descr_t*
@@ -103,31 +127,75 @@ get_slip_device(uint8_t ifindex)
   return slip_device;
 }
 /*---------------------------------------------------------------------------*/
+static struct tx_session *
+get_session(uint8_t ifindex)
+{
+  return ifindex < SLIP_MAX_DEVICE ? &sessions[ifindex] : NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+histogram_add(uint32_t *histogram, clock_time_t delay)
+{
+  unsigned long ms = (unsigned long)delay * 1000 / CLOCK_SECOND;
+  int bucket = 0;
+
+  while(ms > 0 && bucket < NATIVE_RDC_HISTOGRAM_BUCKETS - 1) {
+    ms >>= 1;
+    bucket++;
+  }
+  histogram[bucket]++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+release_callback(struct tx_callback *callback)
+{
+  struct tx_session *session = callback->session;
+
+  callback_count--;
+  session->in_flight--;
+  callback->isused = 0;
+  ctimer_stop(&callback->timeout);
+  /* Free the frames acked in sequence */
+  while(session->oldest_sid != session->next_sid &&
+        !session->window[session->oldest_sid % NATIVE_RDC_MAX_WINDOW].isused) {
+    session->oldest_sid++;
+  }
+}
+/*---------------------------------------------------------------------------*/
 void
 packet_sent(uint8_t sessionid, uint8_t status, uint8_t tx)
 {
+  struct tx_session *session;
+  struct tx_callback *callback;
+  clock_time_t now;
+
   LOG6LBR_PRINTF(PACKET, RADIO_OUT, "sid ack: %d (%d, %d)\n", sessionid, status, tx);
-  if(sessionid < MAX_CALLBACKS) {
-    struct tx_callback *callback;
-
-    callback = &callbacks[sessionid];
-    if (callback->isused) {
-      callback_count--;
-      callback->isused = 0;
-      ctimer_stop(&callback->timeout);
-      if(!sixlbr_config_slip_ip) {
-        packetbuf_clear();
-        packetbuf_attr_copyfrom(callback->attrs, callback->addrs);
-        if(callback->cback != NULL) {
-          //multi_radio_input_ifindex is set by the slip layer
-          mac_call_sent_callback(callback->cback, callback->ptr, status, tx);
-        }
+  //multi_radio_input_ifindex is set by the slip layer
+  session = get_session(multi_radio_input_ifindex);
+  if(session == NULL) {
+    LOG6LBR_ERROR("*** ERROR: ack received from unknown radio %d\n", multi_radio_input_ifindex);
+    return;
+  }
+  callback = &session->window[sessionid % NATIVE_RDC_MAX_WINDOW];
+  if(callback->isused && callback->sid == sessionid) {
+    now = clock_time();
+    session->stats.acks++;
+    if(callback->transmissions == 1) {
+      histogram_add(session->stats.rtt, now - callback->last_tx);
+    }
+    histogram_add(session->stats.ack_latency, now - callback->first_tx);
+    PACKET_TRACE_SAMPLE(PACKET_TRACE_RADIO_ACK, packet_trace_now() - callback->queued);
+    release_callback(callback);
+    if(!sixlbr_config_slip_ip) {
+      packetbuf_clear();
+      packetbuf_attr_copyfrom(callback->attrs, callback->addrs);
+      if(callback->cback != NULL) {
+        mac_call_sent_callback(callback->cback, callback->ptr, status, tx);
       }
-    } else {
-      LOG6LBR_ERROR("br-rdc: ack received for unknown packet (%d)\n", callback->sid);
     }
   } else {
-    LOG6LBR_ERROR("*** ERROR: too high session id %d\n", sessionid);
+    session->stats.stale_acks++;
+    LOG6LBR_ERROR("br-rdc: ack received for unknown packet (%d)\n", sessionid);
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -135,22 +203,26 @@ static void
 packet_timeout(void *ptr)
 {
   struct tx_callback *callback = ptr;
+  struct tx_session *session = callback->session;
   if (callback->isused) {
     native_rdc_ack_timeout++;
+    session->stats.timeouts++;
     if(callback->retransmit > 0) {
       LOG6LBR_INFO("br-rdc: slip ack timeout, retransmit (%d)\n", callback->sid);
       callback->retransmit--;
-      ctimer_set(&callback->timeout, callback->slip_device->timeout, packet_timeout, callback);
-      write_to_slip(callback->slip_device, callback->buf, callback->buf_len);
+      callback->transmissions++;
+      session->stats.retransmissions++;
+      callback->last_tx = clock_time();
+      ctimer_set(&callback->timeout, session->slip_device->timeout, packet_timeout, callback);
+      write_to_slip(session->slip_device, session->frames + callback->buf_offset, callback->buf_len);
     } else {
-      callback_count--;
-      callback->isused = 0;
+      release_callback(callback);
       LOG6LBR_ERROR("br-rdc: send failed, slip ack timeout (%d)\n", callback->sid);
       if(!sixlbr_config_slip_ip) {
         packetbuf_clear();
         packetbuf_attr_copyfrom(callback->attrs, callback->addrs);
         if(callback->cback != NULL) {
-          multi_radio_input_ifindex = callback->slip_device->ifindex;
+          multi_radio_input_ifindex = session->slip_device->ifindex;
           mac_call_sent_callback(callback->cback, callback->ptr, MAC_TX_NOACK, 1);
         }
       }
@@ -160,46 +232,112 @@ packet_timeout(void *ptr)
   }
 }
 /*---------------------------------------------------------------------------*/
-static int
-setup_callback(slip_descr_t *slip_device, mac_callback_t sent, void *ptr)
+/*
+ * Reserve the next session id of the radio and room for a frame of at most
+ * len bytes in the frame buffer. Frames are never split, if the frame does
+ * not fit at the end of the buffer, it is stored at the beginning.
+ * The frame is only accounted for when commit_callback() is called.
+ */
+static struct tx_callback *
+reserve_callback(slip_descr_t *slip_device, int len, uint8_t **frame)
 {
+  struct tx_session *session;
   struct tx_callback *callback;
-  if ( callback_count < MAX_CALLBACKS) {
-    callback_pos++;
-    if(callback_pos >= MAX_CALLBACKS) {
-      callback_pos = 0;
-    }
-    while (callbacks[callback_pos].isused) {
-      callback_pos++;
-      if(callback_pos >= MAX_CALLBACKS) {
-        callback_pos = 0;
-      }
-    }
-    callback_count++;
-
-    callback = &callbacks[callback_pos];
-    callback->cback = sent;
-    callback->ptr = ptr;
-    callback->sid = callback_pos;
-    callback->isused = 1;
-    callback->slip_device = slip_device;
-    callback->retransmit = slip_device->retransmit;
-    if(!sixlbr_config_slip_ip) {
-      packetbuf_attr_copyto(callback->attrs, callback->addrs);
-    }
-    ctimer_set(&callback->timeout, callback->slip_device->timeout, packet_timeout, callback);
+  int window;
+  int offset;
+  int tail;
 
-    return callback_pos;
+  session = get_session(slip_device->ifindex);
+  if(session == NULL) {
+    return NULL;
+  }
+  session->slip_device = slip_device;
+  window = slip_device->window;
+  if(window > NATIVE_RDC_MAX_WINDOW) {
+    window = NATIVE_RDC_MAX_WINDOW;
+  }
+  if((uint8_t)(session->next_sid - session->oldest_sid) >= window || len > NATIVE_RDC_FRAME_BUF_SIZE) {
+    session->stats.window_full++;
+    return NULL;
+  }
+  if(session->next_sid == session->oldest_sid) {
+    offset = 0;
   } else {
-    return -1;
+    tail = session->window[session->oldest_sid % NATIVE_RDC_MAX_WINDOW].buf_offset;
+    if(session->frames_head > tail) {
+      if(session->frames_head + len <= NATIVE_RDC_FRAME_BUF_SIZE) {
+        offset = session->frames_head;
+      } else if(len <= tail) {
+        offset = 0;
+      } else {
+        session->stats.window_full++;
+        return NULL;
+      }
+    } else if(session->frames_head + len <= tail) {
+      offset = session->frames_head;
+    } else {
+      session->stats.window_full++;
+      return NULL;
+    }
+  }
+  callback = &session->window[session->next_sid % NATIVE_RDC_MAX_WINDOW];
+  callback->sid = session->next_sid;
+  callback->session = session;
+  callback->buf_offset = offset;
+  *frame = session->frames + offset;
+  return callback;
+}
+/*---------------------------------------------------------------------------*/
+static void
+commit_callback(struct tx_callback *callback, int len, mac_callback_t sent, void *ptr)
+{
+  struct tx_session *session = callback->session;
+
+  callback->cback = sent;
+  callback->ptr = ptr;
+  callback->isused = 1;
+  callback->retransmit = session->slip_device->retransmit;
+  callback->transmissions = 1;
+  callback->buf_len = len;
+  callback->first_tx = clock_time();
+  callback->last_tx = callback->first_tx;
+#if CETIC_6LBR_PACKET_TRACE
+  callback->queued = packet_trace_now();
+#endif
+  if(!sixlbr_config_slip_ip) {
+    packetbuf_attr_copyto(callback->attrs, callback->addrs);
+  }
+  ctimer_set(&callback->timeout, session->slip_device->timeout, packet_timeout, callback);
+
+  session->next_sid++;
+  session->frames_head = callback->buf_offset + len;
+  session->in_flight++;
+  callback_count++;
+  session->stats.frames++;
+  if(session->in_flight > session->stats.max_in_flight) {
+    session->stats.max_in_flight = session->in_flight;
   }
 }
 /*---------------------------------------------------------------------------*/
+native_rdc_stats_t const *
+native_rdc_get_stats(uint8_t ifindex)
+{
+  struct tx_session *session = get_session(ifindex);
+  return session != NULL ? &session->stats : NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+native_rdc_in_flight(uint8_t ifindex)
+{
+  struct tx_session *session = get_session(ifindex);
+  return session != NULL ? session->in_flight : 0;
+}
+/*---------------------------------------------------------------------------*/
 uint8_t
 native_rdc_send_ip_packet(const uip_lladdr_t *localdest)
 {
-  uint8_t buf[UIP_BUFSIZE + 3 + sizeof(uip_lladdr_t)];
-  int sid;
+  struct tx_callback *callback;
+  uint8_t *buf;
   int size = 0;
   slip_descr_t *slip_device = get_slip_device(multi_radio_output_ifindex);
 
@@ -207,15 +345,15 @@ native_rdc_send_ip_packet(const uip_lladdr_t *localdest)
     LOG6LBR_ERROR("Can not find slip device of interface %d\n", multi_radio_output_ifindex);
     return 0;
   }
-  sid = setup_callback(slip_device, NULL, NULL);
-  if (sid != -1) {
-    LOG6LBR_PRINTF(PACKET, RADIO_OUT, "write: %d (sid: %d, cb: %d)\n", uip_len, sid, callback_count);
+  callback = reserve_callback(slip_device, uip_len + 3 + sizeof(uip_lladdr_t), &buf);
+  if (callback != NULL) {
+    LOG6LBR_PRINTF(PACKET, RADIO_OUT, "write: %d (sid: %d, cb: %d)\n", uip_len, callback->sid, callback_count);
     LOG6LBR_DUMP_PACKET(RADIO_OUT, uip_buf, uip_len);
 
     size = 0;
     buf[size++] = '!';
     buf[size++] = 'S';
-    buf[size++] = sid;             /* sequence or session number for this packet */
+    buf[size++] = callback->sid;   /* sequence or session number for this packet */
 
     if(localdest != NULL) {
       memcpy(&buf[size], localdest, sizeof(uip_lladdr_t));
@@ -227,9 +365,12 @@ native_rdc_send_ip_packet(const uip_lladdr_t *localdest)
     memcpy(&buf[size], &uip_buf[UIP_LLH_LEN], uip_len);
     size += uip_len;
 
-    callbacks[sid].buf_len = size;
-    memcpy(callbacks[sid].buf, buf, size);
-    write_to_slip(slip_device, buf, callbacks[sid].buf_len);
+    PACKET_TRACE_ENTER(PACKET_TRACE_WRITE_TO_SLIP);
+    if(write_to_slip(slip_device, buf, size) < 0) {
+      return 0;
+    }
+    PACKET_TRACE_QUEUED();
+    commit_callback(callback, size, NULL, NULL);
     return 1;
   } else {
     LOG6LBR_INFO("native-rdc queue full\n");
@@ -243,8 +384,9 @@ send_packet(mac_callback_t sent, void *ptr)
   int size;
 
   /* 3 bytes per packet attribute is required for serialization */
-  uint8_t buf[PACKETBUF_NUM_ATTRS * 3 + PACKETBUF_SIZE + 3];
-  int sid;
+  uint8_t *buf;
+  int buf_size = PACKETBUF_NUM_ATTRS * 3 + PACKETBUF_SIZE + 3;
+  struct tx_callback *callback;
   slip_descr_t *slip_device = get_slip_device(multi_radio_output_ifindex);
 
   if(slip_device == NULL) {
@@ -265,37 +407,45 @@ send_packet(mac_callback_t sent, void *ptr)
     /* Failed to allocate space for headers */
     LOG6LBR_ERROR("br-rdc: send failed, too large header\n");
     mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 1);
-
+    return;
+  }
+  /* The frame is built directly in the retransmit buffer */
+  callback = reserve_callback(slip_device, buf_size, &buf);
+  if(callback == NULL) {
+    LOG6LBR_INFO("native-rdc queue full\n");
+    mac_call_sent_callback(sent, ptr, MAC_TX_NOACK, 1);
+    return;
+  }
+  /* here we send the data over SLIP to the radio-chip */
+  size = 0;
+  if(slip_device->serialize_tx_attrs) {
+    size = packetutils_serialize_atts(&buf[3], buf_size - 3);
+  }
+  if(size < 0 || size + packetbuf_totlen() + 3 > buf_size) {
+    LOG6LBR_ERROR("br-rdc: send failed, too large header\n");
+    mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 1);
   } else {
-    /* here we send the data over SLIP to the radio-chip */
-    size = 0;
-    if(slip_device->serialize_tx_attrs) {
-      size = packetutils_serialize_atts(&buf[3], sizeof(buf) - 3);
-    }
-    if(size < 0 || size + packetbuf_totlen() + 3 > sizeof(buf)) {
-      LOG6LBR_ERROR("br-rdc: send failed, too large header\n");
-      mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 1);
-    } else {
-      sid = setup_callback(slip_device, sent, ptr);
-      if (sid != -1) {
-        LOG6LBR_PRINTF(PACKET, RADIO_OUT, "write: %d (sid: %d, cb: %d)\n", packetbuf_datalen(), sid, callback_count);
-        LOG6LBR_DUMP_PACKET(RADIO_OUT, packetbuf_dataptr(), packetbuf_datalen());
+    LOG6LBR_PRINTF(PACKET, RADIO_OUT, "write: %d (sid: %d, cb: %d)\n", packetbuf_datalen(), callback->sid, callback_count);
+    LOG6LBR_DUMP_PACKET(RADIO_OUT, packetbuf_dataptr(), packetbuf_datalen());
 
-        buf[0] = '!';
-        buf[1] = 'S';
-        buf[2] = sid;             /* sequence or session number for this packet */
+    buf[0] = '!';
+    buf[1] = 'S';
+    buf[2] = callback->sid;   /* sequence or session number for this packet */
 
-        /* Copy packet data */
-        memcpy(&buf[3 + size], packetbuf_hdrptr(), packetbuf_totlen());
-        callbacks[sid].buf_len = packetbuf_totlen() + size + 3;
-        memcpy(callbacks[sid].buf, buf, callbacks[sid].buf_len);
+    /* Copy packet data */
+    memcpy(&buf[3 + size], packetbuf_hdrptr(), packetbuf_totlen());
+    size += packetbuf_totlen() + 3;
 
-        write_to_slip(slip_device, buf, callbacks[sid].buf_len);
-      } else {
-        LOG6LBR_INFO("native-rdc queue full\n");
-        mac_call_sent_callback(sent, ptr, MAC_TX_NOACK, 1);
-      }
+    PACKET_TRACE_ENTER(PACKET_TRACE_WRITE_TO_SLIP);
+    if(write_to_slip(slip_device, buf, size) < 0) {
+      /* slip transmit queue is full, let the MAC layer back off */
+      mac_call_sent_callback(sent, ptr, MAC_TX_COLLISION, 1);
+    } else {
+      /* The trace ends once all the fragments of the packet are queued */
+      PACKET_TRACE_QUEUED();
+      commit_callback(callback, size, sent, ptr);
     }
+    PACKET_TRACE_ENTER(PACKET_TRACE_SICSLOWPAN_OUTPUT);
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -313,6 +463,7 @@ send_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
 void
 native_rdc_packet_input(slip_descr_t *slip_device, unsigned char *data, int len)
 {
+  PACKET_TRACE_ENTER(PACKET_TRACE_SICSLOWPAN_INPUT);
   multi_radio_input_ifindex = slip_device->ifindex;
   packetbuf_clear();
 
@@ -408,7 +559,7 @@ off(void)
 static void
 init(void)
 {
-  callback_pos = 0;
+  memset(sessions, 0, sizeof(sessions));
   callback_count = 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -40,6 +40,45 @@
 #include "contiki-net.h"
 #include "slip-dev.h"
 
+/* Maximum number of frames in flight per slip-radio, the session id carried
+   in the frames is 8 bits wide, so it must be a power of two below 256 */
+#ifdef NATIVE_RDC_CONF_MAX_WINDOW
+#define NATIVE_RDC_MAX_WINDOW NATIVE_RDC_CONF_MAX_WINDOW
+#else
+#define NATIVE_RDC_MAX_WINDOW 128
+#endif
+
+#if NATIVE_RDC_MAX_WINDOW > 128 || (NATIVE_RDC_MAX_WINDOW & (NATIVE_RDC_MAX_WINDOW - 1)) != 0
+#error NATIVE_RDC_MAX_WINDOW must be a power of two not larger than 128
+#endif
+
+/* Size of the buffer holding the frames waiting for an ack, per slip-radio */
+#ifdef NATIVE_RDC_CONF_FRAME_BUF_SIZE
+#define NATIVE_RDC_FRAME_BUF_SIZE NATIVE_RDC_CONF_FRAME_BUF_SIZE
+#else
+#define NATIVE_RDC_FRAME_BUF_SIZE 32768
+#endif
+
+/* Histogram bucket 0 counts the delays below 1 ms, bucket i the delays
+   between (1 << (i - 1)) and (1 << i) ms and the last bucket all the larger
+   delays */
+#define NATIVE_RDC_HISTOGRAM_BUCKETS 12
+
+typedef struct {
+  uint32_t frames;
+  uint32_t acks;
+  uint32_t retransmissions;
+  uint32_t timeouts;
+  uint32_t stale_acks;
+  uint32_t window_full;
+  uint32_t max_in_flight;
+  /* Delay between the last transmission of a frame and its ack, frames
+     retransmitted are not sampled */
+  uint32_t rtt[NATIVE_RDC_HISTOGRAM_BUCKETS];
+  /* Delay between the first transmission of a frame and its ack */
+  uint32_t ack_latency[NATIVE_RDC_HISTOGRAM_BUCKETS];
+} native_rdc_stats_t;
+
 extern void native_rdc_init(void);
 extern void native_rdc_reset_slip(void);
 
@@ -54,6 +93,12 @@ native_rdc_send_ip_packet(const uip_lladdr_t *localdest);
 extern void
 native_rdc_packet_input(slip_descr_t *slip_device, unsigned char *data, int len);
 
+extern native_rdc_stats_t const *
+native_rdc_get_stats(uint8_t ifindex);
+
+extern int
+native_rdc_in_flight(uint8_t ifindex);
+
 extern int callback_count;
 extern int native_rdc_ack_timeout;
 extern int native_rdc_parse_error;
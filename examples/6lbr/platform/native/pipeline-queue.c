@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Queues between the I/O threads and the Contiki thread
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "pipeline-queue.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/* The record header keeps the payload 8 bytes aligned */
+#define RECORD_HEADER 8
+#define RECORD_SIZE(len) ((RECORD_HEADER + (uint32_t)(len) + 7) & ~7U)
+#define RECORD_PAD 0x80000000UL
+
+#define RECORD_AT(queue, pos) ((uint32_t *)((queue)->buf + ((pos) & ((queue)->size - 1))))
+
+/*---------------------------------------------------------------------------*/
+int
+pipeline_queue_init(pipeline_queue_t *queue, uint32_t size)
+{
+  if(size < RECORD_HEADER || (size & (size - 1)) != 0) {
+    return 0;
+  }
+  queue->buf = malloc(size);
+  if(queue->buf == NULL) {
+    return 0;
+  }
+  queue->size = size;
+  queue->head = 0;
+  queue->pushed = 0;
+  queue->reserved_pad = 0;
+  queue->tail = 0;
+  queue->popped = 0;
+  queue->peeked_next = 0;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t *
+pipeline_queue_reserve(pipeline_queue_t *queue, int len)
+{
+  uint32_t need = RECORD_SIZE(len);
+  uint32_t head = queue->head;
+  uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+  uint32_t offset = head & (queue->size - 1);
+  uint32_t pad = 0;
+
+  if(need > queue->size) {
+    return NULL;
+  }
+  if(offset + need > queue->size) {
+    pad = queue->size - offset;
+  }
+  if(head + pad + need - tail > queue->size) {
+    return NULL;
+  }
+  queue->reserved_pad = pad;
+  return (uint8_t *)RECORD_AT(queue, head + pad) + RECORD_HEADER;
+}
+/*---------------------------------------------------------------------------*/
+void
+pipeline_queue_commit(pipeline_queue_t *queue, int len)
+{
+  uint32_t head = queue->head;
+
+  if(queue->reserved_pad > 0) {
+    *RECORD_AT(queue, head) = RECORD_PAD | queue->reserved_pad;
+    head += queue->reserved_pad;
+    queue->reserved_pad = 0;
+  }
+  *RECORD_AT(queue, head) = len;
+  head += RECORD_SIZE(len);
+  __atomic_store_n(&queue->pushed, queue->pushed + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&queue->head, head, __ATOMIC_RELEASE);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t *
+pipeline_queue_peek(pipeline_queue_t *queue, int *len)
+{
+  uint32_t tail = queue->tail;
+  uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+  uint32_t header;
+
+  while(tail != head) {
+    header = *RECORD_AT(queue, tail);
+    if((header & RECORD_PAD) != 0) {
+      /* A padding record is always followed by a record at the start */
+      tail += header & ~RECORD_PAD;
+      continue;
+    }
+    *len = header;
+    queue->peeked_next = tail + RECORD_SIZE(header);
+    return (uint8_t *)RECORD_AT(queue, tail) + RECORD_HEADER;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+pipeline_queue_release(pipeline_queue_t *queue)
+{
+  __atomic_store_n(&queue->popped, queue->popped + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&queue->tail, queue->peeked_next, __ATOMIC_RELEASE);
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+pipeline_queue_count(pipeline_queue_t *queue)
+{
+  return __atomic_load_n(&queue->pushed, __ATOMIC_RELAXED) -
+    __atomic_load_n(&queue->popped, __ATOMIC_RELAXED);
+}
+/*---------------------------------------------------------------------------*/
+int
+pipeline_wakeup_init(pipeline_wakeup_t *wakeup)
+{
+  if(pipe(wakeup->fd) == -1) {
+    return 0;
+  }
+  fcntl(wakeup->fd[0], F_SETFL, fcntl(wakeup->fd[0], F_GETFL) | O_NONBLOCK);
+  fcntl(wakeup->fd[1], F_SETFL, fcntl(wakeup->fd[1], F_GETFL) | O_NONBLOCK);
+  wakeup->pending = 0;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+pipeline_wakeup_fd(pipeline_wakeup_t *wakeup)
+{
+  return wakeup->fd[0];
+}
+/*---------------------------------------------------------------------------*/
+void
+pipeline_wakeup_signal(pipeline_wakeup_t *wakeup)
+{
+  /* The queue update must be visible before pending is tested */
+  if(!__atomic_exchange_n(&wakeup->pending, 1, __ATOMIC_SEQ_CST)) {
+    if(write(wakeup->fd[1], "", 1) == -1) {
+      /* The pipe is full, the consumer is awake anyway */
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+pipeline_wakeup_clear(pipeline_wakeup_t *wakeup)
+{
+  uint8_t tmp[16];
+
+  while(read(wakeup->fd[0], tmp, sizeof(tmp)) > 0);
+  __atomic_store_n(&wakeup->pending, 0, __ATOMIC_SEQ_CST);
+  /* Records pushed before a signal that saw pending set must be seen */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+/*---------------------------------------------------------------------------*/
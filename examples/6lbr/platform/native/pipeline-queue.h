@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Queues between the I/O threads and the Contiki thread
+ *
+ *         A queue is a single producer, single consumer ring of variable
+ *         size records, the producer and the consumer only share the two
+ *         positions, which are accessed with acquire/release semantics.
+ *         A record never wraps around the end of the ring so that it can be
+ *         used in place, the room left at the end is skipped with a padding
+ *         record.
+ *
+ *         A wakeup is a pipe used to wake up a thread blocked in select()
+ *         or poll() when a queue it consumes is no longer empty, a single
+ *         byte is written until the consumer clears it.
+ *
+ *         This module does not depend on Contiki so that it can be used by
+ *         the host tools (see tools/pipeline_bench.c).
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#ifndef PIPELINE_QUEUE_H_
+#define PIPELINE_QUEUE_H_
+
+#include <stdint.h>
+
+typedef struct {
+  uint8_t *buf;
+  uint32_t size;
+  /* Written by the producer only */
+  uint32_t head;
+  uint32_t pushed;
+  uint32_t reserved_pad;
+  /* Written by the consumer only */
+  uint32_t tail;
+  uint32_t popped;
+  uint32_t peeked_next;
+} pipeline_queue_t;
+
+typedef struct {
+  int fd[2];
+  uint8_t pending;
+} pipeline_wakeup_t;
+
+/* size must be a power of two, return 0 on allocation failure */
+int pipeline_queue_init(pipeline_queue_t *queue, uint32_t size);
+
+/* Producer side. Return room for a record of at most len bytes, or NULL
+   if the queue is full. The record is only visible once committed, with
+   its actual length. */
+uint8_t *pipeline_queue_reserve(pipeline_queue_t *queue, int len);
+void pipeline_queue_commit(pipeline_queue_t *queue, int len);
+
+/* Consumer side. Return the oldest record, or NULL if the queue is empty.
+   The record stays valid until released. */
+uint8_t *pipeline_queue_peek(pipeline_queue_t *queue, int *len);
+void pipeline_queue_release(pipeline_queue_t *queue);
+
+/* Number of records in the queue, can be called from any thread */
+uint32_t pipeline_queue_count(pipeline_queue_t *queue);
+
+/* Return 0 if the pipe could not be created */
+int pipeline_wakeup_init(pipeline_wakeup_t *wakeup);
+int pipeline_wakeup_fd(pipeline_wakeup_t *wakeup);
+void pipeline_wakeup_signal(pipeline_wakeup_t *wakeup);
+/* Must be called before consuming the queue */
+void pipeline_wakeup_clear(pipeline_wakeup_t *wakeup);
+
+#endif /* PIPELINE_QUEUE_H_ */
@@ -37,6 +37,11 @@
 
 #define LOG6LBR_MODULE "TAP"
 
+/* Needed for recvmmsg() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "uip.h"
 #include "uip-ds6.h"
 #include <stdio.h>
@@ -68,6 +73,7 @@
 #include <linux/if_packet.h>
 #include <linux/if.h>
 #include <linux/if_tun.h>
+#include <linux/filter.h>
 struct ifreq if_idx;
 #endif
 
@@ -82,7 +88,13 @@ struct ifreq if_idx;
 #include "raw-tap-dev.h"
 #include "6lbr-network.h"
 #include "native-config.h"
+#include "nvm-config.h"
 #include "log-6lbr.h"
+#include "packet-trace.h"
+#include "pipeline-queue.h"
+
+#include <pthread.h>
+#include <poll.h>
 
 //Temporary, should be removed
 #include "native-rdc.h"
@@ -93,6 +105,26 @@ extern void cetic_6lbr_clear_ip(void);
 
 static int eth_fd;
 
+/* Maximum number of frames read per wakeup */
+#ifdef RAW_TAP_CONF_BATCH_SIZE
+#define RAW_TAP_BATCH_SIZE RAW_TAP_CONF_BATCH_SIZE
+#else
+#define RAW_TAP_BATCH_SIZE 16
+#endif
+
+/* Size of each queue between the Ethernet thread and the Contiki thread */
+#ifdef RAW_TAP_CONF_PIPELINE_QUEUE_SIZE
+#define RAW_TAP_PIPELINE_QUEUE_SIZE RAW_TAP_CONF_PIPELINE_QUEUE_SIZE
+#else
+#define RAW_TAP_PIPELINE_QUEUE_SIZE (256 * 1024)
+#endif
+
+#ifdef linux
+static uip_buf_t batch_buf[RAW_TAP_BATCH_SIZE];
+static struct mmsghdr batch_msgs[RAW_TAP_BATCH_SIZE];
+static struct iovec batch_iovecs[RAW_TAP_BATCH_SIZE];
+#endif
+
 static int set_fd(fd_set * rset, fd_set * wset);
 static void handle_fd(fd_set * rset, fd_set * wset);
 static const struct select_callback eth_select_callback = {
@@ -100,6 +132,23 @@ static const struct select_callback eth_select_callback = {
   handle_fd
 };
 
+/* Pipelined mode, the received frames are stored with their reception time */
+static pipeline_queue_t rx_queue;
+static pipeline_queue_t tx_queue;
+static pipeline_wakeup_t rx_wakeup;
+static pipeline_wakeup_t tx_wakeup;
+static uint8_t rx_discard_buf[ETHERNET_TMP_BUF_SIZE];
+uint32_t eth_dev_rx_dropped;
+uint32_t eth_dev_tx_dropped;
+
+static int pipeline_set_fd(fd_set * rset, fd_set * wset);
+static void pipeline_handle_fd(fd_set * rset, fd_set * wset);
+static const struct select_callback eth_pipeline_callback = {
+  pipeline_set_fd,
+  pipeline_handle_fd
+};
+static void eth_pipeline_init(void);
+
 static uint16_t delaymsec = 0;
 static uint32_t delaystartsec, delaystartmsec;
 
@@ -174,7 +223,50 @@ ifconf(const char *eth_dev)
 }
 /*---------------------------------------------------------------------------*/
 #ifdef linux
-
+/*
+ * Let the kernel drop the frames the 6LBR is not interested in : only IPv6
+ * is accepted, and IPv4 and ARP when NAT64 is enabled.
+ */
+static void
+eth_attach_filter(int sockfd)
+{
+  struct sock_filter filter[] = {
+    /* Load the Ethernet type */
+    BPF_STMT(BPF_LD + BPF_H + BPF_ABS, 12),
+    BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, ETH_P_IPV6, 4, 0),
+    BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, ETH_P_IP, 1, 0),
+    BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, ETH_P_ARP, 0, 1),
+    /* IPv4 accepted only when NAT64 is enabled, patched below */
+    BPF_STMT(BPF_RET + BPF_K, 0),
+    BPF_STMT(BPF_RET + BPF_K, 0),
+    BPF_STMT(BPF_RET + BPF_K, 0xFFFF),
+  };
+  struct sock_fprog prog;
+
+  if((cetic_6lbr_global_flags & CETIC_GLOBAL_IP64) != 0) {
+    filter[4].k = 0xFFFF;
+  }
+  prog.len = sizeof(filter) / sizeof(filter[0]);
+  prog.filter = filter;
+  if(setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+    LOG6LBR_WARN("Could not attach packet filter : %s\n", strerror(errno));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+eth_batch_init(void)
+{
+  int i;
+
+  memset(batch_msgs, 0, sizeof(batch_msgs));
+  for(i = 0; i < RAW_TAP_BATCH_SIZE; i++) {
+    batch_iovecs[i].iov_base = batch_buf[i].u8;
+    batch_iovecs[i].iov_len = ETHERNET_TMP_BUF_SIZE;
+    batch_msgs[i].msg_hdr.msg_iov = &batch_iovecs[i];
+    batch_msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
 static int
 eth_alloc(const char *eth_dev)
 {
@@ -209,6 +301,7 @@ eth_alloc(const char *eth_dev)
     LOG6LBR_FATAL("setsockopt() : %s\n", strerror(errno));
     exit(1);
   }
+  eth_attach_filter(sockfd);
   return sockfd;
 }
 /*---------------------------------------------------------------------------*/
@@ -236,6 +329,8 @@ tap_alloc(char *dev)
     return err;
   }
   strcpy(dev, ifr.ifr_name);
+  /* Needed to drain the device without blocking */
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
   return fd;
 }
 /*---------------------------------------------------------------------------*/
@@ -315,7 +410,14 @@ eth_dev_init()
     exit(1);
   }
 
-  select_set_callback(eth_fd, &eth_select_callback);
+  if(sixlbr_config_pipeline) {
+    eth_pipeline_init();
+  } else {
+    select_set_callback(eth_fd, &eth_select_callback);
+  }
+#ifdef linux
+  eth_batch_init();
+#endif
 
   LOG6LBR_INFO("opened device %s\n", sixlbr_config_eth_device);
 
@@ -338,6 +440,21 @@ eth_dev_init()
 void
 eth_dev_output(uint8_t * data, int len)
 {
+  uint8_t *out;
+
+  if(sixlbr_config_pipeline) {
+    out = pipeline_queue_reserve(&tx_queue, len);
+    if(out == NULL) {
+      __atomic_fetch_add(&eth_dev_tx_dropped, 1, __ATOMIC_RELAXED);
+      LOG6LBR_INFO("eth tx queue full (%d frames)\n", (int)pipeline_queue_count(&tx_queue));
+      return;
+    }
+    memcpy(out, data, len);
+    pipeline_queue_commit(&tx_queue, len);
+    pipeline_wakeup_signal(&tx_wakeup);
+    LOG6LBR_PRINTF(PACKET, TAP_OUT, "queued: %d\n", len);
+    return;
+  }
   if(write(eth_fd, data, len) != len) {
     LOG6LBR_FATAL("write() : %s\n", strerror(errno));
     exit(1);
@@ -351,6 +468,9 @@ eth_dev_input(unsigned char *data, int maxlen)
   int size;
 
   if((size = read(eth_fd, data, maxlen)) == -1) {
+    if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return -1;
+    }
     LOG6LBR_FATAL("read() : %s\n", strerror(errno));
     exit(1);
   }
@@ -358,6 +478,51 @@ eth_dev_input(unsigned char *data, int maxlen)
   return size;
 }
 /*---------------------------------------------------------------------------*/
+#ifdef linux
+/*
+ * Read up to RAW_TAP_BATCH_SIZE frames and feed them to the Ethernet driver
+ * Return the number of frames read
+ */
+static int
+eth_dev_input_batch(void)
+{
+  int count;
+  int i;
+  packet_trace_time_t rx_time;
+
+  if(sixlbr_config_use_raw_ethernet) {
+    count = recvmmsg(eth_fd, batch_msgs, RAW_TAP_BATCH_SIZE, MSG_DONTWAIT, NULL);
+    if(count == -1) {
+      if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return 0;
+      }
+      LOG6LBR_FATAL("recvmmsg() : %s\n", strerror(errno));
+      exit(1);
+    }
+    /* The frames of a batch also wait for the processing of the previous ones */
+    rx_time = PACKET_TRACE_NOW();
+    for(i = 0; i < count; i++) {
+      LOG6LBR_PRINTF(PACKET, TAP_IN, "read: %d\n", batch_msgs[i].msg_len);
+      PACKET_TRACE_BEGIN(PACKET_TRACE_ETH_DEV_INPUT, rx_time);
+      eth_drv_input(batch_buf[i].u8, batch_msgs[i].msg_len);
+      PACKET_TRACE_END();
+    }
+  } else {
+    /* The tap device has no batched read, drain it until EAGAIN */
+    for(count = 0; count < RAW_TAP_BATCH_SIZE; count++) {
+      int size = eth_dev_input(ethernet_tmp_buf, ETHERNET_TMP_BUF_SIZE);
+      if(size < 0) {
+        break;
+      }
+      PACKET_TRACE_BEGIN(PACKET_TRACE_ETH_DEV_INPUT, PACKET_TRACE_NOW());
+      eth_drv_input(ethernet_tmp_buf, size);
+      PACKET_TRACE_END();
+    }
+  }
+  return count;
+}
+#endif
+/*---------------------------------------------------------------------------*/
 static int
 set_fd(fd_set * rset, fd_set * wset)
 {
@@ -396,8 +561,19 @@ handle_fd(fd_set * rset, fd_set * wset)
     int size;
 
     if(FD_ISSET(eth_fd, rset)) {
+#ifdef linux
+      if(sixlbr_config_eth_basedelay == 0) {
+        eth_dev_input_batch();
+        return;
+      }
+#endif
       size = eth_dev_input(ethernet_tmp_buf, ETHERNET_TMP_BUF_SIZE);
+      if(size < 0) {
+        return;
+      }
+      PACKET_TRACE_BEGIN(PACKET_TRACE_ETH_DEV_INPUT, PACKET_TRACE_NOW());
       eth_drv_input(ethernet_tmp_buf, size);
+      PACKET_TRACE_END();
 
       if(sixlbr_config_eth_basedelay) {
         delaymsec = sixlbr_config_eth_basedelay;
@@ -417,3 +593,184 @@ handle_fd(fd_set * rset, fd_set * wset)
   }
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Pipelined mode, the Ethernet thread reads the received frames into
+ * rx_queue and writes the frames queued in tx_queue, the Contiki thread only
+ * processes the frames.
+ */
+static void
+eth_pipeline_read(void)
+{
+  packet_trace_time_t rx_time;
+  uint8_t *data;
+  int count;
+  int size;
+
+  for(count = 0; count < RAW_TAP_BATCH_SIZE; count++) {
+    data = pipeline_queue_reserve(&rx_queue, sizeof(rx_time) + ETHERNET_TMP_BUF_SIZE);
+    if(data == NULL) {
+      /* The Contiki thread is late, drop the frame like a full NIC ring */
+      size = read(eth_fd, rx_discard_buf, sizeof(rx_discard_buf));
+    } else {
+      size = read(eth_fd, data + sizeof(rx_time), ETHERNET_TMP_BUF_SIZE);
+    }
+    if(size == -1) {
+      if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        break;
+      }
+      LOG6LBR_FATAL("read() : %s\n", strerror(errno));
+      exit(1);
+    }
+    if(data == NULL) {
+      __atomic_fetch_add(&eth_dev_rx_dropped, 1, __ATOMIC_RELAXED);
+      continue;
+    }
+    rx_time = PACKET_TRACE_NOW();
+    memcpy(data, &rx_time, sizeof(rx_time));
+    pipeline_queue_commit(&rx_queue, sizeof(rx_time) + size);
+  }
+  if(count > 0) {
+    pipeline_wakeup_signal(&rx_wakeup);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Write the queued frames, a frame that can not be written yet stays at the
+ * head of the queue. Return 1 if frames are still pending.
+ */
+static int
+eth_pipeline_flush(void)
+{
+  uint8_t *data;
+  int len;
+  int n;
+
+  while((data = pipeline_queue_peek(&tx_queue, &len)) != NULL) {
+    n = write(eth_fd, data, len);
+    if(n == -1) {
+      if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return 1;
+      }
+      if(errno == ENOBUFS) {
+        /* The interface queue is full and poll() does not report when it
+           drains, drop the frame */
+        __atomic_fetch_add(&eth_dev_tx_dropped, 1, __ATOMIC_RELAXED);
+      } else {
+        LOG6LBR_FATAL("write() : %s\n", strerror(errno));
+        exit(1);
+      }
+    } else if(n != len) {
+      LOG6LBR_ERROR("write() : %d bytes written out of %d\n", n, len);
+    }
+    pipeline_queue_release(&tx_queue);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void *
+eth_pipeline_thread(void *arg)
+{
+  struct pollfd fds[2];
+  int pending = 0;
+
+  fds[0].fd = eth_fd;
+  fds[1].fd = pipeline_wakeup_fd(&tx_wakeup);
+  fds[1].events = POLLIN;
+  while(1) {
+    fds[0].events = pending ? POLLIN | POLLOUT : POLLIN;
+    if(poll(fds, 2, -1) == -1) {
+      if(errno == EINTR) {
+        continue;
+      }
+      LOG6LBR_FATAL("poll() : %s\n", strerror(errno));
+      exit(1);
+    }
+    if(fds[1].revents & POLLIN) {
+      pipeline_wakeup_clear(&tx_wakeup);
+    }
+    pending = eth_pipeline_flush();
+    if(fds[0].revents & POLLIN) {
+      eth_pipeline_read();
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+eth_pipeline_input(void)
+{
+  packet_trace_time_t rx_time;
+  uint8_t *data;
+  int count;
+  int len;
+
+  pipeline_wakeup_clear(&rx_wakeup);
+  for(count = 0; count < RAW_TAP_BATCH_SIZE; count++) {
+    data = pipeline_queue_peek(&rx_queue, &len);
+    if(data == NULL) {
+      return;
+    }
+    memcpy(&rx_time, data, sizeof(rx_time));
+    len -= sizeof(rx_time);
+    LOG6LBR_PRINTF(PACKET, TAP_IN, "read: %d\n", len);
+    PACKET_TRACE_BEGIN(PACKET_TRACE_ETH_DEV_INPUT, rx_time);
+    eth_drv_input(data + sizeof(rx_time), len);
+    PACKET_TRACE_END();
+    pipeline_queue_release(&rx_queue);
+  }
+  /* Let the other processes run before handling the remaining frames */
+  pipeline_wakeup_signal(&rx_wakeup);
+}
+/*---------------------------------------------------------------------------*/
+static int
+pipeline_set_fd(fd_set * rset, fd_set * wset)
+{
+  FD_SET(pipeline_wakeup_fd(&rx_wakeup), rset);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+pipeline_handle_fd(fd_set * rset, fd_set * wset)
+{
+  if(FD_ISSET(pipeline_wakeup_fd(&rx_wakeup), rset)) {
+    eth_pipeline_input();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+eth_pipeline_init(void)
+{
+  pthread_t thread;
+
+  if(!pipeline_queue_init(&rx_queue, RAW_TAP_PIPELINE_QUEUE_SIZE)
+     || !pipeline_queue_init(&tx_queue, RAW_TAP_PIPELINE_QUEUE_SIZE)
+     || !pipeline_wakeup_init(&rx_wakeup) || !pipeline_wakeup_init(&tx_wakeup)) {
+    LOG6LBR_FATAL("Could not create Ethernet queues\n");
+    exit(1);
+  }
+  if(sixlbr_config_eth_basedelay) {
+    LOG6LBR_WARN("Ethernet base delay is ignored in pipeline mode\n");
+  }
+  /* The thread drains the device until EAGAIN */
+  fcntl(eth_fd, F_SETFL, fcntl(eth_fd, F_GETFL) | O_NONBLOCK);
+  select_set_callback(pipeline_wakeup_fd(&rx_wakeup), &eth_pipeline_callback);
+  if(pthread_create(&thread, NULL, eth_pipeline_thread, NULL) != 0) {
+    LOG6LBR_FATAL("Could not start Ethernet thread\n");
+    exit(1);
+  }
+  pthread_detach(thread);
+  LOG6LBR_INFO("Ethernet pipeline started\n");
+}
+/*---------------------------------------------------------------------------*/
+int
+eth_dev_rx_queue_length(void)
+{
+  return sixlbr_config_pipeline ? pipeline_queue_count(&rx_queue) : 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+eth_dev_tx_queue_length(void)
+{
+  return sixlbr_config_pipeline ? pipeline_queue_count(&tx_queue) : 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -38,4 +38,11 @@
 extern void eth_dev_init();
 extern void eth_dev_output(uint8_t * data, int len);
 
+/* Pipeline mode statistics, the counters are updated by the I/O thread
+   and must be read with __atomic_load_n() */
+extern int eth_dev_rx_queue_length(void);
+extern int eth_dev_tx_queue_length(void);
+extern uint32_t eth_dev_rx_dropped;
+extern uint32_t eth_dev_tx_dropped;
+
 #endif
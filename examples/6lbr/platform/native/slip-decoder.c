@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2013, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Block oriented SLIP decoder
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "slip-decoder.h"
+
+#include <string.h>
+#include <unistd.h>
+
+static uint8_t crc8_table[256];
+static uint8_t crc8_table_ready = 0;
+
+/*---------------------------------------------------------------------------*/
+/* Polynomial ^8 + ^5 + ^4 + 1 */
+uint8_t
+slip_crc8_add(uint8_t acc, uint8_t byte)
+{
+  int i;
+  acc ^= byte;
+  for(i = 0; i < 8; i++) {
+    if(acc & 1) {
+      acc = (acc >> 1) ^ 0x8c;
+    } else {
+      acc >>= 1;
+    }
+  }
+
+  return acc;
+}
+/*---------------------------------------------------------------------------*/
+void
+slip_decoder_init(slip_decoder_t *decoder)
+{
+  int i;
+  if(!crc8_table_ready) {
+    for(i = 0; i < 256; i++) {
+      crc8_table[i] = slip_crc8_add(0, i);
+    }
+    crc8_table_ready = 1;
+  }
+  decoder->frame_len = 0;
+  decoder->state = SLIP_DECODER_STATE_FRAME;
+  decoder->crc = 0;
+  decoder->dropped = 0;
+}
+/*---------------------------------------------------------------------------*/
+unsigned char *
+slip_decoder_rx_ptr(slip_decoder_t *decoder, int *size)
+{
+  *size = SLIP_DECODER_BUF_SIZE - decoder->frame_len;
+  return decoder->buf + decoder->frame_len;
+}
+/*---------------------------------------------------------------------------*/
+int
+slip_decoder_input(slip_decoder_t *decoder, int len, slip_decoder_callback_t callback, void *ptr)
+{
+  unsigned char *buf = decoder->buf;
+  /* Raw data is read from r and decoded data written at w, as unescaping
+   * only shrinks the data, w can never overtake r */
+  int r = decoder->frame_len;
+  int end = decoder->frame_len + len;
+  int w = decoder->frame_len;
+  int frame_start = 0;
+  uint8_t state = decoder->state;
+  uint8_t crc = decoder->crc;
+  int frames = 0;
+  unsigned char c;
+
+  while(r < end) {
+    c = buf[r++];
+    if(state == SLIP_DECODER_STATE_OVERFLOW) {
+      /* Skip the rest of the oversized frame */
+      if(c == SLIP_END) {
+        state = SLIP_DECODER_STATE_FRAME;
+        crc = 0;
+      }
+      continue;
+    }
+    if(state == SLIP_DECODER_STATE_ESCAPE) {
+      state = SLIP_DECODER_STATE_FRAME;
+      if(c == SLIP_ESC_END) {
+        c = SLIP_END;
+      } else if(c == SLIP_ESC_ESC) {
+        c = SLIP_ESC;
+      }
+    } else if(c == SLIP_END) {
+      if(w > frame_start) {
+        frames++;
+        callback(ptr, buf + frame_start, w - frame_start, crc);
+        frame_start = w;
+      }
+      crc = 0;
+      continue;
+    } else if(c == SLIP_ESC) {
+      state = SLIP_DECODER_STATE_ESCAPE;
+      continue;
+    }
+    if(w - frame_start >= SLIP_DECODER_MAX_FRAME) {
+      decoder->dropped++;
+      w = frame_start;
+      state = SLIP_DECODER_STATE_OVERFLOW;
+      continue;
+    }
+    buf[w++] = c;
+    crc = crc8_table[crc ^ c];
+  }
+  /* Keep the partial frame at the start of the buffer */
+  if(frame_start > 0 && w > frame_start) {
+    memmove(buf, buf + frame_start, w - frame_start);
+  }
+  decoder->frame_len = w - frame_start;
+  decoder->state = state;
+  decoder->crc = crc;
+  return frames;
+}
+/*---------------------------------------------------------------------------*/
+int
+slip_decoder_read(slip_decoder_t *decoder, int fd, slip_decoder_callback_t callback, void *ptr)
+{
+  unsigned char *rx;
+  int size;
+  int n;
+
+  rx = slip_decoder_rx_ptr(decoder, &size);
+  n = read(fd, rx, size);
+  if(n > 0) {
+    slip_decoder_input(decoder, n, callback, ptr);
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2013, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Block oriented SLIP decoder
+ *
+ *         Raw bytes are read in one go at the end of the receive buffer and
+ *         unescaped in place, the CRC8 being accumulated in the same pass.
+ *         Only the trailing partial frame is moved back to the start of the
+ *         buffer once the whole block has been processed.
+ *
+ *         This module does not depend on Contiki so that it can be used by
+ *         the host tools (see tools/slip_replay.c).
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#ifndef SLIP_DECODER_H_
+#define SLIP_DECODER_H_
+
+#include <stdint.h>
+
+#define SLIP_END     0300
+#define SLIP_ESC     0333
+#define SLIP_ESC_END 0334
+#define SLIP_ESC_ESC 0335
+
+/* Decoder states */
+/* Inside a frame, or between frames */
+#define SLIP_DECODER_STATE_FRAME    0
+/* The last byte received was a SLIP_ESC */
+#define SLIP_DECODER_STATE_ESCAPE   1
+/* The current frame is larger than SLIP_DECODER_MAX_FRAME, its bytes are
+ * skipped until the next SLIP_END */
+#define SLIP_DECODER_STATE_OVERFLOW 2
+
+#ifdef SLIP_DECODER_CONF_BUF_SIZE
+#define SLIP_DECODER_BUF_SIZE SLIP_DECODER_CONF_BUF_SIZE
+#else
+#define SLIP_DECODER_BUF_SIZE 4096
+#endif
+
+/* Largest frame accepted, frames bigger than that are dropped */
+#ifdef SLIP_DECODER_CONF_MAX_FRAME
+#define SLIP_DECODER_MAX_FRAME SLIP_DECODER_CONF_MAX_FRAME
+#else
+#define SLIP_DECODER_MAX_FRAME 2048
+#endif
+
+/*
+ * Called for each complete frame. len includes the trailing CRC byte, if any,
+ * crc is the CRC8 accumulated over the whole frame and must be 0 if the frame
+ * carries a valid CRC.
+ */
+typedef void (*slip_decoder_callback_t)(void *ptr, unsigned char *frame, int len, uint8_t crc);
+
+typedef struct {
+  unsigned char buf[SLIP_DECODER_BUF_SIZE];
+  /* Decoded bytes of the current partial frame, stored at the start of buf */
+  int frame_len;
+  /* One of the SLIP_DECODER_STATE_ values */
+  uint8_t state;
+  /* CRC8 of the current partial frame */
+  uint8_t crc;
+  /* statistics */
+  uint32_t dropped;
+} slip_decoder_t;
+
+void slip_decoder_init(slip_decoder_t *decoder);
+
+/*
+ * Return the location and the size of the free space where new raw data
+ * must be written before calling slip_decoder_input()
+ */
+unsigned char *slip_decoder_rx_ptr(slip_decoder_t *decoder, int *size);
+
+/*
+ * Decode len raw bytes previously written at slip_decoder_rx_ptr()
+ * Return the number of complete frames found.
+ */
+int slip_decoder_input(slip_decoder_t *decoder, int len, slip_decoder_callback_t callback, void *ptr);
+
+/*
+ * Do a single read() from fd, of at most the free space of the receive
+ * buffer, and decode the data. Data left in fd is read on the next call,
+ * the callers poll fd until it is no longer readable.
+ * Return the number of bytes read, 0 on EOF or -1 on error (errno is set
+ * accordingly, EAGAIN means there is nothing left to read)
+ */
+int slip_decoder_read(slip_decoder_t *decoder, int fd, slip_decoder_callback_t callback, void *ptr);
+
+uint8_t slip_crc8_add(uint8_t acc, uint8_t byte);
+
+#endif /* SLIP_DECODER_H_ */
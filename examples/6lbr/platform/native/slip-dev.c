@@ -46,10 +46,13 @@
 #include <termios.h>
 #include <signal.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
 #include <errno.h>
 
 #include "log-6lbr.h"
@@ -63,6 +66,9 @@
 #include "multi-radio.h"
 #include "native-rdc.h"
 #include "slip-dev.h"
+#include "packet-trace.h"
+#include "slip-decoder.h"
+#include "pipeline-queue.h"
 
 //Temporary until proper multi mac layer configuration
 extern const struct mac_driver CETIC_6LBR_MULTI_RADIO_DEFAULT_MAC;
@@ -70,11 +76,6 @@ extern const struct mac_driver CETIC_6LBR_MULTI_RADIO_DEFAULT_MAC;
 //#define PROGRESS(s) fprintf(stderr, s)
 #define PROGRESS(s) do { } while(0)
 
-#define SLIP_END     0300
-#define SLIP_ESC     0333
-#define SLIP_ESC_END 0334
-#define SLIP_ESC_ESC 0335
-
 #define DEBUG_LINE_MARKER '\r'
 
 static slip_descr_t slip_devices[SLIP_MAX_DEVICE];
@@ -86,6 +87,9 @@ slip_descr_t * slip_default_device;
 uint8_t multi_radio_input_ifindex = NETWORK_ITF_UNKNOWN;
 uint8_t multi_radio_output_ifindex = NETWORK_ITF_UNKNOWN;
 #endif
+
+/* Time of the last read, the frames it contains are traced from there */
+static packet_trace_time_t rx_time;
 /*---------------------------------------------------------------------------*/
 speed_t
 convert_baud_rate(int baudrate)
@@ -205,23 +209,6 @@ find_slip_dev(uint8_t ifindex)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
-/* Polynomial ^8 + ^5 + ^4 + 1 */
-static uint8_t
-crc8_add(uint8_t acc, uint8_t byte)
-{
-  int i;
-  acc ^= byte;
-  for(i = 0; i < 8; i++) {
-    if(acc & 1) {
-      acc = (acc >> 1) ^ 0x8c;
-    } else {
-      acc >>= 1;
-    }
-  }
-
-  return acc;
-}
-/*---------------------------------------------------------------------------*/
 static void *
 get_in_addr(struct sockaddr *sa)
 {
@@ -293,191 +280,230 @@ is_sensible_string(const unsigned char *s, int len)
   return 1;
 }
 /*---------------------------------------------------------------------------*/
+static void
+slip_frame_input(void *ptr, unsigned char *inbuf, int inbufptr, uint8_t crc)
+{
+  slip_descr_t *slip_device = ptr;
+
+  slip_device->message_received++;
+  LOG6LBR_PRINTF(PACKET, SLIP_IN, "read: %d\n", inbufptr);
+  LOG6LBR_DUMP_PACKET(SLIP_IN, inbuf, inbufptr);
+  if(slip_device->crc8 && inbuf[0] != DEBUG_LINE_MARKER) {
+    if(crc) {
+      /* report error and ignore the packet */
+      slip_device->crc_errors++;
+      LOG6LBR_INFO("Packet received with invalid CRC\n");
+      return;
+    } else {
+      inbufptr--; /* remove the CRC byte */
+    }
+  }
+  if(inbuf[0] == '!') {
+    command_context = CMD_CONTEXT_RADIO;
+    multi_radio_input_ifindex = slip_device->ifindex;
+    cmd_input(inbuf, inbufptr);
+    multi_radio_input_ifindex = NETWORK_ITF_UNKNOWN;
+  } else if(inbuf[0] == '?') {
+  } else if(inbuf[0] == DEBUG_LINE_MARKER) {
+    LOG6LBR_WRITE(INFO, SLIP_DBG, inbuf + 1, inbufptr - 1);
+  } else if(inbuf[0] == 'E' && is_sensible_string(inbuf, inbufptr) ) {
+    LOG6LBR_WRITE(ERROR, GLOBAL, inbuf + 1, inbufptr - 1);
+    LOG6LBR_APPEND(ERROR, GLOBAL, "\n");
+    slip_error_callback(inbuf + 1);
+  } else if(is_sensible_string(inbuf, inbufptr)) {
+    LOG6LBR_WRITE(INFO, SLIP_DBG, inbuf, inbufptr);
+  } else {
+    PACKET_TRACE_BEGIN(PACKET_TRACE_SLIP_INPUT, rx_time);
+    native_rdc_packet_input(slip_device, inbuf, inbufptr);
+    PACKET_TRACE_END();
+  }
+}
+/*---------------------------------------------------------------------------*/
 /*
- * Read from serial, when we have a packet call slip_packet_input. No output
- * buffering, input buffered by stdio.
+ * Read from serial, as much data as the device receive buffer can hold is
+ * read at once and slip_frame_input() is called for each complete frame.
  */
 static void
 serial_input(slip_descr_t *slip_device)
 {
-  static unsigned char inbuf[2048];
-  static int inbufptr = 0;
   int ret;
-  unsigned char c;
+  uint32_t dropped = slip_device->decoder.dropped;
 
-#ifdef linux
-  ret = fread(&c, 1, 1, slip_device->inslip);
-  if(ret == -1 || ret == 0) {
-    LOG6LBR_FATAL("read() : %s\n", strerror(errno));
+  rx_time = PACKET_TRACE_NOW();
+  ret = slip_decoder_read(&slip_device->decoder, slip_device->slipfd, slip_frame_input, slip_device);
+  if(ret == 0) {
+    LOG6LBR_FATAL("read() : end of file\n");
     exit(1);
   }
-  goto after_fread;
-#endif
-
-read_more:
-  if(inbufptr >= sizeof(inbuf)) {
-    LOG6LBR_ERROR("*** dropping large %d byte packet\n", inbufptr);
-    inbufptr = 0;
-  }
-  ret = fread(&c, 1, 1, slip_device->inslip);
-#ifdef linux
-after_fread:
-#endif
   if(ret == -1) {
+    if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return;
+    }
     LOG6LBR_FATAL("read() : %s\n", strerror(errno));
     exit(1);
   }
-  if(ret == 0) {
-    clearerr(slip_device->inslip);
-    return;
+  __atomic_fetch_add(&slip_device->bytes_received, ret, __ATOMIC_RELAXED);
+  if(slip_device->decoder.dropped != dropped) {
+    LOG6LBR_ERROR("*** dropping large packet\n");
   }
-  slip_device->bytes_received++;
-  switch (c) {
-  case SLIP_END:
-    if(inbufptr > 0) {
-      slip_device->message_received++;
-      LOG6LBR_PRINTF(PACKET, SLIP_IN, "read: %d\n", inbufptr);
-      LOG6LBR_DUMP_PACKET(SLIP_IN, inbuf, inbufptr);
-      if(slip_device->crc8 && inbuf[0] != DEBUG_LINE_MARKER) {
-        uint8_t crc = 0;
-        int i;
-        for(i = 0; i < inbufptr; i++) {
-          crc = crc8_add(crc, inbuf[i]);
-        }
-        if(crc) {
-          /* report error and ignore the packet */
-          slip_device->crc_errors++;
-          LOG6LBR_INFO("Packet received with invalid CRC\n");
-          inbufptr = 0;
-          return;
-        } else {
-          inbufptr--; /* remove the CRC byte */
-        }
-      }
-      if(inbuf[0] == '!') {
-        command_context = CMD_CONTEXT_RADIO;
-        multi_radio_input_ifindex = slip_device->ifindex;
-        cmd_input(inbuf, inbufptr);
-        multi_radio_input_ifindex = NETWORK_ITF_UNKNOWN;
-      } else if(inbuf[0] == '?') {
-      } else if(inbuf[0] == DEBUG_LINE_MARKER) {
-        LOG6LBR_WRITE(INFO, SLIP_DBG, inbuf + 1, inbufptr - 1);
-      } else if(inbuf[0] == 'E' && is_sensible_string(inbuf, inbufptr) ) {
-        LOG6LBR_WRITE(ERROR, GLOBAL, inbuf + 1, inbufptr - 1);
-        LOG6LBR_APPEND(ERROR, GLOBAL, "\n");
-        slip_error_callback(inbuf + 1);
-      } else if(is_sensible_string(inbuf, inbufptr)) {
-        LOG6LBR_WRITE(INFO, SLIP_DBG, inbuf, inbufptr);
-      } else {
-        native_rdc_packet_input(slip_device, inbuf, inbufptr);
-      }
-      inbufptr = 0;
-    }
-    break;
-
-  case SLIP_ESC:
-    if(fread(&c, 1, 1, slip_device->inslip) != 1) {
-      clearerr(slip_device->inslip);
-      /* Put ESC back and give up! */
-      ungetc(SLIP_ESC, slip_device->inslip);
-      return;
-    }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Reserve room for a frame of at most len escaped bytes at the end of the
+ * transmit queue. Frames are never split, if the frame does not fit at the
+ * end of the buffer, it is stored at the beginning.
+ */
+static unsigned char *
+slip_tx_reserve(slip_descr_t *slip_device, int len, int *offset)
+{
+  slip_tx_frame_t *head;
+  slip_tx_frame_t *tail;
+  int write_pos;
 
-    switch (c) {
-    case SLIP_ESC_END:
-      c = SLIP_END;
-      break;
-    case SLIP_ESC_ESC:
-      c = SLIP_ESC;
-      break;
+  if(slip_device->tx_count == SLIP_TX_QUEUE_SIZE || len > SLIP_TX_BUF_SIZE) {
+    return NULL;
+  }
+  if(slip_device->tx_count == 0) {
+    *offset = 0;
+    return slip_device->tx_buf;
+  }
+  head = &slip_device->tx_frames[slip_device->tx_head];
+  tail = &slip_device->tx_frames[(slip_device->tx_head + slip_device->tx_count - 1) % SLIP_TX_QUEUE_SIZE];
+  write_pos = tail->offset + tail->len;
+  if(write_pos > head->offset) {
+    if(write_pos + len <= SLIP_TX_BUF_SIZE) {
+      *offset = write_pos;
+    } else if(len <= head->offset) {
+      *offset = 0;
+    } else {
+      return NULL;
     }
-    /* FALLTHROUGH */
-  default:
-    inbuf[inbufptr++] = c;
-    break;
+  } else if(write_pos + len <= head->offset) {
+    *offset = write_pos;
+  } else {
+    return NULL;
   }
-
-  goto read_more;
+  return slip_device->tx_buf + *offset;
 }
 /*---------------------------------------------------------------------------*/
 static void
-slip_send(slip_descr_t *slip_device, unsigned char c)
+slip_tx_commit(slip_descr_t *slip_device, int offset, int len)
 {
-  if(slip_device->slip_end >= sizeof(slip_device->slip_buf)) {
-    LOG6LBR_FATAL("slip_send overflow\n");
-    exit(1);
-  }
-  slip_device->slip_buf[slip_device->slip_end] = c;
-  slip_device->slip_end++;
-  slip_device->bytes_sent++;
-  if(c == SLIP_END) {
-    /* Full packet received. */
-    slip_device->slip_packet_count++;
-    if(slip_device->slip_packet_end == 0) {
-      slip_device->slip_packet_end = slip_device->slip_end;
-    }
-  }
+  slip_tx_frame_t *frame;
+
+  frame = &slip_device->tx_frames[(slip_device->tx_head + slip_device->tx_count) % SLIP_TX_QUEUE_SIZE];
+  frame->offset = offset;
+  frame->len = len;
+#if CETIC_6LBR_PACKET_TRACE
+  frame->queued = packet_trace_now();
+#endif
+  slip_device->tx_count++;
+  slip_device->bytes_sent += len;
 }
 /*---------------------------------------------------------------------------*/
 static int
 slip_empty(slip_descr_t *slip_device)
 {
-  return slip_device->slip_packet_end == 0;
+  return slip_device->tx_count == 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+slip_tx_queue_length(slip_descr_t *slip_device)
+{
+  if(slip_device->tx_queue.buf != NULL) {
+    return pipeline_queue_count(&slip_device->tx_queue);
+  }
+  return slip_device->tx_count;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_delay_expired(void *ptr)
+{
+  /* Nothing to do, the transmit queue is flushed by the main loop */
 }
 /*---------------------------------------------------------------------------*/
 static void
 slip_flushbuf(slip_descr_t *slip_device)
 {
+  struct iovec iov[SLIP_TX_IOV_MAX];
+  slip_tx_frame_t *frame;
+  int iovcnt;
+  int max_frames;
+  int sent_frames;
   int n;
 
   if(slip_empty(slip_device)) {
     return;
   }
 
-  n = write(slip_device->slipfd, slip_device->slip_buf + slip_device->slip_begin,
-      slip_device->slip_packet_end - slip_device->slip_begin);
+  /* When a delay is required between slip packets, send them one by one */
+  max_frames = slip_device->send_delay > 0 ? 1 : SLIP_TX_IOV_MAX;
+  for(iovcnt = 0; iovcnt < slip_device->tx_count && iovcnt < max_frames; iovcnt++) {
+    frame = &slip_device->tx_frames[(slip_device->tx_head + iovcnt) % SLIP_TX_QUEUE_SIZE];
+    iov[iovcnt].iov_base = slip_device->tx_buf + frame->offset;
+    iov[iovcnt].iov_len = frame->len;
+  }
+  iov[0].iov_base = (unsigned char *)iov[0].iov_base + slip_device->tx_sent;
+  iov[0].iov_len -= slip_device->tx_sent;
+
+  n = writev(slip_device->slipfd, iov, iovcnt);
 
-  if(n == -1 && errno != EAGAIN) {
-    LOG6LBR_FATAL("slip_flushbuf::write() : %s\n", strerror(errno));
+  if(n == -1 && errno != EAGAIN && errno != EINTR) {
+    LOG6LBR_FATAL("slip_flushbuf::writev() : %s\n", strerror(errno));
     exit(1);
   } else if(n == -1) {
     PROGRESS("Q");              /* Outqueue is full! */
   } else {
-    slip_device->slip_begin += n;
-    if(slip_device->slip_begin == slip_device->slip_packet_end) {
-      slip_device->slip_packet_count--;
-      if(slip_device->slip_end > slip_device->slip_packet_end) {
-        memcpy(slip_device->slip_buf, slip_device->slip_buf + slip_device->slip_packet_end,
-            slip_device->slip_end - slip_device->slip_packet_end);
-      }
-      slip_device->slip_end -= slip_device->slip_packet_end;
-      slip_device->slip_begin = slip_device->slip_packet_end = 0;
-      if(slip_device->slip_end > 0) {
-        /* Find end of next slip packet */
-        for(n = 1; n < slip_device->slip_end; n++) {
-          if(slip_device->slip_buf[n] == SLIP_END) {
-            slip_device->slip_packet_end = n + 1;
-            break;
-          }
-        }
-        /* a delay between slip packets to avoid losing data */
-        if(slip_device->send_delay > 0) {
-          timer_set(&slip_device->send_delay_timer, (CLOCK_SECOND * slip_device->send_delay) / 1000);
-        }
+    n += slip_device->tx_sent;
+    sent_frames = 0;
+    while(slip_device->tx_count > 0) {
+      frame = &slip_device->tx_frames[slip_device->tx_head];
+      if(n < frame->len) {
+        break;
       }
+      n -= frame->len;
+      PACKET_TRACE_SAMPLE(PACKET_TRACE_SLIP_FLUSH, packet_trace_now() - frame->queued);
+      slip_device->tx_head = (slip_device->tx_head + 1) % SLIP_TX_QUEUE_SIZE;
+      slip_device->tx_count--;
+      sent_frames++;
+    }
+    slip_device->tx_sent = n;
+    if(sent_frames > 0 && slip_device->tx_count > 0 && slip_device->send_delay > 0) {
+      /* a delay between slip packets to avoid losing data */
+      timer_set(&slip_device->send_delay_timer, (CLOCK_SECOND * slip_device->send_delay) / 1000);
+      ctimer_set(&slip_device->send_delay_wakeup, (CLOCK_SECOND * slip_device->send_delay) / 1000,
+                 send_delay_expired, slip_device);
     }
   }
 }
 /*---------------------------------------------------------------------------*/
-/* writes an 802.15.4 packet to slip-radio */
-void
+/*
+ * Queue an 802.15.4 packet for the slip-radio
+ * Return 0 on success or -1 if the transmit queue is full
+ */
+int
 write_to_slip(slip_descr_t *slip_device, const uint8_t * inbuf, int len)
 {
   const uint8_t *p = inbuf;
+  unsigned char *out;
+  int offset;
+  int pos;
   int i;
   uint8_t crc;
   if(slip_device == NULL) {
-    return;
+    return -1;
+  }
+
+  /* Worst case : every byte and the CRC escaped, plus SLIP_END */
+  if(slip_device->tx_queue.buf != NULL) {
+    out = pipeline_queue_reserve(&slip_device->tx_queue, 2 * (len + 1) + 1);
+  } else {
+    out = slip_tx_reserve(slip_device, 2 * (len + 1) + 1, &offset);
+  }
+  if(out == NULL) {
+    slip_device->tx_queue_full++;
+    LOG6LBR_INFO("slip tx queue full (%d frames)\n", slip_tx_queue_length(slip_device));
+    return -1;
   }
 
   slip_device->message_sent++;
@@ -488,40 +514,48 @@ write_to_slip(slip_descr_t *slip_device, const uint8_t * inbuf, int len)
   /* It would be ``nice'' to send a SLIP_END here but it's not
    * really necessary.
    */
-  /* slip_send(outfd, SLIP_END); */
 
   crc = 0;
+  pos = 0;
   for(i = 0; i < len; i++) {
     if(slip_device->crc8) {
-      crc = crc8_add(crc, p[i]);
+      crc = slip_crc8_add(crc, p[i]);
     }
     switch (p[i]) {
     case SLIP_END:
-      slip_send(slip_device, SLIP_ESC);
-      slip_send(slip_device, SLIP_ESC_END);
+      out[pos++] = SLIP_ESC;
+      out[pos++] = SLIP_ESC_END;
       break;
     case SLIP_ESC:
-      slip_send(slip_device, SLIP_ESC);
-      slip_send(slip_device, SLIP_ESC_ESC);
+      out[pos++] = SLIP_ESC;
+      out[pos++] = SLIP_ESC_ESC;
       break;
     default:
-      slip_send(slip_device, p[i]);
+      out[pos++] = p[i];
       break;
     }
   }
   if(slip_device->crc8) {
     /* Write the checksum byte */
     if(crc == SLIP_END) {
-      slip_send(slip_device, SLIP_ESC);
+      out[pos++] = SLIP_ESC;
       crc = SLIP_ESC_END;
     } else if (crc == SLIP_ESC)  {
-      slip_send(slip_device, SLIP_ESC);
+      out[pos++] = SLIP_ESC;
       crc = SLIP_ESC_ESC;
     }
-    slip_send(slip_device, crc);
+    out[pos++] = crc;
+  }
+  out[pos++] = SLIP_END;
+  if(slip_device->tx_queue.buf != NULL) {
+    pipeline_queue_commit(&slip_device->tx_queue, pos);
+    pipeline_wakeup_signal(&slip_device->tx_wakeup);
+    slip_device->bytes_sent += pos;
+  } else {
+    slip_tx_commit(slip_device, offset, pos);
   }
-  slip_send(slip_device, SLIP_END);
   PROGRESS("t");
+  return 0;
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -636,6 +670,221 @@ handle_fd(fd_set * rset, fd_set * wset)
 /*---------------------------------------------------------------------------*/
 static const struct select_callback slip_callback = { set_fd, handle_fd };
 /*---------------------------------------------------------------------------*/
+/*
+ * Pipelined mode, each SLIP device has its own thread which decodes the
+ * received frames into rx_queue and writes the escaped frames queued in
+ * tx_queue, the Contiki thread only processes the frames.
+ *
+ * A record of rx_queue is the frame prefixed by its reception time and
+ * CRC status, padded to keep the frame aligned.
+ */
+#define SLIP_PIPELINE_RX_HDR_SIZE 8
+
+typedef struct {
+  slip_descr_t *slip_device;
+  packet_trace_time_t rx_time;
+} slip_pipeline_context_t;
+
+static void
+slip_pipeline_push(void *ptr, unsigned char *frame, int len, uint8_t crc)
+{
+  slip_pipeline_context_t *context = ptr;
+  slip_descr_t *slip_device = context->slip_device;
+  uint8_t *data;
+
+  data = pipeline_queue_reserve(&slip_device->rx_queue, SLIP_PIPELINE_RX_HDR_SIZE + len);
+  if(data == NULL) {
+    __atomic_fetch_add(&slip_device->rx_queue_full, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  memcpy(data, &context->rx_time, sizeof(context->rx_time));
+  data[sizeof(context->rx_time)] = crc;
+  memcpy(data + SLIP_PIPELINE_RX_HDR_SIZE, frame, len);
+  pipeline_queue_commit(&slip_device->rx_queue, SLIP_PIPELINE_RX_HDR_SIZE + len);
+}
+/*---------------------------------------------------------------------------*/
+static int64_t
+slip_pipeline_now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Write the queued frames, the head frame may be partially written.
+ * Return 1 if frames are still pending.
+ */
+static int
+slip_pipeline_flush(slip_descr_t *slip_device, int64_t *next_tx)
+{
+  uint8_t *data;
+  int len;
+  int n;
+
+  while((data = pipeline_queue_peek(&slip_device->tx_queue, &len)) != NULL) {
+    if(slip_device->send_delay > 0 && slip_pipeline_now_ms() < *next_tx) {
+      return 1;
+    }
+    n = write(slip_device->slipfd, data + slip_device->tx_sent, len - slip_device->tx_sent);
+    if(n == -1) {
+      if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return 1;
+      }
+      LOG6LBR_FATAL("slip_pipeline_flush::write() : %s\n", strerror(errno));
+      exit(1);
+    }
+    slip_device->tx_sent += n;
+    if(slip_device->tx_sent < len) {
+      return 1;
+    }
+    slip_device->tx_sent = 0;
+    pipeline_queue_release(&slip_device->tx_queue);
+    if(slip_device->send_delay > 0) {
+      /* a delay between slip packets to avoid losing data */
+      *next_tx = slip_pipeline_now_ms() + slip_device->send_delay;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void *
+slip_pipeline_thread(void *arg)
+{
+  slip_descr_t *slip_device = arg;
+  slip_pipeline_context_t context;
+  struct pollfd fds[2];
+  int64_t next_tx = 0;
+  int pending = 0;
+  int timeout;
+  int ret;
+
+  context.slip_device = slip_device;
+  fds[0].fd = slip_device->slipfd;
+  fds[1].fd = pipeline_wakeup_fd(&slip_device->tx_wakeup);
+  fds[1].events = POLLIN;
+  while(1) {
+    fds[0].events = POLLIN;
+    timeout = -1;
+    if(pending) {
+      if(slip_device->send_delay > 0 && next_tx > slip_pipeline_now_ms()) {
+        timeout = next_tx - slip_pipeline_now_ms();
+      } else {
+        fds[0].events |= POLLOUT;
+      }
+    }
+    if(poll(fds, 2, timeout) == -1) {
+      if(errno == EINTR) {
+        continue;
+      }
+      LOG6LBR_FATAL("poll() : %s\n", strerror(errno));
+      exit(1);
+    }
+    if(fds[1].revents & POLLIN) {
+      pipeline_wakeup_clear(&slip_device->tx_wakeup);
+    }
+    pending = slip_pipeline_flush(slip_device, &next_tx);
+    if(fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+      context.rx_time = PACKET_TRACE_NOW();
+      ret = slip_decoder_read(&slip_device->decoder, slip_device->slipfd, slip_pipeline_push, &context);
+      if(ret == 0) {
+        LOG6LBR_FATAL("read() : end of file\n");
+        exit(1);
+      }
+      if(ret == -1) {
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          LOG6LBR_FATAL("read() : %s\n", strerror(errno));
+          exit(1);
+        }
+      } else {
+        __atomic_fetch_add(&slip_device->bytes_received, ret, __ATOMIC_RELAXED);
+        pipeline_wakeup_signal(&slip_device->rx_wakeup);
+      }
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+slip_pipeline_input(slip_descr_t *slip_device)
+{
+  uint8_t *data;
+  int count;
+  int len;
+
+  pipeline_wakeup_clear(&slip_device->rx_wakeup);
+  for(count = 0; count < SLIP_PIPELINE_BATCH_SIZE; count++) {
+    data = pipeline_queue_peek(&slip_device->rx_queue, &len);
+    if(data == NULL) {
+      return;
+    }
+    memcpy(&rx_time, data, sizeof(rx_time));
+    slip_frame_input(slip_device, data + SLIP_PIPELINE_RX_HDR_SIZE,
+                     len - SLIP_PIPELINE_RX_HDR_SIZE, data[sizeof(rx_time)]);
+    pipeline_queue_release(&slip_device->rx_queue);
+  }
+  /* Let the other processes run before handling the remaining frames */
+  pipeline_wakeup_signal(&slip_device->rx_wakeup);
+}
+/*---------------------------------------------------------------------------*/
+static int
+pipeline_set_fd(fd_set * rset, fd_set * wset)
+{
+  int i;
+  for(i = 0; i < SLIP_MAX_DEVICE; ++i) {
+    if(slip_devices[i].isused && slip_devices[i].rx_queue.buf != NULL) {
+      FD_SET(pipeline_wakeup_fd(&slip_devices[i].rx_wakeup), rset);
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+pipeline_handle_fd(fd_set * rset, fd_set * wset)
+{
+  int i;
+  int fd;
+  for(i = 0; i < SLIP_MAX_DEVICE; ++i) {
+    if(slip_devices[i].isused && slip_devices[i].rx_queue.buf != NULL) {
+      fd = pipeline_wakeup_fd(&slip_devices[i].rx_wakeup);
+      if(FD_ISSET(fd, rset)) {
+        slip_pipeline_input(&slip_devices[i]);
+        FD_CLR(fd, rset);
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const struct select_callback slip_pipeline_callback = { pipeline_set_fd, pipeline_handle_fd };
+/*---------------------------------------------------------------------------*/
+static void
+slip_pipeline_init(slip_descr_t *slip_device)
+{
+  pthread_t thread;
+  uint8_t *data;
+
+  if(!pipeline_queue_init(&slip_device->rx_queue, SLIP_PIPELINE_QUEUE_SIZE)
+     || !pipeline_queue_init(&slip_device->tx_queue, SLIP_PIPELINE_QUEUE_SIZE)
+     || !pipeline_wakeup_init(&slip_device->rx_wakeup)
+     || !pipeline_wakeup_init(&slip_device->tx_wakeup)) {
+    LOG6LBR_FATAL("Could not create SLIP queues\n");
+    exit(1);
+  }
+  fcntl(slip_device->slipfd, F_SETFL, fcntl(slip_device->slipfd, F_GETFL) | O_NONBLOCK);
+  select_set_callback(pipeline_wakeup_fd(&slip_device->rx_wakeup), &slip_pipeline_callback);
+  /* Flush any garbage in the radio receive buffer */
+  data = pipeline_queue_reserve(&slip_device->tx_queue, 1);
+  data[0] = SLIP_END;
+  pipeline_queue_commit(&slip_device->tx_queue, 1);
+  if(pthread_create(&thread, NULL, slip_pipeline_thread, slip_device) != 0) {
+    LOG6LBR_FATAL("Could not start SLIP thread\n");
+    exit(1);
+  }
+  pthread_detach(thread);
+  LOG6LBR_INFO("SLIP pipeline started\n");
+}
+/*---------------------------------------------------------------------------*/
 void
 slip_init_dev(slip_descr_t *slip_device)
 {
@@ -666,7 +915,9 @@ slip_init_dev(slip_descr_t *slip_device)
     exit(1);
   }
 
-  select_set_callback(slip_device->slipfd, &slip_callback);
+  if(!sixlbr_config_pipeline) {
+    select_set_callback(slip_device->slipfd, &slip_callback);
+  }
 
   if(slip_device->host != NULL) {
     LOG6LBR_INFO("SLIP opened to %s:%s\n", slip_device->host,
@@ -677,12 +928,14 @@ slip_init_dev(slip_descr_t *slip_device)
   }
 
   timer_set(&slip_device->send_delay_timer, 0);
-  slip_send(slip_device, SLIP_END);
-  slip_device->inslip = fdopen(slip_device->slipfd, "r");
-  if(slip_device->inslip == NULL) {
-    LOG6LBR_FATAL("main: fdopen: %s\n", strerror(errno));
-    exit(1);
+  slip_decoder_init(&slip_device->decoder);
+  if(sixlbr_config_pipeline) {
+    slip_pipeline_init(slip_device);
+    return;
   }
+  /* Flush any garbage in the radio receive buffer */
+  slip_device->tx_buf[0] = SLIP_END;
+  slip_tx_commit(slip_device, 0, 1);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -715,6 +968,7 @@ slip_new_device(void)
     slip_devices[i].send_delay = SIXLBR_CONFIG_DEFAULT_SLIP_SEND_DELAY;
     slip_devices[i].timeout = SIXLBR_CONFIG_DEFAULT_SLIP_TIMEOUT;
     slip_devices[i].retransmit = SIXLBR_CONFIG_DEFAULT_SLIP_RETRANSMIT;
+    slip_devices[i].window = SIXLBR_CONFIG_DEFAULT_SLIP_WINDOW;
     slip_devices[i].serialize_tx_attrs = SIXLBR_CONFIG_DEFAULT_SLIP_SERIALIZE_TX;
     slip_devices[i].deserialize_rx_attrs = SIXLBR_CONFIG_DEFAULT_SLIP_DESERIALIZE_RX;
     slip_devices[i].crc8 = SIXLBR_CONFIG_DEFAULT_SLIP_CRC8;
@@ -746,9 +1000,14 @@ slip_init(void)
 void
 slip_close(void)
 {
-  int i;
+  int i, j;
   for(i = 0; i < SLIP_MAX_DEVICE; ++i) {
-    if(slip_devices[i].isused) {
+    if(slip_devices[i].isused && slip_devices[i].tx_queue.buf != NULL) {
+      /* Give some time to the SLIP thread to send the pending frames */
+      for(j = 0; j < 100 && pipeline_queue_count(&slip_devices[i].tx_queue) > 0; j++) {
+        usleep(1000);
+      }
+    } else if(slip_devices[i].isused) {
       slip_flushbuf(&slip_devices[i]);
     }
   }
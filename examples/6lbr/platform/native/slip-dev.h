@@ -40,7 +40,11 @@
 #define NATIVE_SLIP_H_
 
 #include "contiki-conf.h"
+#include "sys/ctimer.h"
 #include "network-itf.h"
+#include "slip-decoder.h"
+#include "packet-trace.h"
+#include "pipeline-queue.h"
 #include <stdio.h>
 #include <termios.h>
 
@@ -50,6 +54,51 @@
 #define SLIP_MAX_DEVICE 1
 #endif
 
+/* Size of the transmit buffer holding the escaped frames */
+#ifdef SLIP_CONF_TX_BUF_SIZE
+#define SLIP_TX_BUF_SIZE SLIP_CONF_TX_BUF_SIZE
+#else
+#define SLIP_TX_BUF_SIZE 16384
+#endif
+
+/* Maximum number of frames in the transmit queue */
+#ifdef SLIP_CONF_TX_QUEUE_SIZE
+#define SLIP_TX_QUEUE_SIZE SLIP_CONF_TX_QUEUE_SIZE
+#else
+#define SLIP_TX_QUEUE_SIZE 64
+#endif
+
+/* Maximum number of frames sent by a single writev() */
+#ifdef SLIP_CONF_TX_IOV_MAX
+#define SLIP_TX_IOV_MAX SLIP_CONF_TX_IOV_MAX
+#else
+#define SLIP_TX_IOV_MAX 16
+#endif
+
+/* Size of each queue between the SLIP thread and the Contiki thread in
+   pipeline mode, must be a power of two */
+#ifdef SLIP_CONF_PIPELINE_QUEUE_SIZE
+#define SLIP_PIPELINE_QUEUE_SIZE SLIP_CONF_PIPELINE_QUEUE_SIZE
+#else
+#define SLIP_PIPELINE_QUEUE_SIZE (64 * 1024)
+#endif
+
+/* Maximum number of received frames handled by the Contiki thread before
+   giving back control to the main loop */
+#ifdef SLIP_CONF_PIPELINE_BATCH_SIZE
+#define SLIP_PIPELINE_BATCH_SIZE SLIP_CONF_PIPELINE_BATCH_SIZE
+#else
+#define SLIP_PIPELINE_BATCH_SIZE 16
+#endif
+
+typedef struct {
+  int offset;
+  int len;
+#if CETIC_6LBR_PACKET_TRACE
+  packet_trace_time_t queued;
+#endif
+} slip_tx_frame_t;
+
 typedef struct {
   uint8_t isused;
 
@@ -63,6 +112,8 @@ typedef struct {
   clock_time_t send_delay;
   int timeout;
   int retransmit;
+  /* Maximum number of frames waiting for an ack */
+  int window;
   int serialize_tx_attrs;
   int deserialize_rx_attrs;
   int crc8;
@@ -75,17 +126,32 @@ typedef struct {
   /* Device runtime */
   uint8_t ifindex;
   int slipfd;
-  FILE *inslip;
-  unsigned char slip_buf[2048];
-  int slip_end, slip_begin, slip_packet_end, slip_packet_count;
+  slip_decoder_t decoder;
+  /* Transmit queue, each frame is stored already escaped in tx_buf */
+  unsigned char tx_buf[SLIP_TX_BUF_SIZE];
+  slip_tx_frame_t tx_frames[SLIP_TX_QUEUE_SIZE];
+  int tx_head, tx_count;
+  /* Bytes of the head frame already written */
+  int tx_sent;
   struct timer send_delay_timer;
-
-  /* for statistics */
+  /* Wake up the main loop when the send delay is over */
+  struct ctimer send_delay_wakeup;
+  /* Pipeline mode, the escaped frames are sent and the received frames are
+     decoded by the SLIP thread */
+  pipeline_queue_t rx_queue;
+  pipeline_queue_t tx_queue;
+  pipeline_wakeup_t rx_wakeup;
+  pipeline_wakeup_t tx_wakeup;
+
+  /* for statistics, bytes_received and rx_queue_full are updated by the
+     SLIP thread in pipeline mode and must be accessed atomically */
   uint32_t bytes_sent;
   uint32_t bytes_received;
   uint32_t message_sent;
   uint32_t message_received;
   uint32_t crc_errors;
+  uint32_t tx_queue_full;
+  uint32_t rx_queue_full;
 } slip_descr_t;
 
 #define SLIP_RADIO_API_MAJOR_CONTIKI 1
@@ -104,7 +170,8 @@ slip_descr_t *slip_new_device(void);
 slip_descr_t *find_slip_dev(uint8_t ifindex);
 
 void slip_init_all_dev(void);
-void write_to_slip(slip_descr_t * slip_device, const uint8_t * buf, int len);
+int write_to_slip(slip_descr_t * slip_device, const uint8_t * buf, int len);
+int slip_tx_queue_length(slip_descr_t * slip_device);
 
 speed_t convert_baud_rate(int baudrate);
 
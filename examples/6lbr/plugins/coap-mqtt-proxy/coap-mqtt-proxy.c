@@ -51,6 +51,7 @@
 #include "log-6lbr.h"
 #include "plugin.h"
 #include "native-config-file.h"
+#include "mqtt-publisher.h"
 
 static native_config_callback_t coap_proxy_config_cb;
 
@@ -73,6 +74,38 @@ static int coap_proxy_config_handler(config_level_t level, void* user, const cha
     mqtt_coap_data_script = strdup(value);
     return 1;
   }
+  if(strcmp(name, "mqtt-host") == 0) {
+    mqtt_publisher_host = strdup(value);
+    return 1;
+  }
+  if(strcmp(name, "mqtt-port") == 0) {
+    mqtt_publisher_port = atoi(value);
+    return 1;
+  }
+  if(strcmp(name, "mqtt-client-id") == 0) {
+    mqtt_publisher_client_id = strdup(value);
+    return 1;
+  }
+  if(strcmp(name, "mqtt-keepalive") == 0) {
+    mqtt_publisher_keepalive = atoi(value);
+    return 1;
+  }
+  if(strcmp(name, "mqtt-qos") == 0) {
+    mqtt_publisher_qos = atoi(value);
+    return mqtt_publisher_qos == 0 || mqtt_publisher_qos == 1;
+  }
+  if(strcmp(name, "mqtt-queue") == 0) {
+    mqtt_publisher_queue_size = atoi(value);
+    return mqtt_publisher_queue_size > 0;
+  }
+  if(strcmp(name, "mqtt-window") == 0) {
+    mqtt_publisher_window = atoi(value);
+    return mqtt_publisher_window > 0;
+  }
+  if(strcmp(name, "mqtt-retry") == 0) {
+    mqtt_publisher_retry = atoi(value);
+    return mqtt_publisher_retry > 0;
+  }
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -88,6 +121,7 @@ typedef struct
   uip_ipaddr_t src;
   uint8_t *data;
   size_t data_len;
+  size_t data_capacity;
   UT_hash_handle hh;         /* makes this structure hashable */
 } coap_entry_t;
 
@@ -108,6 +142,7 @@ new_coap_entry(uip_ipaddr_t *src)
   entry->src = *src;
   entry->data = NULL;
   entry->data_len = 0;
+  entry->data_capacity = 0;
 
   return entry;
 }
@@ -115,7 +150,7 @@ new_coap_entry(uip_ipaddr_t *src)
 static void
 delete_coap_entry(coap_entry_t *entry)
 {
-  free(entry->data);
+  mqtt_publisher_buffer_free(entry->data, entry->data_capacity);
   free(entry);
 }
 /*---------------------------------------------------------------------------*/
@@ -140,17 +175,27 @@ child_cleanup(int signal) {
 static void
 mqtt_data_export_data(coap_entry_t *entry)
 {
+  char topic [40+1];
+  snprintf(topic, 40, "/dev/%02X%02X%02X%02X%02X%02X%02X%02X/data", entry->src.u8[8], entry->src.u8[9], entry->src.u8[10], entry->src.u8[11],
+      entry->src.u8[12], entry->src.u8[13], entry->src.u8[14], entry->src.u8[15]);
+  if(mqtt_publisher_host != NULL) {
+    LOG6LBR_DEBUG("Publishing %d bytes to %s\n", (int)entry->data_len, topic);
+    /* The publisher takes ownership of the buffer */
+    if(!mqtt_publisher_publish(topic, entry->data, entry->data_len, entry->data_capacity)) {
+      LOG6LBR_WARN("MQTT queue full, data of %s dropped\n", topic);
+    }
+    entry->data = NULL;
+    entry->data_len = 0;
+    entry->data_capacity = 0;
+    return;
+  }
   if(mqtt_coap_data_script == NULL) {
     return;
   }
   signal(SIGCHLD, child_cleanup);
-  char topic [40+1];
-  snprintf(topic, 40, "/dev/%02X%02X%02X%02X%02X%02X%02X%02X/data", entry->src.u8[8], entry->src.u8[9], entry->src.u8[10], entry->src.u8[11],
-      entry->src.u8[12], entry->src.u8[13], entry->src.u8[14], entry->src.u8[15]);
-  /* Reallocate place to add the end of string \0 */
-  entry->data = (uint8_t *)realloc(entry->data, entry->data_len + 1);
+  /* The buffer always has room for the end of string \0 */
   entry->data[entry->data_len] = 0;
-  LOG6LBR_INFO("Invoking %s for %s : %s (%d bytes)\n", mqtt_coap_data_script, topic, entry->data, entry->data_len);
+  LOG6LBR_INFO("Invoking %s for %s : %s (%d bytes)\n", mqtt_coap_data_script, topic, entry->data, (int)entry->data_len);
   pid_t child_pid = fork();
   if(child_pid != 0) {
    return;
@@ -176,18 +221,22 @@ mqtt_data_put_handler(void *request, void *response, uint8_t *buffer, uint16_t p
   uint8_t *incoming = NULL;
   if((len = REST.get_request_payload(request, (const uint8_t **)&incoming))) {
 
-    entry->data_len = coap_req->block1_num * coap_req->block1_size + len;
+    size_t data_len = coap_req->block1_num * coap_req->block1_size + len;
+    uint8_t *data;
 
-    /* Reallocate place because we just received another chunk */
-    entry->data = (uint8_t *)realloc(entry->data, entry->data_len);
+    /* Grow the pooled buffer, with room for the end of string \0 */
+    data = mqtt_publisher_buffer_grow(entry->data, &entry->data_capacity, entry->data_len, data_len + 1);
 
-    if(entry->data == NULL) {
-      LOG6LBR_ERROR("Error (re)allocating data buffer of size (%d). Aborting\n", (int)entry->data_len);
+    if(data == NULL) {
+      LOG6LBR_ERROR("Error (re)allocating data buffer of size (%d). Aborting\n", (int)data_len);
       REST.set_response_status(response, REST.status.REQUEST_ENTITY_TOO_LARGE);
-      REST.set_response_payload(response, buffer, snprintf((char *)buffer, REST_MAX_CHUNK_SIZE, "%uB max.", (unsigned int)sizeof(entry->data_len)));
+      REST.set_response_payload(response, buffer, snprintf((char *)buffer, REST_MAX_CHUNK_SIZE, "%uB max.", (unsigned int)MQTT_PUBLISHER_MAX_PAYLOAD - 1));
+      HASH_DEL(entries_hash, entry);
       delete_coap_entry(entry);
       return;
     }
+    entry->data = data;
+    entry->data_len = data_len;
 
     LOG6LBR_DEBUG("Adding: %d (total: %d)\n", (int)len, (int)entry->data_len);
 
@@ -196,7 +245,7 @@ mqtt_data_put_handler(void *request, void *response, uint8_t *buffer, uint16_t p
     REST.set_response_status(response, REST.status.CHANGED);
     coap_set_header_block1(response, coap_req->block1_num, 0, coap_req->block1_size);
     if(!coap_req->block1_more) {
-      LOG6LBR_INFO("End of transfer %d\n", entry->data_len);
+      LOG6LBR_INFO("End of transfer %d\n", (int)entry->data_len);
       mqtt_data_export_data(entry);
     }
   } else {
@@ -217,6 +266,9 @@ static int init(void) {
   LOG6LBR_INFO("MQTT-CoAP Bridge Server init\n");
 
   rest_activate_resource(&resource_mqtt_data, mqtt_relay_uri);
+  if(mqtt_publisher_host != NULL) {
+    mqtt_publisher_init();
+  }
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -229,6 +281,9 @@ version(void)
 static char const *
 status(void)
 {
+  if(mqtt_publisher_host != NULL) {
+    return mqtt_publisher_is_connected() ? "Connected" : "Disconnected";
+  }
   return "Started";
 }
 /*---------------------------------------------------------------------------*/
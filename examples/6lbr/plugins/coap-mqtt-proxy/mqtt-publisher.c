@@ -0,0 +1,661 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Native MQTT publisher for the CoAP-MQTT proxy
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#define LOG6LBR_MODULE "CMP"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "contiki.h"
+#include "lib/list.h"
+#include "log-6lbr.h"
+#include "mqtt-publisher.h"
+
+#define MQTT_PUBLISHER_TOPIC_SIZE 64
+#define MQTT_PUBLISHER_OUT_BUF_SIZE 16384
+#define MQTT_PUBLISHER_IN_BUF_SIZE 256
+
+/* Buffers kept per size class for reuse */
+#define BUFFER_POOL_MIN_SHIFT 8
+#define BUFFER_POOL_CLASSES 9
+#define BUFFER_POOL_DEPTH 16
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_DISCONNECT 0xE0
+#define MQTT_DUP 0x08
+
+/* Reconnection delay, doubled after each failure */
+#define RECONNECT_MIN 1
+#define RECONNECT_MAX 60
+
+char *mqtt_publisher_host = NULL;
+int mqtt_publisher_port = 1883;
+char *mqtt_publisher_client_id = NULL;
+int mqtt_publisher_keepalive = 60;
+int mqtt_publisher_qos = 1;
+int mqtt_publisher_queue_size = 64;
+int mqtt_publisher_window = 16;
+int mqtt_publisher_retry = 5;
+
+mqtt_publisher_stats_t mqtt_publisher_stats;
+
+typedef enum {
+  STATE_DISCONNECTED,
+  STATE_CONNECTING,
+  STATE_WAIT_CONNACK,
+  STATE_CONNECTED
+} publisher_state_t;
+
+typedef struct mqtt_message {
+  struct mqtt_message *next;
+  char topic[MQTT_PUBLISHER_TOPIC_SIZE];
+  uint8_t *payload;
+  size_t len;
+  size_t capacity;
+  uint16_t mid;
+  uint8_t dup;
+  unsigned long sent;
+} mqtt_message_t;
+
+static mqtt_message_t *messages;
+LIST(free_messages);
+/* Messages waiting to be written */
+LIST(queued_messages);
+/* QoS 1 messages waiting for their PUBACK */
+LIST(inflight_messages);
+static int inflight_count;
+
+static uint8_t *buffer_pool[BUFFER_POOL_CLASSES][BUFFER_POOL_DEPTH];
+static int buffer_pool_count[BUFFER_POOL_CLASSES];
+
+static publisher_state_t state = STATE_DISCONNECTED;
+static int fd = -1;
+static uint16_t next_mid = 1;
+
+static uint8_t out_buf[MQTT_PUBLISHER_OUT_BUF_SIZE];
+static int out_start;
+static int out_len;
+/* Part of the first queued message already in the output buffer */
+static size_t out_msg_offset;
+
+static uint8_t in_buf[MQTT_PUBLISHER_IN_BUF_SIZE];
+static int in_len;
+
+static struct ctimer periodic_timer;
+static unsigned long reconnect_time;
+static int reconnect_delay = RECONNECT_MIN;
+static unsigned long last_tx;
+static unsigned long last_rx;
+
+static int set_fd(fd_set *fdr, fd_set *fdw);
+static void handle_fd(fd_set *fdr, fd_set *fdw);
+static const struct select_callback publisher_select_callback = { set_fd, handle_fd };
+
+/*---------------------------------------------------------------------------*/
+static int
+buffer_class(size_t size)
+{
+  int i;
+  for(i = 0; i < BUFFER_POOL_CLASSES && ((size_t)1 << (BUFFER_POOL_MIN_SHIFT + i)) < size; i++);
+  return i;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t *
+mqtt_publisher_buffer_alloc(size_t size, size_t *capacity)
+{
+  int i = buffer_class(size);
+
+  if(size > MQTT_PUBLISHER_MAX_PAYLOAD || i == BUFFER_POOL_CLASSES) {
+    return NULL;
+  }
+  *capacity = (size_t)1 << (BUFFER_POOL_MIN_SHIFT + i);
+  if(buffer_pool_count[i] > 0) {
+    return buffer_pool[i][--buffer_pool_count[i]];
+  }
+  return malloc(*capacity);
+}
+/*---------------------------------------------------------------------------*/
+void
+mqtt_publisher_buffer_free(uint8_t *buffer, size_t capacity)
+{
+  int i;
+
+  if(buffer == NULL) {
+    return;
+  }
+  i = buffer_class(capacity);
+  if(i < BUFFER_POOL_CLASSES && buffer_pool_count[i] < BUFFER_POOL_DEPTH) {
+    buffer_pool[i][buffer_pool_count[i]++] = buffer;
+  } else {
+    free(buffer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint8_t *
+mqtt_publisher_buffer_grow(uint8_t *buffer, size_t *capacity, size_t len, size_t size)
+{
+  uint8_t *new_buffer;
+  size_t new_capacity;
+
+  if(buffer != NULL && size <= *capacity) {
+    return buffer;
+  }
+  new_buffer = mqtt_publisher_buffer_alloc(size, &new_capacity);
+  if(new_buffer == NULL) {
+    return NULL;
+  }
+  if(buffer != NULL) {
+    memcpy(new_buffer, buffer, len);
+    mqtt_publisher_buffer_free(buffer, *capacity);
+  }
+  *capacity = new_capacity;
+  return new_buffer;
+}
+/*---------------------------------------------------------------------------*/
+static void
+release_message(mqtt_message_t *msg)
+{
+  mqtt_publisher_buffer_free(msg->payload, msg->capacity);
+  msg->payload = NULL;
+  list_add(free_messages, msg);
+}
+/*---------------------------------------------------------------------------*/
+static int
+encode_remaining_length(uint8_t *buf, size_t len)
+{
+  int i = 0;
+  do {
+    buf[i] = len & 0x7f;
+    len >>= 7;
+    if(len > 0) {
+      buf[i] |= 0x80;
+    }
+    i++;
+  } while(len > 0);
+  return i;
+}
+/*---------------------------------------------------------------------------*/
+/* Fixed and variable headers of a PUBLISH message, returns their size */
+static int
+encode_publish_header(uint8_t *buf, mqtt_message_t const *msg)
+{
+  size_t topic_len = strlen(msg->topic);
+  int pos = 0;
+
+  buf[pos++] = MQTT_PUBLISH | (msg->dup ? MQTT_DUP : 0) | (mqtt_publisher_qos << 1);
+  pos += encode_remaining_length(buf + pos, 2 + topic_len + (mqtt_publisher_qos > 0 ? 2 : 0) + msg->len);
+  buf[pos++] = topic_len >> 8;
+  buf[pos++] = topic_len & 0xff;
+  memcpy(buf + pos, msg->topic, topic_len);
+  pos += topic_len;
+  if(mqtt_publisher_qos > 0) {
+    buf[pos++] = msg->mid >> 8;
+    buf[pos++] = msg->mid & 0xff;
+  }
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static int
+out_room(void)
+{
+  if(out_len == 0) {
+    out_start = 0;
+  } else if(out_start > 0 && out_start + out_len > MQTT_PUBLISHER_OUT_BUF_SIZE / 2) {
+    memmove(out_buf, out_buf + out_start, out_len);
+    out_start = 0;
+  }
+  return MQTT_PUBLISHER_OUT_BUF_SIZE - out_start - out_len;
+}
+/*---------------------------------------------------------------------------*/
+static int
+out_add(uint8_t const *data, int len)
+{
+  if(out_room() < len) {
+    return 0;
+  }
+  memcpy(out_buf + out_start + out_len, data, len);
+  out_len += len;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Serializes the queued messages in the output buffer, within the limit of
+ * the QoS 1 window. A message larger than the free space is streamed over
+ * several calls.
+ */
+static void
+fill_output(void)
+{
+  uint8_t header[5 + 2 + MQTT_PUBLISHER_TOPIC_SIZE + 2];
+  mqtt_message_t *msg;
+  int header_len;
+  size_t total;
+  int room;
+  int n;
+
+  while((msg = list_head(queued_messages)) != NULL) {
+    if(out_msg_offset == 0 && mqtt_publisher_qos > 0 && inflight_count >= mqtt_publisher_window) {
+      break;
+    }
+    room = out_room();
+    if(room == 0) {
+      break;
+    }
+    header_len = encode_publish_header(header, msg);
+    total = header_len + msg->len;
+    if(out_msg_offset < header_len) {
+      n = header_len - out_msg_offset < room ? header_len - out_msg_offset : room;
+      memcpy(out_buf + out_start + out_len, header + out_msg_offset, n);
+    } else {
+      n = total - out_msg_offset < room ? total - out_msg_offset : room;
+      memcpy(out_buf + out_start + out_len, msg->payload + out_msg_offset - header_len, n);
+    }
+    out_len += n;
+    out_msg_offset += n;
+    if(out_msg_offset < total) {
+      continue;
+    }
+    out_msg_offset = 0;
+    list_remove(queued_messages, msg);
+    if(msg->dup) {
+      mqtt_publisher_stats.retransmissions++;
+    } else {
+      mqtt_publisher_stats.published++;
+    }
+    if(mqtt_publisher_qos > 0) {
+      msg->sent = clock_seconds();
+      list_add(inflight_messages, msg);
+      inflight_count++;
+    } else {
+      release_message(msg);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+flush_output(void)
+{
+  int n;
+
+  if(state == STATE_CONNECTED) {
+    fill_output();
+  }
+  while(out_len > 0) {
+    n = write(fd, out_buf + out_start, out_len);
+    if(n <= 0) {
+      break;
+    }
+    out_start += n;
+    out_len -= n;
+    last_tx = clock_seconds();
+    if(out_len == 0 && state == STATE_CONNECTED) {
+      /* Pipeline as many messages as the socket accepts */
+      fill_output();
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Puts the unacknowledged messages back at the head of the queue */
+static void
+requeue_inflight(void)
+{
+  mqtt_message_t *msg;
+
+  while((msg = list_chop(inflight_messages)) != NULL) {
+    msg->dup = 1;
+    list_push(queued_messages, msg);
+  }
+  inflight_count = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+disconnect(void)
+{
+  if(fd >= 0) {
+    select_set_callback(fd, NULL);
+    close(fd);
+    fd = -1;
+  }
+  if(state == STATE_CONNECTED) {
+    LOG6LBR_WARN("Disconnected from MQTT broker\n");
+  }
+  state = STATE_DISCONNECTED;
+  out_len = 0;
+  out_start = 0;
+  in_len = 0;
+  if(out_msg_offset > 0) {
+    /* The first queued message was partially written, send it again */
+    out_msg_offset = 0;
+    ((mqtt_message_t *)list_head(queued_messages))->dup = mqtt_publisher_qos > 0;
+  }
+  requeue_inflight();
+  reconnect_time = clock_seconds() + reconnect_delay;
+  if(reconnect_delay < RECONNECT_MAX) {
+    reconnect_delay *= 2;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_connect(void)
+{
+  uint8_t buf[5 + 10 + 2 + 256];
+  size_t id_len = strlen(mqtt_publisher_client_id);
+  int pos = 0;
+
+  if(id_len > 256) {
+    id_len = 256;
+  }
+  buf[pos++] = MQTT_CONNECT;
+  pos += encode_remaining_length(buf + pos, 10 + 2 + id_len);
+  memcpy(buf + pos, "\0\4MQTT\4", 7);
+  pos += 7;
+  /* Clean session */
+  buf[pos++] = 0x02;
+  buf[pos++] = mqtt_publisher_keepalive >> 8;
+  buf[pos++] = mqtt_publisher_keepalive & 0xff;
+  buf[pos++] = id_len >> 8;
+  buf[pos++] = id_len & 0xff;
+  memcpy(buf + pos, mqtt_publisher_client_id, id_len);
+  pos += id_len;
+  out_add(buf, pos);
+  state = STATE_WAIT_CONNACK;
+  flush_output();
+}
+/*---------------------------------------------------------------------------*/
+static void
+connect_broker(void)
+{
+  struct addrinfo hints;
+  struct addrinfo *result;
+  struct addrinfo *rp;
+  char port[8];
+  int flag = 1;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  snprintf(port, sizeof(port), "%d", mqtt_publisher_port);
+  if(getaddrinfo(mqtt_publisher_host, port, &hints, &result) != 0) {
+    LOG6LBR_ERROR("Can not resolve MQTT broker %s\n", mqtt_publisher_host);
+    disconnect();
+    return;
+  }
+  for(rp = result; rp != NULL; rp = rp->ai_next) {
+    fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+    if(fd < 0) {
+      continue;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    if(connect(fd, rp->ai_addr, rp->ai_addrlen) == 0 || errno == EINPROGRESS) {
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(result);
+  if(fd < 0) {
+    LOG6LBR_ERROR("Can not connect to MQTT broker %s:%d : %s\n", mqtt_publisher_host, mqtt_publisher_port, strerror(errno));
+    disconnect();
+    return;
+  }
+  state = STATE_CONNECTING;
+  last_rx = clock_seconds();
+  select_set_callback(fd, &publisher_select_callback);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_puback(uint16_t mid)
+{
+  mqtt_message_t *msg;
+
+  for(msg = list_head(inflight_messages); msg != NULL; msg = list_item_next(msg)) {
+    if(msg->mid == mid) {
+      list_remove(inflight_messages, msg);
+      inflight_count--;
+      mqtt_publisher_stats.acked++;
+      release_message(msg);
+      return;
+    }
+  }
+  LOG6LBR_DEBUG("Unexpected PUBACK %d\n", mid);
+}
+/*---------------------------------------------------------------------------*/
+/* Parses the received packets, the broker only sends short ones to us */
+static void
+handle_input(void)
+{
+  int pos = 0;
+  int len;
+
+  while(in_len - pos >= 2) {
+    if(in_buf[pos + 1] & 0x80) {
+      LOG6LBR_ERROR("Unexpected MQTT packet 0x%02x\n", in_buf[pos]);
+      disconnect();
+      return;
+    }
+    len = 2 + in_buf[pos + 1];
+    if(in_len - pos < len) {
+      break;
+    }
+    switch(in_buf[pos] & 0xf0) {
+    case MQTT_CONNACK:
+      if(len < 4 || in_buf[pos + 3] != 0) {
+        LOG6LBR_ERROR("MQTT connection refused (%d)\n", len < 4 ? -1 : in_buf[pos + 3]);
+        disconnect();
+        return;
+      }
+      LOG6LBR_INFO("Connected to MQTT broker %s:%d\n", mqtt_publisher_host, mqtt_publisher_port);
+      state = STATE_CONNECTED;
+      reconnect_delay = RECONNECT_MIN;
+      mqtt_publisher_stats.connections++;
+      break;
+    case MQTT_PUBACK:
+      if(len >= 4) {
+        handle_puback((in_buf[pos + 2] << 8) | in_buf[pos + 3]);
+      }
+      break;
+    default:
+      break;
+    }
+    pos += len;
+  }
+  if(pos > 0) {
+    memmove(in_buf, in_buf + pos, in_len - pos);
+    in_len -= pos;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+set_fd(fd_set *fdr, fd_set *fdw)
+{
+  if(fd < 0) {
+    return 0;
+  }
+  FD_SET(fd, fdr);
+  if(state == STATE_CONNECTING || out_len > 0 ||
+     (state == STATE_CONNECTED && list_head(queued_messages) != NULL &&
+      (mqtt_publisher_qos == 0 || inflight_count < mqtt_publisher_window))) {
+    FD_SET(fd, fdw);
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_fd(fd_set *fdr, fd_set *fdw)
+{
+  int error = 0;
+  socklen_t error_len = sizeof(error);
+  int n;
+
+  if(fd < 0) {
+    return;
+  }
+  if(state == STATE_CONNECTING) {
+    if(FD_ISSET(fd, fdw) || FD_ISSET(fd, fdr)) {
+      if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len) < 0 || error != 0) {
+        LOG6LBR_ERROR("Can not connect to MQTT broker %s:%d : %s\n", mqtt_publisher_host, mqtt_publisher_port, strerror(error));
+        disconnect();
+        return;
+      }
+      send_connect();
+    }
+    return;
+  }
+  if(FD_ISSET(fd, fdr)) {
+    n = read(fd, in_buf + in_len, sizeof(in_buf) - in_len);
+    if(n <= 0) {
+      if(n == 0 || (errno != EAGAIN && errno != EINTR)) {
+        disconnect();
+      }
+      return;
+    }
+    in_len += n;
+    last_rx = clock_seconds();
+    handle_input();
+  }
+  if(fd >= 0 && FD_ISSET(fd, fdw)) {
+    flush_output();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+periodic(void *ptr)
+{
+  static const uint8_t pingreq[] = { MQTT_PINGREQ, 0 };
+  unsigned long now = clock_seconds();
+  mqtt_message_t *msg;
+  mqtt_message_t *next;
+  mqtt_message_t *prev;
+
+  if(state == STATE_DISCONNECTED) {
+    if((long)(now - reconnect_time) >= 0) {
+      connect_broker();
+    }
+  } else if(mqtt_publisher_keepalive > 0 && now - last_rx > (mqtt_publisher_keepalive * 3) / 2) {
+    LOG6LBR_WARN("MQTT broker timeout\n");
+    disconnect();
+  } else if(state == STATE_CONNECTED) {
+    /* Retransmit the messages without PUBACK first, in order, but after
+     * the message being streamed if any */
+    prev = out_msg_offset > 0 ? list_head(queued_messages) : NULL;
+    for(msg = list_head(inflight_messages); msg != NULL; msg = next) {
+      next = list_item_next(msg);
+      if(now - msg->sent >= mqtt_publisher_retry) {
+        list_remove(inflight_messages, msg);
+        inflight_count--;
+        msg->dup = 1;
+        list_insert(queued_messages, prev, msg);
+        prev = msg;
+      }
+    }
+    if(mqtt_publisher_keepalive > 0 && now - last_tx >= mqtt_publisher_keepalive && out_len == 0) {
+      out_add(pingreq, sizeof(pingreq));
+    }
+    flush_output();
+  }
+  ctimer_reset(&periodic_timer);
+}
+/*---------------------------------------------------------------------------*/
+int
+mqtt_publisher_publish(char const *topic, uint8_t *payload, size_t len, size_t capacity)
+{
+  mqtt_message_t *msg = list_pop(free_messages);
+
+  if(msg == NULL) {
+    mqtt_publisher_stats.dropped++;
+    mqtt_publisher_buffer_free(payload, capacity);
+    return 0;
+  }
+  strncpy(msg->topic, topic, sizeof(msg->topic) - 1);
+  msg->topic[sizeof(msg->topic) - 1] = '\0';
+  msg->payload = payload;
+  msg->len = len;
+  msg->capacity = capacity;
+  msg->dup = 0;
+  msg->mid = next_mid++;
+  if(next_mid == 0) {
+    next_mid = 1;
+  }
+  list_add(queued_messages, msg);
+  if(state == STATE_CONNECTED) {
+    flush_output();
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+mqtt_publisher_is_connected(void)
+{
+  return state == STATE_CONNECTED;
+}
+/*---------------------------------------------------------------------------*/
+void
+mqtt_publisher_init(void)
+{
+  int i;
+
+  if(mqtt_publisher_client_id == NULL) {
+    mqtt_publisher_client_id = "6lbr-coap-mqtt-proxy";
+  }
+  if(mqtt_publisher_qos > 1) {
+    mqtt_publisher_qos = 1;
+  }
+  messages = calloc(mqtt_publisher_queue_size, sizeof(mqtt_message_t));
+  list_init(free_messages);
+  list_init(queued_messages);
+  list_init(inflight_messages);
+  for(i = 0; messages != NULL && i < mqtt_publisher_queue_size; i++) {
+    list_add(free_messages, &messages[i]);
+  }
+  reconnect_time = clock_seconds();
+  ctimer_set(&periodic_timer, CLOCK_SECOND, periodic, NULL);
+}
+/*---------------------------------------------------------------------------*/
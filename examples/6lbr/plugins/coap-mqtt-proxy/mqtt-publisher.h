@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Native MQTT publisher for the CoAP-MQTT proxy
+ *
+ *         Keeps a persistent connection to the broker through a non blocking
+ *         socket handled in the main select loop. Publishes are queued in a
+ *         bounded queue, written back to back in a single output buffer and
+ *         QoS 1 messages are kept until their PUBACK is received.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#ifndef MQTT_PUBLISHER_H
+#define MQTT_PUBLISHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+extern char *mqtt_publisher_host;
+extern int mqtt_publisher_port;
+extern char *mqtt_publisher_client_id;
+extern int mqtt_publisher_keepalive;
+extern int mqtt_publisher_qos;
+extern int mqtt_publisher_queue_size;
+extern int mqtt_publisher_window;
+extern int mqtt_publisher_retry;
+
+typedef struct {
+  uint32_t published;
+  uint32_t acked;
+  uint32_t retransmissions;
+  uint32_t dropped;
+  uint32_t connections;
+} mqtt_publisher_stats_t;
+
+extern mqtt_publisher_stats_t mqtt_publisher_stats;
+
+/* Payload buffers, allocated by power of two size classes and recycled */
+#define MQTT_PUBLISHER_MAX_PAYLOAD 65536
+
+uint8_t *
+mqtt_publisher_buffer_alloc(size_t size, size_t *capacity);
+
+/* Returns a buffer large enough for size bytes, keeping the first len bytes */
+uint8_t *
+mqtt_publisher_buffer_grow(uint8_t *buffer, size_t *capacity, size_t len, size_t size);
+
+void
+mqtt_publisher_buffer_free(uint8_t *buffer, size_t capacity);
+
+/*
+ * Queues a message, the publisher takes ownership of the payload buffer,
+ * which must come from mqtt_publisher_buffer_alloc(). Returns 0 if the queue
+ * is full, the buffer is then released.
+ */
+int
+mqtt_publisher_publish(char const *topic, uint8_t *payload, size_t len, size_t capacity);
+
+int
+mqtt_publisher_is_connected(void);
+
+void
+mqtt_publisher_init(void);
+
+#endif /* MQTT_PUBLISHER_H */
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Compare the CCM* backends used by the link-layer security.
+ *
+ *         Each secured frame selects the pairwise key of one of the
+ *         neighbors before being authenticated and encrypted, like AKES
+ *         does. The default software driver (core/lib) is compared with
+ *         the native driver, using the T-tables and AES-NI.
+ *
+ *         Before measuring, the outputs of the drivers are checked against
+ *         each other for random frames.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "lib/aes-128.h"
+#include "lib/ccm-star.h"
+#include "native-aes-128.h"
+#include "native-ccm-star.h"
+
+#define MAX_FRAME_SIZE 127
+#define MIC_MAX_LEN 16
+
+typedef struct {
+  const char *name;
+  const struct aes_128_driver *aes;
+  const struct ccm_star_driver *ccm;
+  int aesni;
+} backend_t;
+
+static uint8_t (*keys)[AES_128_KEY_LENGTH];
+
+/*---------------------------------------------------------------------------*/
+static void
+random_bytes(uint8_t *buf, int len)
+{
+  int i;
+
+  for(i = 0; i < len; i++) {
+    buf[i] = rand();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+check_backends(const backend_t *ref, const backend_t *backend, int nb_tests)
+{
+  uint8_t key[AES_128_KEY_LENGTH];
+  uint8_t nonce[CCM_STAR_NONCE_LENGTH];
+  uint8_t frame[MAX_FRAME_SIZE];
+  uint8_t ref_m[MAX_FRAME_SIZE];
+  uint8_t m[MAX_FRAME_SIZE];
+  uint8_t ref_mic[MIC_MAX_LEN];
+  uint8_t mic[MIC_MAX_LEN];
+  int a_len, m_len, mic_len;
+  int i;
+
+  for(i = 0; i < nb_tests; i++) {
+    random_bytes(key, sizeof(key));
+    random_bytes(nonce, sizeof(nonce));
+    random_bytes(frame, sizeof(frame));
+    a_len = rand() % 40;
+    m_len = rand() % (MAX_FRAME_SIZE - a_len);
+    mic_len = (rand() % 4) * 4;
+    memcpy(ref_m, frame + a_len, m_len);
+    memcpy(m, frame + a_len, m_len);
+
+    ref->ccm->set_key(key);
+    ref->ccm->aead(nonce, ref_m, m_len, frame, a_len, ref_mic, mic_len, 1);
+    backend->ccm->set_key(key);
+    backend->ccm->aead(nonce, m, m_len, frame, a_len, mic, mic_len, 1);
+    if(memcmp(ref_m, m, m_len) != 0 || memcmp(ref_mic, mic, mic_len) != 0) {
+      fprintf(stderr, "%s: encryption mismatch (a_len %d, m_len %d, mic_len %d)\n",
+              backend->name, a_len, m_len, mic_len);
+      return 0;
+    }
+    backend->ccm->aead(nonce, m, m_len, frame, a_len, mic, mic_len, 0);
+    if(memcmp(frame + a_len, m, m_len) != 0 || memcmp(ref_mic, mic, mic_len) != 0) {
+      fprintf(stderr, "%s: decryption mismatch (a_len %d, m_len %d, mic_len %d)\n",
+              backend->name, a_len, m_len, mic_len);
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static double
+run(const backend_t *backend, int nb_frames, int nb_neighbors,
+    int a_len, int m_len, int mic_len)
+{
+  uint8_t nonce[CCM_STAR_NONCE_LENGTH];
+  uint8_t frame[MAX_FRAME_SIZE];
+  uint8_t mic[MIC_MAX_LEN];
+  struct timespec start, end;
+  int i;
+
+  random_bytes(nonce, sizeof(nonce));
+  random_bytes(frame, sizeof(frame));
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i = 0; i < nb_frames; i++) {
+    nonce[CCM_STAR_NONCE_LENGTH - 1] = i;
+    backend->ccm->set_key(keys[i % nb_neighbors]);
+    backend->ccm->aead(nonce, frame + a_len, m_len, frame, a_len, mic, mic_len, i & 1);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+/*---------------------------------------------------------------------------*/
+static void
+usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [-n frames] [-k neighbors] [-a header length] [-m payload length] [-l mic length]\n", name);
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char *argv[])
+{
+  int c;
+  int nb_frames = 1000000;
+  int nb_neighbors = 64;
+  int a_len = 23;
+  int m_len = 80;
+  int mic_len = 8;
+  int i;
+  double elapsed;
+  backend_t backends[] = {
+    { "software", &aes_128_driver, &ccm_star_driver, 0 },
+    { "native T-table", &native_aes_128_driver, &native_ccm_star_driver, 0 },
+    { "native AES-NI", &native_aes_128_driver, &native_ccm_star_driver, 1 },
+  };
+
+  while((c = getopt(argc, argv, "n:k:a:m:l:h")) != -1) {
+    switch(c) {
+    case 'n':
+      nb_frames = atoi(optarg);
+      break;
+    case 'k':
+      nb_neighbors = atoi(optarg);
+      break;
+    case 'a':
+      a_len = atoi(optarg);
+      break;
+    case 'm':
+      m_len = atoi(optarg);
+      break;
+    case 'l':
+      mic_len = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if(nb_frames <= 0 || nb_neighbors <= 0 || a_len < 0 || m_len < 0 ||
+     a_len + m_len > MAX_FRAME_SIZE || mic_len < 0 || mic_len > MIC_MAX_LEN) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  keys = malloc(nb_neighbors * AES_128_KEY_LENGTH);
+  if(keys == NULL) {
+    return 1;
+  }
+  srand(1);
+  random_bytes(keys[0], nb_neighbors * AES_128_KEY_LENGTH);
+
+  printf("Frames : %d, neighbors : %d, header : %d, payload : %d, MIC : %d\n",
+         nb_frames, nb_neighbors, a_len, m_len, mic_len);
+  for(i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+    if(native_aes_128_set_aesni(backends[i].aesni) != backends[i].aesni) {
+      printf("%-16s : not supported\n", backends[i].name);
+      continue;
+    }
+    if(i > 0 && !check_backends(&backends[0], &backends[i], 10000)) {
+      return 1;
+    }
+    elapsed = run(&backends[i], nb_frames, nb_neighbors, a_len, m_len, mic_len);
+    printf("%-16s : %.0f frames/s\n", backends[i].name, nb_frames / elapsed);
+  }
+  printf("Key cache : %u hits, %u misses\n",
+         native_aes_128_stats.key_hits, native_aes_128_stats.key_misses);
+
+  free(keys);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
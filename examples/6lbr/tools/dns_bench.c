@@ -0,0 +1,480 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Stand-in name server and load generator for the DNS proxy
+ *
+ *         With -s, a name server answering on UDP: hN.<domain> resolves to
+ *         192.0.2.N, and to 2001:db8::N when N is even, so odd hosts need
+ *         DNS64. Names starting with "nx" do not exist. Answers can be
+ *         delayed to mimic the uplink.
+ *
+ *         Otherwise, AAAA queries for hN.example.com are sent to the proxy,
+ *         N following a skewed popularity, with a window of outstanding
+ *         queries, and the latency of the answers is reported.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define DNS_HEADER_SIZE 12
+#define DNS_TYPE_A      1
+#define DNS_TYPE_SOA    6
+#define DNS_TYPE_AAAA  28
+#define MAX_MESSAGE   512
+#define MAX_WINDOW    256
+#define MAX_DELAYED  1024
+
+struct delayed_answer {
+  double time;
+  struct sockaddr_in6 addr;
+  int len;
+  uint8_t msg[MAX_MESSAGE];
+};
+
+struct outstanding {
+  int used;
+  uint16_t id;
+  int host;
+  double sent;
+};
+
+static struct delayed_answer delayed[MAX_DELAYED];
+static int nb_delayed;
+
+/*---------------------------------------------------------------------------*/
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+/*---------------------------------------------------------------------------*/
+static int
+put_record_header(uint8_t *p, int type, uint32_t ttl, int rdlen)
+{
+  /* Name compressed as a pointer to the question */
+  p[0] = 0xc0;
+  p[1] = DNS_HEADER_SIZE;
+  p[2] = 0;
+  p[3] = type;
+  p[4] = 0;
+  p[5] = 1;
+  p[6] = ttl >> 24;
+  p[7] = ttl >> 16;
+  p[8] = ttl >> 8;
+  p[9] = ttl;
+  p[10] = rdlen >> 8;
+  p[11] = rdlen;
+  return 12;
+}
+/*---------------------------------------------------------------------------*/
+static int
+put_soa(uint8_t *p, uint32_t ttl, uint32_t minimum)
+{
+  int n;
+
+  n = put_record_header(p, DNS_TYPE_SOA, ttl, 4 + 20);
+  /* Primary server and mailbox point to the question name */
+  p[n++] = 0xc0;
+  p[n++] = DNS_HEADER_SIZE;
+  p[n++] = 0xc0;
+  p[n++] = DNS_HEADER_SIZE;
+  memset(p + n, 0, 16);
+  n += 16;
+  p[n++] = minimum >> 24;
+  p[n++] = minimum >> 16;
+  p[n++] = minimum >> 8;
+  p[n++] = minimum;
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+/* Builds the answer of the stand-in server, returns its length or 0 */
+static int
+server_answer(const uint8_t *query, int len, uint8_t *out, uint32_t ttl)
+{
+  int offset;
+  int type;
+  int host;
+  int n;
+
+  if(len < DNS_HEADER_SIZE || (query[2] & 0x80) != 0 || query[5] != 1) {
+    return 0;
+  }
+  for(offset = DNS_HEADER_SIZE; offset < len && query[offset] != 0; offset += 1 + query[offset]);
+  offset++;
+  if(offset + 4 > len) {
+    return 0;
+  }
+  type = query[offset + 1];
+  n = offset + 4;
+  memcpy(out, query, n);
+  out[2] = 0x84 | (query[2] & 0x01);
+  out[3] = 0x80;
+  memset(out + 6, 0, 6);
+
+  if(query[DNS_HEADER_SIZE] >= 2 && strncmp((const char *)query + DNS_HEADER_SIZE + 1, "nx", 2) == 0) {
+    out[3] |= 3;
+    out[9] = 1;
+    return n + put_soa(out + n, ttl, ttl / 4);
+  }
+  host = query[DNS_HEADER_SIZE] >= 2 && query[DNS_HEADER_SIZE + 1] == 'h' ?
+    atoi((const char *)query + DNS_HEADER_SIZE + 2) : 0;
+  if(type == DNS_TYPE_A) {
+    out[7] = 1;
+    n += put_record_header(out + n, DNS_TYPE_A, ttl, 4);
+    out[n++] = 192;
+    out[n++] = 0;
+    out[n++] = 2;
+    out[n++] = host & 0xff;
+  } else if(type == DNS_TYPE_AAAA && host % 2 == 0) {
+    out[7] = 1;
+    n += put_record_header(out + n, DNS_TYPE_AAAA, ttl, 16);
+    memset(out + n, 0, 16);
+    out[n] = 0x20;
+    out[n + 1] = 0x01;
+    out[n + 2] = 0x0d;
+    out[n + 3] = 0xb8;
+    out[n + 14] = host >> 8;
+    out[n + 15] = host;
+    n += 16;
+  } else {
+    /* No data */
+    out[9] = 1;
+    n += put_soa(out + n, ttl, ttl / 4);
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static int
+run_server(int sock, double delay, uint32_t ttl)
+{
+  uint8_t query[MAX_MESSAGE];
+  uint8_t answer[MAX_MESSAGE];
+  struct sockaddr_in6 addr;
+  socklen_t addrlen;
+  struct pollfd pfd;
+  unsigned long queries = 0;
+  double last_report;
+  int len;
+  int i;
+
+  printf("Stand-in name server, delay %.0f ms, TTL %u s\n", delay * 1000, ttl);
+  last_report = now();
+  pfd.fd = sock;
+  pfd.events = POLLIN;
+  while(1) {
+    poll(&pfd, 1, nb_delayed > 0 ? 1 : 100);
+    if(pfd.revents & POLLIN) {
+      addrlen = sizeof(addr);
+      len = recvfrom(sock, query, sizeof(query), 0, (struct sockaddr *)&addr, &addrlen);
+      if(len > 0 && (len = server_answer(query, len, answer, ttl)) > 0) {
+        queries++;
+        if(delay <= 0) {
+          sendto(sock, answer, len, 0, (struct sockaddr *)&addr, addrlen);
+        } else if(nb_delayed < MAX_DELAYED) {
+          delayed[nb_delayed].time = now() + delay;
+          delayed[nb_delayed].addr = addr;
+          delayed[nb_delayed].len = len;
+          memcpy(delayed[nb_delayed].msg, answer, len);
+          nb_delayed++;
+        }
+      }
+    }
+    for(i = 0; i < nb_delayed;) {
+      if(delayed[i].time <= now()) {
+        sendto(sock, delayed[i].msg, delayed[i].len, 0,
+               (struct sockaddr *)&delayed[i].addr, sizeof(delayed[i].addr));
+        delayed[i] = delayed[--nb_delayed];
+      } else {
+        i++;
+      }
+    }
+    if(now() - last_report >= 1) {
+      printf("Queries : %lu\n", queries);
+      last_report = now();
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+make_query(uint8_t *msg, uint16_t id, int host)
+{
+  int n;
+
+  memset(msg, 0, DNS_HEADER_SIZE);
+  msg[0] = id >> 8;
+  msg[1] = id;
+  msg[2] = 0x01;
+  msg[5] = 1;
+  n = DNS_HEADER_SIZE;
+  msg[n] = sprintf((char *)msg + n + 1, "h%d", host);
+  n += 1 + msg[n];
+  msg[n++] = 7;
+  memcpy(msg + n, "example", 7);
+  n += 7;
+  msg[n++] = 3;
+  memcpy(msg + n, "com", 3);
+  n += 3;
+  msg[n++] = 0;
+  msg[n++] = 0;
+  msg[n++] = DNS_TYPE_AAAA;
+  msg[n++] = 0;
+  msg[n++] = 1;
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static int
+pick_host(int nb_hosts, double skew)
+{
+  /* Popularity of host N proportional to 1 / (N + 1)^skew */
+  static double *cdf;
+  static int cdf_size;
+  double r;
+  int low, high, mid;
+  int i;
+
+  if(cdf_size != nb_hosts) {
+    free(cdf);
+    cdf = malloc(nb_hosts * sizeof(double));
+    for(i = 0; i < nb_hosts; i++) {
+      cdf[i] = (i > 0 ? cdf[i - 1] : 0) + 1 / pow(i + 1, skew);
+    }
+    cdf_size = nb_hosts;
+  }
+  r = (double)rand() / RAND_MAX * cdf[nb_hosts - 1];
+  low = 0;
+  high = nb_hosts - 1;
+  while(low < high) {
+    mid = (low + high) / 2;
+    if(cdf[mid] < r) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+/*---------------------------------------------------------------------------*/
+static int
+compare_double(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+/*---------------------------------------------------------------------------*/
+static int
+run_client(int sock, struct sockaddr_in6 *proxy, int nb_queries, int window,
+           int nb_hosts, double skew, double timeout)
+{
+  uint8_t msg[MAX_MESSAGE];
+  struct outstanding slots[MAX_WINDOW];
+  double *latencies;
+  struct pollfd pfd;
+  int sent = 0;
+  int answered = 0;
+  int timeouts = 0;
+  int invalid = 0;
+  int synthesized = 0;
+  int active = 0;
+  double start, elapsed, t, total;
+  uint16_t id;
+  int len, i;
+
+  latencies = malloc(nb_queries * sizeof(double));
+  memset(slots, 0, sizeof(slots));
+  pfd.fd = sock;
+  pfd.events = POLLIN;
+  start = now();
+  while(sent < nb_queries || active > 0) {
+    for(i = 0; i < window && sent < nb_queries; i++) {
+      if(!slots[i].used) {
+        slots[i].used = 1;
+        slots[i].id = (rand() & 0xff00) | i;
+        slots[i].host = pick_host(nb_hosts, skew);
+        slots[i].sent = now();
+        len = make_query(msg, slots[i].id, slots[i].host);
+        sendto(sock, msg, len, 0, (struct sockaddr *)proxy, sizeof(*proxy));
+        sent++;
+        active++;
+      }
+    }
+    poll(&pfd, 1, 10);
+    if(pfd.revents & POLLIN) {
+      len = recv(sock, msg, sizeof(msg), 0);
+      id = len >= DNS_HEADER_SIZE ? (msg[0] << 8) | msg[1] : 0;
+      i = id & 0xff;
+      if(len >= DNS_HEADER_SIZE && i < window && slots[i].used && slots[i].id == id) {
+        t = now();
+        latencies[answered++] = t - slots[i].sent;
+        /* Odd hosts only have an IPv4 address, mapped by DNS64 */
+        if(slots[i].host % 2 == 1 && msg[7] > 0) {
+          synthesized++;
+        }
+        slots[i].used = 0;
+        active--;
+      } else {
+        invalid++;
+      }
+    }
+    t = now();
+    for(i = 0; i < window; i++) {
+      if(slots[i].used && t - slots[i].sent > timeout) {
+        slots[i].used = 0;
+        active--;
+        timeouts++;
+      }
+    }
+  }
+  elapsed = now() - start;
+
+  qsort(latencies, answered, sizeof(double), compare_double);
+  total = 0;
+  for(i = 0; i < answered; i++) {
+    total += latencies[i];
+  }
+  printf("Queries : %d (%d answered, %d timeouts, %d invalid answers)\n",
+         sent, answered, timeouts, invalid);
+  printf("DNS64 answers : %d\n", synthesized);
+  printf("Time : %.3f s\n", elapsed);
+  printf("Queries/s : %.0f\n", answered / elapsed);
+  if(answered > 0) {
+    printf("Latency (ms) : mean %.2f, p50 %.2f, p99 %.2f, max %.2f\n",
+           total / answered * 1000, latencies[answered / 2] * 1000,
+           latencies[answered * 99 / 100] * 1000, latencies[answered - 1] * 1000);
+  }
+  free(latencies);
+  return timeouts > 0 || invalid > 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s -s [-p port] [-d delay] [-t ttl]\n", name);
+  fprintf(stderr, "       %s [-p port] [-n queries] [-w window] [-H hosts] [-z skew] proxy-address\n", name);
+  fprintf(stderr, "  -s: stand-in name server\n");
+  fprintf(stderr, "  -d: delay of the answers in ms\n");
+  fprintf(stderr, "  -t: TTL of the answers in s\n");
+  fprintf(stderr, "  -w: number of outstanding queries\n");
+  fprintf(stderr, "  -H: number of distinct names\n");
+  fprintf(stderr, "  -z: skew of the popularity of the names, 0 is uniform\n");
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char *argv[])
+{
+  int c;
+  int server = 0;
+  int port = 53;
+  double delay = 0;
+  uint32_t ttl = 300;
+  int nb_queries = 10000;
+  int window = 16;
+  int nb_hosts = 100;
+  double skew = 1;
+  struct sockaddr_in6 addr;
+  int sock;
+
+  while((c = getopt(argc, argv, "sp:d:t:n:w:H:z:h")) != -1) {
+    switch(c) {
+    case 's':
+      server = 1;
+      break;
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'd':
+      delay = atof(optarg) / 1000;
+      break;
+    case 't':
+      ttl = atoi(optarg);
+      break;
+    case 'n':
+      nb_queries = atoi(optarg);
+      break;
+    case 'w':
+      window = atoi(optarg);
+      break;
+    case 'H':
+      nb_hosts = atoi(optarg);
+      break;
+    case 'z':
+      skew = atof(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if(window <= 0 || window > MAX_WINDOW || nb_hosts <= 0 || nb_queries <= 0 ||
+     (!server && optind >= argc)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  sock = socket(AF_INET6, SOCK_DGRAM, 0);
+  if(sock == -1) {
+    perror("socket");
+    return 1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_port = htons(port);
+  if(server) {
+    addr.sin6_addr = in6addr_any;
+    if(bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+      perror("bind");
+      return 1;
+    }
+    return run_server(sock, delay, ttl);
+  }
+  if(inet_pton(AF_INET6, argv[optind], &addr.sin6_addr) != 1) {
+    fprintf(stderr, "Invalid address %s\n", argv[optind]);
+    return 1;
+  }
+  srand(1);
+  return run_client(sock, &addr, nb_queries, window, nb_hosts, skew, 5);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Convert a binary node info export file to CSV.
+ *
+ *         By default all the snapshots are printed on stdout in the global
+ *         layout with an additional timestamp column. With -d, the legacy
+ *         per node layout is recreated, one CSV file per node in the given
+ *         directory.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "node-info-export-format.h"
+
+/*---------------------------------------------------------------------------*/
+static int
+print_record_per_node(const char *path, node_info_export_record_t *record)
+{
+  /* '/' + :XXXX times 8 + '.csv' */
+  char full_path[PATH_MAX + 8*5 + 4 + 1];
+  int len = strlen(path);
+  int existing_file;
+  FILE *stream;
+
+  strcpy(full_path, path);
+  full_path[len] = '/';
+  strcpy(full_path + len + 1 + node_info_export_print_ipaddr(full_path + len + 1, record->ipaddr), ".csv");
+  existing_file = access(full_path, W_OK) == 0;
+  stream = fopen(full_path, "a");
+  if(stream == NULL) {
+    perror(full_path);
+    return -1;
+  }
+  if(!existing_file) {
+    node_info_export_print_csv_header(stream, 1);
+  }
+  node_info_export_print_csv(stream, record, 1);
+  fclose(stream);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [-u] [-d directory] export file\n", name);
+  fprintf(stderr, "  -u: use the wall clock time of the snapshot as timestamp\n");
+  fprintf(stderr, "  -d: write one CSV file per node in the directory\n");
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char *argv[])
+{
+  int c;
+  int wall_time = 0;
+  const char *path = NULL;
+  FILE *stream;
+  uint8_t header[NODE_INFO_EXPORT_FILE_HEADER_SIZE];
+  uint8_t batch_header[NODE_INFO_EXPORT_BATCH_HEADER_SIZE];
+  uint8_t *buf;
+  int record_size;
+  node_info_export_record_t record;
+  uint32_t count;
+  uint64_t time;
+  uint32_t i;
+  unsigned long batches = 0;
+
+  while((c = getopt(argc, argv, "ud:h")) != -1) {
+    switch(c) {
+    case 'u':
+      wall_time = 1;
+      break;
+    case 'd':
+      path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if(optind >= argc || (path != NULL && strlen(path) >= PATH_MAX)) {
+    usage(argv[0]);
+    return 1;
+  }
+  stream = fopen(argv[optind], "rb");
+  if(stream == NULL) {
+    perror(argv[optind]);
+    return 1;
+  }
+  if(fread(header, sizeof(header), 1, stream) != 1 ||
+     (record_size = node_info_export_read_file_header(header)) < 0) {
+    fprintf(stderr, "%s: not a node info export file\n", argv[optind]);
+    fclose(stream);
+    return 1;
+  }
+  /* Newer versions may append fields to the records */
+  buf = malloc(record_size);
+  if(buf == NULL) {
+    fclose(stream);
+    return 1;
+  }
+  if(path != NULL) {
+    if(access(path, X_OK) < 0 && mkdir(path, 0755) < 0) {
+      fprintf(stderr, "Can not create path '%s': %s\n", path, strerror(errno));
+      free(buf);
+      fclose(stream);
+      return 1;
+    }
+  } else {
+    node_info_export_print_csv_header(stdout, 1);
+  }
+
+  while(fread(batch_header, sizeof(batch_header), 1, stream) == 1) {
+    if(node_info_export_read_batch_header(batch_header, &count, &time) < 0) {
+      fprintf(stderr, "Corrupted batch header after %lu batches\n", batches);
+      break;
+    }
+    for(i = 0; i < count; i++) {
+      if(fread(buf, record_size, 1, stream) != 1) {
+        fprintf(stderr, "Truncated batch after %lu batches\n", batches);
+        break;
+      }
+      node_info_export_read_record(buf, &record);
+      if(wall_time) {
+        record.timestamp = time;
+      }
+      if(path != NULL) {
+        if(print_record_per_node(path, &record) < 0) {
+          break;
+        }
+      } else {
+        node_info_export_print_csv(stdout, &record, 1);
+      }
+    }
+    if(i < count) {
+      break;
+    }
+    batches++;
+  }
+
+  free(buf);
+  fclose(stream);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
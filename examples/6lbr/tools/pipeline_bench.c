@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Compare the inline and the pipelined forwarding paths of the native
+ *         platform.
+ *
+ *         A generator thread sends timestamped packets at a fixed rate to a
+ *         forwarding core which spends some time on each packet and is
+ *         periodically stalled, like the Contiki thread rendering a web page.
+ *         The forwarded packets are received by a sink thread which records
+ *         their latency.
+ *
+ *         In inline mode, the core reads and writes the sockets itself. In
+ *         pipelined mode, an input and an output thread exchange the packets
+ *         with the core through the pipeline queues, so that the sockets are
+ *         drained while the core is stalled. Each packet is handed over two
+ *         more times between threads, which is only cheap when the threads
+ *         have their own cores.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "pipeline-queue.h"
+
+#define MAX_PACKET_SIZE 1500
+#define QUEUE_SIZE (256 * 1024)
+
+static int nb_packets = 100000;
+static int packet_size = 128;
+static int rate = 20000;
+static int work_ns = 5000;
+static int stall_every = 1000;
+static int stall_us = 2000;
+
+/* Generator to core and core to sink sockets */
+static int in_fd[2];
+static int out_fd[2];
+
+static pipeline_queue_t rx_queue;
+static pipeline_queue_t tx_queue;
+static pipeline_wakeup_t rx_wakeup;
+static pipeline_wakeup_t tx_wakeup;
+
+static volatile int done;
+static volatile uint32_t sent;
+static uint32_t send_dropped;
+static volatile uint32_t core_dropped;
+static uint32_t received;
+static uint64_t *latencies;
+static uint64_t first_send;
+static uint64_t last_receive;
+
+/*---------------------------------------------------------------------------*/
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+spin_ns(uint64_t ns)
+{
+  uint64_t end = now_ns() + ns;
+  while(now_ns() < end) {
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void *
+generator_thread(void *arg)
+{
+  uint8_t packet[MAX_PACKET_SIZE];
+  uint64_t period = 1000000000ULL / rate;
+  uint64_t next;
+  uint64_t t;
+  int i;
+
+  memset(packet, 0, sizeof(packet));
+  first_send = now_ns();
+  next = first_send;
+  for(i = 0; i < nb_packets; i++) {
+    /* Sleep rather than spin, a spinning generator steals the CPU of the
+       forwarding threads when there are fewer cores than threads */
+    if((t = now_ns()) < next) {
+      struct timespec ts;
+      ts.tv_sec = next / 1000000000ULL;
+      ts.tv_nsec = next % 1000000000ULL;
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+      t = now_ns();
+    }
+    memcpy(packet, &t, sizeof(t));
+    if(send(in_fd[0], packet, packet_size, MSG_DONTWAIT) == -1) {
+      /* Ingress buffer full, like a NIC ring overflow */
+      send_dropped++;
+    } else {
+      sent++;
+    }
+    next += period;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void *
+sink_thread(void *arg)
+{
+  uint8_t packet[MAX_PACKET_SIZE];
+  struct pollfd fds;
+  uint64_t t;
+
+  fds.fd = out_fd[1];
+  fds.events = POLLIN;
+  /* Packets dropped by the core never arrive, and the sockets may drop
+     some too, so stop once the core is done and the sink is idle */
+  while(!done || received + core_dropped < sent) {
+    if(poll(&fds, 1, 100) <= 0) {
+      if(done) {
+        break;
+      }
+      continue;
+    }
+    while(recv(out_fd[1], packet, sizeof(packet), MSG_DONTWAIT) > 0) {
+      memcpy(&t, packet, sizeof(t));
+      last_receive = now_ns();
+      latencies[received++] = last_receive - t;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+process_packet(uint32_t count)
+{
+  spin_ns(work_ns);
+  if(stall_every > 0 && count % stall_every == 0) {
+    spin_ns((uint64_t)stall_us * 1000);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_inline(void)
+{
+  uint8_t packet[MAX_PACKET_SIZE];
+  struct pollfd fds;
+  uint32_t count = 0;
+  int len;
+
+  fds.fd = in_fd[1];
+  fds.events = POLLIN;
+  while(!done) {
+    if(poll(&fds, 1, 100) <= 0) {
+      continue;
+    }
+    while((len = recv(in_fd[1], packet, sizeof(packet), MSG_DONTWAIT)) > 0) {
+      process_packet(++count);
+      send(out_fd[0], packet, len, 0);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void *
+input_thread(void *arg)
+{
+  struct pollfd fds;
+  uint8_t *data;
+  int count;
+  int len;
+
+  fds.fd = in_fd[1];
+  fds.events = POLLIN;
+  while(!done) {
+    if(poll(&fds, 1, 100) <= 0) {
+      continue;
+    }
+    /* Like the Ethernet thread, wake up the core once per batch */
+    count = 0;
+    while((data = pipeline_queue_reserve(&rx_queue, MAX_PACKET_SIZE)) != NULL
+          && (len = recv(in_fd[1], data, MAX_PACKET_SIZE, MSG_DONTWAIT)) > 0) {
+      pipeline_queue_commit(&rx_queue, len);
+      count++;
+    }
+    if(count > 0) {
+      pipeline_wakeup_signal(&rx_wakeup);
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void *
+output_thread(void *arg)
+{
+  struct pollfd fds;
+  uint8_t *data;
+  int len;
+
+  fds.fd = pipeline_wakeup_fd(&tx_wakeup);
+  fds.events = POLLIN;
+  while(!done) {
+    if(poll(&fds, 1, 100) <= 0) {
+      continue;
+    }
+    pipeline_wakeup_clear(&tx_wakeup);
+    while((data = pipeline_queue_peek(&tx_queue, &len)) != NULL) {
+      send(out_fd[0], data, len, 0);
+      pipeline_queue_release(&tx_queue);
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_pipelined(void)
+{
+  struct pollfd fds;
+  uint32_t count = 0;
+  uint8_t *data;
+  uint8_t *out;
+  int len;
+
+  fds.fd = pipeline_wakeup_fd(&rx_wakeup);
+  fds.events = POLLIN;
+  while(!done) {
+    if(poll(&fds, 1, 100) <= 0) {
+      continue;
+    }
+    pipeline_wakeup_clear(&rx_wakeup);
+    while((data = pipeline_queue_peek(&rx_queue, &len)) != NULL) {
+      process_packet(++count);
+      out = pipeline_queue_reserve(&tx_queue, len);
+      if(out != NULL) {
+        memcpy(out, data, len);
+        pipeline_queue_commit(&tx_queue, len);
+        pipeline_wakeup_signal(&tx_wakeup);
+      } else {
+        core_dropped++;
+      }
+      pipeline_queue_release(&rx_queue);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void *
+core_thread(void *arg)
+{
+  if(*(int *)arg) {
+    run_pipelined();
+  } else {
+    run_inline();
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+compare_latency(const void *a, const void *b)
+{
+  uint64_t la = *(const uint64_t *)a;
+  uint64_t lb = *(const uint64_t *)b;
+  return la < lb ? -1 : la > lb;
+}
+/*---------------------------------------------------------------------------*/
+static double
+percentile(double p)
+{
+  return latencies[(uint32_t)(p * (received - 1))] / 1000.0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [-p] [-n packets] [-s size] [-r rate] [-w work] [-e every] [-d stall]\n", name);
+  fprintf(stderr, "  -p: pipelined forwarding\n");
+  fprintf(stderr, "  -r: offered load in packets/s\n");
+  fprintf(stderr, "  -w: processing time per packet in ns\n");
+  fprintf(stderr, "  -e, -d: stall the core for d us every e packets\n");
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char *argv[])
+{
+  pthread_t generator, sink, core, input, output;
+  int pipelined = 0;
+  double elapsed;
+  int c;
+
+  while((c = getopt(argc, argv, "pn:s:r:w:e:d:h")) != -1) {
+    switch(c) {
+    case 'p':
+      pipelined = 1;
+      break;
+    case 'n':
+      nb_packets = atoi(optarg);
+      break;
+    case 's':
+      packet_size = atoi(optarg);
+      break;
+    case 'r':
+      rate = atoi(optarg);
+      break;
+    case 'w':
+      work_ns = atoi(optarg);
+      break;
+    case 'e':
+      stall_every = atoi(optarg);
+      break;
+    case 'd':
+      stall_us = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if(nb_packets <= 0 || rate <= 0 || packet_size < sizeof(uint64_t) || packet_size > MAX_PACKET_SIZE) {
+    usage(argv[0]);
+    return 1;
+  }
+  latencies = malloc(nb_packets * sizeof(uint64_t));
+  if(latencies == NULL
+     || socketpair(AF_UNIX, SOCK_DGRAM, 0, in_fd) == -1
+     || socketpair(AF_UNIX, SOCK_DGRAM, 0, out_fd) == -1
+     || !pipeline_queue_init(&rx_queue, QUEUE_SIZE)
+     || !pipeline_queue_init(&tx_queue, QUEUE_SIZE)
+     || !pipeline_wakeup_init(&rx_wakeup)
+     || !pipeline_wakeup_init(&tx_wakeup)) {
+    perror("init");
+    return 1;
+  }
+
+  pthread_create(&sink, NULL, sink_thread, NULL);
+  pthread_create(&core, NULL, core_thread, &pipelined);
+  if(pipelined) {
+    pthread_create(&input, NULL, input_thread, NULL);
+    pthread_create(&output, NULL, output_thread, NULL);
+  }
+  pthread_create(&generator, NULL, generator_thread, NULL);
+  pthread_join(generator, NULL);
+  /* Wait for the packets in flight */
+  usleep(500 * 1000);
+  done = 1;
+  pthread_join(core, NULL);
+  if(pipelined) {
+    pthread_join(input, NULL);
+    pthread_join(output, NULL);
+  }
+  pthread_join(sink, NULL);
+
+  if(received == 0) {
+    printf("No packet forwarded\n");
+    return 1;
+  }
+  qsort(latencies, received, sizeof(uint64_t), compare_latency);
+  elapsed = (last_receive - first_send) / 1e9;
+  printf("Mode : %s\n", pipelined ? "pipelined" : "inline");
+  printf("Offered : %d packets/s, %d bytes\n", rate, packet_size);
+  printf("Packets : %u forwarded, %u lost (%u on input, %u in the core)\n",
+         received, nb_packets - received, send_dropped, core_dropped);
+  printf("Packets/s : %.0f\n", received / elapsed);
+  printf("Latency (us) : p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+         percentile(0.5), percentile(0.99), percentile(0.999), latencies[received - 1] / 1000.0);
+
+  free(latencies);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2013, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Replay a captured SLIP stream through the slip-dev decoder and
+ *         report the decoding throughput.
+ *
+ *         The capture is the raw byte stream received from the slip-radio,
+ *         (e.g. recorded with 'cat /dev/ttyUSB0 > capture.slip'). Without
+ *         capture file, a synthetic stream of 802.15.4 sized frames is used.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "slip-decoder.h"
+
+static slip_decoder_t decoder;
+
+static uint32_t frames;
+static uint32_t crc_errors;
+static uint64_t frame_bytes;
+
+/*---------------------------------------------------------------------------*/
+static void
+frame_input(void *ptr, unsigned char *frame, int len, uint8_t crc)
+{
+  int check_crc = *(int *)ptr;
+  frames++;
+  frame_bytes += len;
+  if(check_crc && crc) {
+    crc_errors++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+slip_encode(uint8_t *out, const uint8_t *in, int len, int with_crc)
+{
+  int i;
+  int pos = 0;
+  uint8_t crc = 0;
+  uint8_t c;
+
+  for(i = 0; i <= len; i++) {
+    if(i == len) {
+      if(!with_crc) {
+        break;
+      }
+      c = crc;
+    } else {
+      c = in[i];
+      crc = slip_crc8_add(crc, c);
+    }
+    if(c == SLIP_END) {
+      out[pos++] = SLIP_ESC;
+      out[pos++] = SLIP_ESC_END;
+    } else if(c == SLIP_ESC) {
+      out[pos++] = SLIP_ESC;
+      out[pos++] = SLIP_ESC_ESC;
+    } else {
+      out[pos++] = c;
+    }
+  }
+  out[pos++] = SLIP_END;
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+generate_stream(int nb_frames, int with_crc, size_t *size)
+{
+  uint8_t frame[127];
+  uint8_t *stream;
+  size_t pos = 0;
+  int i, j, len;
+
+  stream = malloc(nb_frames * (sizeof(frame) * 2 + 4));
+  if(stream == NULL) {
+    return NULL;
+  }
+  srand(1);
+  for(i = 0; i < nb_frames; i++) {
+    len = 20 + rand() % (sizeof(frame) - 20);
+    frame[0] = '!';
+    frame[1] = 'S';
+    for(j = 2; j < len; j++) {
+      frame[j] = rand();
+    }
+    pos += slip_encode(stream + pos, frame, len, with_crc);
+  }
+  *size = pos;
+  return stream;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+load_stream(const char *filename, size_t *size)
+{
+  struct stat st;
+  uint8_t *stream;
+  int fd;
+  ssize_t n;
+  size_t pos = 0;
+
+  fd = open(filename, O_RDONLY);
+  if(fd == -1 || fstat(fd, &st) == -1) {
+    perror(filename);
+    return NULL;
+  }
+  stream = malloc(st.st_size);
+  if(stream == NULL) {
+    close(fd);
+    return NULL;
+  }
+  while(pos < st.st_size && (n = read(fd, stream + pos, st.st_size - pos)) > 0) {
+    pos += n;
+  }
+  close(fd);
+  *size = pos;
+  return stream;
+}
+/*---------------------------------------------------------------------------*/
+static void
+usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [-c] [-n iterations] [-b block size] [-f frames] [capture file]\n", name);
+  fprintf(stderr, "  -c: frames carry a CRC8 trailer\n");
+  fprintf(stderr, "  -b: size of the blocks fed to the decoder, mimics read() sizes\n");
+  fprintf(stderr, "  -f: number of frames in the synthetic stream\n");
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char *argv[])
+{
+  int c;
+  int with_crc = 0;
+  int iterations = 100;
+  int block_size = 256;
+  int nb_frames = 10000;
+  uint8_t *stream;
+  size_t stream_size;
+  size_t pos;
+  int i, size, n;
+  unsigned char *rx;
+  struct timespec start, end;
+  double elapsed;
+
+  while((c = getopt(argc, argv, "cn:b:f:h")) != -1) {
+    switch(c) {
+    case 'c':
+      with_crc = 1;
+      break;
+    case 'n':
+      iterations = atoi(optarg);
+      break;
+    case 'b':
+      block_size = atoi(optarg);
+      break;
+    case 'f':
+      nb_frames = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if(block_size <= 0 || iterations <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  if(optind < argc) {
+    stream = load_stream(argv[optind], &stream_size);
+  } else {
+    stream = generate_stream(nb_frames, with_crc, &stream_size);
+  }
+  if(stream == NULL) {
+    return 1;
+  }
+
+  slip_decoder_init(&decoder);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(i = 0; i < iterations; i++) {
+    pos = 0;
+    while(pos < stream_size) {
+      rx = slip_decoder_rx_ptr(&decoder, &size);
+      n = block_size < size ? block_size : size;
+      if(n > stream_size - pos) {
+        n = stream_size - pos;
+      }
+      memcpy(rx, stream + pos, n);
+      slip_decoder_input(&decoder, n, frame_input, &with_crc);
+      pos += n;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  printf("Stream size : %lu bytes\n", (unsigned long)stream_size);
+  printf("Iterations : %d\n", iterations);
+  printf("Frames : %u (%u CRC errors, %u dropped)\n", frames, crc_errors, decoder.dropped);
+  printf("Time : %.3f s\n", elapsed);
+  printf("Frames/s : %.0f\n", frames / elapsed);
+  printf("Bytes/s : %.0f (decoded %.0f)\n", stream_size * (double)iterations / elapsed, frame_bytes / elapsed);
+
+  free(stream);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
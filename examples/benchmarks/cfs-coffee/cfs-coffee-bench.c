@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Coffee file system micro-benchmark
+ *
+ *         The file system is filled to 80% with files, then the cost of
+ *         opening, appending to, and removing and re-creating random files
+ *         is measured. Build it with WITH_INDEX=0 and WITH_INDEX=1 to compare
+ *         the storage scans with the RAM index.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+#include "cfs-coffee-arch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FILE_SIZE 4096
+#define FILE_CONTENT 1024
+#define APPEND_SIZE 16
+#define OPS_PER_STEP 20000UL
+
+/* Pages used by a file, including its header */
+#define FILE_PAGES ((FILE_SIZE + 32 + COFFEE_PAGE_SIZE - 1) / COFFEE_PAGE_SIZE)
+#define NB_FILES (int)((COFFEE_SIZE / COFFEE_PAGE_SIZE) * 8 / 10 / FILE_PAGES)
+
+PROCESS(cfs_coffee_bench_process, "Coffee benchmark");
+AUTOSTART_PROCESSES(&cfs_coffee_bench_process);
+
+static char buf[FILE_CONTENT];
+
+/*---------------------------------------------------------------------------*/
+static void
+file_name(char *name, int id)
+{
+  sprintf(name, "file-%d", id);
+}
+/*---------------------------------------------------------------------------*/
+static int
+create_file(int id)
+{
+  char name[16];
+  int fd;
+  int r;
+
+  file_name(name, id);
+  if(cfs_coffee_reserve(name, FILE_SIZE) < 0) {
+    return -1;
+  }
+  fd = cfs_open(name, CFS_WRITE);
+  if(fd < 0) {
+    return -1;
+  }
+  r = cfs_write(fd, buf, sizeof(buf));
+  cfs_close(fd);
+  return r == sizeof(buf) ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+measure_open(void)
+{
+  char name[16];
+  unsigned long i;
+  clock_time_t start;
+  int fd;
+
+  start = clock_time();
+  for(i = 0; i < OPS_PER_STEP; i++) {
+    file_name(name, rand() % NB_FILES);
+    fd = cfs_open(name, CFS_READ);
+    if(fd < 0) {
+      printf("Could not open %s\n", name);
+      break;
+    }
+    cfs_close(fd);
+  }
+  return clock_time() - start;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+measure_append(void)
+{
+  char name[16];
+  unsigned long i;
+  clock_time_t start;
+  int fd;
+
+  start = clock_time();
+  for(i = 0; i < OPS_PER_STEP; i++) {
+    file_name(name, i % NB_FILES);
+    fd = cfs_open(name, CFS_WRITE | CFS_APPEND);
+    if(fd < 0 || cfs_write(fd, buf, APPEND_SIZE) != APPEND_SIZE) {
+      printf("Could not append to %s\n", name);
+      cfs_close(fd);
+      break;
+    }
+    cfs_close(fd);
+  }
+  return clock_time() - start;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+measure_remove(void)
+{
+  char name[16];
+  unsigned long i;
+  clock_time_t start;
+  int id;
+
+  start = clock_time();
+  for(i = 0; i < OPS_PER_STEP; i++) {
+    /* Oldest files first, so that the garbage collector can erase the
+       sectors once they only contain removed files */
+    id = i % NB_FILES;
+    file_name(name, id);
+    if(cfs_remove(name) < 0 || create_file(id) < 0) {
+      printf("Could not re-create %s\n", name);
+      break;
+    }
+  }
+  return clock_time() - start;
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_result(const char *op, unsigned long time)
+{
+  printf("%s, %lu\n", op, time * (1000000000UL / CLOCK_SECOND) / OPS_PER_STEP);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(cfs_coffee_bench_process, ev, data)
+{
+  int i;
+
+  PROCESS_BEGIN();
+
+  printf("Coffee benchmark: %s, %d files of %d pages, %lu pages\n",
+         COFFEE_BENCH_WITH_INDEX ? "RAM index" : "storage scan",
+         NB_FILES, (int)FILE_PAGES, (unsigned long)(COFFEE_SIZE / COFFEE_PAGE_SIZE));
+
+  memset(buf, 'x', sizeof(buf));
+  srand(1);
+  cfs_coffee_format();
+  for(i = 0; i < NB_FILES; i++) {
+    if(create_file(i) < 0) {
+      printf("Could not create file %d\n", i);
+      PROCESS_EXIT();
+    }
+  }
+
+  printf("operation, ns/op\n");
+  print_result("open", measure_open());
+  PROCESS_PAUSE();
+  print_result("append", measure_append());
+  PROCESS_PAUSE();
+  print_result("remove", measure_remove());
+
+  printf("Coffee benchmark done\n");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         CSMA scheduling benchmark
+ *
+ *         A simulated slip-radio buffers up to RADIO_WINDOW frames and sends
+ *         them one after the other. Bulk transfers keep the queues of a few
+ *         neighbors full while RPL control packets are sent periodically to
+ *         a larger set of neighbors, bulk ones included. The benchmark
+ *         reports the control packet latency and the bulk throughput. Build
+ *         it with WITH_DRR=0 and WITH_DRR=1 to compare the independent
+ *         neighbor queues with the deficit round robin scheduler.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "contiki.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+#include "net/mac/csma.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-icmp6.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Frames buffered by the radio, as the native-rdc window */
+#define RADIO_WINDOW 16
+/* Air time of a frame, 4 ms is about 127 bytes at 250 kbit/s */
+#define AIRTIME (CLOCK_SECOND / 250)
+
+#ifndef BULK_NEIGHBORS
+#define BULK_NEIGHBORS 2
+#endif
+/* Packets of a bulk transfer queued at any time */
+#ifndef BULK_WINDOW
+#define BULK_WINDOW 16
+#endif
+#define BULK_SIZE 100
+
+#ifndef CONTROL_NEIGHBORS
+#define CONTROL_NEIGHBORS 8
+#endif
+#define CONTROL_INTERVAL (CLOCK_SECOND / 20)
+#define CONTROL_SIZE 60
+
+#define DURATION (10 * CLOCK_SECOND)
+#define MAX_CONTROL_PACKETS (DURATION / CONTROL_INTERVAL + 1)
+
+PROCESS(csma_bench_process, "CSMA benchmark");
+AUTOSTART_PROCESSES(&csma_bench_process);
+
+/* Simulated radio */
+struct radio_frame {
+  mac_callback_t sent;
+  void *ptr;
+  struct rdc_buf_list *buf;
+};
+static struct radio_frame radio_frames[RADIO_WINDOW];
+static int radio_head;
+static int radio_len;
+static struct ctimer radio_timer;
+static unsigned long radio_full;
+
+/* Traffic */
+static int running;
+static int bulk_outstanding[BULK_NEIGHBORS];
+static unsigned long bulk_sent[BULK_NEIGHBORS];
+static int bulk_refused;
+static clock_time_t control_time[MAX_CONTROL_PACKETS];
+static int control_nb;
+static unsigned long control_done[2];
+static unsigned long control_dropped[2];
+static unsigned long control_latency[2];
+static clock_time_t control_max[2];
+
+/*---------------------------------------------------------------------------*/
+static void
+radio_done(void *ptr)
+{
+  struct radio_frame frame = radio_frames[radio_head];
+
+  radio_head = (radio_head + 1) % RADIO_WINDOW;
+  radio_len--;
+  if(radio_len > 0) {
+    ctimer_set(&radio_timer, AIRTIME, radio_done, NULL);
+  }
+  queuebuf_to_packetbuf(frame.buf->buf);
+  mac_call_sent_callback(frame.sent, frame.ptr, MAC_TX_OK, 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+rdc_send(mac_callback_t sent, void *ptr)
+{
+  mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+rdc_send_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *list)
+{
+  queuebuf_to_packetbuf(list->buf);
+  if(radio_len == RADIO_WINDOW) {
+    /* Same as native-rdc when the window is full */
+    radio_full++;
+    mac_call_sent_callback(sent, ptr, MAC_TX_NOACK, 1);
+    return;
+  }
+  radio_frames[(radio_head + radio_len) % RADIO_WINDOW].sent = sent;
+  radio_frames[(radio_head + radio_len) % RADIO_WINDOW].ptr = ptr;
+  radio_frames[(radio_head + radio_len) % RADIO_WINDOW].buf = list;
+  if(radio_len++ == 0) {
+    ctimer_set(&radio_timer, AIRTIME, radio_done, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+rdc_input(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+static int
+rdc_on(void)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+rdc_off(int keep_radio_on)
+{
+  return keep_radio_on;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+rdc_channel_check_interval(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+rdc_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+const struct rdc_driver bench_rdc_driver = {
+  "bench-rdc",
+  rdc_init,
+  rdc_send,
+  rdc_send_list,
+  rdc_input,
+  rdc_on,
+  rdc_off,
+  rdc_channel_check_interval,
+};
+/*---------------------------------------------------------------------------*/
+static void
+prepare_packet(int neighbor, int len)
+{
+  linkaddr_t addr;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.u8[LINKADDR_SIZE - 1] = neighbor + 1;
+  packetbuf_clear();
+  memset(packetbuf_dataptr(), neighbor, len);
+  packetbuf_set_datalen(len);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &addr);
+}
+/*---------------------------------------------------------------------------*/
+static void bulk_refill(int neighbor);
+
+static void
+bulk_sent_callback(void *ptr, int status, int transmissions)
+{
+  int neighbor = (int)(uintptr_t)ptr;
+
+  bulk_outstanding[neighbor]--;
+  if(status == MAC_TX_OK) {
+    bulk_sent[neighbor]++;
+  }
+  if(status == MAC_TX_ERR) {
+    /* Refused by CSMA, the queue is full */
+    bulk_refused = 1;
+  } else if(running) {
+    bulk_refill(neighbor);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+bulk_refill(int neighbor)
+{
+  bulk_refused = 0;
+  while(bulk_outstanding[neighbor] < BULK_WINDOW && !bulk_refused) {
+    bulk_outstanding[neighbor]++;
+    prepare_packet(neighbor, BULK_SIZE);
+    packetbuf_set_attr(PACKETBUF_ATTR_NETWORK_ID, UIP_PROTO_UDP);
+    NETSTACK_MAC.send(bulk_sent_callback, (void *)(uintptr_t)neighbor);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+control_sent_callback(void *ptr, int status, int transmissions)
+{
+  int id = (int)(uintptr_t)ptr;
+  int bulk = id % CONTROL_NEIGHBORS < BULK_NEIGHBORS;
+  clock_time_t latency;
+
+  if(status != MAC_TX_OK) {
+    control_dropped[bulk]++;
+    return;
+  }
+  latency = clock_time() - control_time[id];
+  control_done[bulk]++;
+  control_latency[bulk] += latency;
+  if(latency > control_max[bulk]) {
+    control_max[bulk] = latency;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_control(void)
+{
+  int id = control_nb++;
+
+  control_time[id] = clock_time();
+  prepare_packet(id % CONTROL_NEIGHBORS, CONTROL_SIZE);
+  packetbuf_set_attr(PACKETBUF_ATTR_NETWORK_ID, UIP_PROTO_ICMP6);
+  /* A RPL DAO-ACK */
+  packetbuf_set_attr(PACKETBUF_ATTR_CHANNEL, ICMP6_RPL << 8 | 0x03);
+  NETSTACK_MAC.send(control_sent_callback, (void *)(uintptr_t)id);
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_control(const char *name, int bulk)
+{
+  printf("Control to %s neighbors : %lu sent, %lu dropped, mean %lu ms, max %lu ms\n",
+         name, control_done[bulk], control_dropped[bulk],
+         control_done[bulk] ? control_latency[bulk] * 1000 / CLOCK_SECOND / control_done[bulk] : 0,
+         (unsigned long)control_max[bulk] * 1000 / CLOCK_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(csma_bench_process, ev, data)
+{
+  static struct etimer et;
+  static clock_time_t start;
+  int i;
+#if CSMA_WITH_DRR
+  struct csma_neighbor_stats stats;
+  int used;
+#endif
+
+  PROCESS_BEGIN();
+
+  printf("CSMA benchmark: %s, %d bulk neighbors, %d control neighbors\n",
+         CSMA_WITH_DRR ? "deficit round robin" : "independent queues",
+         BULK_NEIGHBORS, CONTROL_NEIGHBORS);
+
+  running = 1;
+  start = clock_time();
+  for(i = 0; i < BULK_NEIGHBORS; i++) {
+    bulk_refill(i);
+  }
+  etimer_set(&et, CONTROL_INTERVAL);
+  while(clock_time() - start < DURATION) {
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    etimer_reset(&et);
+    send_control();
+    /* Restart the transfers stopped by a full queue */
+    for(i = 0; i < BULK_NEIGHBORS; i++) {
+      bulk_refill(i);
+    }
+  }
+  running = 0;
+  /* Let the queues drain */
+  etimer_set(&et, CLOCK_SECOND * 2);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  print_control("bulk", 1);
+  print_control("other", 0);
+  for(i = 0; i < BULK_NEIGHBORS; i++) {
+    printf("Bulk %d : %lu packets/s\n", i,
+           bulk_sent[i] * CLOCK_SECOND / DURATION);
+  }
+  printf("Packet overflows : %lu, radio window full : %lu\n",
+         (unsigned long)csma_packet_overflow, radio_full);
+#if CSMA_WITH_DRR
+  for(i = 0; (used = csma_neighbor_stats(i, &stats)) >= 0; i++) {
+    if(used && stats.dequeued > 0) {
+      printf("Neighbor %d : %lu packets, max queued %u, sojourn mean %lu ms, max %lu ms\n",
+             stats.addr.u8[LINKADDR_SIZE - 1], (unsigned long)stats.dequeued,
+             stats.max_queued,
+             (unsigned long)(stats.sojourn_total * 1000 / CLOCK_SECOND / stats.dequeued),
+             (unsigned long)stats.sojourn_max * 1000 / CLOCK_SECOND);
+    }
+  }
+#endif
+
+  printf("CSMA benchmark done\n");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
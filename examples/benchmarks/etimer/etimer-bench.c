@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Event and callback timer stress benchmark
+ *
+ *         Up to NB_TIMERS event timers are kept pending and, for several
+ *         numbers of pending timers, the cost of re-arming and of stopping
+ *         and setting again random timers is measured. The same is done
+ *         with callback timers, then all the timers are set to expire within
+ *         one second to measure their lateness. Build it with WITH_WHEEL=0
+ *         and WITH_WHEEL=1 to compare the timer list with the timer wheel.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+
+#define NB_TIMERS 10000
+/* Each measure runs for at least this time */
+#define MEASURE_TIME (CLOCK_SECOND / 4)
+/* Pending timers expire between one and two minutes from now */
+#define LONG_INTERVAL (60 * CLOCK_SECOND)
+#define EXPIRY_SPREAD CLOCK_SECOND
+
+PROCESS(etimer_bench_process, "Timer benchmark");
+AUTOSTART_PROCESSES(&etimer_bench_process);
+
+static struct etimer etimers[NB_TIMERS];
+static struct ctimer ctimers[NB_TIMERS];
+static unsigned long ctimer_calls;
+
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+long_interval(void)
+{
+  return LONG_INTERVAL + random_rand() % LONG_INTERVAL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+ctimer_callback(void *ptr)
+{
+  ctimer_calls++;
+}
+/*---------------------------------------------------------------------------*/
+/* Runs the operation on random timers until MEASURE_TIME has elapsed and
+   returns the cost of one operation in ns */
+static unsigned long
+measure(int size, int op)
+{
+  unsigned long ops;
+  clock_time_t start;
+  clock_time_t elapsed;
+  int i;
+  int n;
+
+  ops = 0;
+  start = clock_time();
+  do {
+    for(n = 0; n < 64; n++) {
+      i = random_rand() % size;
+      switch(op) {
+      case 0:
+        etimer_set(&etimers[i], long_interval());
+        break;
+      case 1:
+        etimer_stop(&etimers[i]);
+        etimer_set(&etimers[i], long_interval());
+        break;
+      case 2:
+        ctimer_set(&ctimers[i], long_interval(), ctimer_callback, NULL);
+        break;
+      default:
+        ctimer_stop(&ctimers[i]);
+        ctimer_set(&ctimers[i], long_interval(), ctimer_callback, NULL);
+        break;
+      }
+    }
+    ops += n;
+    elapsed = clock_time() - start;
+  } while(elapsed < MEASURE_TIME);
+  return elapsed * (1000000000UL / CLOCK_SECOND) / ops;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(etimer_bench_process, ev, data)
+{
+  static int size;
+  static int next_step;
+  static int expired;
+  static clock_time_t start;
+  static clock_time_t late;
+  static clock_time_t max_late;
+  static unsigned long total_late;
+  int i;
+
+  PROCESS_BEGIN();
+
+  printf("Timer benchmark: %s, %d timers\n",
+         ETIMER_WHEEL ? "timer wheel" : "timer list", NB_TIMERS);
+
+  printf("etimer, size, set ns/op, stop+set ns/op\n");
+  next_step = 10;
+  for(size = 1; size <= NB_TIMERS; size++) {
+    etimer_set(&etimers[size - 1], long_interval());
+    if(size == next_step) {
+      printf("etimer, %d, %lu, %lu\n", size, measure(size, 0), measure(size, 1));
+      next_step *= 10;
+      PROCESS_PAUSE();
+    }
+  }
+
+  printf("ctimer, size, set ns/op, stop+set ns/op\n");
+  next_step = 10;
+  for(size = 1; size <= NB_TIMERS; size++) {
+    ctimer_set(&ctimers[size - 1], long_interval(), ctimer_callback, NULL);
+    if(size == next_step) {
+      printf("ctimer, %d, %lu, %lu\n", size, measure(size, 2), measure(size, 3));
+      next_step *= 10;
+      PROCESS_PAUSE();
+    }
+  }
+
+  /* Let all the timers expire within EXPIRY_SPREAD */
+  for(i = 0; i < NB_TIMERS; i++) {
+    ctimer_set(&ctimers[i], 1 + random_rand() % EXPIRY_SPREAD, ctimer_callback, NULL);
+    etimer_set(&etimers[i], 1 + random_rand() % EXPIRY_SPREAD);
+  }
+  ctimer_calls = 0;
+  expired = 0;
+  max_late = 0;
+  total_late = 0;
+  start = clock_time();
+  while(expired < NB_TIMERS) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+    late = clock_time() - etimer_expiration_time(data);
+    if(late > max_late) {
+      max_late = late;
+    }
+    total_late += late;
+    expired++;
+  }
+  while(ctimer_calls < NB_TIMERS) {
+    PROCESS_PAUSE();
+  }
+  printf("expiry, %d etimers and %lu ctimers in %lu ms, lateness mean %lu ms, max %lu ms\n",
+         expired, ctimer_calls,
+         (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND),
+         (unsigned long)(total_late * 1000 / CLOCK_SECOND / expired),
+         (unsigned long)(max_late * 1000 / CLOCK_SECOND));
+
+  printf("Timer benchmark done\n");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Main loop of the host build of the benchmarks (TARGET=host, see
+ *         Makefile.host). It initializes what the native platform would
+ *         for the benchmark, starts its autostart process and runs the
+ *         scheduler until that process exits.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "contiki.h"
+#include "sys/autostart.h"
+#include "sys/ctimer.h"
+
+#if HOST_MAIN_WITH_NETSTACK
+#include "net/netstack.h"
+#include "net/queuebuf.h"
+#endif /* HOST_MAIN_WITH_NETSTACK */
+
+#if HOST_MAIN_WITH_DS6
+#include "net/ipv6/uip-ds6.h"
+#endif /* HOST_MAIN_WITH_DS6 */
+
+/*---------------------------------------------------------------------------*/
+int
+main(void)
+{
+  process_init();
+  process_start(&etimer_process, NULL);
+  ctimer_init();
+#if HOST_MAIN_WITH_NETSTACK
+  queuebuf_init();
+  NETSTACK_RDC.init();
+  NETSTACK_MAC.init();
+#endif /* HOST_MAIN_WITH_NETSTACK */
+#if HOST_MAIN_WITH_DS6
+  uip_ds6_neighbors_init();
+  uip_ds6_route_init();
+#endif /* HOST_MAIN_WITH_DS6 */
+  autostart_start(autostart_processes);
+
+  /* The benchmarks busy wait on their timers, as the native platform
+     does when there is no I/O */
+  while(process_is_running(autostart_processes[0])) {
+    process_run();
+    etimer_request_poll();
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
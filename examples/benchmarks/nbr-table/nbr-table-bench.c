@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Neighbor table lookup micro-benchmark
+ *
+ *         The table is filled step by step and, for each size, the cost of
+ *         nbr_table_get_from_lladdr() is measured for present and absent
+ *         addresses. Build it with WITH_HASH=0 and WITH_HASH=1 to compare
+ *         the list walk with the hash index.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "contiki.h"
+#include "net/nbr-table.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define LOOKUPS_PER_STEP 1000000UL
+
+PROCESS(nbr_table_bench_process, "Neighbor table benchmark");
+AUTOSTART_PROCESSES(&nbr_table_bench_process);
+
+NBR_TABLE(uint32_t, bench_table);
+
+/*---------------------------------------------------------------------------*/
+static void
+make_lladdr(linkaddr_t *lladdr, uint32_t id)
+{
+  memset(lladdr, 0, sizeof(linkaddr_t));
+  /* Mimic EUI-64 addresses sharing the same vendor prefix */
+  lladdr->u8[0] = 0x02;
+  lladdr->u8[1] = 0x12;
+  lladdr->u8[LINKADDR_SIZE - 2] = id >> 8;
+  lladdr->u8[LINKADDR_SIZE - 1] = id & 0xff;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+measure(int size, int present)
+{
+  linkaddr_t lladdr;
+  unsigned long i;
+  clock_time_t start;
+  volatile void *item;
+
+  start = clock_time();
+  for(i = 0; i < LOOKUPS_PER_STEP; i++) {
+    /* Absent addresses are taken above the filled range */
+    make_lladdr(&lladdr, present ? i % size : size + i % size);
+    item = nbr_table_get_from_lladdr(bench_table, &lladdr);
+  }
+  (void)item;
+  return clock_time() - start;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(nbr_table_bench_process, ev, data)
+{
+  static int size;
+  static int next_step;
+  linkaddr_t lladdr;
+  uint32_t *item;
+  unsigned long hit_time;
+  unsigned long miss_time;
+
+  PROCESS_BEGIN();
+
+  nbr_table_register(bench_table, NULL);
+
+  printf("nbr-table benchmark: %s, %d neighbors max\n",
+         NBR_TABLE_WITH_HASH ? "hash index" : "list walk", NBR_TABLE_MAX_NEIGHBORS);
+  printf("size, hit ns/lookup, miss ns/lookup\n");
+
+  next_step = 8;
+  for(size = 1; size <= NBR_TABLE_MAX_NEIGHBORS; size++) {
+    make_lladdr(&lladdr, size - 1);
+    item = nbr_table_add_lladdr(bench_table, &lladdr, NBR_TABLE_REASON_UNDEFINED, NULL);
+    if(item == NULL) {
+      printf("Could not add neighbor %d\n", size);
+      break;
+    }
+    *item = size - 1;
+    if(size == next_step || size == NBR_TABLE_MAX_NEIGHBORS) {
+      hit_time = measure(size, 1);
+      miss_time = measure(size, 0);
+      printf("%d, %lu, %lu\n", size,
+             hit_time * (1000000000UL / CLOCK_SECOND) / LOOKUPS_PER_STEP,
+             miss_time * (1000000000UL / CLOCK_SECOND) / LOOKUPS_PER_STEP);
+      next_step *= 2;
+      /* Let the system breathe between steps */
+      PROCESS_PAUSE();
+    }
+  }
+
+  printf("nbr-table benchmark done\n");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Host build (TARGET=host) stubs of the TSCH state used by
+ *         tsch-schedule and tsch-queue, in place of tsch.c and
+ *         tsch-slot-operation.c. The benchmark runs outside of any slot
+ *         operation, so the lock is a plain flag.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "contiki.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-slot-operation.h"
+
+const linkaddr_t tsch_broadcast_address = { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } };
+const linkaddr_t tsch_eb_address = { { 0, 0, 0, 0, 0, 0, 0, 0 } };
+struct tsch_link *current_link;
+int tsch_is_associated;
+int tsch_is_coordinator;
+
+static int locked;
+
+/*---------------------------------------------------------------------------*/
+int
+tsch_get_lock(void)
+{
+  if(locked) {
+    return 0;
+  }
+  locked = 1;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_release_lock(void)
+{
+  locked = 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_is_locked(void)
+{
+  return locked;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_schedule_keepalive(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_set_ka_timeout(uint32_t timeout)
+{
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         TSCH schedule lookup micro-benchmark
+ *
+ *         An Orchestra like schedule (EB, common shared and per neighbor
+ *         unicast slotframes) is filled step by step and, for each size,
+ *         tsch_schedule_get_next_active_link() is checked against and timed
+ *         with a plain scan of all the links. Build it with SORTED=0 and
+ *         SORTED=1 to compare the list walk with the sorted links.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "contiki.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "net/mac/tsch/tsch-schedule.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define LOOKUPS_PER_STEP 1000000UL
+#define CHECKS_PER_STEP 100000UL
+
+#define EB_PERIOD 397
+#define COMMON_SHARED_PERIOD 31
+
+#if TSCH_BENCH_NEIGHBORS >= TSCH_BENCH_UNICAST_PERIOD
+#error The unicast slotframe must have more timeslots than neighbors
+#endif
+
+PROCESS(tsch_schedule_bench_process, "TSCH schedule benchmark");
+AUTOSTART_PROCESSES(&tsch_schedule_bench_process);
+
+static struct tsch_slotframe *slotframes[3];
+
+/*---------------------------------------------------------------------------*/
+static void
+make_lladdr(linkaddr_t *lladdr, uint16_t id)
+{
+  memset(lladdr, 0, sizeof(linkaddr_t));
+  lladdr->u8[0] = 0x02;
+  lladdr->u8[1] = 0x12;
+  lladdr->u8[LINKADDR_SIZE - 2] = id >> 8;
+  lladdr->u8[LINKADDR_SIZE - 1] = id & 0xff;
+}
+/*---------------------------------------------------------------------------*/
+/* Reference implementation: walk all the links of all the slotframes */
+static struct tsch_link *
+scan_next_active_link(struct tsch_asn_t *asn, uint16_t *time_offset,
+    struct tsch_link **backup_link)
+{
+  uint16_t time_to_curr_best = 0;
+  struct tsch_link *curr_best = NULL;
+  struct tsch_link *curr_backup = NULL;
+  int i;
+
+  for(i = 0; i < 3; i++) {
+    struct tsch_slotframe *sf = slotframes[i];
+    uint16_t timeslot = TSCH_ASN_MOD(*asn, sf->size);
+    struct tsch_link *l = list_head(sf->links_list);
+    while(l != NULL) {
+      uint16_t time_to_timeslot =
+        l->timeslot > timeslot ?
+        l->timeslot - timeslot :
+        sf->size.val + l->timeslot - timeslot;
+      if(curr_best == NULL || time_to_timeslot < time_to_curr_best) {
+        time_to_curr_best = time_to_timeslot;
+        curr_best = l;
+        curr_backup = NULL;
+      } else if(time_to_timeslot == time_to_curr_best) {
+        struct tsch_link *new_best = NULL;
+        if((curr_best->link_options & LINK_OPTION_TX) == (l->link_options & LINK_OPTION_TX)) {
+          if(l->slotframe_handle < curr_best->slotframe_handle) {
+            new_best = l;
+          }
+        } else if(l->link_options & LINK_OPTION_TX) {
+          new_best = l;
+        }
+        if(curr_backup == NULL) {
+          if(new_best != l && (l->link_options & LINK_OPTION_RX)) {
+            curr_backup = l;
+          }
+          if(new_best != curr_best && (curr_best->link_options & LINK_OPTION_RX)) {
+            curr_backup = curr_best;
+          }
+        }
+        if(new_best != NULL) {
+          curr_best = new_best;
+        }
+      }
+      l = list_item_next(l);
+    }
+  }
+  *time_offset = time_to_curr_best;
+  *backup_link = curr_backup;
+  return curr_best;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+check(void)
+{
+  struct tsch_asn_t asn;
+  struct tsch_link *link, *backup, *ref_link, *ref_backup;
+  uint16_t offset, ref_offset;
+  unsigned long i;
+  unsigned long errors = 0;
+
+  TSCH_ASN_INIT(asn, 1, 0xffff0000UL);
+  for(i = 0; i < CHECKS_PER_STEP; i++) {
+    link = tsch_schedule_get_next_active_link(&asn, &offset, &backup);
+    ref_link = scan_next_active_link(&asn, &ref_offset, &ref_backup);
+    if(link != ref_link || offset != ref_offset || backup != ref_backup) {
+      errors++;
+    }
+    TSCH_ASN_INC(asn, 1);
+  }
+  return errors;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+measure(int reference)
+{
+  struct tsch_asn_t asn;
+  struct tsch_link *backup;
+  uint16_t offset;
+  unsigned long i;
+  clock_time_t start;
+  volatile void *link;
+
+  TSCH_ASN_INIT(asn, 1, 0xffff0000UL);
+  start = clock_time();
+  for(i = 0; i < LOOKUPS_PER_STEP; i++) {
+    if(reference) {
+      link = scan_next_active_link(&asn, &offset, &backup);
+    } else {
+      link = tsch_schedule_get_next_active_link(&asn, &offset, &backup);
+    }
+    TSCH_ASN_INC(asn, 1);
+  }
+  (void)link;
+  return (clock_time() - start) * (1000000000UL / CLOCK_SECOND) / LOOKUPS_PER_STEP;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_schedule_bench_process, ev, data)
+{
+  static int neighbors;
+  static int next_step;
+  static unsigned long errors;
+  linkaddr_t lladdr;
+  unsigned long lookup_time;
+  unsigned long scan_time;
+
+  PROCESS_BEGIN();
+
+  tsch_queue_init();
+  tsch_schedule_init();
+
+  /* Same slotframes and handles as Orchestra */
+  slotframes[0] = tsch_schedule_add_slotframe(0, EB_PERIOD);
+  slotframes[1] = tsch_schedule_add_slotframe(1, TSCH_BENCH_UNICAST_PERIOD);
+  slotframes[2] = tsch_schedule_add_slotframe(2, COMMON_SHARED_PERIOD);
+  /* EB transmission and reception from the time source */
+  tsch_schedule_add_link(slotframes[0], LINK_OPTION_TX, LINK_TYPE_ADVERTISING_ONLY,
+                         &tsch_broadcast_address, 0, 0);
+  tsch_schedule_add_link(slotframes[0], LINK_OPTION_RX, LINK_TYPE_ADVERTISING_ONLY,
+                         &tsch_broadcast_address, EB_PERIOD / 2, 0);
+  /* Shared link for broadcast and unicast */
+  tsch_schedule_add_link(slotframes[2], LINK_OPTION_RX | LINK_OPTION_TX | LINK_OPTION_SHARED,
+                         LINK_TYPE_ADVERTISING, &tsch_broadcast_address, 0, 1);
+  /* Receiver-based unicast: our own Rx link */
+  tsch_schedule_add_link(slotframes[1], LINK_OPTION_RX, LINK_TYPE_NORMAL,
+                         &tsch_broadcast_address, 0, 2);
+
+  printf("tsch-schedule benchmark: %s, unicast slotframe %d\n",
+         TSCH_SCHEDULE_SORTED ? "sorted links" : "list walk", TSCH_BENCH_UNICAST_PERIOD);
+  printf("neighbors, links, lookup ns/slot, scan ns/slot\n");
+
+  errors = 0;
+  next_step = 1;
+  for(neighbors = 1; neighbors <= TSCH_BENCH_NEIGHBORS; neighbors++) {
+    /* Tx link to the Rx timeslot of the neighbor, the timeslots are all
+     * different as long as 7 and the unicast period minus one are coprime */
+    make_lladdr(&lladdr, neighbors);
+    if(tsch_schedule_add_link(slotframes[1], LINK_OPTION_TX | LINK_OPTION_SHARED, LINK_TYPE_NORMAL,
+                              &lladdr, 1 + (neighbors * 7) % (TSCH_BENCH_UNICAST_PERIOD - 1), 2) == NULL) {
+      printf("Could not add link to neighbor %d\n", neighbors);
+      break;
+    }
+    if(neighbors == next_step || neighbors == TSCH_BENCH_NEIGHBORS) {
+      errors += check();
+      lookup_time = measure(0);
+      scan_time = measure(1);
+      printf("%d, %d, %lu, %lu\n", neighbors, neighbors + 4, lookup_time, scan_time);
+      next_step *= 2;
+      /* Let the system breathe between steps */
+      PROCESS_PAUSE();
+    }
+  }
+
+  /* Remove every other neighbor, then check the schedule again */
+  for(neighbors = 1; neighbors <= TSCH_BENCH_NEIGHBORS; neighbors += 2) {
+    tsch_schedule_remove_link_by_timeslot(slotframes[1],
+        1 + (neighbors * 7) % (TSCH_BENCH_UNICAST_PERIOD - 1));
+  }
+  errors += check();
+
+  printf("tsch-schedule benchmark done, %lu mismatches\n", errors);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
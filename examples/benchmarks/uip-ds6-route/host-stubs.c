@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Host build (TARGET=host) stubs of the IPv6 stack functions
+ *         used by uip-ds6-route and uip-ds6-nbr. The benchmark only adds,
+ *         looks up and removes routes, so none of them is called.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "contiki.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/ip/uip-packetqueue.h"
+#include "net/link-stats.h"
+
+uip_ds6_netif_t uip_ds6_if;
+uint16_t uip_len;
+
+/*---------------------------------------------------------------------------*/
+void
+link_stats_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+link_stats_packet_sent(const linkaddr_t *lladdr, int status, int numtx)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_debug_ipaddr_print(const uip_ipaddr_t *addr)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_nd6_ns_output(uip_ipaddr_t *src, uip_ipaddr_t *dest, uip_ipaddr_t *tgt)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_packetqueue_new(struct uip_packetqueue_handle *handle)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_packetqueue_free(struct uip_packetqueue_handle *handle)
+{
+}
+/*---------------------------------------------------------------------------*/
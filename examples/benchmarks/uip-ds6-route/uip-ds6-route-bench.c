@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2017, CETIC.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Routing table lookup micro-benchmark
+ *
+ *         Host routes are added step by step, next to a /64 prefix route,
+ *         and for each size the cost of uip_ds6_route_lookup() is measured
+ *         for destinations with a host route and for destinations without
+ *         any route. Build it with LPM_INDEX=0 and LPM_INDEX=1 to compare
+ *         the list walk with the route index.
+ * \author
+ *         6LBR Team <6lbr@cetic.be>
+ */
+
+#include "contiki.h"
+#include "net/ipv6/uip-ds6.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define LOOKUPS_PER_STEP 100000UL
+#define NB_NEXTHOPS 8
+
+PROCESS(uip_ds6_route_bench_process, "Routing table benchmark");
+AUTOSTART_PROCESSES(&uip_ds6_route_bench_process);
+
+/*---------------------------------------------------------------------------*/
+static void
+make_host_addr(uip_ipaddr_t *ipaddr, uint32_t id)
+{
+  uip_ip6addr(ipaddr, 0xfd00, 0, 0, 0, 0x0212, 0x7400, id >> 16, id & 0xffff);
+}
+/*---------------------------------------------------------------------------*/
+static void
+make_nexthop(uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr, int id)
+{
+  uip_ip6addr(ipaddr, 0xfe80, 0, 0, 0, 0x0212, 0x7400, 0xffff, id);
+  memset(lladdr, 0, sizeof(uip_lladdr_t));
+  lladdr->addr[0] = 0x02;
+  lladdr->addr[1] = 0x12;
+  lladdr->addr[sizeof(uip_lladdr_t) - 1] = id;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+measure(int size, int present)
+{
+  uip_ipaddr_t ipaddr;
+  unsigned long i;
+  clock_time_t start;
+  volatile uip_ds6_route_t *route;
+
+  start = clock_time();
+  for(i = 0; i < LOOKUPS_PER_STEP; i++) {
+    /* Absent destinations are taken above the filled range */
+    make_host_addr(&ipaddr, present ? i % size : size + i % size);
+    route = uip_ds6_route_lookup(&ipaddr);
+  }
+  (void)route;
+  return clock_time() - start;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(uip_ds6_route_bench_process, ev, data)
+{
+  static int size;
+  static int next_step;
+  uip_ipaddr_t ipaddr;
+  uip_ipaddr_t nexthop;
+  uip_lladdr_t lladdr;
+  int i;
+  unsigned long hit_time;
+  unsigned long miss_time;
+
+  PROCESS_BEGIN();
+
+  for(i = 0; i < NB_NEXTHOPS; i++) {
+    make_nexthop(&nexthop, &lladdr, i);
+    uip_ds6_nbr_add(&nexthop, &lladdr, 1, NBR_REACHABLE, NBR_TABLE_REASON_UNDEFINED, NULL);
+  }
+  uip_ip6addr(&ipaddr, 0xfd01, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_route_add(&ipaddr, 64, &nexthop);
+
+  printf("uip-ds6-route benchmark: %s, %d routes max\n",
+         UIP_DS6_ROUTE_LPM_INDEX ? "route index" : "list walk", UIP_DS6_ROUTE_NB);
+  printf("routes, hit ns/lookup, miss ns/lookup\n");
+
+  next_step = 8;
+  for(size = 1; size < UIP_DS6_ROUTE_NB; size++) {
+    make_host_addr(&ipaddr, size - 1);
+    make_nexthop(&nexthop, &lladdr, size % NB_NEXTHOPS);
+    if(uip_ds6_route_add(&ipaddr, 128, &nexthop) == NULL) {
+      printf("Could not add route %d\n", size);
+      break;
+    }
+    if(size == next_step || size == UIP_DS6_ROUTE_NB - 1) {
+      hit_time = measure(size, 1);
+      miss_time = measure(size, 0);
+      printf("%d, %lu, %lu\n", size + 1,
+             hit_time * (1000000000UL / CLOCK_SECOND) / LOOKUPS_PER_STEP,
+             miss_time * (1000000000UL / CLOCK_SECOND) / LOOKUPS_PER_STEP);
+      next_step *= 2;
+      /* Let the system breathe between steps */
+      PROCESS_PAUSE();
+    }
+  }
+
+  printf("uip-ds6-route benchmark done\n");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -64,8 +64,14 @@ extern const struct slip_radio_sensors SLIP_RADIO_CONF_SENSORS;
 
 void slip_send_packet(const uint8_t *ptr, int len);
 
- /* max 16 packets at the same time??? */
-uint8_t packet_ids[16];
+ /* Session ids of the packets being sent, must be at least as large as
+    the window configured on the host side */
+#ifdef SLIP_RADIO_CONF_MAX_PENDING
+#define SLIP_RADIO_MAX_PENDING SLIP_RADIO_CONF_MAX_PENDING
+#else
+#define SLIP_RADIO_MAX_PENDING 16
+#endif
+uint8_t packet_ids[SLIP_RADIO_MAX_PENDING];
 int packet_pos;
 
 static int slip_radio_cmd_handler(const uint8_t *data, int len);
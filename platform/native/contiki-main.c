@@ -85,9 +85,45 @@
 #define SELECT_TIMEOUT 1000
 #endif
 
+#ifdef SELECT_CONF_EPOLL
+#define SELECT_EPOLL SELECT_CONF_EPOLL
+#else
+#define SELECT_EPOLL 0
+#endif
+
+#if SELECT_EPOLL
+#include <sys/epoll.h>
+
+/* Upper bound of the epoll wait, in ms */
+#ifdef SELECT_CONF_EPOLL_MAX_TIMEOUT
+#define SELECT_EPOLL_MAX_TIMEOUT SELECT_CONF_EPOLL_MAX_TIMEOUT
+#else
+#define SELECT_EPOLL_MAX_TIMEOUT 1000
+#endif
+
+#ifdef SELECT_CONF_EPOLL_EVENTS
+#define SELECT_EPOLL_EVENTS SELECT_CONF_EPOLL_EVENTS
+#else
+#define SELECT_EPOLL_EVENTS 16
+#endif
+#endif /* SELECT_EPOLL */
+
 static const struct select_callback *select_callback[SELECT_MAX];
 static int select_max = 0;
 
+#if SELECT_EPOLL
+static int epoll_fd = -1;
+/* Registered file descriptors, in registration order */
+static int select_fds[SELECT_MAX];
+static int select_nfds = 0;
+/* Events currently monitored by epoll for each file descriptor */
+static uint32_t select_events[SELECT_MAX];
+/* File descriptors epoll refuses (regular files, /dev/null). As with
+   select(), they are considered always ready */
+static uint8_t select_unpollable[SELECT_MAX];
+static int select_nunpollable = 0;
+#endif
+
 SENSORS(&pir_sensor, &vib_sensor, &button_sensor);
 
 static uint8_t serial_id[] = {0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08};
@@ -95,6 +131,191 @@ static uint8_t serial_id[] = {0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08};
 static uint16_t node_id = 0x0102;
 #endif /* !NETSTACK_CONF_WITH_IPV6 */
 /*---------------------------------------------------------------------------*/
+#if SELECT_EPOLL
+static void
+select_epoll_update(int fd, const struct select_callback *callback)
+{
+  int i;
+
+  if(callback != NULL && select_callback[fd] == NULL) {
+    select_fds[select_nfds++] = fd;
+    select_events[fd] = 0;
+  } else if(callback == NULL && select_callback[fd] != NULL) {
+    for(i = 0; i < select_nfds; i++) {
+      if(select_fds[i] == fd) {
+        select_fds[i] = select_fds[--select_nfds];
+        break;
+      }
+    }
+    if(select_unpollable[fd]) {
+      select_unpollable[fd] = 0;
+      select_nunpollable--;
+      select_events[fd] = 0;
+    } else if(select_events[fd] != 0) {
+      /* The fd may already be closed, ignore errors */
+      epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+      select_events[fd] = 0;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Change the events monitored for fd from old_events to events. The kernel
+ * drops the registration of a closed fd, and a reused fd number may still
+ * be registered, so ENOENT and EEXIST fall back to the other operation.
+ */
+static int
+select_epoll_ctl(int fd, uint32_t old_events, uint32_t events)
+{
+  struct epoll_event ev;
+  int ret;
+
+  if(events == 0) {
+    ret = epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    /* Not registered, or already closed */
+    return ret == -1 && (errno == ENOENT || errno == EBADF) ? 0 : ret;
+  }
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.fd = fd;
+  ret = epoll_ctl(epoll_fd, old_events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev);
+  if(ret == -1 && errno == ENOENT) {
+    ret = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+  } else if(ret == -1 && errno == EEXIST) {
+    ret = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+  }
+  return ret;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Update the epoll interest list according to what the callbacks request.
+ * set_fd() is still used to let the drivers enable or disable write
+ * notifications, but epoll_ctl() is only called when the requested events
+ * of a file descriptor change.
+ */
+static void
+select_epoll_set_fds(void)
+{
+  static const struct select_callback *called[SELECT_MAX];
+  fd_set fdr;
+  fd_set fdw;
+  int ncalled = 0;
+  int i, j, fd;
+  uint32_t events;
+
+  FD_ZERO(&fdr);
+  FD_ZERO(&fdw);
+  for(i = 0; i < select_nfds; i++) {
+    /* The same callback is often registered for several fds */
+    for(j = 0; j < ncalled && called[j] != select_callback[select_fds[i]]; j++);
+    if(j == ncalled) {
+      called[ncalled++] = select_callback[select_fds[i]];
+      select_callback[select_fds[i]]->set_fd(&fdr, &fdw);
+    }
+  }
+  for(i = 0; i < select_nfds; i++) {
+    fd = select_fds[i];
+    events = (FD_ISSET(fd, &fdr) ? EPOLLIN : 0) | (FD_ISSET(fd, &fdw) ? EPOLLOUT : 0);
+    if(events != select_events[fd]) {
+      if(select_unpollable[fd]) {
+        /* Not in the epoll set, select_epoll_wait() handles it */
+      } else if(select_epoll_ctl(fd, select_events[fd], events) == -1) {
+        if(errno != EPERM) {
+          /* Keep the previous events, the update is retried next time */
+          perror("epoll_ctl");
+          continue;
+        }
+        fprintf(stderr, "epoll_ctl: fd %d can not be polled, it is considered always ready\n", fd);
+        select_unpollable[fd] = 1;
+        select_nunpollable++;
+      }
+      select_events[fd] = events;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+select_epoll_timeout(int pending)
+{
+  clock_time_t now;
+  clock_time_t next;
+  clock_time_t timeout;
+  int i;
+
+  if(pending) {
+    return 0;
+  }
+  for(i = 0; i < select_nfds && select_nunpollable > 0; i++) {
+    if(select_unpollable[select_fds[i]] && select_events[select_fds[i]] != 0) {
+      return 0;
+    }
+  }
+  if(!etimer_pending()) {
+    return SELECT_EPOLL_MAX_TIMEOUT;
+  }
+  now = clock_time();
+  next = etimer_next_expiration_time();
+  if((long)(next - now) <= 0) {
+    return 0;
+  }
+  timeout = ((next - now) * 1000 + CLOCK_SECOND - 1) / CLOCK_SECOND;
+  return timeout < SELECT_EPOLL_MAX_TIMEOUT ? timeout : SELECT_EPOLL_MAX_TIMEOUT;
+}
+/*---------------------------------------------------------------------------*/
+static void
+select_epoll_wait(int pending)
+{
+  struct epoll_event events[SELECT_EPOLL_EVENTS];
+  fd_set fdr;
+  fd_set fdw;
+  int i, n, fd;
+
+  select_epoll_set_fds();
+
+  n = epoll_wait(epoll_fd, events, SELECT_EPOLL_EVENTS, select_epoll_timeout(pending));
+  if(n < 0) {
+    if(errno != EINTR) {
+      perror("epoll_wait");
+    }
+    return;
+  }
+  FD_ZERO(&fdr);
+  FD_ZERO(&fdw);
+  for(i = 0; i < n; i++) {
+    fd = events[i].data.fd;
+    /* The callback may have been removed by a previous handler */
+    if(select_callback[fd] == NULL) {
+      continue;
+    }
+    if(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+      FD_SET(fd, &fdr);
+    }
+    if(events[i].events & EPOLLOUT) {
+      FD_SET(fd, &fdw);
+    }
+    select_callback[fd]->handle_fd(&fdr, &fdw);
+    FD_CLR(fd, &fdr);
+    FD_CLR(fd, &fdw);
+  }
+  for(i = 0; i < select_nfds && select_nunpollable > 0; i++) {
+    fd = select_fds[i];
+    /* The callback may have been removed by a previous handler */
+    if(!select_unpollable[fd] || select_events[fd] == 0 || select_callback[fd] == NULL) {
+      continue;
+    }
+    if(select_events[fd] & EPOLLIN) {
+      FD_SET(fd, &fdr);
+    }
+    if(select_events[fd] & EPOLLOUT) {
+      FD_SET(fd, &fdw);
+    }
+    select_callback[fd]->handle_fd(&fdr, &fdw);
+    FD_CLR(fd, &fdr);
+    FD_CLR(fd, &fdw);
+  }
+}
+#endif /* SELECT_EPOLL */
+/*---------------------------------------------------------------------------*/
 int
 select_set_callback(int fd, const struct select_callback *callback)
 {
@@ -106,6 +327,9 @@ select_set_callback(int fd, const struct select_callback *callback)
       callback = NULL;
     }
 
+#if SELECT_EPOLL
+    select_epoll_update(fd, callback);
+#endif
     select_callback[fd] = callback;
 
     /* Update fd max */
@@ -210,6 +434,14 @@ main(int argc, char **argv)
 #endif
 #endif
 
+#if SELECT_EPOLL
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if(epoll_fd == -1) {
+    perror("epoll_create1");
+    return 1;
+  }
+#endif
+
   process_init();
   process_start(&etimer_process, NULL);
   ctimer_init();
@@ -263,6 +495,19 @@ main(int argc, char **argv)
 #if ! CETIC_6LBR
   select_set_callback(STDIN_FILENO, &stdin_fd);
 #endif
+#if SELECT_EPOLL
+  while(1) {
+    select_epoll_wait(process_run());
+
+    etimer_request_poll();
+
+#if WITH_GUI
+    if(console_resize()) {
+       ctk_restore();
+    }
+#endif /* WITH_GUI */
+  }
+#else
   while(1) {
     fd_set fdr;
     fd_set fdw;
@@ -307,6 +552,7 @@ main(int argc, char **argv)
     }
 #endif /* WITH_GUI */
   }
+#endif /* SELECT_EPOLL */
 
   return 0;
 }